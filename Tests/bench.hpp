@@ -0,0 +1,44 @@
+#pragma once
+
+#include "utils.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Benchmarks of the core
+// Built along with the tests but not registered with CTest, run them by hand on a quiet machine. Timings come from
+// QpcNow(), so they are comparable across both platforms.
+
+// Keeps the value, and whatever computed it, from being optimized out
+template <typename T>
+inline void DoNotOptimize(const T& value) noexcept {
+#ifdef _MSC_VER
+	static const void* volatile sink;
+	sink = &value;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r"(&value) : "memory");
+#endif
+}
+
+// Run body() iterations times after a tenth of that as warm-up, and print the mean time of one
+// \return nanoseconds per iteration
+template <typename Fn>
+double RunBenchmark(std::string_view name, int64_t iterations, Fn&& body) {
+	for (int64_t i = 0; i < iterations / 10; ++i)
+		body();
+
+	int64_t begin = QpcNow();
+	for (int64_t i = 0; i < iterations; ++i)
+		body();
+	int64_t end = QpcNow();
+
+	double ns = static_cast<double>(end - begin) * 1e9 / static_cast<double>(QpcFrequency()) / static_cast<double>(iterations);
+	std::printf("%-48.*s %10.1f ns\n", static_cast<int>(name.size()), name.data(), ns);
+	return ns;
+}
@@ -0,0 +1,42 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "ds4report.hpp"
+
+// Packing DS4 reports, and advancing the mouse driven touchpad
+
+static void BenchPack() {
+	DS4_REPORT_EX rep;
+	DS4Motion m;
+	XUSB_REPORT s = {};
+	uint32_t i = 0;
+	RunBenchmark("PackDS4Report()", 50'000'000, [&] {
+		// Changing inputs, so that nothing is hoisted out of the loop
+		++i;
+		s.sThumbLX = static_cast<SHORT>(i);
+		s.wButtons = static_cast<USHORT>(i * 2654435761u >> 16);
+		s.bLeftTrigger = static_cast<BYTE>(i);
+		m.touchX = static_cast<float>(i & 1023);
+		PackDS4Report(s, m, static_cast<uint16_t>(i), rep);
+		DoNotOptimize(rep);
+	});
+}
+
+static void BenchTouchpad() {
+	constexpr int64_t kFreq = 10'000'000;
+	ConfigDS4 cfg;
+	cfg.mouseMode = DS4MouseMode::Touchpad;
+	DS4Motion m;
+	int64_t i = 0;
+	RunBenchmark("DS4Motion::AddMotion() + Advance(), touchpad", 50'000'000, [&] {
+		++i;
+		m.AddMotion(static_cast<float>(i & 7) - 3, 1, kFreq + i * 10'000);
+		m.Advance(cfg, kFreq + i * 10'000 + 5'000, kFreq);
+		DoNotOptimize(m);
+	});
+}
+
+int main() {
+	BenchPack();
+	BenchTouchpad();
+}
@@ -0,0 +1,211 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "fakes.hpp"
+
+#include <memory>
+#include <random>
+
+// FeederEngine's per-event and per-tick costs, through the fake host and sink
+
+using namespace std::literals;
+
+// Every gamepad has both sticks on the mouse, and the one mouse drives them all
+static Config MakeMouseStickConfig(int padCount) {
+	std::string doc = std::format("[Profiles.Default]\nXboxCount = {}\nRoutes = [{{ Device = \"mouse\", Kind = \"mouse\", Pads = [", padCount);
+	for (int i = 0; i < padCount; ++i)
+		doc += std::format("{}{}", i == 0 ? "" : ", ", i);
+	doc += "] }]\n";
+	for (int i = 0; i < padCount; ++i)
+		doc += "[[Profiles.Default.Gamepads]]\nLStick = { Type = \"mouse\", Deadzone = 0.05 }\nRStick = { Type = \"mouse\", NonLinearSensitivity = 0.6 }\n";
+	return Config(toml::parse(doc));
+}
+
+// One sampler tick: filters, the stick kernel, and a report per gamepad
+static void BenchUpdate(int padCount) {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, MakeMouseStickConfig(padCount));
+	auto mouse = MakeFakeDevice(IdevKind::Mouse, 0, "mouse");
+	engine.AttachDevice(mouse);
+
+	int i = 0;
+	RunBenchmark(std::format("Update(), {} pad{} with mouse sticks", padCount, padCount == 1 ? "" : "s"), 1'000'000, [&] {
+		// Keeps the filters moving, so that the sampler never comes to rest
+		if ((++i & 7) == 0)
+			engine.HandleMouseMovement(mouse, i % 13 - 6, i % 7 - 3, InputTimestamp{ QpcNow(), 0, 0 });
+		engine.Update();
+	});
+}
+
+// Every gamepad has face and shoulder buttons, triggers and the left stick on the one keyboard
+// With keymaps, each also has a multi-button key, a layer and a chord.
+static Config MakeKeyboardConfig(int padCount, bool keymaps) {
+	std::string doc = std::format("[Profiles.Default]\nXboxCount = {}\nRoutes = [{{ Device = \"keyboard\", Kind = \"keyboard\", Pads = [", padCount);
+	for (int i = 0; i < padCount; ++i)
+		doc += std::format("{}{}", i == 0 ? "" : ", ", i);
+	doc += "] }]\n";
+	for (int i = 0; i < padCount; ++i)
+		doc += "[[Profiles.Default.Gamepads]]\n"
+			"A = \"Space\"\nB = \"E\"\nX = \"R\"\nY = \"F\"\nLB = \"Q\"\nRB = \"C\"\nLT = \"LShift\"\nRT = \"LCtrl\"\n"
+			"LStickUp = \"W\"\nLStickDown = \"S\"\nLStickLeft = \"A\"\nLStickRight = \"D\"\n"
+			+ (keymaps ? "MultiKeys = { G = [\"A\", \"B\"] }\n"
+				"Layers = [{ Key = \"Tab\", Buttons = { E = [\"Y\"], R = [\"LB\"] } }]\n"
+				"Chords = [{ Keys = [\"Z\", \"X\"], Buttons = [\"RB\"] }]\n"s : ""s);
+	return Config(toml::parse(doc));
+}
+
+// Keys toggling at random: 70% buttons, 25% stick directions, 5% unbound
+// Which with keymaps makes the unbound ones keymap keys, and E and R layered.
+static std::vector<BYTE> MakeKeyTrace() {
+	const BYTE buttons[] = { VK_SPACE, 'E', 'R', 'F', 'Q', 'C', VK_LSHIFT, VK_LCONTROL };
+	const BYTE stick[] = { 'W', 'S', 'A', 'D' };
+	const BYTE unbound[] = { 'Z', 'X', VK_TAB, 'G' };
+	std::mt19937 rng(3);
+	std::vector<BYTE> trace;
+	for (int i = 0; i < 2'000'000; ++i) {
+		auto r = rng() % 100;
+		trace.push_back(r < 70 ? buttons[rng() % std::size(buttons)] : r < 95 ? stick[rng() % std::size(stick)] : unbound[rng() % std::size(unbound)]);
+	}
+	return trace;
+}
+
+// HandleKeyPress() as it was before key bindings were compiled per gamepad, to compare against in the same run
+// Every gamepad is walked and matched by device, and the bound button goes through one switch for all kinds. Reports
+// and latency are recorded as the engine does, so both do the same work for each gamepad a key reaches.
+struct ReferenceKeyDispatch {
+	std::vector<X360Gamepad> x360s;
+	std::vector<ConfigGamepad> gamepads;
+	std::vector<HANDLE> srcKbds;
+	std::vector<BYTE> stickKeys;
+	X360Button btns[kMaxX360Count][0x100];
+	GamepadLatency x360Latency[kMaxX360Count];
+
+	ReferenceKeyDispatch(GamepadSink& sink, const ConfigProfile& profile, HANDLE hKbd) {
+		x360s.reserve(profile.gamepads.size());
+		for (int gamepadId = 0; gamepadId < profile.gamepads.size(); ++gamepadId) {
+			x360s.emplace_back(sink, GamepadKind::X360);
+			gamepads.push_back(profile.gamepads[gamepadId]);
+			srcKbds.push_back(hKbd);
+			stickKeys.push_back(0);
+			PopulateBtnLut(gamepadId);
+		}
+	}
+
+	void PopulateBtnLut(int gamepadId) {
+		std::ranges::fill(btns[gamepadId], X360Button::None);
+		for (int i = 0; i < kX360ButtonCount; ++i) {
+			KeyCode key = gamepads[gamepadId].buttons[i];
+			if (key != 0xFF)
+				btns[gamepadId][key] = static_cast<X360Button>(i);
+		}
+	}
+
+	void HandleKeyPress(HANDLE hDevice, BYTE vkey, bool pressed, const InputTimestamp& ts) {
+		using enum X360Button;
+		for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+			auto& dev = x360s[gamepadId];
+			auto& gamepad = gamepads[gamepadId];
+
+			if (dev.pendingRebindKbd) {
+				srcKbds[gamepadId] = hDevice;
+				dev.pendingRebindKbd = false;
+			}
+			if (srcKbds[gamepadId] != hDevice) continue;
+
+			if (dev.pendingRebindBtn != None) {
+				gamepad.buttons[std::to_underlying(dev.pendingRebindBtn)] = vkey;
+				PopulateBtnLut(gamepadId);
+				dev.pendingRebindBtn = None;
+			}
+
+			// Bits in stickKeys corresponding to each direction
+			enum { LUp, LDown, LLeft, LRight, RUp, RDown, RLeft, RRight };
+			auto& keys = stickKeys[gamepadId];
+			auto hasBit = [&](int nth) { return (keys & (1 << nth)) != 0; };
+
+			X360Button btn = btns[gamepadId][vkey];
+			if (btn == None)
+				continue;
+			if (IsX360ButtonDirectMap(btn)) {
+				dev.SetButton(X360ButtonToViGEm(btn), pressed);
+			}
+			else switch (btn) {
+			case LeftTrigger: dev.SetLeftTrigger(pressed ? 0xFF : 0x00); break;
+			case RightTrigger: dev.SetRightTrigger(pressed ? 0xFF : 0x00); break;
+			case LStickUp: SetUnsetBit(keys, LUp, pressed); goto lstick;
+			case LStickDown: SetUnsetBit(keys, LDown, pressed); goto lstick;
+			case LStickLeft: SetUnsetBit(keys, LLeft, pressed); goto lstick;
+			case LStickRight: SetUnsetBit(keys, LRight, pressed); goto lstick;
+			lstick: {
+				auto val = static_cast<SHORT>(MAXSHORT * gamepad.lstick.speed);
+				dev.SetStickLX((hasBit(LRight) ? val : 0) - (hasBit(LLeft) ? val : 0));
+				dev.SetStickLY((hasBit(LUp) ? val : 0) - (hasBit(LDown) ? val : 0));
+			} break;
+			case RStickUp: SetUnsetBit(keys, RUp, pressed); goto rstick;
+			case RStickDown: SetUnsetBit(keys, RDown, pressed); goto rstick;
+			case RStickLeft: SetUnsetBit(keys, RLeft, pressed); goto rstick;
+			case RStickRight: SetUnsetBit(keys, RRight, pressed); goto rstick;
+			rstick: {
+				auto val = static_cast<SHORT>(MAXSHORT * gamepad.rstick.speed);
+				dev.SetStickRX((hasBit(RRight) ? val : 0) - (hasBit(RLeft) ? val : 0));
+				dev.SetStickRY((hasBit(RUp) ? val : 0) - (hasBit(RDown) ? val : 0));
+			} break;
+			default: break;
+			}
+
+			dev.SendReport();
+			x360Latency[gamepadId].Record(ts, QpcNow());
+		}
+	}
+};
+
+// The key trace through ReferenceKeyDispatch, with the plain bindings of MakeKeyboardConfig()
+static void BenchReferenceKeyPress(int padCount) {
+	FakeSink sink;
+	auto config = MakeKeyboardConfig(padCount, false);
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard");
+	auto ref = std::make_unique<ReferenceKeyDispatch>(sink, config.profiles.begin()->second, kbd.hDevice);
+
+	auto trace = MakeKeyTrace();
+	bool pressed[0x100] = {};
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	size_t i = 0;
+	RunBenchmark(std::format("Reference dispatch, {} pad{}", padCount, padCount == 1 ? "" : "s"), 10'000'000, [&] {
+		BYTE key = trace[i++ % trace.size()];
+		pressed[key] = !pressed[key];
+		ref->HandleKeyPress(kbd.hDevice, key, pressed[key], ts);
+	});
+}
+
+// One key event from a keyboard routed to every gamepad
+static void BenchKeyPress(int padCount, bool keymaps) {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, MakeKeyboardConfig(padCount, keymaps));
+	if (keymaps && !WaitForKeymaps(host, engine))
+		return;
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard");
+	engine.AttachDevice(kbd);
+
+	auto trace = MakeKeyTrace();
+	bool pressed[0x100] = {};
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	size_t i = 0;
+	RunBenchmark(std::format("HandleKeyPress(), {} pad{}{}", padCount, padCount == 1 ? "" : "s", keymaps ? " with keymaps" : ""), 10'000'000, [&] {
+		BYTE key = trace[i++ % trace.size()];
+		pressed[key] = !pressed[key];
+		engine.HandleKeyPress(kbd, key, pressed[key], ts);
+	});
+}
+
+int main() {
+	BenchUpdate(1);
+	BenchUpdate(4);
+	BenchReferenceKeyPress(1);
+	BenchKeyPress(1, false);
+	BenchReferenceKeyPress(4);
+	BenchKeyPress(4, false);
+	BenchKeyPress(1, true);
+	BenchKeyPress(4, true);
+}
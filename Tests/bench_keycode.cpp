@@ -0,0 +1,124 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "keycode.hpp"
+
+#include <bitset>
+#include <random>
+#include <unordered_map>
+
+// Key name lookups, as done for every binding while loading a config
+
+// The names of 1000 profiles x 4 gamepads x 24 bindings, as std::string like toml++ hands them out
+static std::vector<std::string> MakeBindingNames() {
+	std::vector<std::string_view> known;
+	for (int k = 0; k <= 0xFF; ++k)
+		if (auto name = KeyCodeToString(static_cast<KeyCode>(k)); name != "<unknown>")
+			known.push_back(name);
+
+	std::mt19937 rng(1);
+	std::vector<std::string> names;
+	for (int i = 0; i < 1000 * 4 * 24; ++i)
+		names.emplace_back(known[rng() % known.size()]);
+	return names;
+}
+
+static void BenchFromString() {
+	auto names = MakeBindingNames();
+
+	size_t i = 0;
+	RunBenchmark("KeyCodeFromString()", 10'000'000, [&] {
+		DoNotOptimize(KeyCodeFromString(names[i++ % names.size()]));
+	});
+
+	// What the perfect hash replaces, along with building it on startup
+	std::unordered_map<std::string_view, KeyCode> map;
+	RunBenchmark("Build std::unordered_map of names", 1000, [&] {
+		map.clear();
+		for (int k = 0; k <= 0xFF; ++k)
+			map.emplace(KeyCodeToString(static_cast<KeyCode>(k)), static_cast<KeyCode>(k));
+	});
+	RunBenchmark("std::unordered_map::find()", 10'000'000, [&] {
+		auto it = map.find(names[i++ % names.size()]);
+		DoNotOptimize(it != map.end() ? it->second : 0xFF);
+	});
+}
+
+// Keyboard raw input decoding, per event
+struct RawKey {
+	USHORT makeCode, flags, vKey;
+};
+
+// Press/release pairs weighted towards WASD and modifiers, as while gaming
+static std::vector<RawKey> MakeKeyTrace() {
+	struct Key {
+		USHORT makeCode, flags;
+		KeyCode key;
+	};
+	std::vector<Key> all;
+	for (USHORT flags : { USHORT(0), USHORT(RI_KEY_E0), USHORT(RI_KEY_E1) })
+		for (USHORT makeCode = 0; makeCode <= 0x7F; ++makeCode)
+			if (KeyCode key = KeyCodeFromScanCode(makeCode, flags); key != 0xFF)
+				all.push_back({ makeCode, flags, key });
+	const Key hot[] = {
+		{ 0x11, 0, 'W' }, { 0x1E, 0, 'A' }, { 0x1F, 0, 'S' }, { 0x20, 0, 'D' }, { 0x2A, 0, VK_LSHIFT },
+		{ 0x1D, 0, VK_LCONTROL }, { 0x39, 0, VK_SPACE }, { 0x12, 0, 'E' }, { 0x13, 0, 'R' },
+		{ 0x48, RI_KEY_E0, VK_UP }, { 0x1D, RI_KEY_E0, VK_RCONTROL }, { 0x38, 0, VK_LMENU },
+	};
+
+	// What Windows reports as RAWKEYBOARD::VKey, with the sides of the modifiers folded together
+	auto ToVKey = [](KeyCode key) -> USHORT {
+		switch (key) {
+		case VK_LSHIFT: case VK_RSHIFT: return VK_SHIFT;
+		case VK_LCONTROL: case VK_RCONTROL: return VK_CONTROL;
+		case VK_LMENU: case VK_RMENU: return VK_MENU;
+		default: return key;
+		}
+	};
+
+	std::mt19937 rng(7);
+	std::vector<RawKey> trace;
+	for (int i = 0; i < 1'000'000; ++i) {
+		const Key& k = rng() % 4 ? hot[rng() % std::size(hot)] : all[rng() % all.size()];
+		trace.push_back({ k.makeCode, k.flags, ToVKey(k.key) });
+		trace.push_back({ k.makeCode, static_cast<USHORT>(k.flags | RI_KEY_BREAK), ToVKey(k.key) });
+	}
+	return trace;
+}
+
+static void BenchDecode() {
+	auto trace = MakeKeyTrace();
+
+	std::bitset<0x100> keyStates;
+	auto Track = [&](const RawKey& e, KeyCode key) {
+		if (key == 0xFF)
+			return;
+		bool pressed = !(e.flags & RI_KEY_BREAK);
+		if (keyStates[key] != pressed)
+			keyStates.set(key, pressed);
+	};
+
+	size_t i = 0;
+	RunBenchmark("Scan code mode, decode + key state", 20'000'000, [&] {
+		const auto& e = trace[i++ % trace.size()];
+		Track(e, KeyCodeFromScanCode(e.makeCode, e.flags));
+	});
+	RunBenchmark("Vkey mode, decode + key state", 20'000'000, [&] {
+		const auto& e = trace[i++ % trace.size()];
+		KeyCode key;
+		bool e0 = e.flags & RI_KEY_E0;
+		switch (e.vKey) {
+		case VK_SHIFT: key = e.makeCode == 0x36 ? VK_RSHIFT : VK_LSHIFT; break;
+		case VK_CONTROL: key = e0 ? VK_RCONTROL : VK_LCONTROL; break;
+		case VK_MENU: key = e0 ? VK_RMENU : VK_LMENU; break;
+		default: key = static_cast<KeyCode>(e.vKey); break;
+		}
+		Track(e, key);
+	});
+	DoNotOptimize(keyStates);
+}
+
+int main() {
+	BenchFromString();
+	BenchDecode();
+}
@@ -0,0 +1,61 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "keymap.hpp"
+
+#include <memory>
+#include <random>
+
+// Keymap compilation, and key events through the compiled tables on their own
+
+using namespace std::literals;
+
+// 4 layers of 8 keys, 3 chords and a multi-button key
+constexpr auto kConfig = R"(
+[Profiles.Default]
+XboxCount = 1
+[[Profiles.Default.Gamepads]]
+MultiKeys = { Q = ["LB", "RB"] }
+Chords = [
+	{ Keys = ["J", "K"], Buttons = ["X"] },
+	{ Keys = ["J", "K", "L"], Buttons = ["Y"] },
+	{ Keys = ["U", "V"], Buttons = ["A"] },
+]
+Layers = [
+	{ Key = "F1", Buttons = { A = ["A"], B = ["B"], C = ["X"], D = ["Y"], E = ["LB"], F = ["RB"], G = ["Back"], H = ["Start"] } },
+	{ Key = "F2", Buttons = { B = ["A"], C = ["B"], D = ["X"], E = ["Y"], F = ["LB"], G = ["RB"], H = ["Back"], I = ["Start"] } },
+	{ Key = "F3", Buttons = { C = ["A"], D = ["B"], E = ["X"], F = ["Y"], G = ["LB"], H = ["RB"], I = ["Back"], J = ["Start"] } },
+	{ Key = "F4", Buttons = { D = ["A"], E = ["B"], F = ["X"], G = ["Y"], H = ["LB"], I = ["RB"], J = ["Back"], K = ["Start"] } },
+]
+)"sv;
+
+static void BenchKeymap() {
+	Config config(toml::parse(kConfig));
+	auto& gamepad = config.profiles.at("Default").gamepads.at(0);
+	auto tables = std::make_unique<KeymapTables>();
+
+	RunBenchmark("CompileKeymap(), 4 layers and 3 chords", 100'000, [&] {
+		CompileKeymap(gamepad, *tables);
+		DoNotOptimize(*tables);
+	});
+
+	const KeyCode keys[] = { 'A', 'B', 'C', 'D', 'J', 'K', 'L', 'Q', 'U', 'V', VK_F1, VK_F2, VK_F3, VK_F4 };
+	std::mt19937 rng(7);
+	std::vector<std::pair<KeyCode, bool>> trace(1 << 20);
+	for (auto& [key, pressed] : trace) {
+		key = keys[rng() % std::size(keys)];
+		pressed = rng() & 1;
+	}
+
+	auto state = std::make_unique<KeymapState>();
+	USHORT wButtons = 0;
+	size_t i = 0;
+	RunBenchmark("TranslateKeymapKey(), layer/chord/multi mix", 50'000'000, [&] {
+		auto [key, pressed] = trace[i++ & (trace.size() - 1)];
+		DoNotOptimize(TranslateKeymapKey(*tables, *state, key, pressed, wButtons));
+	});
+}
+
+int main() {
+	BenchKeymap();
+}
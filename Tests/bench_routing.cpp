@@ -0,0 +1,102 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "fakes.hpp"
+#include "routing.hpp"
+
+#include <random>
+
+using namespace std::literals;
+
+// RouteTable lookups against a profile with many routes, and key events fanned out through routes
+
+static std::string MakeDeviceName(int i) {
+	return std::format("\\\\?\\hid#vid_{:04x}&pid_{:04x}#7&{:x}&0&0000#{{884b96c3}}", i, i, i * 7919);
+}
+
+static void BenchReattach() {
+	constexpr int kRouteCount = 2000;
+	std::vector<ConfigRoute> routes(kRouteCount);
+	for (int i = 0; i < kRouteCount; ++i)
+		routes[i] = { MakeDeviceName(i), IdevKind::Keyboard, static_cast<uint32_t>(i << 16 | i), 0, 1 };
+
+	RouteTable t;
+	RunBenchmark("Index(), 2000 routes", 100, [&] { t.Index(routes); });
+
+	int i = 0;
+	RunBenchmark("Attach+ResolveSlot+Detach, 2000 routes", 200'000, [&] {
+		auto& route = routes[(i++ * 31) % kRouteCount];
+		auto slot = t.Attach(reinterpret_cast<HANDLE>(static_cast<uintptr_t>(i)), route.device, IdevKind::Keyboard, route.vidPid);
+		DoNotOptimize(t.ResolveSlot(slot, routes, 4));
+		t.Detach(slot);
+	});
+
+	// What the index replaces
+	RunBenchmark("Linear search by name, 2000 routes", 20'000, [&] {
+		auto name = NormalizeDeviceName(routes[(i++ * 31) % kRouteCount].device);
+		auto it = std::ranges::find_if(routes, [&](const ConfigRoute& r) { return NormalizeDeviceName(r.device) == name; });
+		DoNotOptimize(it);
+	});
+}
+
+// Key events from 16 keyboards, each routed to the gamepads padsOf(device) with the X360Buttons buttonsOf(device)
+// Gamepads are capped at kMaxX360Count (4), so this is 16 devices x 4 pads.
+template <typename PadsOf, typename ButtonsOf>
+static void BenchFanOut(std::string_view name, PadsOf&& padsOf, ButtonsOf&& buttonsOf) {
+	std::string doc = std::format("[Profiles.Default]\nXboxCount = {}\n", kMaxX360Count);
+	for (int i = 0; i < kMaxX360Count; ++i)
+		doc += "[[Profiles.Default.Gamepads]]\nA = \"Space\"\nB = \"E\"\nX = \"R\"\nY = \"F\"\nLB = \"Q\"\nRB = \"C\"\n"
+			"DPadUp = \"W\"\nDPadDown = \"S\"\nDPadLeft = \"A\"\nDPadRight = \"D\"\n";
+	for (int i = 0; i < kMaxRouteDevices; ++i) {
+		doc += std::format("[[Profiles.Default.Routes]]\nDevice = \"keyboard-{}\"\nKind = \"keyboard\"\nPads = [", i);
+		int pads = padsOf(i);
+		for (int p = 0, n = 0; p < kMaxX360Count; ++p) {
+			if (pads & (1 << p))
+				doc += std::format("{}{}", n++ == 0 ? "" : ", ", p);
+		}
+		doc += "]\n";
+		if (auto buttons = buttonsOf(i); !buttons.empty())
+			doc += std::format("Buttons = {}\n", buttons);
+	}
+
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(doc)));
+	std::vector<InputDevice> kbds;
+	for (int i = 0; i < kMaxRouteDevices; ++i) {
+		kbds.push_back(MakeFakeDevice(IdevKind::Keyboard, i, std::format("keyboard-{}", i)));
+		engine.AttachDevice(kbds.back());
+	}
+
+	// Random keys of random devices, toggling
+	const BYTE keys[] = { VK_SPACE, 'E', 'R', 'F', 'Q', 'C', 'W', 'S', 'A', 'D' };
+	std::mt19937 rng(5);
+	std::vector<std::pair<uint8_t, BYTE>> trace(1 << 20);
+	for (auto& [device, key] : trace) {
+		device = static_cast<uint8_t>(rng() % kMaxRouteDevices);
+		key = keys[rng() % std::size(keys)];
+	}
+	bool pressed[kMaxRouteDevices][0x100] = {};
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	size_t i = 0;
+	RunBenchmark(name, 10'000'000, [&] {
+		auto [device, key] = trace[i++ & (trace.size() - 1)];
+		bool& p = pressed[device][key];
+		p = !p;
+		engine.HandleKeyPress(kbds[device], key, p, ts);
+	});
+}
+
+static void BenchFanOut() {
+	auto all = [](int) { return ""s; };
+	BenchFanOut("HandleKeyPress(), 16 kbds, 1 pad each", [](int i) { return 1 << (i % kMaxX360Count); }, all);
+	BenchFanOut("HandleKeyPress(), 16 kbds merged into pad 0", [](int) { return 1; }, all);
+	BenchFanOut("HandleKeyPress(), 16 kbds x 4 pads", [](int) { return (1 << kMaxX360Count) - 1; }, all);
+	BenchFanOut("HandleKeyPress(), 16 kbds x 4 pads, half subsets", [](int) { return (1 << kMaxX360Count) - 1; },
+		[](int i) { return i & 1 ? "[\"A\", \"B\", \"DPadUp\", \"DPadDown\"]"s : ""s; });
+}
+
+int main() {
+	BenchReattach();
+	BenchFanOut();
+}
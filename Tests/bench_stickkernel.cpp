@@ -0,0 +1,78 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "stickkernel.hpp"
+#include "stickreference.hpp"
+
+#include <random>
+
+// One sampler tick of mouse sticks: the SIMD kernel, its scalar instantiation, and the per-stick reference it replaced
+// 16 pads are four full batches, as a batch holds the kMaxX360Count gamepads of one engine.
+
+static void FillBatch(MouseStickBatch& b, std::mt19937& rng, std::vector<ConfigJoystick>& confs) {
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int lane = 0; lane < MouseStickBatch::kLaneCount; ++lane) {
+		ConfigJoystick conf;
+		conf.useMouse = true;
+		conf.sensitivity = MouseStickBatch::kNeutralSensitivity;
+		conf.deadzone = unit(rng) * 0.2f;
+		conf.nonLinear = 0.5f + unit(rng);
+		b.SetLaneParams(lane, conf);
+		confs.push_back(conf);
+	}
+}
+
+static void BenchPads(int padCount) {
+	int batchCount = (padCount * 2 + MouseStickBatch::kLaneCount - 1) / MouseStickBatch::kLaneCount;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> defl(-15.0f, 15.0f);
+
+	auto batches = std::make_unique<MouseStickBatch[]>(batchCount);
+	std::vector<ConfigJoystick> confs;
+	for (int i = 0; i < batchCount; ++i)
+		FillBatch(batches[i], rng, confs);
+	// Changing inputs, so that nothing is hoisted out of the loop
+	std::vector<float> inputs(1024);
+	for (float& v : inputs)
+		v = defl(rng);
+
+	int tick = 0;
+	auto SetInputs = [&] {
+		++tick;
+		for (int i = 0; i < batchCount; ++i) {
+			for (int lane = 0; lane < MouseStickBatch::kLaneCount; ++lane) {
+				batches[i].deflX[lane] = inputs[(tick + lane) & 1023];
+				batches[i].deflY[lane] = inputs[(tick * 3 + lane) & 1023];
+			}
+		}
+	};
+
+	RunBenchmark(std::format("Compute(), {} pads", padCount), 1'000'000, [&] {
+		SetInputs();
+		for (int i = 0; i < batchCount; ++i)
+			batches[i].Compute(0.0f);
+		DoNotOptimize(batches[0].outX[0]);
+	});
+	RunBenchmark(std::format("ComputeScalar(), {} pads", padCount), 1'000'000, [&] {
+		SetInputs();
+		for (int i = 0; i < batchCount; ++i)
+			batches[i].ComputeScalar(0.0f);
+		DoNotOptimize(batches[0].outX[0]);
+	});
+	RunBenchmark(std::format("Reference, {} pads", padCount), 1'000'000, [&] {
+		SetInputs();
+		for (int i = 0; i < batchCount; ++i) {
+			for (int lane = 0; lane < MouseStickBatch::kLaneCount; ++lane) {
+				short x, y;
+				stickref::ComputeStick(batches[i].deflX[lane], batches[i].deflY[lane], confs[i * MouseStickBatch::kLaneCount + lane], 0.0f, x, y);
+				DoNotOptimize(x);
+				DoNotOptimize(y);
+			}
+		}
+	});
+}
+
+int main() {
+	BenchPads(4);
+	BenchPads(16);
+}
@@ -0,0 +1,40 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "../WndMsgFilter/suppressmask.hpp"
+
+#include <memory>
+#include <random>
+
+// The hook's per-message decision, in every hooked process, with 4 keyboards published
+
+static void BenchDecision() {
+	auto t = std::make_unique<SuppressMaskTable>();
+	uint64_t keys[4] = { 0x00FF00FF00FF00FF, 0, 0x0F0F0F0F0F0F0F0F, 0 };
+	for (int i = 0; i < 4; ++i)
+		WriteSuppressDeviceEntry(t->devices[i], 0x100 + i, keys);
+	UpdateSuppressAnyDevice(*t);
+
+	std::vector<uint8_t> trace(1 << 20);
+	std::mt19937 rng(1);
+	for (auto& key : trace)
+		key = static_cast<uint8_t>(rng());
+
+	size_t i = 0;
+	RunBenchmark("WM_KEYDOWN, any device", 50'000'000, [&] {
+		DoNotOptimize(IsKeySuppressed(*t, trace[i++ & (trace.size() - 1)]));
+	});
+	RunBenchmark("WM_INPUT, device in the first entry", 50'000'000, [&] {
+		DoNotOptimize(IsKeySuppressed(*t, 0x100, trace[i++ & (trace.size() - 1)]));
+	});
+	RunBenchmark("WM_INPUT, device in the 4th entry", 50'000'000, [&] {
+		DoNotOptimize(IsKeySuppressed(*t, 0x103, trace[i++ & (trace.size() - 1)]));
+	});
+	RunBenchmark("WM_INPUT, unknown device", 50'000'000, [&] {
+		DoNotOptimize(IsKeySuppressed(*t, 0x999, trace[i++ & (trace.size() - 1)]));
+	});
+}
+
+int main() {
+	BenchDecision();
+}
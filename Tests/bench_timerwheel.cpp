@@ -0,0 +1,72 @@
+#include "pch.hpp"
+
+#include "bench.hpp"
+#include "timerwheel.hpp"
+
+#include <map>
+#include <random>
+
+// Timer wheel operations with 16 gamepads x 256 timers armed, re-arming on fire like turbo does
+
+struct BenchTimer : TimerNode {
+	TimerWheel* wheel = nullptr;
+	uint64_t period = 0;
+};
+
+static void BenchWheel() {
+	constexpr int kTimerCount = 16 * 256;
+	std::mt19937_64 rng(1);
+
+	TimerWheel w;
+	std::vector<BenchTimer> ts(kTimerCount);
+	for (int i = 0; i < kTimerCount; ++i) {
+		auto& t = ts[i];
+		t.wheel = &w;
+		t.period = 20 + i % 200;
+		t.fire = [](TimerNode& node) noexcept {
+			auto& t = static_cast<BenchTimer&>(node);
+			t.wheel->Schedule(t, t.period);
+		};
+		w.Schedule(t, 1 + rng() % 2000);
+	}
+
+	int64_t op = 0;
+	RunBenchmark("TimerWheel, schedule/cancel, 4096 timers", 10'000'000, [&] {
+		auto& t = ts[rng() % kTimerCount];
+		if (op & 1)
+			w.Cancel(t);
+		else
+			w.Schedule(t, 1 + rng() % 4000);
+		if ((op++ & 15) == 0)
+			w.AdvanceTo(w.GetCurrentTick() + 4);
+	});
+
+	// What a wheel saves over an ordered container
+	std::multimap<uint64_t, int> map;
+	std::vector<std::multimap<uint64_t, int>::iterator> its(kTimerCount, map.end());
+	uint64_t now = 0;
+	for (int i = 0; i < kTimerCount; ++i)
+		its[i] = map.emplace(now + 1 + rng() % 2000, i);
+	op = 0;
+	RunBenchmark("std::multimap, schedule/cancel, 4096 timers", 10'000'000, [&] {
+		int i = static_cast<int>(rng() % kTimerCount);
+		if (its[i] != map.end()) {
+			map.erase(its[i]);
+			its[i] = map.end();
+		}
+		if (!(op & 1))
+			its[i] = map.emplace(now + 1 + rng() % 4000, i);
+		if ((op++ & 15) == 0) {
+			now += 4;
+			while (!map.empty() && map.begin()->first <= now) {
+				int j = map.begin()->second;
+				map.erase(map.begin());
+				its[j] = map.emplace(now + ts[j].period, j);
+			}
+		}
+	});
+}
+
+int main() {
+	BenchWheel();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Checks for the core's tests
+// Each test is an executable registered with CTest, which fails when main() returns non-zero, see TestResult(). A failed
+// check prints where it was and carries on, so that one run shows everything that is broken.
+
+inline int gChecksRun = 0;
+inline int gChecksFailed = 0;
+
+template <typename T>
+std::string CheckValueToString(const T& v) {
+	if constexpr (std::is_enum_v<T>)
+		return std::to_string(std::to_underlying(v));
+	else if constexpr (std::is_integral_v<T>)
+		// Unlike operator<<, prints uint8_t as a number
+		return std::to_string(v);
+	else if constexpr (requires(std::ostream& os) { os << v; }) {
+		std::ostringstream ss;
+		ss << v;
+		return ss.str();
+	}
+	else
+		return "?";
+}
+
+inline bool CheckImpl(bool ok, const char* expr, const char* file, int line) {
+	++gChecksRun;
+	if (!ok) {
+		++gChecksFailed;
+		std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+	}
+	return ok;
+}
+
+template <typename A, typename B>
+bool CheckEqImpl(const A& a, const B& b, const char* exprA, const char* exprB, const char* file, int line) {
+	++gChecksRun;
+	if (a == b)
+		return true;
+	++gChecksFailed;
+	std::printf("%s:%d: CHECK_EQ(%s, %s) failed: %s != %s\n", file, line, exprA, exprB,
+		CheckValueToString(a).c_str(), CheckValueToString(b).c_str());
+	return false;
+}
+
+template <typename A, typename B, typename E>
+bool CheckNearImpl(const A& a, const B& b, const E& eps, const char* exprA, const char* exprB, const char* file, int line) {
+	++gChecksRun;
+	if (a - b <= eps && b - a <= eps)
+		return true;
+	++gChecksFailed;
+	std::printf("%s:%d: CHECK_NEAR(%s, %s) failed: %s != %s within %s\n", file, line, exprA, exprB,
+		CheckValueToString(a).c_str(), CheckValueToString(b).c_str(), CheckValueToString(eps).c_str());
+	return false;
+}
+
+// All return whether the check passed, for a test to skip what depends on it
+#define CHECK(cond) CheckImpl(static_cast<bool>(cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) CheckEqImpl((a), (b), #a, #b, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, eps) CheckNearImpl((a), (b), (eps), #a, #b, __FILE__, __LINE__)
+
+// Return this from main()
+inline int TestResult() {
+	std::printf("%d of %d checks failed\n", gChecksFailed, gChecksRun);
+	return gChecksFailed != 0;
+}
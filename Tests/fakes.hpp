@@ -0,0 +1,95 @@
+#pragma once
+
+#include "enginehost.hpp"
+#include "gamepadsink.hpp"
+#include "modelruntime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Stand-ins for the platform in tests and benchmarks: the engine runs on the test's thread, and nothing fires on its own
+
+// Records what the engine asked for instead of starting timers
+class FakeHost : public EngineHost {
+public:
+	bool samplerRunning = false;
+	int samplerStarts = 0;
+	int samplerPeriodMs = 0;
+	// -1 while no action timer is set
+	int64_t actionTimerDelayMicros = -1;
+	// Set on the keymap compiler thread
+	std::atomic<int> keymapsCompiled = 0;
+
+	bool StartSampler(FeederEngine& engine, int periodMs) noexcept override {
+		samplerRunning = true;
+		++samplerStarts;
+		samplerPeriodMs = periodMs;
+		return true;
+	}
+	void StopSampler() noexcept override { samplerRunning = false; }
+	void SetActionTimer(FeederEngine& engine, int64_t delayMicros) noexcept override { actionTimerDelayMicros = delayMicros; }
+	void CancelActionTimer() noexcept override { actionTimerDelayMicros = -1; }
+	void PostKeymapsCompiled() noexcept override { ++keymapsCompiled; }
+};
+
+// Keeps the last report of each gamepad
+// Handles are the index into targets plus one, so the first gamepad plugged is targets[0].
+class FakeSink : public GamepadSink {
+public:
+	struct Target {
+		GamepadKind kind;
+		bool plugged = true;
+		int reportCount = 0;
+		XUSB_REPORT x360 = {};
+		DS4_REPORT_EX ds4 = {};
+	};
+	std::vector<Target> targets;
+
+	// Reserved up front, so that a test counting allocations isn't thrown off by this
+	FakeSink() { targets.reserve(16); }
+
+	void* Plug(GamepadKind kind) override {
+		targets.push_back({ kind });
+		return reinterpret_cast<void*>(targets.size());
+	}
+	void Unplug(void* target) noexcept override { At(target).plugged = false; }
+	void SubmitX360(void* target, const XUSB_REPORT& report) noexcept override {
+		auto& t = At(target);
+		t.x360 = report;
+		++t.reportCount;
+	}
+	void SubmitDS4(void* target, const DS4_REPORT_EX& report) noexcept override {
+		auto& t = At(target);
+		t.ds4 = report;
+		++t.reportCount;
+	}
+
+private:
+	Target& At(void* target) noexcept { return targets[reinterpret_cast<uintptr_t>(target) - 1]; }
+};
+
+// Fake devices, named so that config routes can refer to them
+inline InputDevice MakeFakeDevice(IdevKind kind, int n, std::string name = {}) {
+	InputDevice idev;
+	idev.hDevice = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(0x100 + n));
+	idev.nameUtf8 = name.empty() ? std::format("fake-device-{}", n) : std::move(name);
+	idev.kind = kind;
+	return idev;
+}
+
+// What the app's window does when the keymap compiler posts its message
+// \return false if nothing was compiled within a second
+inline bool WaitForKeymaps(FakeHost& host, FeederEngine& engine) {
+	using namespace std::chrono_literals;
+	for (int i = 0; i < 100; ++i) {
+		if (host.keymapsCompiled.exchange(0) > 0) {
+			engine.InstallCompiledKeymaps();
+			return true;
+		}
+		std::this_thread::sleep_for(10ms);
+	}
+	return false;
+}
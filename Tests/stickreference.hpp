@@ -0,0 +1,86 @@
+#pragma once
+
+#include "modelconfig.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// The mouse stick math as it was before MouseStickBatch, one stick at a time with atan2f() and pow(), which the batch
+// has to reproduce
+
+namespace stickref {
+
+constexpr float pi = 3.14159265358979323846f;
+
+inline float Scale(float x, float lowerbound, float upperbound) {
+	return (x - lowerbound) / (upperbound - lowerbound);
+}
+
+// \param phi phi ∈ [-π,π], defines in which direction the stick is tilted.
+// \param tilt tilt ∈ (0,1], defines the amount of tilt. 0 is no tilt, 1 is full tilt.
+inline void CalcJoystickPosition(float phi, float tilt, bool invertX, bool invertY, short& outX, short& outY) {
+	constexpr float kSnapToFullFilt = 0.005f;
+
+	tilt = std::clamp(tilt, 0.0f, 1.0f);
+	tilt = (1 - tilt) < kSnapToFullFilt ? 1 : tilt;
+
+	auto Unnormalize = [](float val) { return static_cast<short>(val * 32767); };
+	auto MoreVerti = [&](float lowerbound, float upperbound, int xDir, int yDir) {
+		if (phi >= lowerbound && phi <= upperbound) {
+			outX = Unnormalize(xDir * tilt * Scale(phi, lowerbound, upperbound));
+			outY = Unnormalize(yDir * tilt);
+			return true;
+		}
+		return false;
+	};
+	auto MoreHoriz = [&](float lowerbound, float upperbound, int xDir, int yDir) {
+		if (phi >= lowerbound && phi <= upperbound) {
+			outX = Unnormalize(xDir * tilt);
+			outY = Unnormalize(yDir * tilt * Scale(phi, lowerbound, upperbound));
+			return true;
+		}
+		return false;
+	};
+
+	int posX = invertX ? -1 : 1;
+	int negX = -posX;
+	int posY = invertY ? -1 : 1;
+	int negY = -posY;
+
+	// Same order as the original cascade, which decides the boundaries
+	if (MoreVerti(pi / 4, pi / 2, posX, posY)) return;
+	if (MoreHoriz(0, pi / 4, posX, posY)) return;
+	if (MoreHoriz(-pi / 4, 0, posX, negY)) return;
+	if (MoreVerti(-pi / 2, -pi / 4, posX, negY)) return;
+	if (MoreVerti(-3 * pi / 4, -pi / 2, negX, negY)) return;
+	if (MoreHoriz(-pi, -3 * pi / 4, negX, negY)) return;
+	if (MoreHoriz(3 * pi / 4, pi, negX, posY)) return;
+	if (MoreVerti(pi / 2, 3 * pi / 4, negX, posY)) return;
+
+	outX = 0;
+	outY = 0;
+}
+
+// One stick, deflection already multiplied by the gain
+// \return the tilt before snapping to full tilt
+inline float ComputeStick(float x, float y, const ConfigJoystick& conf, float bounceBack, short& outX, short& outY) {
+	float outerRadius = std::max(conf.outerRadius, 1.0f);
+	float r = std::sqrt(x * x + y * y);
+	if (r > outerRadius) {
+		x = std::round(x * (outerRadius - bounceBack) / r);
+		y = std::round(y * (outerRadius - bounceBack) / r);
+		r = std::sqrt(x * x + y * y);
+	}
+
+	float deadzone = conf.deadzone * outerRadius;
+	if (r <= deadzone) {
+		outX = 0;
+		outY = 0;
+		return 0.0f;
+	}
+	float tilt = std::pow(std::min((r - deadzone) / (outerRadius - deadzone), 1.0f), conf.nonLinear);
+	CalcJoystickPosition(std::atan2(y, x), tilt, conf.invertXAxis, conf.invertYAxis, outX, outY);
+	return tilt;
+}
+
+} // namespace stickref
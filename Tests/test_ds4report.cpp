@@ -0,0 +1,212 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "ds4report.hpp"
+#include "fakes.hpp"
+
+#include <cstring>
+
+// DS4 reports, checked byte by byte as they would go out on the bus
+
+using namespace std::literals;
+
+constexpr int64_t kFreq = 10'000'000;
+
+// The bytes of one report, little endian like the bus
+struct Bus {
+	const DS4_REPORT_EX& r;
+
+	unsigned U8(int off) const { return r.ReportBuffer[off]; }
+	unsigned U16(int off) const { return r.ReportBuffer[off] | r.ReportBuffer[off + 1] << 8; }
+	int S16(int off) const { return static_cast<int16_t>(U16(off)); }
+	unsigned Hat() const { return U16(4) & 0xF; }
+};
+
+static void TestSticksAndButtons() {
+	static_assert(sizeof(DS4_REPORT_EX) == 63);
+	DS4_REPORT_EX rep;
+	DS4Motion m;
+	XUSB_REPORT s = {};
+	Bus bus{ rep };
+
+	// Neutral
+	PackDS4Report(s, m, 0x1234, rep);
+	CHECK_EQ(bus.U8(0), 0x80u);
+	CHECK_EQ(bus.U8(1), 0x7Fu);
+	CHECK_EQ(bus.U8(2), 0x80u);
+	CHECK_EQ(bus.U8(3), 0x7Fu);
+	CHECK_EQ(bus.U16(4), 0x0008u);
+	CHECK_EQ(bus.U8(6), 0u);
+	CHECK_EQ(bus.U16(9), 0x1234u);
+	CHECK_EQ(bus.S16(20), 8192);
+	CHECK_EQ(bus.U8(32), 1u);
+	CHECK_EQ(bus.U8(34), 0x80u);
+	CHECK_EQ(bus.U8(38), 0x80u);
+
+	// Full deflection: up is 0 on a DS4
+	s.sThumbLX = 32767;
+	s.sThumbLY = 32767;
+	s.sThumbRX = -32768;
+	s.sThumbRY = -32768;
+	PackDS4Report(s, m, 0, rep);
+	CHECK_EQ(bus.U8(0), 0xFFu);
+	CHECK_EQ(bus.U8(1), 0x00u);
+	CHECK_EQ(bus.U8(2), 0x00u);
+	CHECK_EQ(bus.U8(3), 0xFFu);
+
+	s = {};
+	s.wButtons = XUSB_GAMEPAD_A | XUSB_GAMEPAD_Y | XUSB_GAMEPAD_BACK | XUSB_GAMEPAD_START | XUSB_GAMEPAD_GUIDE
+		| XUSB_GAMEPAD_DPAD_UP | XUSB_GAMEPAD_DPAD_RIGHT | XUSB_GAMEPAD_LEFT_SHOULDER;
+	s.bRightTrigger = 200;
+	PackDS4Report(s, m, 0, rep);
+	CHECK_EQ(bus.U16(4), unsigned(DS4_BUTTON_CROSS | DS4_BUTTON_TRIANGLE | DS4_BUTTON_SHARE | DS4_BUTTON_OPTIONS
+		| DS4_BUTTON_SHOULDER_LEFT | DS4_BUTTON_TRIGGER_RIGHT | DS4_BUTTON_DPAD_NORTHEAST));
+	CHECK_EQ(bus.U8(6), unsigned(DS4_SPECIAL_BUTTON_PS));
+	CHECK_EQ(bus.U8(7), 0u);
+	CHECK_EQ(bus.U8(8), 200u);
+
+	// Every byte is written whatever was there before
+	DS4_REPORT_EX dirty;
+	std::memset(&dirty, 0xA5, sizeof(dirty));
+	PackDS4Report(s, m, 0, dirty);
+	CHECK(std::memcmp(&dirty, &rep, sizeof(rep)) == 0);
+}
+
+// Hat for each of the 16 combinations of XUSB_GAMEPAD_DPAD_* bits (up 1, down 2, left 4, right 8)
+// Opposite directions cancel out, 8 is centered.
+constexpr unsigned kHats[16] = {
+	8, 0, 4, 8,
+	6, 7, 5, 6,
+	2, 1, 3, 2,
+	8, 0, 4, 8,
+};
+
+static void TestDPad() {
+	DS4_REPORT_EX rep;
+	DS4Motion m;
+	Bus bus{ rep };
+	for (USHORT dpad = 0; dpad < 16; ++dpad) {
+		XUSB_REPORT s = {};
+		s.wButtons = dpad | XUSB_GAMEPAD_B;
+		PackDS4Report(s, m, 0, rep);
+		if (!CHECK_EQ(bus.Hat(), kHats[dpad]))
+			std::printf("  D-pad bits %X\n", dpad);
+		// The hat shares its word with the buttons
+		CHECK(bus.U16(4) & DS4_BUTTON_CIRCLE);
+	}
+}
+
+static void TestDPadThroughEngine() {
+	// A DS4 gamepad on the fake sink: each key press goes out as a whole report
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.Default]
+XboxCount = 0
+Routes = [{ Device = "keyboard-0", Kind = "keyboard", Pads = [0] }]
+[[Profiles.Default.Gamepads]]
+DPadUp = "UpArrow"
+DPadDown = "DownArrow"
+DPadLeft = "LeftArrow"
+DPadRight = "RightArrow"
+DS4 = { Mouse = "none" }
+)"sv)));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+	engine.AttachDevice(kbd);
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	if (!CHECK_EQ(sink.targets.size(), 1u) || !CHECK(sink.targets[0].kind == GamepadKind::DS4))
+		return;
+	auto& target = sink.targets[0];
+	Bus bus{ target.ds4 };
+
+	const BYTE keys[4] = { VK_UP, VK_DOWN, VK_LEFT, VK_RIGHT };
+	for (int dpad = 1; dpad < 16; ++dpad) {
+		for (int d = 0; d < 4; ++d) {
+			if (dpad & (1 << d))
+				engine.HandleKeyPress(kbd, keys[d], true, ts);
+		}
+		if (!CHECK_EQ(bus.Hat(), kHats[dpad]))
+			std::printf("  D-pad bits %X\n", dpad);
+		for (int d = 0; d < 4; ++d) {
+			if (dpad & (1 << d))
+				engine.HandleKeyPress(kbd, keys[d], false, ts);
+		}
+		CHECK_EQ(bus.Hat(), kHats[0]);
+	}
+}
+
+static void TestTouchpad() {
+	DS4_REPORT_EX rep;
+	Bus bus{ rep };
+	XUSB_REPORT s = {};
+	ConfigDS4 cfg;
+	cfg.mouseMode = DS4MouseMode::Touchpad;
+	cfg.touchSensitivity = 2.0f;
+
+	// The first motion lands in the center, then moves
+	DS4Motion m;
+	m.AddMotion(10, -5, kFreq);
+	CHECK(!m.Advance(cfg, kFreq + kFreq / 1000, kFreq));
+	PackDS4Report(s, m, 0, rep);
+	unsigned x = bus.U8(35) | (bus.U8(36) & 0xF) << 8;
+	unsigned y = bus.U8(36) >> 4 | bus.U8(37) << 4;
+	CHECK_EQ(bus.U8(33), 1u);
+	CHECK_EQ(bus.U8(34), 0x01u);
+	CHECK_EQ(x, 980u);
+	CHECK_EQ(y, 461u);
+
+	// Lifts after 100ms without motion
+	CHECK(!m.Advance(cfg, kFreq + kFreq / 20, kFreq));
+	CHECK(m.Advance(cfg, kFreq + kFreq / 10, kFreq));
+	PackDS4Report(s, m, 0, rep);
+	CHECK_EQ(bus.U8(33), 2u);
+	CHECK_EQ(bus.U8(34), 0x81u);
+
+	// The next stroke gets a new tracking number, re-centered, and is clamped at the edge
+	m.AddMotion(-100000, 0, 2 * kFreq);
+	m.Advance(cfg, 2 * kFreq + 1, kFreq);
+	PackDS4Report(s, m, 0, rep);
+	x = bus.U8(35) | (bus.U8(36) & 0xF) << 8;
+	CHECK_EQ(bus.U8(34), 0x02u);
+	CHECK_EQ(x, 0u);
+}
+
+static void TestGyro() {
+	DS4_REPORT_EX rep;
+	Bus bus{ rep };
+	XUSB_REPORT s = {};
+	ConfigDS4 cfg;
+	cfg.mouseMode = DS4MouseMode::Gyro;
+
+	// 100 counts over 10ms = 10000 counts/s * 0.1 = 1000 dps, yaw negative for rightwards
+	DS4Motion g;
+	g.AddMotion(100, 0, kFreq);
+	CHECK(!g.Advance(cfg, kFreq + kFreq / 100, kFreq));
+	PackDS4Report(s, g, 0, rep);
+	CHECK_EQ(bus.S16(14), -16384);
+	CHECK_EQ(bus.S16(12), 0);
+	CHECK(g.Advance(cfg, kFreq + kFreq / 50, kFreq));
+	PackDS4Report(s, g, 0, rep);
+	CHECK_EQ(bus.S16(14), 0);
+
+	// Saturates
+	g.AddMotion(0, -1e6f, 3 * kFreq);
+	g.Advance(cfg, 3 * kFreq + kFreq / 1000, kFreq);
+	CHECK_EQ(g.gyroX, 32767);
+}
+
+static void TestTimestamps() {
+	// 1s = 187500 units of 16/3 us, wrapping at 16 bits
+	CHECK_EQ(DS4TimestampOf(kFreq, kFreq), uint16_t(187500 & 0xFFFF));
+	CHECK_EQ(DS4TimestampOf(0, kFreq), 0);
+}
+
+int main() {
+	TestSticksAndButtons();
+	TestDPad();
+	TestDPadThroughEngine();
+	TestTouchpad();
+	TestGyro();
+	TestTimestamps();
+	return TestResult();
+}
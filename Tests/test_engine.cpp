@@ -0,0 +1,175 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "fakes.hpp"
+
+// FeederEngine end to end: config in, fake devices' input through routes, reports out of the fake sink
+
+using namespace std::literals;
+
+constexpr auto kConfig = R"(
+[Profiles.Default]
+XboxCount = 1
+Gamepads = [
+	{ A = "Space", B = "E", LStickUp = "W", LStickDown = "S", LStickLeft = "A", LStickRight = "D", RStick = { Type = "mouse" } },
+	{ A = "Space", DS4 = { Mouse = "none" } },
+]
+Routes = [
+	{ Device = "keyboard-0", Kind = "keyboard", Pads = [0] },
+	{ Device = "keyboard-1", Kind = "keyboard", Pads = [0, 1] },
+	{ Device = "mouse-0", Kind = "mouse", Pads = [0] },
+]
+)"sv;
+
+static void TestPlugging() {
+	FakeHost host;
+	FakeSink sink;
+	{
+		FeederEngine engine(host, sink, Config(toml::parse(kConfig)));
+		CHECK_EQ(engine.GetX360s().size(), 2u);
+		if (CHECK_EQ(sink.targets.size(), 2u)) {
+			CHECK(sink.targets[0].kind == GamepadKind::X360);
+			CHECK(sink.targets[1].kind == GamepadKind::DS4);
+		}
+		CHECK(engine.AddX360());
+		// X360 gamepads go in front of the DS4 ones
+		CHECK(engine.GetX360s()[1].kind == GamepadKind::X360);
+		CHECK(engine.GetX360s()[2].kind == GamepadKind::DS4);
+	}
+	for (auto& t : sink.targets)
+		CHECK(!t.plugged);
+}
+
+static void TestKeyboardRoutes() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(kConfig)));
+	auto kbd0 = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+	auto kbd1 = MakeFakeDevice(IdevKind::Keyboard, 1, "keyboard-1");
+	auto stray = MakeFakeDevice(IdevKind::Keyboard, 2);
+	engine.AttachDevice(kbd0);
+	engine.AttachDevice(kbd1);
+	engine.AttachDevice(stray);
+	CHECK(kbd0.routeSlot != kNoRouteSlot);
+
+	auto& pad0 = sink.targets[0];
+	auto& pad1 = sink.targets[1];
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+
+	engine.HandleKeyPress(kbd0, VK_SPACE, true, ts);
+	CHECK(pad0.x360.wButtons & XUSB_GAMEPAD_A);
+	CHECK_EQ(pad1.reportCount, 0);
+	engine.HandleKeyPress(kbd0, VK_SPACE, false, ts);
+	CHECK(!(pad0.x360.wButtons & XUSB_GAMEPAD_A));
+
+	// Routed to both
+	engine.HandleKeyPress(kbd1, VK_SPACE, true, ts);
+	CHECK(pad0.x360.wButtons & XUSB_GAMEPAD_A);
+	CHECK(pad1.ds4.Report.wButtons & DS4_BUTTON_CROSS);
+
+	// Merged devices: the key stays held until both release it
+	engine.HandleKeyPress(kbd0, VK_SPACE, true, ts);
+	engine.HandleKeyPress(kbd1, VK_SPACE, false, ts);
+	CHECK(pad0.x360.wButtons & XUSB_GAMEPAD_A);
+	CHECK(!(pad1.ds4.Report.wButtons & DS4_BUTTON_CROSS));
+	engine.HandleKeyPress(kbd0, VK_SPACE, false, ts);
+	CHECK(!(pad0.x360.wButtons & XUSB_GAMEPAD_A));
+
+	// Unrouted, nothing happens
+	int reports = pad0.reportCount;
+	engine.HandleKeyPress(stray, VK_SPACE, true, ts);
+	CHECK_EQ(pad0.reportCount, reports);
+
+	// Keyboard stick
+	engine.HandleKeyPress(kbd0, 'W', true, ts);
+	engine.HandleKeyPress(kbd0, 'D', true, ts);
+	CHECK_EQ(pad0.x360.sThumbLX, MAXSHORT);
+	CHECK_EQ(pad0.x360.sThumbLY, MAXSHORT);
+	engine.HandleKeyPress(kbd0, 'W', false, ts);
+	CHECK_EQ(pad0.x360.sThumbLY, 0);
+
+	// Once the route is gone, the key it held is released too
+	engine.SetDeviceRoute(kbd0.routeSlot, 0, false);
+	engine.HandleKeyPress(kbd0, 'E', true, ts);
+	CHECK(!(pad0.x360.wButtons & XUSB_GAMEPAD_B));
+	engine.SetDeviceRoute(stray.routeSlot, 0, true);
+	engine.HandleKeyPress(stray, 'E', true, ts);
+	CHECK(pad0.x360.wButtons & XUSB_GAMEPAD_B);
+
+	engine.DetachDevice(stray);
+	CHECK_EQ(stray.routeSlot, kNoRouteSlot);
+}
+
+static void TestMouseStick() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(kConfig)));
+	auto mouse = MakeFakeDevice(IdevKind::Mouse, 0, "mouse-0");
+	engine.AttachDevice(mouse);
+
+	CHECK(!host.samplerRunning);
+	engine.HandleMouseMovement(mouse, 40, -20, InputTimestamp{ QpcNow(), 0, 0 });
+	CHECK(host.samplerRunning);
+	CHECK(engine.IsSamplerRunning());
+
+	// What the sampler's timer would do
+	for (int i = 0; i < 4; ++i)
+		engine.Update();
+	auto& pad0 = sink.targets[0];
+	CHECK(pad0.x360.sThumbRX > 0);
+	CHECK(pad0.x360.sThumbRY > 0);
+	// The left stick is on the keyboard
+	CHECK_EQ(pad0.x360.sThumbLX, 0);
+}
+
+static void TestRebind() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(kConfig)));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+	engine.AttachDevice(kbd);
+
+	engine.StartRebindX360Mapping(0, X360Button::X);
+	CHECK(engine.IsRebindPending());
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	engine.CaptureRebind(kbd, 'Q');
+	CHECK(!engine.IsRebindPending());
+	engine.HandleKeyPress(kbd, 'Q', true, ts);
+	engine.HandleKeyPress(kbd, 'Q', false, ts);
+	CHECK_EQ(engine.GetCurrentProfile()->second.gamepads[0].buttons[std::to_underlying(X360Button::X)], 'Q');
+
+	engine.HandleKeyPress(kbd, 'Q', true, ts);
+	CHECK(sink.targets[0].x360.wButtons & XUSB_GAMEPAD_X);
+}
+
+static void TestKeymapCompilation() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.Default]
+XboxCount = 1
+Gamepads = [{ Layers = [{ Key = "Q", Buttons = { E = ["B"] } }] }]
+Routes = [{ Device = "keyboard-0", Kind = "keyboard", Pads = [0] }]
+)"sv)));
+	CHECK(WaitForKeymaps(host, engine));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+	engine.AttachDevice(kbd);
+
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	auto& pad0 = sink.targets[0];
+	engine.HandleKeyPress(kbd, 'E', true, ts);
+	CHECK(!(pad0.x360.wButtons & XUSB_GAMEPAD_B));
+	engine.HandleKeyPress(kbd, 'E', false, ts);
+	engine.HandleKeyPress(kbd, 'Q', true, ts);
+	engine.HandleKeyPress(kbd, 'E', true, ts);
+	CHECK(pad0.x360.wButtons & XUSB_GAMEPAD_B);
+}
+
+int main() {
+	TestPlugging();
+	TestKeyboardRoutes();
+	TestMouseStick();
+	TestRebind();
+	TestKeymapCompilation();
+	return TestResult();
+}
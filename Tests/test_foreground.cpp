@@ -0,0 +1,106 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "fakes.hpp"
+#include "foreground.hpp"
+
+// Profile switching as applications come to the foreground, fed scripted events the way the WinEvent hook would
+
+using namespace std::literals;
+
+constexpr auto kConfig = R"(
+[Profiles.Desktop]
+XboxCount = 1
+Gamepads = [{ A = "Space" }]
+[Profiles.Shooter]
+XboxCount = 1
+Gamepads = [{ B = "Space" }]
+Executables = ["Game.EXE", "other.exe"]
+[Profiles.Racing]
+XboxCount = 1
+Executables = ["race.exe", "game.exe"]
+[[Profiles.Racing.Gamepads]]
+X = "Space"
+[[Profiles.Racing.Gamepads]]
+DS4 = { Mouse = "none" }
+)"sv;
+
+static void TestSwitcher() {
+	Config config(toml::parse(kConfig));
+	ForegroundSwitcher sw;
+	sw.Index(config.profiles);
+	auto racing = &*config.profiles.find("Racing");
+	auto shooter = &*config.profiles.find("Shooter");
+
+	CHECK_EQ(sw.profileByExe.size(), 3u);
+	// Windows matches file names case-insensitively, and either slash separates directories
+	CHECK_EQ(NormalizeExeName("C:\\A\\B/Foo.Exe"), "foo.exe"s);
+	CHECK(sw.Find("D:/r/Other.EXE") == shooter);
+	// Mapped by two profiles: the first in profile order wins
+	CHECK(sw.Find("C:\\Games\\GAME.exe") == racing);
+	CHECK(sw.Find("C:\\Windows\\explorer.exe") == nullptr);
+	CHECK(sw.Find("") == nullptr);
+}
+
+static void TestEngineSwitching() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(kConfig)));
+	auto Current = [&] { return engine.GetCurrentProfile() ? std::string_view(engine.GetCurrentProfile()->first) : ""sv; };
+	CHECK_EQ(Current(), "Desktop"sv);
+
+	// Unmapped applications keep the current profile
+	struct Step {
+		std::string_view exe;
+		std::string_view profile;
+	};
+	const Step script[] = {
+		{ "C:\\Windows\\explorer.exe", "Desktop" },
+		{ "D:\\Games\\other.exe", "Shooter" },
+		{ "C:\\Windows\\notepad.exe", "Shooter" },
+		{ "C:\\Games\\race.exe", "Racing" },
+		{ "C:\\Games\\Race.exe", "Racing" },
+		{ "D:/Games/OTHER.EXE", "Shooter" },
+	};
+	for (auto& step : script) {
+		engine.OnForegroundApp(step.exe, QpcNow());
+		CHECK_EQ(Current(), step.profile);
+	}
+	// One latency sample per actual switch
+	CHECK_EQ(engine.GetProfileSwitchLatency().GetCount(), 3u);
+
+	// The X360 gamepad stayed plugged across every switch; Racing's DS4 was added, then removed again
+	if (CHECK_EQ(sink.targets.size(), 2u)) {
+		CHECK(sink.targets[0].plugged);
+		CHECK(sink.targets[1].kind == GamepadKind::DS4);
+		CHECK(!sink.targets[1].plugged);
+	}
+
+	// The new profile's bindings are live right away
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0);
+	engine.AttachDevice(kbd);
+	engine.RebindX360Device(0, IdevKind::Keyboard, kbd.hDevice);
+	engine.HandleKeyPress(kbd, VK_SPACE, true, InputTimestamp{});
+	CHECK_EQ(sink.targets[0].x360.wButtons, XUSB_GAMEPAD_B);
+}
+
+static void TestEditedExecutables() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(kConfig)));
+	auto desktop = &*engine.GetConfig().profiles.find("Desktop");
+
+	// Like the profile's Executables field in the UI: takes effect without a restart
+	engine.OnForegroundApp("C:\\Apps\\editor.exe", QpcNow());
+	engine.OnForegroundApp("C:\\Games\\race.exe", QpcNow());
+	engine.SetProfileExecutables(desktop, { "editor.exe" });
+	engine.OnForegroundApp("C:\\Apps\\editor.exe", QpcNow());
+	CHECK(engine.GetCurrentProfile() == desktop);
+}
+
+int main() {
+	TestSwitcher();
+	TestEngineSwitching();
+	TestEditedExecutables();
+	return TestResult();
+}
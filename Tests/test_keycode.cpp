@@ -0,0 +1,96 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "keycode.hpp"
+
+#include <string>
+
+using namespace std::literals;
+
+// Key names: the compile time perfect hash finds every name, and only those
+
+static void TestNamesRoundTrip() {
+	int named = 0;
+	for (int k = 0; k <= 0xFF; ++k) {
+		auto key = static_cast<KeyCode>(k);
+		auto name = KeyCodeToString(key);
+		if (name == "<unknown>"sv)
+			continue;
+		++named;
+		// Through a std::string like toml++ hands them out, so nothing can match by pointer
+		auto found = KeyCodeFromString(std::string(name));
+		if (CHECK(found.has_value()))
+			CHECK_EQ(*found, key);
+	}
+	CHECK(named > 100);
+
+	CHECK_EQ(KeyCodeToString(VK_OEM_1), "Semicolon"sv);
+	CHECK_EQ(KeyCodeToString(VK_ESCAPE), "Escape"sv);
+	CHECK_EQ(KeyCodeToString(0), "<unknown>"sv);
+}
+
+static void TestAliases() {
+	CHECK_EQ(KeyCodeFromString(";").value_or(0), VK_OEM_1);
+	CHECK_EQ(KeyCodeFromString("Esc").value_or(0), VK_ESCAPE);
+	CHECK_EQ(KeyCodeFromString("A").value_or(0), 'A');
+	CHECK_EQ(KeyCodeFromString("LShift").value_or(0), VK_LSHIFT);
+}
+
+static void TestFalseHits() {
+	// Prefixes, extensions, wrong case, and names of keys that don't exist
+	for (auto bad : { ""sv, "a"sv, "Semicolo"sv, "Semicolonx"sv, "LSHIFT"sv, "lshift"sv, "<unknown>"sv, "F25"sv, " A"sv })
+		CHECK(!KeyCodeFromString(bad).has_value());
+}
+
+// Scan codes: keys by position, with the E0/E1 prefixes telling the duplicated keys apart
+
+static void TestScanCodes() {
+	CHECK_EQ(KeyCodeFromScanCode(0x1E, 0), 'A');
+	CHECK_EQ(KeyCodeFromScanCode(0x11, 0), 'W');
+	CHECK_EQ(KeyCodeFromScanCode(0x2A, 0), VK_LSHIFT);
+	CHECK_EQ(KeyCodeFromScanCode(0x36, 0), VK_RSHIFT);
+	CHECK_EQ(KeyCodeFromScanCode(0x1D, 0), VK_LCONTROL);
+	CHECK_EQ(KeyCodeFromScanCode(0x1D, RI_KEY_E0), VK_RCONTROL);
+	CHECK_EQ(KeyCodeFromScanCode(0x38, RI_KEY_E0), VK_RMENU);
+	CHECK_EQ(KeyCodeFromScanCode(0x1C, 0), VK_RETURN);
+	CHECK_EQ(KeyCodeFromScanCode(0x1C, RI_KEY_E0), kVkNumpadEnter);
+	CHECK_EQ(KeyCodeFromScanCode(0x48, RI_KEY_E0), VK_UP);
+	CHECK_EQ(KeyCodeFromScanCode(0x52, 0), VK_NUMPAD0);
+	CHECK_EQ(KeyCodeFromScanCode(0x52, RI_KEY_E0), VK_INSERT);
+	CHECK_EQ(KeyCodeFromScanCode(0x1D, RI_KEY_E1), VK_PAUSE);
+	CHECK_EQ(KeyCodeFromScanCode(0x73, 0), kVkIntlRo);
+	CHECK_EQ(KeyCodeFromScanCode(0x7D, 0), kVkIntlYen);
+
+	// Releases decode to the same key
+	CHECK_EQ(KeyCodeFromScanCode(0x1D, RI_KEY_E0 | RI_KEY_BREAK), VK_RCONTROL);
+
+	// The fake shifts around navigation keys, the rest of the Pause sequence, and overrun codes
+	CHECK_EQ(KeyCodeFromScanCode(0x2A, RI_KEY_E0), 0xFF);
+	CHECK_EQ(KeyCodeFromScanCode(0x36, RI_KEY_E0), 0xFF);
+	CHECK_EQ(KeyCodeFromScanCode(0x00, 0), 0xFF);
+	CHECK_EQ(KeyCodeFromScanCode(0xFF, 0), 0xFF);
+}
+
+static void TestScanCodeKeysHaveNames() {
+	// Whatever scan code mode produces must be bindable in the config
+	int mapped = 0;
+	for (USHORT flags : { USHORT(0), USHORT(RI_KEY_E0), USHORT(RI_KEY_E1) })
+		for (USHORT makeCode = 0; makeCode <= 0x7F; ++makeCode) {
+			KeyCode key = KeyCodeFromScanCode(makeCode, flags);
+			if (key == 0xFF)
+				continue;
+			++mapped;
+			if (!CHECK(KeyCodeToString(key) != "<unknown>"sv))
+				std::printf("  make code %02X flags %X\n", makeCode, flags);
+		}
+	CHECK(mapped > 100);
+}
+
+int main() {
+	TestNamesRoundTrip();
+	TestAliases();
+	TestFalseHits();
+	TestScanCodes();
+	TestScanCodeKeysHaveNames();
+	return TestResult();
+}
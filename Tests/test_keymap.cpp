@@ -0,0 +1,155 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "keymap.hpp"
+
+#include <memory>
+
+// Layers, chords and multi-button keys, compiled from a config and replayed key by key
+
+using namespace std::literals;
+
+constexpr auto kConfig = R"(
+[Profiles.Default]
+XboxCount = 1
+[[Profiles.Default.Gamepads]]
+A = "Space"
+MultiKeys = { Q = ["LB", "RB"], M = ["A"] }
+Chords = [
+	{ Keys = ["J", "K"], Buttons = ["X"] },
+	{ Keys = ["J", "K", "L"], Buttons = ["Y"] },
+	{ Keys = ["U", "V"], Buttons = ["A"] },
+]
+Layers = [
+	{ Key = "LShift", Buttons = { E = ["B"], R = ["X", "Y"] } },
+	{ Key = "LCtrl", Buttons = { E = ["DPadUp"] } },
+]
+)"sv;
+
+struct Keymap {
+	std::unique_ptr<KeymapTables> tables = std::make_unique<KeymapTables>();
+	std::unique_ptr<KeymapState> state = std::make_unique<KeymapState>();
+	USHORT wButtons = 0;
+
+	Keymap() {
+		Config config(toml::parse(kConfig));
+		auto& gamepad = config.profiles.at("Default").gamepads.at(0);
+		CHECK(HasKeymap(gamepad));
+		CompileKeymap(gamepad, *tables);
+	}
+
+	bool Press(KeyCode key) { return TranslateKeymapKey(*tables, *state, key, true, wButtons); }
+	bool Release(KeyCode key) { return TranslateKeymapKey(*tables, *state, key, false, wButtons); }
+};
+
+static void TestKeys() {
+	Keymap k;
+	// Only keys that appear in the keymap leave the plain binding fast path
+	for (KeyCode key : std::initializer_list<KeyCode>{ 'Q', 'M', 'J', 'K', 'L', 'U', 'V', 'E', 'R', VK_LSHIFT, VK_LCONTROL })
+		CHECK(k.tables->HasKey(key));
+	CHECK(!k.tables->HasKey(VK_SPACE));
+	CHECK(!k.tables->HasKey('W'));
+}
+
+static void TestMultiKey() {
+	Keymap k;
+	CHECK(k.Press('Q'));
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_LEFT_SHOULDER | XUSB_GAMEPAD_RIGHT_SHOULDER);
+	CHECK(k.Release('Q'));
+	CHECK_EQ(k.wButtons, 0);
+}
+
+static void TestChords() {
+	Keymap k;
+	k.Press('J');
+	CHECK_EQ(k.wButtons, 0);
+	k.Press('K');
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_X);
+	// A longer chord adds its own buttons on top
+	k.Press('L');
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_X | XUSB_GAMEPAD_Y);
+	// Breaking the shorter chord breaks both
+	k.Release('K');
+	CHECK_EQ(k.wButtons, 0);
+	k.Release('J');
+	k.Release('L');
+	CHECK_EQ(k.wButtons, 0);
+}
+
+static void TestReferenceCounting() {
+	// Chord U+V and multi key M both press A, neither releases the other's
+	Keymap k;
+	k.Press('M');
+	k.Press('U');
+	k.Press('V');
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_A);
+	k.Release('M');
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_A);
+	k.Release('V');
+	CHECK_EQ(k.wButtons, 0);
+	k.Release('U');
+}
+
+static void TestLayers() {
+	Keymap k;
+	// Not on any layer, E has no plain binding in the keymap
+	CHECK(!k.Press('E'));
+	CHECK_EQ(k.wButtons, 0);
+	k.Release('E');
+
+	k.Press(VK_LSHIFT);
+	CHECK(k.Press('E'));
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_B);
+	// Released with the key even though the layer is gone by then
+	k.Release(VK_LSHIFT);
+	k.Release('E');
+	CHECK_EQ(k.wButtons, 0);
+
+	// The later layer takes precedence while both are held
+	k.Press(VK_LSHIFT);
+	k.Press(VK_LCONTROL);
+	k.Press('E');
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_DPAD_UP);
+	k.Release('E');
+	// R isn't on the upper layer, so the lower held one doesn't apply either: keys a layer leaves out are as on the base
+	k.Press('R');
+	CHECK_EQ(k.wButtons, 0);
+	k.Release('R');
+	k.Release(VK_LCONTROL);
+	k.Press('R');
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_X | XUSB_GAMEPAD_Y);
+	k.Release('R');
+	k.Release(VK_LSHIFT);
+
+	// A multi key on the base layer still works with a layer held that leaves it out
+	k.Press(VK_LSHIFT);
+	k.Press('Q');
+	CHECK_EQ(k.wButtons, XUSB_GAMEPAD_LEFT_SHOULDER | XUSB_GAMEPAD_RIGHT_SHOULDER);
+	k.Release('Q');
+	k.Release(VK_LSHIFT);
+	CHECK_EQ(k.wButtons, 0);
+}
+
+static void TestReset() {
+	Keymap k;
+	k.Press('Q');
+	k.Press('J');
+	k.Press('K');
+	CHECK(k.wButtons != 0);
+	k.state->Reset(k.wButtons);
+	CHECK_EQ(k.wButtons, 0);
+	// Nothing stuck afterwards
+	k.Press('Q');
+	k.Release('Q');
+	CHECK_EQ(k.wButtons, 0);
+}
+
+int main() {
+	TestKeys();
+	TestMultiKey();
+	TestChords();
+	TestReferenceCounting();
+	TestLayers();
+	TestReset();
+	return TestResult();
+}
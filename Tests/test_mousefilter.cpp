@@ -0,0 +1,119 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "mousefilter.hpp"
+
+#include <cmath>
+#include <vector>
+
+// MouseVelocityFilter: the same physical motion gives the same deflection whatever the mouse's polling rate and the tick rate
+
+// Velocity of the simulated hand in counts per second: 2 seconds of motion, then rest
+static double HandVelocity(double t) {
+	return t < 2.0 ? 1500.0 * std::sin(t * 3.0) + 800.0 : 0.0;
+}
+
+constexpr double kDuration = 3.0;
+
+// Simulates a mouse that reports whole counts at pollingRate, starting at a fraction phase into its first interval
+// \return deflection at every tick
+static std::vector<float> Replay(const ConfigMouseFilter& conf, double pollingRate, double tick, double phase) {
+	auto ToQpc = [](double t) { return static_cast<int64_t>(t * static_cast<double>(QpcFrequency())); };
+
+	MouseVelocityFilter f;
+	std::vector<float> out;
+	double pos = 0.0, reported = 0.0;
+	double tNextPacket = phase / pollingRate;
+	double tNextTick = tick;
+	constexpr double kStep = 1e-5;
+	for (int step = 0; step * kStep < kDuration; ++step) {
+		double t = step * kStep;
+		pos += HandVelocity(t) * kStep;
+		if (t >= tNextPacket) {
+			// Like a real mouse, no packet while nothing moved
+			if (double d = std::floor(pos - reported); d != 0.0) {
+				f.AddMotion(conf, static_cast<float>(d), 0.0f, ToQpc(t));
+				reported += d;
+			}
+			tNextPacket += 1.0 / pollingRate;
+		}
+		if (t >= tNextTick) {
+			f.AdvanceTo(conf, ToQpc(t));
+			out.push_back(f.GetDeflectionX());
+			tNextTick += tick;
+		}
+	}
+	return out;
+}
+
+struct Difference {
+	double rms, worst, peak;
+};
+
+static Difference Compare(const std::vector<float>& a, const std::vector<float>& b) {
+	Difference d{};
+	size_t n = std::min(a.size(), b.size());
+	for (size_t i = 0; i < n; ++i) {
+		double diff = a[i] - b[i];
+		d.rms += diff * diff;
+		d.worst = std::max(d.worst, std::abs(diff));
+		d.peak = std::max(d.peak, static_cast<double>(std::abs(a[i])));
+	}
+	d.rms = std::sqrt(d.rms / static_cast<double>(n));
+	return d;
+}
+
+static void TestPollingRates(MouseFilterKind kind, const char* name) {
+	ConfigMouseFilter conf;
+	conf.kind = kind;
+	for (double tick : { 0.010, 0.075 }) {
+		auto slow = Replay(conf, 125.0, tick, 0.3);
+		auto fast = Replay(conf, 8000.0, tick, 0.7);
+		auto d = Compare(slow, fast);
+		std::printf("%s, %.0f ms ticks: peak %.1f counts, 125 Hz vs 8000 Hz RMS %.2f, worst %.2f\n", name, tick * 1000, d.peak, d.rms, d.worst);
+		CHECK(d.peak > 100.0);
+		// Within 2% of the peak on average; the worst case is the first packets of the motion's onset
+		CHECK(d.rms < d.peak * 0.02);
+		CHECK(d.worst < d.peak * 0.15);
+		// Back to exactly 0 once the hand stops
+		CHECK_EQ(slow.back(), 0.0f);
+		CHECK_EQ(fast.back(), 0.0f);
+	}
+}
+
+static void TestTickRates(MouseFilterKind kind) {
+	ConfigMouseFilter conf;
+	conf.kind = kind;
+	// Ticks of 5 and 15 ms, compared at the same points in time: every third tick of the faster one
+	auto fine = Replay(conf, 1000.0, 0.005, 0.5);
+	auto coarse = Replay(conf, 1000.0, 0.015, 0.5);
+	std::vector<float> fineAtCoarse;
+	for (size_t i = 2; i < fine.size(); i += 3)
+		fineAtCoarse.push_back(fine[i]);
+	auto d = Compare(fineAtCoarse, coarse);
+	CHECK(d.rms < d.peak * 0.01);
+	// Deterministic
+	CHECK(Replay(conf, 1000.0, 0.005, 0.5) == fine);
+}
+
+static void TestReset() {
+	ConfigMouseFilter conf;
+	MouseVelocityFilter f;
+	f.AddMotion(conf, 10.0f, -5.0f, 1000);
+	f.AddMotion(conf, 10.0f, -5.0f, 1000 + QpcFrequency() / 1000);
+	CHECK(!f.IsAtRest());
+	CHECK(f.GetDeflectionX() > 0.0f);
+	CHECK(f.GetDeflectionY() < 0.0f);
+	f.Reset();
+	CHECK(f.IsAtRest());
+	CHECK_EQ(f.GetDeflectionX(), 0.0f);
+}
+
+int main() {
+	TestPollingRates(MouseFilterKind::Ema, "ema");
+	TestPollingRates(MouseFilterKind::OneEuro, "oneeuro");
+	TestTickRates(MouseFilterKind::Ema);
+	TestTickRates(MouseFilterKind::OneEuro);
+	TestReset();
+	return TestResult();
+}
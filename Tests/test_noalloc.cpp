@@ -0,0 +1,109 @@
+#include "pch.hpp"
+
+#include "allochook.hpp"
+#include "check.hpp"
+#include "fakes.hpp"
+
+// The input path, from HandleKeyPress()/HandleMouseMovement() to the reports, makes no heap allocation
+// Built with allochook.cpp, which counts every operator new.
+
+using namespace std::literals;
+
+constexpr auto kConfig = R"(
+[Profiles.Default]
+XboxCount = 1
+Routes = [
+	{ Device = "keyboard", Kind = "keyboard", Pads = [0, 1] },
+	{ Device = "mouse", Kind = "mouse", Pads = [0, 1] },
+]
+
+[[Profiles.Default.Gamepads]]
+A = "Space"
+X = "R"
+LT = "Q"
+LStickUp = "W"
+LStickDown = "S"
+LStickLeft = "A"
+LStickRight = "D"
+LStick = { Socd = "last", Ramp = { Attack = 30, Release = 15 } }
+RStick = { Type = "mouse" }
+LeftTriggerRamp = { Attack = 20 }
+Actions = { X = { Type = "turbo", Rate = 30 } }
+
+[[Profiles.Default.Gamepads]]
+A = "Space"
+B = "E"
+Layers = [{ Key = "F", Buttons = { E = ["Y"] } }]
+Chords = [{ Keys = ["Z", "C"], Buttons = ["Back"] }]
+RStick = { Type = "mouse" }
+DS4 = { Mouse = "touchpad" }
+)"sv;
+
+constexpr BYTE kKeys[] = { VK_SPACE, 'R', 'Q', 'W', 'A', 'S', 'D', 'E', 'F', 'Z', 'C', 'P' };
+
+static void Replay(FeederEngine& engine, InputDevice& kbd, InputDevice& mouse, int rounds) {
+	for (int i = 0; i < rounds; ++i) {
+		InputTimestamp ts{ QpcNow(), 0, 0 };
+		for (BYTE key : kKeys)
+			engine.HandleKeyPress(kbd, key, true, ts);
+		engine.HandleMouseMovement(mouse, 7 - i % 15, i % 9 - 4, ts);
+		engine.Update();
+		engine.RunActionTimers();
+		for (BYTE key : kKeys)
+			engine.HandleKeyPress(kbd, key, false, ts);
+		engine.HandleMouseMovement(mouse, i % 5, -3, ts);
+		engine.Update();
+		engine.RunActionTimers();
+	}
+}
+
+int main() {
+#ifdef WXF_ALLOC_HOOK
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(kConfig)));
+	CHECK(WaitForKeymaps(host, engine));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard");
+	auto mouse = MakeFakeDevice(IdevKind::Mouse, 1, "mouse");
+	engine.AttachDevice(kbd);
+	engine.AttachDevice(mouse);
+
+	// Sanity check of the hook itself, through a volatile so that the allocation can't be elided
+	uint64_t allocs = GetThreadAllocCount();
+	static int* volatile probe;
+	probe = new int(1);
+	delete probe;
+	CHECK_EQ(GetThreadAllocCount() - allocs, 1u);
+
+	// Anything allocated once on first use, e.g. by the C++ runtime, is allowed
+	Replay(engine, kbd, mouse, 1);
+
+	allocs = GetThreadAllocCount();
+	Replay(engine, kbd, mouse, 500);
+	CHECK_EQ(GetThreadAllocCount() - allocs, 0u);
+	// Otherwise nothing was tested
+	CHECK(sink.targets[0].reportCount > 1000);
+	CHECK(sink.targets[1].reportCount > 1000);
+
+	// A pending rebind leaves the input path as it is, the capture that rebuilds the routes is App's to do outside of it
+	engine.StartRebindX360Device(1, IdevKind::Keyboard);
+	engine.StartRebindX360Mapping(0, X360Button::Y);
+	allocs = GetThreadAllocCount();
+	Replay(engine, kbd, mouse, 50);
+	CHECK_EQ(GetThreadAllocCount() - allocs, 0u);
+	CHECK(engine.IsRebindPending());
+
+	engine.CaptureRebind(kbd, 'P');
+	CHECK(!engine.IsRebindPending());
+	Replay(engine, kbd, mouse, 1);
+	allocs = GetThreadAllocCount();
+	Replay(engine, kbd, mouse, 500);
+	CHECK_EQ(GetThreadAllocCount() - allocs, 0u);
+	// The rebound key is replayed too, so the new mapping was exercised
+	CHECK_EQ(engine.GetCurrentProfile()->second.gamepads[0].buttons[std::to_underlying(X360Button::Y)], 'P');
+#else
+	std::printf("Needs WXF_ALLOC_HOOK\n");
+	CHECK(false);
+#endif
+	return TestResult();
+}
@@ -0,0 +1,274 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "fakes.hpp"
+
+// What the engine changes at runtime survives saving the config and loading it again, the way App::SaveConfig() does
+
+using namespace std::literals;
+
+// Through text, like the config file
+static Config Reload(const FeederEngine& engine) {
+	std::ostringstream ss;
+	ss << engine.GetConfig().ExportAsToml();
+	return Config(toml::parse(ss.str()));
+}
+
+static void TestDeviceIdentity() {
+	FakeHost host;
+	FakeSink sink;
+	Config reloaded;
+	{
+		FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.Default]
+XboxCount = 1
+Gamepads = [{ A = "Space" }]
+Routes = [{ Device = "old-port", Kind = "keyboard", VidPid = "046D:C31C", Pads = [0] }]
+)"sv)));
+		CHECK(!engine.IsConfigDirty());
+
+		// Moved to another port: matched by VID/PID, and the route takes the new name
+		auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "new-port");
+		kbd.vendorId = 0x046D;
+		kbd.productId = 0xC31C;
+		engine.AttachDevice(kbd);
+		CHECK(engine.IsConfigDirty());
+		engine.HandleKeyPress(kbd, VK_SPACE, true, InputTimestamp{});
+		CHECK(sink.targets[0].x360.wButtons & XUSB_GAMEPAD_A);
+
+		reloaded = Reload(engine);
+	}
+
+	auto& routes = reloaded.profiles.at("Default").routes;
+	if (CHECK_EQ(routes.size(), 1u)) {
+		CHECK_EQ(routes[0].device, "new-port"s);
+		CHECK_EQ(routes[0].vidPid, 0x046DC31Cu);
+		CHECK_EQ(routes[0].pads, 1);
+	}
+
+	// Found by its new name, so nothing needs to be saved again
+	FakeSink sink2;
+	FeederEngine engine(host, sink2, std::move(reloaded));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "new-port");
+	kbd.vendorId = 0x046D;
+	kbd.productId = 0xC31C;
+	engine.AttachDevice(kbd);
+	CHECK(!engine.IsConfigDirty());
+	engine.HandleKeyPress(kbd, VK_SPACE, true, InputTimestamp{});
+	CHECK(sink2.targets[0].x360.wButtons & XUSB_GAMEPAD_A);
+}
+
+static void TestGamepadsAndRebinds() {
+	FakeHost host;
+	FakeSink sink;
+	Config reloaded;
+	{
+		Config config;
+		config.profiles.emplace("Default", ConfigProfile{});
+		FeederEngine engine(host, sink, std::move(config));
+		CHECK(engine.AddProfile("Second"));
+		CHECK(engine.AddX360());
+		CHECK(engine.AddDS4());
+		auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0);
+		engine.AttachDevice(kbd);
+		engine.SetDeviceRoute(kbd.routeSlot, 1, true);
+		engine.MarkConfigSaved();
+
+		engine.StartRebindX360Mapping(1, X360Button::Y);
+		engine.CaptureRebind(kbd, 'T');
+		CHECK(engine.IsConfigDirty());
+
+		reloaded = Reload(engine);
+	}
+
+	CHECK(reloaded.profiles.contains("Second"));
+	auto& profile = reloaded.profiles.at("Default");
+	CHECK_EQ(profile.GetX360Count(), 1u);
+	if (CHECK_EQ(profile.GetDS4Count(), 1u)) {
+		CHECK_EQ(profile.gamepads[1].buttons[std::to_underlying(X360Button::Y)], 'T');
+		// Unbound buttons stay unbound
+		CHECK_EQ(profile.gamepads[1].buttons[std::to_underlying(X360Button::A)], 0xFF);
+	}
+}
+
+static void TestRouteEdits() {
+	FakeHost host;
+	FakeSink sink;
+	auto MakeDevices = [] {
+		auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+		kbd.vendorId = 0x046D;
+		kbd.productId = 0xC31C;
+		auto mouse = MakeFakeDevice(IdevKind::Mouse, 1, "mouse-0");
+		mouse.vendorId = 0x046D;
+		mouse.productId = 0xC077;
+		return std::pair(kbd, mouse);
+	};
+	Config reloaded;
+	{
+		FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.Default]
+XboxCount = 3
+[[Profiles.Default.Gamepads]]
+A = "Space"
+[[Profiles.Default.Gamepads]]
+A = "Space"
+[[Profiles.Default.Gamepads]]
+A = "Space"
+)"sv)));
+		auto [kbd, mouse] = MakeDevices();
+		engine.AttachDevice(kbd);
+		engine.AttachDevice(mouse);
+		CHECK(!engine.IsConfigDirty());
+
+		// Like the Routing tree's checkboxes, and Rebind for the mouse
+		engine.SetDeviceRoute(kbd.routeSlot, 0, true);
+		engine.SetDeviceRoute(kbd.routeSlot, 2, true);
+		engine.RebindX360Device(1, IdevKind::Mouse, mouse.hDevice);
+		CHECK(engine.IsConfigDirty());
+
+		reloaded = Reload(engine);
+	}
+
+	auto& routes = reloaded.profiles.at("Default").routes;
+	CHECK_EQ(routes.size(), 2u);
+
+	// After a restart the same devices drive the same gamepads, and nothing needs saving
+	FeederEngine engine(host, sink, std::move(reloaded));
+	auto [kbd, mouse] = MakeDevices();
+	engine.AttachDevice(kbd);
+	engine.AttachDevice(mouse);
+	CHECK(!engine.IsConfigDirty());
+	CHECK_EQ(engine.GetRoutes().pads[kbd.routeSlot], 0b101);
+	CHECK_EQ(engine.GetRoutes().pads[mouse.routeSlot], 0b010);
+
+	size_t first = sink.targets.size() - 3;
+	engine.HandleKeyPress(kbd, VK_SPACE, true, InputTimestamp{});
+	CHECK(sink.targets[first + 0].x360.wButtons & XUSB_GAMEPAD_A);
+	CHECK(!(sink.targets[first + 1].x360.wButtons & XUSB_GAMEPAD_A));
+	CHECK(sink.targets[first + 2].x360.wButtons & XUSB_GAMEPAD_A);
+}
+
+static void TestStickSettings() {
+	FakeHost host;
+	FakeSink sink;
+	Config reloaded;
+	{
+		FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.Default]
+XboxCount = 1
+[[Profiles.Default.Gamepads]]
+DPadSocd = "neutral"
+LeftTriggerRamp = { Attack = 30, Release = 10, Curve = "easein" }
+LStick = { Type = "keyboard", Speed = 0.5, Socd = "last", Ramp = { Attack = 80, Release = 40, Curve = "smooth" } }
+RStick = { Type = "mouse", Sensitivity = 20, NonLinearSensitivity = 0.6, Deadzone = 0.1, OuterRadius = 4, InvertYAxis = true }
+)"sv)));
+		reloaded = Reload(engine);
+	}
+
+	auto& gamepad = reloaded.profiles.at("Default").gamepads.at(0);
+	CHECK(gamepad.dpadSocd == SocdMode::Neutral);
+	CHECK_EQ(gamepad.leftTriggerRamp.attackTime, 30.0f);
+	CHECK(gamepad.leftTriggerRamp.curve == RampCurve::EaseIn);
+
+	auto& ls = gamepad.lstick;
+	CHECK(!ls.useMouse);
+	CHECK_EQ(ls.speed, 0.5f);
+	CHECK(ls.socd == SocdMode::LastInput);
+	CHECK_EQ(ls.ramp.attackTime, 80.0f);
+	CHECK_EQ(ls.ramp.releaseTime, 40.0f);
+	CHECK(ls.ramp.curve == RampCurve::Smooth);
+
+	// Each stick keeps its own settings
+	auto& rs = gamepad.rstick;
+	CHECK(rs.useMouse);
+	CHECK_EQ(rs.sensitivity, 20.0f);
+	CHECK_EQ(rs.nonLinear, 0.6f);
+	CHECK_EQ(rs.deadzone, 0.1f);
+	CHECK_EQ(rs.outerRadius, 4.0f);
+	CHECK(!rs.invertXAxis);
+	CHECK(rs.invertYAxis);
+	CHECK(rs.socd == SocdMode::Off);
+	CHECK(rs.ramp.IsInstant());
+}
+
+static void TestProfileExecutables() {
+	FakeHost host;
+	FakeSink sink;
+	Config reloaded;
+	{
+		Config config;
+		config.profiles.emplace("Default", ConfigProfile{});
+		config.profiles.emplace("Game", ConfigProfile{});
+		FeederEngine engine(host, sink, std::move(config));
+		engine.SetProfileExecutables(&*engine.GetConfig().profiles.find("Game"), { "game.exe", "Launcher.exe" });
+		CHECK(engine.IsConfigDirty());
+
+		reloaded = Reload(engine);
+	}
+
+	CHECK((reloaded.profiles.at("Game").executables == std::vector{ "game.exe"s, "Launcher.exe"s }));
+	CHECK(reloaded.profiles.at("Default").executables.empty());
+
+	// And they switch profiles again after a restart
+	FeederEngine engine(host, sink, std::move(reloaded));
+	engine.OnForegroundApp("C:\\Games\\LAUNCHER.EXE", QpcNow());
+	if (CHECK(engine.GetCurrentProfile() != nullptr))
+		CHECK_EQ(engine.GetCurrentProfile()->first, "Game"s);
+}
+
+static void TestMouseCalibration() {
+	constexpr uint32_t kVidPid = 0x046DC077;
+	FakeHost host;
+	FakeSink sink;
+	Config reloaded;
+	{
+		Config config;
+		config.profiles.emplace("Default", ConfigProfile{});
+		FeederEngine engine(host, sink, std::move(config));
+		CHECK(engine.GetMouseCalibration(kVidPid) == nullptr);
+
+		ConfigMouseCalibration calib;
+		calib.dpi = 1600.0f;
+		calib.pollingRate = 1000.0f;
+		engine.SetMouseCalibration(kVidPid, calib);
+		CHECK(engine.IsConfigDirty());
+
+		reloaded = Reload(engine);
+	}
+
+	FeederEngine engine(host, sink, std::move(reloaded));
+	auto calib = engine.GetMouseCalibration(kVidPid);
+	if (CHECK(calib != nullptr)) {
+		CHECK_EQ(calib->dpi, 1600.0f);
+		CHECK_EQ(calib->pollingRate, 1000.0f);
+	}
+
+	// Applied to mice of that model as they connect, others are used unscaled
+	auto mouse = MakeFakeDevice(IdevKind::Mouse, 0);
+	mouse.vendorId = 0x046D;
+	mouse.productId = 0xC077;
+	engine.ApplyMouseCalibration(mouse);
+	CHECK_EQ(mouse.mouseCountScale, kReferenceMouseDpi / 1600.0f);
+	auto other = MakeFakeDevice(IdevKind::Mouse, 1);
+	other.vendorId = 0x1532;
+	engine.ApplyMouseCalibration(other);
+	CHECK_EQ(other.mouseCountScale, 1.0f);
+
+	// Mice without VID/PID are no model, so they don't share one calibration
+	engine.MarkConfigSaved();
+	engine.SetMouseCalibration(0, ConfigMouseCalibration{ 400.0f, 125.0f });
+	CHECK(!engine.IsConfigDirty());
+	auto unknown = MakeFakeDevice(IdevKind::Mouse, 2);
+	engine.ApplyMouseCalibration(unknown);
+	CHECK_EQ(unknown.mouseCountScale, 1.0f);
+}
+
+int main() {
+	TestDeviceIdentity();
+	TestGamepadsAndRebinds();
+	TestRouteEdits();
+	TestStickSettings();
+	TestProfileExecutables();
+	TestMouseCalibration();
+	return TestResult();
+}
@@ -0,0 +1,193 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "fakes.hpp"
+#include "ramp.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// RampAxis: the same attack and release times whatever the tick rate, then key-driven axes through the engine
+
+using namespace std::literals;
+
+// Advance at `hz` until the axis reaches its target
+// \return milliseconds it took, and the level after each step in trace
+static double RunUntilRest(RampAxis& a, const ConfigRamp& r, int hz, std::vector<float>* trace = nullptr) {
+	int steps = 1;
+	while (a.Advance(r, 1.0f / hz) && steps < 100'000) {
+		++steps;
+		if (trace)
+			trace->push_back(a.level);
+	}
+	if (trace)
+		trace->push_back(a.level);
+	return steps * 1000.0 / hz;
+}
+
+static void TestTickRates() {
+	ConfigRamp r;
+	r.attackTime = 100;
+	r.releaseTime = 50;
+	for (int hz : { 1000, 500, 250, 125, 60 }) {
+		// At most one step late at any rate
+		double step = 1000.0 / hz;
+		RampAxis a;
+		a.target = 1;
+		double t = RunUntilRest(a, r, hz);
+		CHECK(t >= 100 && t < 100 + step + 1e-6);
+		CHECK_EQ(a.level, 1.0f);
+
+		a.target = 0;
+		t = RunUntilRest(a, r, hz);
+		CHECK(t >= 50 && t < 50 + step + 1e-6);
+		CHECK_EQ(a.level, 0.0f);
+
+		// Full right to full left releases, then attacks
+		a.level = 1;
+		a.target = -1;
+		t = RunUntilRest(a, r, hz);
+		CHECK(t >= 150 && t < 150 + step + 1e-6);
+		CHECK_EQ(a.level, -1.0f);
+	}
+}
+
+static void TestSequence() {
+	// 250 Hz, attack 20ms, reversed 12ms in with a release of 8ms
+	ConfigRamp r;
+	r.attackTime = 20;
+	r.releaseTime = 8;
+	RampAxis a;
+	a.target = 1;
+	std::vector<float> trace;
+	for (int i = 0; i < 3; ++i) {
+		a.Advance(r, 0.004f);
+		trace.push_back(a.level);
+	}
+	a.target = -1;
+	RunUntilRest(a, r, 250, &trace);
+
+	const float want[] = { 0.2f, 0.4f, 0.6f, 0.1f, -0.16f, -0.36f, -0.56f, -0.76f, -0.96f, -1.0f };
+	if (CHECK_EQ(trace.size(), std::size(want))) {
+		for (size_t i = 0; i < trace.size(); ++i)
+			CHECK_NEAR(trace[i], want[i], 1e-5f);
+	}
+}
+
+static void TestCurves() {
+	for (auto c : { RampCurve::Linear, RampCurve::EaseIn, RampCurve::EaseOut, RampCurve::Smooth }) {
+		RampAxis a;
+		CHECK_EQ(a.Output(c), 0.0f);
+		a.level = 1;
+		CHECK_EQ(a.Output(c), 1.0f);
+		a.level = -1;
+		CHECK_EQ(a.Output(c), -1.0f);
+	}
+	RampAxis half;
+	half.level = 0.5f;
+	CHECK_NEAR(half.Output(RampCurve::Linear), 0.5f, 1e-3f);
+	CHECK(half.Output(RampCurve::EaseIn) < 0.5f);
+	CHECK(half.Output(RampCurve::EaseOut) > 0.5f);
+	CHECK_NEAR(half.Output(RampCurve::Smooth), 0.5f, 1e-2f);
+}
+
+static void TestDeterminism() {
+	ConfigRamp r;
+	r.attackTime = 100;
+	r.curve = RampCurve::Smooth;
+	std::vector<float> t1, t2;
+	RampAxis a, b;
+	a.target = b.target = 1;
+	RunUntilRest(a, r, 240, &t1);
+	RunUntilRest(b, r, 240, &t2);
+	CHECK(t1 == t2);
+
+	// No ramp: there at once
+	RampAxis z;
+	z.target = -1;
+	CHECK(!z.Advance(ConfigRamp{}, 0.001f));
+	CHECK_EQ(z.level, -1.0f);
+}
+
+static void TestEngineSticks() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.Default]
+XboxCount = 1
+Routes = [{ Device = "keyboard-0", Kind = "keyboard", Pads = [0] }]
+[[Profiles.Default.Gamepads]]
+LStickRight = "D"
+RStickRight = "RightArrow"
+RStickUp = "UpArrow"
+LStick = { Ramp = { Attack = 20, Release = 20 } }
+)"sv)));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+	engine.AttachDevice(kbd);
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	auto& pad = sink.targets.at(0).x360;
+
+	// Without a ramp each stick moves at once, and only its own axes
+	engine.HandleKeyPress(kbd, VK_RIGHT, true, ts);
+	CHECK_EQ(pad.sThumbRX, MAXSHORT);
+	CHECK_EQ(pad.sThumbLX, 0);
+	engine.HandleKeyPress(kbd, VK_UP, true, ts);
+	CHECK_EQ(pad.sThumbRY, MAXSHORT);
+	CHECK_EQ(pad.sThumbLY, 0);
+	engine.HandleKeyPress(kbd, VK_RIGHT, false, ts);
+	engine.HandleKeyPress(kbd, VK_UP, false, ts);
+	CHECK_EQ(pad.sThumbRX, 0);
+	CHECK_EQ(pad.sThumbRY, 0);
+
+	// With one, the action timer moves it
+	engine.HandleKeyPress(kbd, 'D', true, ts);
+	CHECK(host.actionTimerDelayMicros > 0);
+	CHECK(pad.sThumbLX < MAXSHORT);
+	std::this_thread::sleep_for(40ms);
+	engine.RunActionTimers();
+	CHECK_EQ(pad.sThumbLX, MAXSHORT);
+	CHECK_EQ(pad.sThumbRX, 0);
+}
+
+static void TestRemoveProfileWhileRamping() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.A]
+XboxCount = 1
+Routes = [{ Device = "keyboard-0", Kind = "keyboard", Pads = [0] }]
+[[Profiles.A.Gamepads]]
+LStickRight = "D"
+LStick = { Ramp = { Attack = 1000, Release = 1000 } }
+[Profiles.B]
+XboxCount = 1
+Gamepads = [{ A = "Space" }]
+)"sv)));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+	engine.AttachDevice(kbd);
+	engine.HandleKeyPress(kbd, 'D', true, InputTimestamp{ QpcNow(), 0, 0 });
+	CHECK(host.actionTimerDelayMicros > 0);
+
+	// Leaving the profile finishes its moving ramps, which must happen before its gamepads are gone
+	engine.RemoveProfile(engine.GetCurrentProfile());
+	if (CHECK(engine.GetCurrentProfile() != nullptr))
+		CHECK_EQ(engine.GetCurrentProfile()->first, "B"s);
+	CHECK(!engine.GetConfig().profiles.contains("A"));
+	CHECK_EQ(host.actionTimerDelayMicros, -1);
+
+	// And removing the last one leaves none selected
+	engine.RemoveProfile(engine.GetCurrentProfile());
+	CHECK(engine.GetCurrentProfile() == nullptr);
+}
+
+int main() {
+	TestTickRates();
+	TestSequence();
+	TestCurves();
+	TestDeterminism();
+	TestEngineSticks();
+	TestRemoveProfileWhileRamping();
+	return TestResult();
+}
@@ -0,0 +1,93 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "routing.hpp"
+
+// RouteTable: which route an attached device gets, by name or by VID/PID and ordinal
+
+static HANDLE FakeHandle(int i) {
+	return reinterpret_cast<HANDLE>(static_cast<uintptr_t>(0x1000 + i));
+}
+
+static void TestIdentity() {
+	std::vector<ConfigRoute> routes(3);
+	routes[0] = { "\\\\?\\HID#VID_046D&PID_C31C#7&1a2b&0&0000#{884b96c3}", IdevKind::Keyboard, 0x046DC31C, 0, 0b01 };
+	routes[1] = { "\\\\?\\HID#VID_046D&PID_C31C#7&9f9f&0&0000#{884b96c3}", IdevKind::Keyboard, 0x046DC31C, 1, 0b10 };
+	routes[2] = { "\\\\?\\hid#vid_1532&pid_0084#x#{378de44c}", IdevKind::Mouse, 0, 0, 0b11 };
+	RouteTable t;
+	t.Index(routes);
+
+	// Exact name, in any case
+	auto a = t.Attach(FakeHandle(1), "\\\\?\\hid#vid_046d&pid_c31c#7&1a2b&0&0000#{884b96c3}", IdevKind::Keyboard, 0x046DC31C);
+	CHECK_EQ(t.ResolveSlot(a, routes, 4), 0);
+	CHECK_EQ(t.pads[a], 0b01);
+	auto b = t.Attach(FakeHandle(2), "\\\\?\\HID#VID_046D&PID_C31C#7&9F9F&0&0000#{884b96c3}", IdevKind::Keyboard, 0x046DC31C);
+	CHECK_EQ(t.devices[b].ordinal, 1);
+	CHECK_EQ(t.ResolveSlot(b, routes, 4), 1);
+	CHECK_EQ(t.pads[b], 0b10);
+
+	// The first keyboard replugged into another port: new name and handle, same ordinal
+	t.Detach(a);
+	auto a2 = t.Attach(FakeHandle(3), "\\\\?\\HID#VID_046D&PID_C31C#7&5555&0&0000#{884b96c3}", IdevKind::Keyboard, 0x046DC31C);
+	CHECK_EQ(t.devices[a2].ordinal, 0);
+	CHECK_EQ(t.ResolveSlot(a2, routes, 4), 0);
+	CHECK_EQ(t.pads[a2], 0b01);
+
+	// The same model as a mouse doesn't match keyboard routes
+	auto m = t.Attach(FakeHandle(4), "\\\\?\\HID#VID_046D&PID_C31C&MI_01#z", IdevKind::Mouse, 0x046DC31C);
+	CHECK_EQ(t.devices[m].ordinal, 0);
+	CHECK_EQ(t.ResolveSlot(m, routes, 4), -1);
+	CHECK_EQ(t.pads[m], 0);
+
+	// A route without VID/PID matches by name only, and its pads are clipped to existing gamepads
+	auto r = t.Attach(FakeHandle(5), "\\\\?\\HID#VID_1532&PID_0084#X#{378DE44C}", IdevKind::Mouse, 0x15320084);
+	CHECK_EQ(t.ResolveSlot(r, routes, 1), 2);
+	CHECK_EQ(t.pads[r], 0b01);
+
+	// An unknown third keyboard of the model gets ordinal 2, unrouted
+	auto c = t.Attach(FakeHandle(6), "\\\\?\\HID#VID_046D&PID_C31C#other", IdevKind::Keyboard, 0x046DC31C);
+	CHECK_EQ(t.devices[c].ordinal, 2);
+	CHECK_EQ(t.ResolveSlot(c, routes, 4), -1);
+	CHECK_EQ(t.GetSlotsOf(1), 1 << b);
+}
+
+static void TestSlots() {
+	RouteTable t;
+	int attached = 0;
+	for (int i = 0; i < kMaxRouteDevices + 4; ++i)
+		attached += t.Attach(FakeHandle(i), std::format("device-{}", i), IdevKind::Keyboard, 0) != kNoRouteSlot;
+	CHECK_EQ(attached, kMaxRouteDevices);
+
+	// A freed slot is reused
+	t.Detach(5);
+	CHECK_EQ(t.Attach(FakeHandle(100), "device-100", IdevKind::Keyboard, 0), 5);
+}
+
+static void TestUnknownModel() {
+	// Devices without VID/PID in their names, e.g. PS/2 keyboards; 0 is "unknown", see InputDevice::vendorId
+	std::vector<ConfigRoute> routes(1);
+	routes[0] = { "\\\\?\\ACPI#PNP0303#4&1d401fb5&0#{884b96c3}", IdevKind::Keyboard, 0, 0, 0b01 };
+	RouteTable t;
+	t.Index(routes);
+
+	auto a = t.Attach(FakeHandle(1), "\\\\?\\ACPI#PNP0303#4&1d401fb5&0#{884b96c3}", IdevKind::Keyboard, 0);
+	CHECK_EQ(t.ResolveSlot(a, routes, 4), 0);
+	CHECK_EQ(t.pads[a], 0b01);
+
+	// Another one is not the same model, whatever its ordinal
+	auto b = t.Attach(FakeHandle(2), "\\\\?\\ACPI#PNP0303#4&77aa&0#{884b96c3}", IdevKind::Keyboard, 0);
+	CHECK_EQ(t.ResolveSlot(b, routes, 4), -1);
+	CHECK_EQ(t.pads[b], 0);
+	t.Detach(a);
+	auto c = t.Attach(FakeHandle(3), "\\\\?\\ACPI#PNP0303#4&5555&0#{884b96c3}", IdevKind::Keyboard, 0);
+	CHECK_EQ(t.devices[c].ordinal, 0);
+	CHECK_EQ(t.ResolveSlot(c, routes, 4), -1);
+	CHECK_EQ(t.pads[c], 0);
+}
+
+int main() {
+	TestIdentity();
+	TestUnknownModel();
+	TestSlots();
+	return TestResult();
+}
@@ -0,0 +1,105 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "fakes.hpp"
+#include "socd.hpp"
+
+#include <string>
+
+// Simultaneous opposing directions: SocdState replayed event by event, then through the engine
+
+using namespace std::literals;
+
+// Events are "+L " for a press of left, "-L " for its release, and so on for UDLR
+// \return the resolved directions after each event, "0" for none
+static std::string Replay(SocdMode mode, std::string_view events) {
+	SocdState s;
+	// Wraps around during the replay
+	uint32_t clock = 0xFFFFFFF0;
+	std::string out;
+	for (size_t i = 0; i + 1 < events.size(); i += 3) {
+		bool pressed = events[i] == '+';
+		int dir = static_cast<int>("UDLR"sv.find(events[i + 1]));
+		s.Set(dir, pressed, clock);
+
+		BYTE dirs = s.Resolve(mode);
+		std::string o;
+		for (int d = 0; d < 4; ++d) {
+			if (dirs & (1 << d))
+				o += "UDLR"[d];
+		}
+		out += (o.empty() ? "0" : o) + " ";
+	}
+	return out;
+}
+
+static void TestReplay() {
+	constexpr auto kLeftRight = "+L +R -R -L "sv;
+	CHECK_EQ(Replay(SocdMode::Off, kLeftRight), "L LR L 0 "s);
+	CHECK_EQ(Replay(SocdMode::Neutral, kLeftRight), "L 0 L 0 "s);
+	CHECK_EQ(Replay(SocdMode::LastInput, kLeftRight), "L R L 0 "s);
+	CHECK_EQ(Replay(SocdMode::FirstInput, kLeftRight), "L L L 0 "s);
+	CHECK_EQ(Replay(SocdMode::Absolute, kLeftRight), "L 0 L 0 "s);
+
+	// The second +R is a typematic repeat, which must not count as a new press
+	constexpr auto kRepeat = "+L +R +R -L -R "sv;
+	CHECK_EQ(Replay(SocdMode::LastInput, kRepeat), "L R R R 0 "s);
+	CHECK_EQ(Replay(SocdMode::FirstInput, kRepeat), "L L L R 0 "s);
+
+	constexpr auto kAll = "+U +D +L +R -U -L -D -R "sv;
+	CHECK_EQ(Replay(SocdMode::Off, kAll), "U UD UDL UDLR DLR DR R 0 "s);
+	CHECK_EQ(Replay(SocdMode::Neutral, kAll), "U 0 L 0 D DR R 0 "s);
+	CHECK_EQ(Replay(SocdMode::LastInput, kAll), "U D DL DR DR DR R 0 "s);
+	CHECK_EQ(Replay(SocdMode::FirstInput, kAll), "U U UL UL DL DR R 0 "s);
+	CHECK_EQ(Replay(SocdMode::Absolute, kAll), "U U UL U D DR R 0 "s);
+
+	// A re-press after a release refreshes the direction's timestamp
+	constexpr auto kRepress = "+L +R -L +L -R "sv;
+	CHECK_EQ(Replay(SocdMode::LastInput, kRepress), "L R R L L "s);
+	CHECK_EQ(Replay(SocdMode::FirstInput, kRepress), "L L R R L "s);
+}
+
+static void TestEngine() {
+	FakeHost host;
+	FakeSink sink;
+	FeederEngine engine(host, sink, Config(toml::parse(R"(
+[Profiles.Default]
+XboxCount = 1
+Routes = [{ Device = "keyboard-0", Kind = "keyboard", Pads = [0] }]
+[[Profiles.Default.Gamepads]]
+DPadLeft = "LeftArrow"
+DPadRight = "RightArrow"
+DPadSocd = "last"
+LStickLeft = "A"
+LStickRight = "D"
+LStick = { Socd = "first" }
+)"sv)));
+	auto kbd = MakeFakeDevice(IdevKind::Keyboard, 0, "keyboard-0");
+	engine.AttachDevice(kbd);
+	InputTimestamp ts{ QpcNow(), 0, 0 };
+	auto& pad = sink.targets.at(0).x360;
+
+	engine.HandleKeyPress(kbd, VK_LEFT, true, ts);
+	CHECK_EQ(pad.wButtons & 0xF, XUSB_GAMEPAD_DPAD_LEFT);
+	engine.HandleKeyPress(kbd, VK_RIGHT, true, ts);
+	CHECK_EQ(pad.wButtons & 0xF, XUSB_GAMEPAD_DPAD_RIGHT);
+	engine.HandleKeyPress(kbd, VK_RIGHT, false, ts);
+	CHECK_EQ(pad.wButtons & 0xF, XUSB_GAMEPAD_DPAD_LEFT);
+	engine.HandleKeyPress(kbd, VK_LEFT, false, ts);
+	CHECK_EQ(pad.wButtons & 0xF, 0);
+
+	engine.HandleKeyPress(kbd, 'A', true, ts);
+	CHECK(pad.sThumbLX < 0);
+	engine.HandleKeyPress(kbd, 'D', true, ts);
+	CHECK(pad.sThumbLX < 0);
+	engine.HandleKeyPress(kbd, 'A', false, ts);
+	CHECK(pad.sThumbLX > 0);
+	engine.HandleKeyPress(kbd, 'D', false, ts);
+	CHECK_EQ(pad.sThumbLX, 0);
+}
+
+int main() {
+	TestReplay();
+	TestEngine();
+	return TestResult();
+}
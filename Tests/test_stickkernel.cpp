@@ -0,0 +1,205 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "stickkernel.hpp"
+#include "stickreference.hpp"
+
+#include <random>
+
+// MouseStickBatch: the SIMD kernel against its scalar instantiation, and both against the per-stick reference
+
+// Differences from the reference come from the LUT (in place of pow()) and the polynomial atan, in units of the report
+constexpr int kMaxErrorVsReference = 4;
+// Except where the tilt is this close to MouseStickBatch::kSnapToFullTilt, which those errors may push to the other side
+constexpr float kSnapMargin = 0.0005f;
+
+// ConfigJoystick::sensitivity for a gain of 1, so that deflections are in the reference's units
+constexpr float kUnitGainSensitivity = MouseStickBatch::kNeutralSensitivity;
+
+struct Lane {
+	ConfigJoystick conf;
+	float x, y;
+};
+
+// Every lane of both batches, compared bit for bit, and against the reference
+static void CheckBatch(std::span<const Lane> lanes, int& worstError) {
+	static MouseStickBatch simd, scalar;
+	simd.Clear();
+	scalar.Clear();
+	for (int lane = 0; lane < lanes.size(); ++lane) {
+		simd.SetLaneParams(lane, lanes[lane].conf);
+		scalar.SetLaneParams(lane, lanes[lane].conf);
+		simd.deflX[lane] = scalar.deflX[lane] = lanes[lane].x;
+		simd.deflY[lane] = scalar.deflY[lane] = lanes[lane].y;
+	}
+	simd.Compute(0.0f);
+	scalar.ComputeScalar(0.0f);
+
+	for (int lane = 0; lane < lanes.size(); ++lane) {
+		auto& l = lanes[lane];
+		bool same = CHECK_EQ(simd.outX[lane], scalar.outX[lane]) & CHECK_EQ(simd.outY[lane], scalar.outY[lane]);
+
+		short refX, refY;
+		float tilt = stickref::ComputeStick(l.x, l.y, l.conf, 0.0f, refX, refY);
+		if (std::abs(1.0f - tilt - MouseStickBatch::kSnapToFullTilt) < kSnapMargin)
+			continue;
+		int error = std::max(std::abs(refX - scalar.outX[lane]), std::abs(refY - scalar.outY[lane]));
+		worstError = std::max(worstError, error);
+		bool close = CHECK(error <= kMaxErrorVsReference);
+		if (!same || !close) {
+			std::printf("  lane %d: (%g, %g) deadzone %g nonlinear %g outer radius %g: simd (%d, %d) scalar (%d, %d) reference (%d, %d)\n",
+				lane, l.x, l.y, l.conf.deadzone, l.conf.nonLinear, l.conf.outerRadius,
+				simd.outX[lane], simd.outY[lane], scalar.outX[lane], scalar.outY[lane], refX, refY);
+		}
+	}
+}
+
+static ConfigJoystick MakeConf(float deadzone, float nonLinear, float outerRadius, bool invertX = false, bool invertY = false) {
+	ConfigJoystick conf;
+	conf.useMouse = true;
+	conf.sensitivity = kUnitGainSensitivity;
+	conf.deadzone = deadzone;
+	conf.nonLinear = nonLinear;
+	conf.outerRadius = outerRadius;
+	conf.invertXAxis = invertX;
+	conf.invertYAxis = invertY;
+	return conf;
+}
+
+static void TestEdgeCases() {
+	auto conf = MakeConf(0.1f, 0.8f, 10.0f);
+	// Center, signed zeros, the axes, the diagonals of all quadrants, on and beyond the outer radius, inside the deadzone
+	const float points[][2] = {
+		{ 0, 0 }, { -0.0f, 0 }, { 0, -0.0f }, { -0.0f, -0.0f },
+		{ 5, 0 }, { -5, 0 }, { 0, 5 }, { 0, -5 }, { -5, -0.0f }, { 5, -0.0f },
+		{ 4, 4 }, { -4, 4 }, { -4, -4 }, { 4, -4 },
+		{ 10, 0 }, { 7, 7 }, { 30, -30 }, { -1000, 3 }, { 0.5f, 0.5f }, { 1, 0 },
+	};
+	std::vector<Lane> lanes;
+	int worst = 0;
+	for (auto& p : points) {
+		lanes.push_back({ conf, p[0], p[1] });
+		if (lanes.size() == MouseStickBatch::kLaneCount) {
+			CheckBatch(lanes, worst);
+			lanes.clear();
+		}
+	}
+	if (!lanes.empty())
+		CheckBatch(lanes, worst);
+
+	// Full tilt on an axis is exact
+	MouseStickBatch b;
+	b.SetLaneParams(0, conf);
+	b.deflX[0] = 20.0f;
+	b.Compute(0.0f);
+	CHECK_EQ(b.outX[0], 32767);
+	CHECK_EQ(b.outY[0], 0);
+	// Inside the deadzone
+	b.deflX[0] = 0.9f;
+	b.Compute(0.0f);
+	CHECK_EQ(b.outX[0], 0);
+}
+
+static void TestRandom() {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_int_distribution<int> counts(-25, 25);
+
+	int worst = 0;
+	Lane lanes[MouseStickBatch::kLaneCount];
+	for (int round = 0; round < 20000; ++round) {
+		for (auto& l : lanes) {
+			l.conf = MakeConf(unit(rng) * 0.3f, 0.3f + unit(rng), 1.0f + unit(rng) * 20.0f, unit(rng) < 0.5f, unit(rng) < 0.5f);
+			// Whole mouse counts like the original accumulator, and sub-count deflections like the filter's
+			if (round % 2 == 0) {
+				l.x = static_cast<float>(counts(rng));
+				l.y = static_cast<float>(counts(rng));
+			}
+			else {
+				l.x = (unit(rng) * 2.0f - 1.0f) * 25.0f;
+				l.y = (unit(rng) * 2.0f - 1.0f) * 25.0f;
+			}
+		}
+		CheckBatch(lanes, worst);
+		if (gChecksFailed > 20)
+			break;
+	}
+	std::printf("Worst error against the reference: %d\n", worst);
+}
+
+// Along the positive X axis the direction mapping is the identity, so outX is the response curve itself
+static void TestResponseCurve() {
+	struct Params {
+		float deadzone, nonLinear, outerRadius, sensitivity;
+	};
+	const Params params[] = {
+		{ 0.0f, 1.0f, 10.0f, 15.0f },
+		{ 0.02f, 0.8f, 10.0f, 50.0f },
+		{ 0.3f, 0.3f, 4.0f, 5.0f },
+		{ 0.1f, 1.7f, 25.0f, 15.0f },
+		{ 0.5f, 0.5f, 1.0f, 100.0f },
+		{ 1.0f, 1.0f, 10.0f, 15.0f },
+	};
+
+	int worst = 0;
+	for (auto& p : params) {
+		ConfigJoystick conf = MakeConf(p.deadzone, p.nonLinear, p.outerRadius);
+		conf.sensitivity = p.sensitivity;
+		MouseStickBatch b;
+		b.SetLaneParams(0, conf);
+		conf.invertXAxis = true;
+		b.SetLaneParams(1, conf);
+
+		float gain = MouseStickBatch::kNeutralSensitivity / p.sensitivity;
+		// Up to twice the outer radius, which saturates
+		constexpr int kSteps = 2000;
+		for (int i = 0; i <= kSteps; ++i) {
+			float u = 2.0f * i / kSteps;
+			b.deflX[0] = b.deflX[1] = u * p.outerRadius / gain;
+			b.deflY[0] = b.deflY[1] = 0.0f;
+			b.Compute(0.0f);
+
+			float expected = MouseStickBatch::EvalTiltCurve(std::min(u, 1.0f), p.deadzone, p.nonLinear);
+			float raw = MouseStickBatch::EvalLiveZoneCurve((std::min(u, 1.0f) - p.deadzone) / (1.0f - p.deadzone), p.nonLinear);
+			if (std::abs(1.0f - raw - MouseStickBatch::kSnapToFullTilt) < kSnapMargin)
+				continue;
+			int error = std::abs(b.outX[0] - static_cast<int>(expected * 32767.0f));
+			worst = std::max(worst, error);
+			if (!CHECK(error <= kMaxErrorVsReference))
+				std::printf("  u %g deadzone %g nonlinear %g: %d, expected %g\n", u, p.deadzone, p.nonLinear, b.outX[0], expected * 32767.0f);
+			CHECK_EQ(b.outY[0], 0);
+			// Inverted
+			CHECK_EQ(b.outX[1], -b.outX[0]);
+			if (u <= p.deadzone)
+				CHECK_EQ(b.outX[0], 0);
+			// A 100% deadzone never tilts
+			if (u >= 1.0f && p.deadzone < 1.0f)
+				CHECK_EQ(b.outX[0], 32767);
+		}
+	}
+	std::printf("Worst error against the analytic curve: %d\n", worst);
+}
+
+static void TestInactiveLanes() {
+	MouseStickBatch b;
+	b.SetLaneParams(MouseStickBatch::LaneOf(1, true), MakeConf(0.0f, 1.0f, 10.0f));
+	CHECK_EQ(b.activeMask, 1u << MouseStickBatch::LaneOf(1, true));
+	b.SetDeflection(1, 3.0f, 4.0f);
+	b.Compute(0.0f);
+	CHECK(b.outX[MouseStickBatch::LaneOf(1, true)] != 0);
+	// Cleared lanes come out centered
+	CHECK_EQ(b.outX[MouseStickBatch::LaneOf(1, false)], 0);
+
+	ConfigJoystick keyboard;
+	keyboard.useMouse = false;
+	b.SetLaneParams(MouseStickBatch::LaneOf(1, true), keyboard);
+	CHECK_EQ(b.activeMask, 0u);
+}
+
+int main() {
+	TestEdgeCases();
+	TestRandom();
+	TestResponseCurve();
+	TestInactiveLanes();
+	return TestResult();
+}
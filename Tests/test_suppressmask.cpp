@@ -0,0 +1,124 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "keycode.hpp"
+#include "../WndMsgFilter/suppressmask.hpp"
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// The protocol between the feeder and WndMsgFilter's hook, on a table in ordinary memory instead of the file mapping
+
+static void SetKey(uint64_t (&mask)[4], uint8_t key) {
+	mask[key >> 6] |= uint64_t(1) << (key & 63);
+}
+
+static void TestDevices() {
+	// Value initialized, like a fresh mapping is zero filled
+	auto t = std::make_unique<SuppressMaskTable>();
+	CHECK(!IsKeySuppressed(*t, 'W'));
+	CHECK(!IsKeySuppressed(*t, 0x1234, 'W'));
+
+	uint64_t a[4] = {}, b[4] = {};
+	SetKey(a, 'W');
+	SetKey(a, VK_LSHIFT);
+	SetKey(b, 'I');
+	WriteSuppressDeviceEntry(t->devices[0], 0x1234, a);
+	WriteSuppressDeviceEntry(t->devices[3], 0x5678, b);
+	UpdateSuppressAnyDevice(*t);
+
+	CHECK(IsKeySuppressed(*t, 0x1234, 'W'));
+	CHECK(IsKeySuppressed(*t, 0x1234, VK_LSHIFT));
+	CHECK(!IsKeySuppressed(*t, 0x1234, 'I'));
+	CHECK(IsKeySuppressed(*t, 0x5678, 'I'));
+	CHECK(!IsKeySuppressed(*t, 0x9999, 'W'));
+	// WM_KEYDOWN doesn't say which device, so any device's keys count
+	CHECK(IsKeySuppressed(*t, 'W'));
+	CHECK(IsKeySuppressed(*t, 'I'));
+	CHECK(!IsKeySuppressed(*t, 'A'));
+	// Even again once written
+	CHECK_EQ(t->devices[0].seq.load(), 2u);
+
+	// Freeing an entry takes its keys out of the union
+	uint64_t none[4] = {};
+	WriteSuppressDeviceEntry(t->devices[0], 0, none);
+	UpdateSuppressAnyDevice(*t);
+	CHECK(!IsKeySuppressed(*t, 0x1234, 'W'));
+	CHECK(!IsKeySuppressed(*t, 'W'));
+	CHECK(IsKeySuppressed(*t, 'I'));
+
+	// And it can be reused by another device
+	WriteSuppressDeviceEntry(t->devices[0], 0x4321, a);
+	UpdateSuppressAnyDevice(*t);
+	CHECK(IsKeySuppressed(*t, 0x4321, 'W'));
+	CHECK(!IsKeySuppressed(*t, 0x1234, 'W'));
+}
+
+static void TestScanCodeSlots() {
+	// The hook decodes with the table the feeder copies in, so the slots must be laid out the same
+	CHECK_EQ(SuppressScanCodeSlotOf(0x1C, true, false), 0x11C);
+	CHECK_EQ(SuppressScanCodeSlotOf(0x1D, false, true), 0x9D);
+
+	auto t = std::make_unique<SuppressMaskTable>();
+	for (int slot = 0; slot < kSuppressScanCodeSlotCount; ++slot) {
+		USHORT flags = (slot & 0x100 ? RI_KEY_E0 : 0) | (slot & 0x80 ? RI_KEY_E1 : 0);
+		t->scanCodeKeys[slot] = KeyCodeFromScanCode(slot & 0x7F, flags);
+	}
+	CHECK_EQ(t->scanCodeKeys[SuppressScanCodeSlotOf(0x1C, true, false)], kVkNumpadEnter);
+	CHECK_EQ(t->scanCodeKeys[SuppressScanCodeSlotOf(0x1D, false, true)], VK_PAUSE);
+	CHECK_EQ(t->scanCodeKeys[SuppressScanCodeSlotOf(0x1D, true, false)], VK_RCONTROL);
+	CHECK_EQ(t->scanCodeKeys[SuppressScanCodeSlotOf(0x2A, true, false)], 0xFF);
+}
+
+static void TestConcurrentRewrite() {
+	auto t = std::make_unique<SuppressMaskTable>();
+
+	// The writer keeps handing entry 1 between device A, with only even keys, and device B, with only odd keys.
+	// A reader must never see a key of one device's mask reported for the other.
+	uint64_t even[4], odd[4];
+	for (int i = 0; i < 4; ++i) {
+		even[i] = 0x5555555555555555;
+		odd[i] = ~even[i];
+	}
+	std::atomic<bool> stop = false;
+	std::atomic<int64_t> hits = 0, violations = 0;
+	std::thread writer([&] {
+		for (uint64_t n = 0; !stop.load(std::memory_order_relaxed); ++n)
+			WriteSuppressDeviceEntry(t->devices[1], n & 1 ? 0xB : 0xA, n & 1 ? odd : even);
+	});
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 3; ++r) {
+		readers.emplace_back([&, r] {
+			std::mt19937 rng(r);
+			int64_t localHits = 0, localViolations = 0;
+			for (int i = 0; i < 2'000'000; ++i) {
+				auto key = static_cast<uint8_t>(rng());
+				bool isA = rng() & 1;
+				if (IsKeySuppressed(*t, isA ? 0xA : 0xB, key)) {
+					++localHits;
+					if ((key & 1) == (isA ? 1 : 0))
+						++localViolations;
+				}
+			}
+			hits += localHits;
+			violations += localViolations;
+		});
+	}
+	for (auto& r : readers)
+		r.join();
+	stop = true;
+	writer.join();
+
+	CHECK(hits.load() > 0);
+	CHECK_EQ(violations.load(), 0);
+}
+
+int main() {
+	TestDevices();
+	TestScanCodeSlots();
+	TestConcurrentRewrite();
+	return TestResult();
+}
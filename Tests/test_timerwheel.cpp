@@ -0,0 +1,167 @@
+#include "pch.hpp"
+
+#include "check.hpp"
+#include "timerwheel.hpp"
+
+#include <random>
+#include <vector>
+
+// TimerWheel: every timer fires on its exact tick, however far away and however it was re-armed
+
+struct TestTimer : TimerNode {
+	TimerWheel* wheel = nullptr;
+	uint64_t want = 0;
+	int fired = 0;
+	int late = 0;
+	// Re-arm from the callback with this delay, 0 for none
+	uint64_t rearmDelay = 0;
+
+	TestTimer() {
+		fire = [](TimerNode& node) noexcept {
+			auto& t = static_cast<TestTimer&>(node);
+			++t.fired;
+			if (t.wheel->GetCurrentTick() != t.want)
+				++t.late;
+			if (t.rearmDelay != 0) {
+				t.want = t.wheel->GetCurrentTick() + t.rearmDelay;
+				t.wheel->Schedule(t, t.rearmDelay);
+			}
+		};
+	}
+
+	void Arm(uint64_t delay) {
+		want = wheel->GetCurrentTick() + delay;
+		wheel->Schedule(*this, delay);
+	}
+};
+
+static void TestExactExpiry() {
+	TimerWheel w;
+	// One per level, and right at the level boundaries
+	const uint64_t delays[] = { 1, 2, 63, 64, 65, 4095, 4096, 4097, 100'000, 262'143, 262'144, TimerWheel::kMaxDelay };
+	std::vector<TestTimer> ts(std::size(delays));
+	for (size_t i = 0; i < ts.size(); ++i) {
+		ts[i].wheel = &w;
+		ts[i].Arm(delays[i]);
+	}
+	CHECK_EQ(w.GetArmedCount(), ts.size());
+
+	// In uneven jumps, so that some advances cross several slots and levels at once
+	std::mt19937_64 rng(2);
+	while (w.GetArmedCount() != 0 && w.GetCurrentTick() <= TimerWheel::kMaxDelay) {
+		uint64_t next = w.GetTicksUntilNext();
+		CHECK(next >= 1);
+		w.AdvanceTo(w.GetCurrentTick() + next);
+	}
+	for (auto& t : ts) {
+		CHECK_EQ(t.fired, 1);
+		CHECK_EQ(t.late, 0);
+	}
+}
+
+static void TestCancelAndRearm() {
+	TimerWheel w;
+	TestTimer a, b, c;
+	a.wheel = b.wheel = c.wheel = &w;
+
+	a.Arm(10);
+	b.Arm(10);
+	w.Cancel(b);
+	CHECK(!b.IsArmed());
+	// A no-op when not armed
+	w.Cancel(b);
+	CHECK_EQ(w.GetArmedCount(), 1u);
+
+	// Re-arming moves the timer
+	c.Arm(5);
+	c.Arm(5000);
+	w.AdvanceTo(10);
+	CHECK_EQ(a.fired, 1);
+	CHECK_EQ(b.fired, 0);
+	CHECK_EQ(c.fired, 0);
+	w.AdvanceTo(5010);
+	CHECK_EQ(c.fired, 1);
+	CHECK_EQ(c.late, 0);
+
+	// Too far away is clamped, and 0 is the next tick
+	a.Arm(0);
+	CHECK_EQ(a.expiry, w.GetCurrentTick() + 1);
+	w.Schedule(b, TimerWheel::kMaxDelay * 2);
+	CHECK_EQ(b.expiry, w.GetCurrentTick() + TimerWheel::kMaxDelay);
+	w.Cancel(a);
+	w.Cancel(b);
+	CHECK_EQ(w.GetArmedCount(), 0u);
+	CHECK_EQ(w.GetTicksUntilNext(), TimerWheel::kNever);
+}
+
+static void TestRearmFromCallback() {
+	// Like turbo: the timer re-arms itself every time it fires
+	TimerWheel w;
+	TestTimer t;
+	t.wheel = &w;
+	t.rearmDelay = 7;
+	t.Arm(7);
+	w.AdvanceTo(7 * 100);
+	CHECK_EQ(t.fired, 100);
+	CHECK_EQ(t.late, 0);
+	CHECK(t.IsArmed());
+}
+
+static void TestRandomized() {
+	// 16 gamepads x 256 timers, randomly scheduled, cancelled and re-armed, stepping tick by tick so that every fire
+	// is checked against its exact expiry
+	TimerWheel w;
+	std::vector<TestTimer> ts(16 * 256);
+	for (auto& t : ts)
+		t.wheel = &w;
+
+	std::mt19937_64 rng(1);
+	int tooLate = 0;
+	for (int step = 0; step < 20'000; ++step) {
+		auto& t = ts[rng() % ts.size()];
+		switch (rng() % 4) {
+		case 0:
+			t.rearmDelay = rng() % 3 == 0 ? 1 + rng() % 500 : 0;
+			t.Arm(1 + rng() % (rng() & 1 ? 60 : 300'000));
+			break;
+		case 1:
+			w.Cancel(t);
+			break;
+		default: {
+			uint64_t until = w.GetCurrentTick() + 1 + rng() % 50;
+			while (w.GetCurrentTick() < until) {
+				// Never late: nothing may be due before what this says
+				uint64_t next = w.GetTicksUntilNext();
+				uint64_t earliest = TimerWheel::kNever;
+				for (auto& other : ts) {
+					if (other.IsArmed())
+						earliest = std::min(earliest, other.expiry - w.GetCurrentTick());
+				}
+				tooLate += next > earliest;
+				w.AdvanceTo(w.GetCurrentTick() + 1);
+			}
+			break;
+		}
+		}
+	}
+
+	int fired = 0, late = 0;
+	size_t armed = 0;
+	for (auto& t : ts) {
+		fired += t.fired;
+		late += t.late;
+		armed += t.IsArmed();
+	}
+	CHECK_EQ(tooLate, 0);
+	CHECK(fired > 1000);
+	CHECK_EQ(late, 0);
+	CHECK_EQ(armed, w.GetArmedCount());
+}
+
+int main() {
+	TestExactExpiry();
+	TestCancelAndRearm();
+	TestRearmFromCallback();
+	TestRandomized();
+	return TestResult();
+}
@@ -0,0 +1,79 @@
+#include "pch.hpp"
+
+#include "allochook.hpp"
+
+#ifdef WXF_ALLOC_HOOK
+
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#ifdef _WIN32
+static void* AlignedMalloc(size_t size, size_t align) noexcept {
+	return _aligned_malloc(size, align);
+}
+
+static void AlignedFree(void* p) noexcept {
+	_aligned_free(p);
+}
+#else
+// aligned_alloc() wants the size to be a multiple of the alignment
+static void* AlignedMalloc(size_t size, size_t align) noexcept {
+	return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+static void AlignedFree(void* p) noexcept {
+	std::free(p);
+}
+#endif
+
+static thread_local uint64_t tAllocCount = 0;
+
+uint64_t GetThreadAllocCount() noexcept {
+	return tAllocCount;
+}
+
+void* operator new(size_t size) {
+	++tAllocCount;
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	++tAllocCount;
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+	++tAllocCount;
+	if (void* p = AlignedMalloc(size == 0 ? 1 : size, static_cast<size_t>(align)))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+	++tAllocCount;
+	return AlignedMalloc(size == 0 ? 1 : size, static_cast<size_t>(align));
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, const std::nothrow_t& t) noexcept { return operator new(size, t); }
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t& t) noexcept { return operator new(size, align, t); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { AlignedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { AlignedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { AlignedFree(p); }
+
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { AlignedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { AlignedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { AlignedFree(p); }
+
+#endif
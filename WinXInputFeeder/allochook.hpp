@@ -0,0 +1,36 @@
+#pragma once
+
+#include "utils.hpp"
+
+#include <cassert>
+#include <cstdint>
+
+// Heap allocation counting hook, compiled in when WXF_ALLOC_HOOK is defined (on by default in Debug builds)
+// Replaces the global operator new/delete to count allocations made by each thread. Allocations that bypass operator new
+// (e.g. malloc() calls from C libraries) are not counted.
+
+#ifdef WXF_ALLOC_HOOK
+
+// Number of operator new calls made by the calling thread so far
+uint64_t GetThreadAllocCount() noexcept;
+
+// Asserts that no heap allocation happens on this thread during the lifetime of the object
+struct NoAllocScope {
+	uint64_t allocCountAtEntry;
+
+	NoAllocScope() noexcept : allocCountAtEntry{ GetThreadAllocCount() } {}
+	~NoAllocScope() {
+		assert(GetThreadAllocCount() == allocCountAtEntry && "heap allocation in a no-alloc scope");
+	}
+
+	NoAllocScope(const NoAllocScope&) = delete;
+	NoAllocScope& operator=(const NoAllocScope&) = delete;
+};
+
+#define NO_ALLOC_SCOPE() NoAllocScope UNIQUE_NAME(noAllocScope)
+
+#else
+
+#define NO_ALLOC_SCOPE()
+
+#endif
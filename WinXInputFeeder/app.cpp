@@ -5,7 +5,10 @@
 
 #include "modelconfig.hpp"
 #include "modelruntime.hpp"
+#include "allochook.hpp"
+#include "taskgraph.hpp"
 #include "inputdevice.hpp"
+#include "trace.hpp"
 #include "ui.hpp"
 #include "utils.hpp"
 
@@ -14,7 +17,9 @@
 #include <cmath>
 #include <cstddef>
 #include <d3d11.h>
+#include <dxgi1_3.h>
 #include <filesystem>
+#include <fstream>
 #include <imgui.h>
 #include <imgui_impl_dx11.h>
 #include <imgui_impl_win32.h>
@@ -28,6 +33,15 @@ namespace fs = std::filesystem;
 using namespace std::literals;
 
 constexpr UINT_PTR kMouseCheckTimerID = 0;
+// Startup has at most 3 slow tasks that can run at the same time: config parsing, ViGEm connection and D3D device creation
+constexpr int kStartupWorkerCount = 3;
+constexpr UINT kTrayIconMessage = WM_APP + 1;
+constexpr UINT kTrayIconID = 1;
+constexpr UINT_PTR kTrayMenuShowUI = 1;
+constexpr UINT_PTR kTrayMenuQuit = 2;
+constexpr UINT_PTR kTrimTimerID = 1;
+// How long the UI has to stay minimized before its GPU and font resources are released
+constexpr UINT kTrimTimeoutMs = 10'000;
 
 // Forward declare message handler from imgui_impl_win32.cpp
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -45,43 +59,82 @@ LRESULT CALLBACK MainWindowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM l
 
 	case WM_SIZE: {
 		auto& app = *reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+		// Still being created, or being destroyed by HideUI()
+		if (!app.mainWindow)
+			break;
 
 		if (wParam == SIZE_MINIMIZED) {
 			--app.shownWindowCount;
+			SetTimer(app.inputWindow.hWnd, kTrimTimerID, kTrimTimeoutMs, nullptr);
 			return 0;
 		}
 
+		KillTimer(app.inputWindow.hWnd, kTrimTimerID);
+		if (app.uiTrimmed)
+			app.RestoreUIResources();
+
 		auto resizeWidth = static_cast<UINT>(LOWORD(lParam));
 		auto resizeHeight = static_cast<UINT>(HIWORD(lParam));
-		app.mainWindow.ResizeRenderTarget(resizeWidth, resizeHeight);
+		if (app.mainWindow->swapChain)
+			app.mainWindow->ResizeRenderTarget(resizeWidth, resizeHeight);
 		++app.shownWindowCount;
 		return 0;
 	}
 
-	case WM_DESTROY: {
-		PostQuitMessage(0);
+	case WM_CLOSE: {
+		auto& app = *reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+		// Closing the window only hides the UI, the feeder keeps running in the tray
+		app.RequestUI(false);
 		return 0;
 	}
 
+	case WM_DPICHANGED: {
+		auto& app = *reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+
+		auto newRect = reinterpret_cast<RECT*>(lParam);
+		SetWindowPos(hWnd,
+			nullptr,
+			newRect->left,
+			newRect->top,
+			newRect->right - newRect->left,
+			newRect->bottom - newRect->top,
+			SWP_NOZORDER | SWP_NOACTIVATE);
+
+		app.OnDpiChanged(HIWORD(wParam));
+		break;
+	}
+	}
+
+	return DefWindowProcW(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT CALLBACK InputWindowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept {
+	switch (uMsg) {
+	case WM_NCCREATE: {
+		auto cs = reinterpret_cast<CREATESTRUCT*>(lParam);
+		SetWindowLongPtrW(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(cs->lpCreateParams));
+		break;
+	}
+
 	case WM_INPUT: {
 		auto& app = *reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
 
-		auto hri = reinterpret_cast<HRAWINPUT>(lParam);
+		InputTimestamp ts;
+		ts.qpcReceived = QpcNow();
+		ts.msgTime = static_cast<DWORD>(GetMessageTime());
+		ts.tickReceived = GetTickCount();
 
-		UINT size = 0;
-		GetRawInputData(hri, RID_INPUT, nullptr, &size, sizeof(RAWINPUTHEADER));
-		if (size > app.rawinputSize || app.rawinput == nullptr) {
-			app.rawinput = std::make_unique<std::byte[]>(size);
-			app.rawinputSize = size;
-		}
+		auto hri = reinterpret_cast<HRAWINPUT>(lParam);
 
-		if (GetRawInputData(hri, RID_INPUT, app.rawinput.get(), &size, sizeof(RAWINPUTHEADER)) == (UINT)-1) {
-			LOG_DEBUG(L"GetRawInputData() failed");
+		// Fails if the input doesn't fit, which can't happen for the keyboard/mouse inputs we register for
+		UINT size = sizeof(app.rawinput);
+		if (GetRawInputData(hri, RID_INPUT, app.rawinput, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1) {
+			LOG_DEBUG_STATIC(L"GetRawInputData() failed");
 			return 0;
 		}
-		RAWINPUT* ri = reinterpret_cast<RAWINPUT*>(app.rawinput.get());
+		RAWINPUT* ri = reinterpret_cast<RAWINPUT*>(app.rawinput);
 
-		return app.OnRawInput(ri);
+		return app.OnRawInput(ri, ts);
 	}
 
 	case WM_INPUT_DEVICE_CHANGE: {
@@ -96,19 +149,45 @@ LRESULT CALLBACK MainWindowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM l
 		return 0;
 	}
 
-	case WM_DPICHANGED: {
+	case WM_TIMER: {
+		if (wParam != kTrimTimerID)
+			break;
+
 		auto& app = *reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+		KillTimer(hWnd, kTrimTimerID);
+		app.TrimUIResources();
+		return 0;
+	}
 
-		auto newRect = reinterpret_cast<RECT*>(lParam);
-		SetWindowPos(hWnd,
-			nullptr,
-			newRect->left,
-			newRect->top,
-			newRect->right - newRect->left,
-			newRect->bottom - newRect->top,
-			SWP_NOZORDER | SWP_NOACTIVATE);
+	case kKeymapsCompiledMessage: {
+		auto& app = *reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+		if (app.feeder)
+			app.feeder->InstallCompiledKeymaps();
+		return 0;
+	}
 
-		app.OnDpiChanged(HIWORD(wParam));
+	case kTrayIconMessage: {
+		auto& app = *reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+
+		switch (LOWORD(lParam)) {
+		case WM_LBUTTONUP:
+		case WM_LBUTTONDBLCLK:
+			app.RequestUI(true);
+			break;
+		case WM_RBUTTONUP:
+			app.inputWindow.ShowTrayMenu(app);
+			break;
+		}
+		return 0;
+	}
+
+	default: {
+		// Registered message, so it can't be a case label
+		auto app = reinterpret_cast<App*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+		if (app && uMsg == app->inputWindow.taskbarCreatedMsg) {
+			app->inputWindow.AddTrayIcon();
+			return 0;
+		}
 		break;
 	}
 	}
@@ -116,22 +195,114 @@ LRESULT CALLBACK MainWindowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM l
 	return DefWindowProcW(hWnd, uMsg, wParam, lParam);
 }
 
-MainWindow::MainWindow(App& app, HINSTANCE hInstance) {
+InputWindow::InputWindow(App& app, HINSTANCE hInstance) {
+	taskbarCreatedMsg = RegisterWindowMessageW(L"TaskbarCreated");
+
 	WNDCLASSEXW wc = {};
 	wc.cbSize = sizeof(wc);
-	wc.lpfnWndProc = MainWindowWndProc;
+	wc.lpfnWndProc = InputWindowWndProc;
 	wc.hInstance = hInstance;
-	wc.lpszClassName = L"WinXInputFeeder Config";
+	wc.lpszClassName = L"WinXInputFeeder Input";
 	hWc = RegisterClassExW(&wc);
 	if (!hWc)
-		throw std::runtime_error(std::format("Error creating main window class: {}", GetLastErrorStrUtf8()));
+		throw std::runtime_error(std::format("Error creating input window class: {}", GetLastErrorStrUtf8()));
 
+	// Never shown
+	hWnd = CreateWindowExW(
+		0,
+		MAKEINTATOM(hWc),
+		L"WinXInputFeeder",
+		WS_OVERLAPPED,
+		0, 0, 0, 0,
+		NULL,  // Parent window
+		NULL,  // Menu
+		NULL,  // Instance handle
+		reinterpret_cast<LPVOID>(&app)
+	);
+	if (hWnd == nullptr)
+		throw std::runtime_error(std::format("Error creating input window: {}", GetLastErrorStrUtf8()));
+
+	trayIcon.cbSize = sizeof(trayIcon);
+	trayIcon.hWnd = hWnd;
+	trayIcon.uID = kTrayIconID;
+	trayIcon.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
+	trayIcon.uCallbackMessage = kTrayIconMessage;
+	trayIcon.hIcon = LoadIconW(nullptr, IDI_APPLICATION);
+	wcscpy_s(trayIcon.szTip, L"WinXInputFeeder");
+	AddTrayIcon();
+}
+
+InputWindow::~InputWindow() {
+	Shell_NotifyIconW(NIM_DELETE, &trayIcon);
+	DestroyWindow(hWnd);
+	UnregisterClassW(MAKEINTATOM(hWc), nullptr);
+}
+
+void InputWindow::AddTrayIcon() noexcept {
+	// Not fatal, the UI can still be shown with the hotkey
+	if (!Shell_NotifyIconW(NIM_ADD, &trayIcon))
+		LOG_DEBUG_STATIC(L"Failed to add tray icon");
+}
+
+void InputWindow::ShowTrayMenu(App& app) noexcept {
+	HMENU menu = CreatePopupMenu();
+	if (!menu)
+		return;
+	AppendMenuW(menu, MF_STRING, kTrayMenuShowUI, L"Show UI");
+	AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+	AppendMenuW(menu, MF_STRING, kTrayMenuQuit, L"Quit");
+
+	POINT cursor;
+	GetCursorPos(&cursor);
+	// Required for the menu to close when clicking outside of it
+	// https://learn.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-trackpopupmenu#remarks
+	SetForegroundWindow(hWnd);
+	UINT_PTR cmd = TrackPopupMenu(menu, TPM_RETURNCMD | TPM_RIGHTBUTTON | TPM_NONOTIFY, cursor.x, cursor.y, 0, hWnd, nullptr);
+	DestroyMenu(menu);
+
+	if (cmd == kTrayMenuShowUI)
+		app.RequestUI(true);
+	else if (cmd == kTrayMenuQuit)
+		PostQuitMessage(0);
+}
+
+static UINT GetPrimaryMonitorDpi() noexcept {
 	HMONITOR monitor = MonitorFromPoint(POINT{ 0,0 }, MONITOR_DEFAULTTOPRIMARY);
 	// https://learn.microsoft.com/en-us/windows/win32/api/shellscalingapi/nf-shellscalingapi-getdpiformonitor
 	// "The values of *dpiX and *dpiY are identical. You only need to record one of the values to determine the DPI and respond appropriately."
 	UINT dpiX, dpiY;
 	if (FAILED(GetDpiForMonitor(monitor, MDT_EFFECTIVE_DPI, &dpiX, &dpiY)))
 		dpiX = USER_DEFAULT_SCREEN_DPI;
+	return dpiX;
+}
+
+void MainWindow::CreateDevice(ID3D11Device*& device, ID3D11DeviceContext*& context) {
+	UINT createDeviceFlags = 0;
+	//createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+	D3D_FEATURE_LEVEL featureLevel;
+	D3D_FEATURE_LEVEL featureLevelArray[] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_0, };
+	HRESULT res = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, createDeviceFlags, featureLevelArray, 2, D3D11_SDK_VERSION, &device, &featureLevel, &context);
+	// Try high-performance WARP software driver if hardware is not available.
+	if (res == DXGI_ERROR_UNSUPPORTED)
+		res = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, createDeviceFlags, featureLevelArray, 2, D3D11_SDK_VERSION, &device, &featureLevel, &context);
+	if (res != S_OK)
+		throw std::runtime_error("Failed to create D3D device");
+}
+
+MainWindow::MainWindow(App& app, HINSTANCE hInstance, ID3D11Device* device, ID3D11DeviceContext* context)
+	: d3dDevice{ device }
+	, d3dDeviceContext{ context }
+{
+	WNDCLASSEXW wc = {};
+	wc.cbSize = sizeof(wc);
+	wc.lpfnWndProc = MainWindowWndProc;
+	wc.hInstance = hInstance;
+	wc.lpszClassName = L"WinXInputFeeder Config";
+	hWc = RegisterClassExW(&wc);
+	if (!hWc)
+		throw std::runtime_error(std::format("Error creating main window class: {}", GetLastErrorStrUtf8()));
+
+	UINT dpiX = GetPrimaryMonitorDpi();
 	auto scaleFactor = static_cast<float>(dpiX) / USER_DEFAULT_SCREEN_DPI;
 
 	RECT wndRect{};
@@ -159,39 +330,14 @@ MainWindow::MainWindow(App& app, HINSTANCE hInstance) {
 	if (hWnd == nullptr)
 		throw std::runtime_error(std::format("Error creating main window: {}", GetLastErrorStrUtf8()));
 
-	// Setup swap chain
-	DXGI_SWAP_CHAIN_DESC sd = {};
-	sd.BufferCount = 2;
-	sd.BufferDesc.Width = 0;
-	sd.BufferDesc.Height = 0;
-	sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	sd.BufferDesc.RefreshRate.Numerator = 60;
-	sd.BufferDesc.RefreshRate.Denominator = 1;
-	sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
-	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	sd.OutputWindow = hWnd;
-	sd.SampleDesc.Count = 1;
-	sd.SampleDesc.Quality = 0;
-	sd.Windowed = TRUE;
-	sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-
-	UINT createDeviceFlags = 0;
-	//createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
-	D3D_FEATURE_LEVEL featureLevel;
-	D3D_FEATURE_LEVEL featureLevelArray[] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_0, };
-	HRESULT res = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, createDeviceFlags, featureLevelArray, 2, D3D11_SDK_VERSION, &sd, &swapChain, &d3dDevice, &featureLevel, &d3dDeviceContext);
-	// Try high-performance WARP software driver if hardware is not available.
-	if (res == DXGI_ERROR_UNSUPPORTED)
-		res = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, createDeviceFlags, featureLevelArray, 2, D3D11_SDK_VERSION, &sd, &swapChain, &d3dDevice, &featureLevel, &d3dDeviceContext);
-	if (res != S_OK)
-		throw std::runtime_error("Failed to create D3D device and swapchain");
-
-	CreateRenderTarget();
+	if (!d3dDevice)
+		CreateDevice(d3dDevice, d3dDeviceContext);
+	if (!CreateSwapChain())
+		throw std::runtime_error("Failed to create swapchain");
 }
 
 MainWindow::~MainWindow() {
-	DestroyRenderTarget();
-	if (swapChain) { swapChain->Release(); }
+	ReleaseSwapChain();
 	if (d3dDeviceContext) { d3dDeviceContext->Release(); }
 	if (d3dDevice) { d3dDevice->Release(); }
 
@@ -199,6 +345,81 @@ MainWindow::~MainWindow() {
 	UnregisterClassW(MAKEINTATOM(hWc), nullptr);
 }
 
+bool MainWindow::CreateSwapChain() noexcept {
+	// Flip model, so Present() doesn't copy the back buffer, and with a frame latency waitable object, so that we can wait
+	// for the swap chain to accept a new frame together with window messages, instead of blocking in Present()
+	// FLIP_DISCARD needs Windows 10, which ViGEmBus requires anyways
+	DXGI_SWAP_CHAIN_DESC1 sd = {};
+	sd.Width = 0;
+	sd.Height = 0;
+	sd.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	sd.SampleDesc.Count = 1;
+	sd.SampleDesc.Quality = 0;
+	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	sd.BufferCount = 2;
+	sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	sd.Flags = kSwapChainFlags;
+
+	// The factory that created the device, which is the one that can create a swap chain for it
+	IDXGIDevice* dxgiDevice = nullptr;
+	IDXGIAdapter* dxgiAdapter = nullptr;
+	IDXGIFactory2* dxgiFactory = nullptr;
+	IDXGISwapChain1* swapChain1 = nullptr;
+	IDXGISwapChain2* swapChain2 = nullptr;
+	HRESULT res = d3dDevice->QueryInterface(IID_PPV_ARGS(&dxgiDevice));
+	if (SUCCEEDED(res))
+		res = dxgiDevice->GetAdapter(&dxgiAdapter);
+	if (SUCCEEDED(res))
+		res = dxgiAdapter->GetParent(IID_PPV_ARGS(&dxgiFactory));
+	if (SUCCEEDED(res))
+		res = dxgiFactory->CreateSwapChainForHwnd(d3dDevice, hWnd, &sd, nullptr, nullptr, &swapChain1);
+	if (SUCCEEDED(res))
+		res = swapChain1->QueryInterface(IID_PPV_ARGS(&swapChain2));
+	if (SUCCEEDED(res)) {
+		// Only ever one frame queued, so that what's on screen is as fresh as possible
+		swapChain2->SetMaximumFrameLatency(1);
+		frameLatencyWaitable = swapChain2->GetFrameLatencyWaitableObject();
+	}
+	if (swapChain1) { swapChain1->Release(); }
+	if (dxgiFactory) { dxgiFactory->Release(); }
+	if (dxgiAdapter) { dxgiAdapter->Release(); }
+	if (dxgiDevice) { dxgiDevice->Release(); }
+	if (FAILED(res)) {
+		if (swapChain2) { swapChain2->Release(); }
+		return false;
+	}
+
+	swapChain = swapChain2;
+	CreateRenderTarget();
+	return true;
+}
+
+void MainWindow::ReleaseSwapChain() noexcept {
+	DestroyRenderTarget();
+	if (frameLatencyWaitable) {
+		CloseHandle(frameLatencyWaitable);
+		frameLatencyWaitable = nullptr;
+	}
+	if (swapChain) {
+		swapChain->Release();
+		swapChain = nullptr;
+	}
+}
+
+void MainWindow::TrimDevice() noexcept {
+	// https://learn.microsoft.com/en-us/windows/win32/api/dxgi1_3/nf-dxgi1_3-idxgidevice3-trim
+	// "the app must call ID3D11DeviceContext::ClearState before calling Trim"
+	d3dDeviceContext->ClearState();
+	d3dDeviceContext->Flush();
+
+	// Not available before Windows 8.1, just skip
+	IDXGIDevice3* dxgiDevice = nullptr;
+	if (SUCCEEDED(d3dDevice->QueryInterface(IID_PPV_ARGS(&dxgiDevice)))) {
+		dxgiDevice->Trim();
+		dxgiDevice->Release();
+	}
+}
+
 void MainWindow::CreateRenderTarget() {
 	ID3D11Texture2D* backBuffer;
 	swapChain->GetBuffer(0, IID_PPV_ARGS(&backBuffer));
@@ -209,40 +430,147 @@ void MainWindow::CreateRenderTarget() {
 }
 
 void MainWindow::DestroyRenderTarget() noexcept {
-	if (mainRenderTargetView)
+	// A flip model swap chain can't resize its buffers while they are still bound
+	d3dDeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+	if (mainRenderTargetView) {
 		mainRenderTargetView->Release();
+		mainRenderTargetView = nullptr;
+	}
 }
 
 void MainWindow::ResizeRenderTarget(UINT width, UINT height) {
 	DestroyRenderTarget();
-	swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
+	// Flags have to match the ones used at creation
+	swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, kSwapChainFlags);
 	CreateRenderTarget();
 }
 
-static toml::table LoadConfigFile() {
-	if (!fs::exists(L"config.toml"))
+// \param path set to the file read, which is where the config is saved back to
+static toml::table LoadConfigFile(fs::path& path) {
+	path = L"config.toml";
+	if (!fs::exists(path))
 		return toml::table();
 
-	auto configFile = toml::parse_file(fs::path(L"config.toml"));
+	auto configFile = toml::parse_file(path);
 
 	if (auto configAltPath = configFile["AltPath"].value<std::string>()) {
+		path = fs::path(Utf8ToWide(*configAltPath));
 		// If parse error, let it propagate out
-		return toml::parse_file(fs::path(*configAltPath));
+		return toml::parse_file(path);
 	}
 	return configFile;
 }
 
+void App::SaveConfig() {
+	TRACE_ZONE("App::SaveConfig");
+	// Keys the feeder doesn't know about, e.g. FontFile, are kept as they were in the file
+	auto exported = feeder->GetConfig().ExportAsToml();
+	for (auto&& [key, val] : exported) {
+		if (auto table = val.as_table())
+			configFile.insert_or_assign(key.str(), std::move(*table));
+	}
+
+	// Written next to it and then moved over, so that a crash halfway through never leaves a truncated config behind
+	auto tmpPath = fs::path(configFilePath).concat(L".tmp");
+	{
+		std::ofstream file(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file) {
+			LOG_DEBUG("Failed to open {} for writing", tmpPath.wstring());
+			return;
+		}
+		file << configFile << '\n';
+		if (!file.flush()) {
+			LOG_DEBUG("Failed to write {}", tmpPath.wstring());
+			return;
+		}
+	}
+	std::error_code ec;
+	fs::rename(tmpPath, configFilePath, ec);
+	if (ec) {
+		LOG_DEBUG("Failed to replace {}: {}", configFilePath.wstring(), Utf8ToWide(ec.message()));
+		return;
+	}
+	feeder->MarkConfigSaved();
+}
+
+void App::SaveConfigIfDirty() {
+	if (feeder && feeder->IsConfigDirty())
+		SaveConfig();
+}
+
 App::App(HINSTANCE hInstance)
 	: hInstance{ hInstance }
-	, mainWindow(*this, hInstance)
+	, inputWindow(*this, hInstance)
 	, mainUI(*this)
 {
-	auto config = LoadConfigFile();
-	fontFilePath = config["FontFile"].value_or<std::string>("C:/Windows/Fonts/segoeui.ttf");
-	fontSize = config["FontSize"].value_or<float>(16.0f);
-	feeder.reset(new FeederEngine(mainWindow.hWnd, Config(config), vigem));
+}
+
+bool App::Startup(int64_t qpcBegin, bool headless, bool profile) {
+	// Each task owns what it writes, and dependencies order them, so these need no synchronization
+	// Last, so that it waits for running tasks before anything they touch goes away if a task throws
+	TaskGraph graph(kStartupWorkerCount, qpcBegin);
+
+	auto tConfig = graph.Add("Config", [&] {
+		configFile = LoadConfigFile(configFilePath);
+		fontFilePath = configFile["FontFile"].value_or<std::string>("C:/Windows/Fonts/segoeui.ttf");
+		fontSize = configFile["FontSize"].value_or<float>(16.0f);
+		uiFrameRateLimit = configFile["UIFrameRateLimit"].value_or<int>(60);
+	});
+	auto tViGEm = graph.Add("ViGEm", [&] {
+		vigem = std::make_unique<ViGEmSink>();
+	});
+	auto tFeeder = graph.Add("FeederEngine", [&] {
+		engineHost = std::make_unique<Win32EngineHost>(inputWindow.hWnd);
+		feeder.reset(new FeederEngine(*engineHost, *vigem, Config(configFile)));
+	}, { tConfig, tViGEm });
+	auto tRawInput = graph.Add("RawInput", [&] {
+		RegisterRawInput();
+	}, {}, TaskGraph::Affinity::MainThread);
+
+	// Input is dispatched as soon as the main loop (or the message pump below) runs, so the feeder must exist by then
+	TaskGraph::TaskId liveTasks[] = { tFeeder, tRawInput };
+	if (!graph.RunUntil(liveTasks, false))
+		return false;
 	mainUI.OnFeederEngine(feeder.get());
+	feeder->StartKeySuppression();
+	feeder->StartForegroundTracking();
+	int64_t qpcInputLive = QpcNow();
+
+	if (!headless) {
+		// The slow parts of ShowUI() that don't need the main thread
+		auto tDevice = graph.Add("D3DDevice", [&] {
+			MainWindow::CreateDevice(preparedD3dDevice, preparedD3dContext);
+		});
+		auto tFontAtlas = graph.Add("FontAtlas", [&] {
+			// The window is created on the primary monitor, so this is normally the font OnDpiChanged() asks for
+			fontAtlas = std::make_unique<ImFontAtlas>();
+			bool atlasChanged;
+			fonts.Get(*fontAtlas, fontFilePath, fontSize, GetPrimaryMonitorDpi(), atlasChanged);
+		}, { tConfig });
+		auto tShowUI = graph.Add("ShowUI", [&] {
+			ShowUI();
+		}, { tDevice, tFontAtlas }, TaskGraph::Affinity::MainThread);
+
+		// Input is live already, keep handling it while the UI gets ready
+		TaskGraph::TaskId uiTasks[] = { tShowUI };
+		if (!graph.RunUntil(uiTasks, true))
+			return false;
+	}
 
+	perf.RecordStartup(qpcBegin, qpcInputLive, headless);
+	LOG_DEBUG("Startup ({}): input live after {:.1f}ms, ready after {:.1f}ms, working set {} KiB",
+		headless ? L"headless" : L"with UI", perf.inputLiveMs, perf.startupMs, perf.startupWorkingSet / 1024);
+
+	if (profile) {
+		if (std::ofstream profileFile("startup_profile.txt"); profileFile) {
+			profileFile << std::format("Input live: {:.2f}ms\nReady: {:.2f}ms\n\n", perf.inputLiveMs, perf.startupMs);
+			graph.DumpProfile(profileFile);
+		}
+	}
+	return true;
+}
+
+void App::RegisterRawInput() {
 	constexpr UINT kNumRid = 2;
 	RAWINPUTDEVICE rid[kNumRid];
 
@@ -251,39 +579,179 @@ App::App(HINSTANCE hInstance)
 	rid[0].usUsagePage = HID_USAGE_PAGE_GENERIC;
 	rid[0].dwFlags = RIDEV_DEVNOTIFY | RIDEV_INPUTSINK;
 	rid[0].usUsage = HID_USAGE_GENERIC_KEYBOARD;
-	rid[0].hwndTarget = mainWindow.hWnd;
+	rid[0].hwndTarget = inputWindow.hWnd;
 
 	rid[1].usUsagePage = HID_USAGE_PAGE_GENERIC;
 	rid[1].dwFlags = RIDEV_DEVNOTIFY | RIDEV_INPUTSINK;
 	rid[1].usUsage = HID_USAGE_GENERIC_MOUSE;
-	rid[1].hwndTarget = mainWindow.hWnd;
+	rid[1].hwndTarget = inputWindow.hWnd;
 
 	if (RegisterRawInputDevices(rid, kNumRid, sizeof(RAWINPUTDEVICE)) == false)
 		throw std::runtime_error("Failed to register RAWINPUT devices");
+}
+
+App::~App() {
+	HideUI();
+	// Prepared by Startup() but never used, i.e. startup failed
+	if (preparedD3dContext) { preparedD3dContext->Release(); }
+	if (preparedD3dDevice) { preparedD3dDevice->Release(); }
+}
+
+void App::ShowUI() {
+	uiRequested = true;
+	if (mainWindow)
+		return;
 
-	ShowWindow(mainWindow.hWnd, SW_SHOWDEFAULT);
-	UpdateWindow(mainWindow.hWnd);
+	TRACE_ZONE("App::ShowUI");
+	// Use the device and font atlas prepared during startup if there are any, otherwise create them here
+	mainWindow = std::make_unique<MainWindow>(*this, hInstance, std::exchange(preparedD3dDevice, nullptr), std::exchange(preparedD3dContext, nullptr));
+	if (!fontAtlas)
+		fontAtlas = std::make_unique<ImFontAtlas>();
 
 	IMGUI_CHECKVERSION();
-	ImGui::CreateContext();
+	// The atlas is ours, so that it can be built before there is a context
+	ImGui::CreateContext(fontAtlas.get());
 	auto& io = ImGui::GetIO();
 	io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
 	io.IniFilename = "imgui_state.ini";
 
-	UINT dpi = GetDpiForWindow(mainWindow.hWnd);
+	UINT dpi = GetDpiForWindow(mainWindow->hWnd);
 	OnDpiChanged(dpi, false);
 
-	ImGui_ImplWin32_Init(mainWindow.hWnd);
-	ImGui_ImplDX11_Init(mainWindow.d3dDevice, mainWindow.d3dDeviceContext);
+	ImGui_ImplWin32_Init(mainWindow->hWnd);
+	ImGui_ImplDX11_Init(mainWindow->d3dDevice, mainWindow->d3dDeviceContext);
+
+	ShowWindow(mainWindow->hWnd, SW_SHOWDEFAULT);
+	UpdateWindow(mainWindow->hWnd);
+	SetForegroundWindow(mainWindow->hWnd);
 }
 
-App::~App() {
+void App::HideUI() noexcept {
+	uiRequested = false;
+	if (!mainWindow)
+		return;
+
+	TRACE_ZONE("App::HideUI");
+	size_t workingSetBefore = GetProcessWorkingSet();
+	KillTimer(inputWindow.hWnd, kTrimTimerID);
+
+	// Also writes imgui_state.ini
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
+	fontAtlas.reset();
+	fonts.Clear();
+
+	mainWindow.reset();
+	shownWindowCount = 0;
+	pendingFrames = 0;
+	uiTrimmed = false;
+
+	perf.RecordRelease(workingSetBefore);
+}
+
+void App::TrimUIResources() noexcept {
+	if (!mainWindow || uiTrimmed)
+		return;
+
+	TRACE_ZONE("App::TrimUIResources");
+	size_t workingSetBefore = GetProcessWorkingSet();
+
+	// Font texture, shaders and buffers; recreated by ImGui_ImplDX11_NewFrame()
+	ImGui_ImplDX11_InvalidateDeviceObjects();
+	// The rasterized atlas kept around on the CPU side, rebuilt from the glyphs on the next texture upload
+	ImGui::GetIO().Fonts->ClearTexData();
+	mainWindow->ReleaseSwapChain();
+	mainWindow->TrimDevice();
+	uiTrimmed = true;
+
+	perf.RecordRelease(workingSetBefore);
+	LOG_DEBUG("Trimmed UI resources, working set {} KiB -> {} KiB", perf.workingSetBeforeRelease / 1024, perf.workingSetAfterRelease / 1024);
+}
+
+void App::RestoreUIResources() noexcept {
+	TRACE_ZONE("App::RestoreUIResources");
+	// Left trimmed on failure; rendering is skipped without a swap chain, and the next restore of the window tries again
+	if (!mainWindow->CreateSwapChain()) {
+		LOG_DEBUG_STATIC(L"Failed to recreate swapchain");
+		return;
+	}
+	uiTrimmed = false;
+}
+
+PerfStats::PerfStats() noexcept
+	: qpcStart{ QpcNow() }
+	, cpuStart{ GetProcessCpuTime() }
+	, qpcWindowBegin{ qpcStart }
+	, cpuWindowBegin{ cpuStart } {}
+
+void PerfStats::Sample() noexcept {
+	int64_t qpcNow = QpcNow();
+	double seconds = static_cast<double>(qpcNow - qpcWindowBegin) / static_cast<double>(QpcFrequency());
+	if (seconds < 1.0)
+		return;
+
+	uint64_t cpuNow = GetProcessCpuTime();
+	cpuPercent = static_cast<float>(static_cast<double>(cpuNow - cpuWindowBegin) / 1e7 / seconds * 100.0);
+	qpcWindowBegin = qpcNow;
+	cpuWindowBegin = cpuNow;
+}
+
+float PerfStats::GetSessionCpuPercent() const noexcept {
+	double seconds = static_cast<double>(QpcNow() - qpcStart) / static_cast<double>(QpcFrequency());
+	if (seconds <= 0.0)
+		return 0.0f;
+	return static_cast<float>(static_cast<double>(GetProcessCpuTime() - cpuStart) / 1e7 / seconds * 100.0);
+}
+
+void PerfStats::RecordStartup(int64_t qpcBegin, int64_t qpcInputLive, bool headless) noexcept {
+	auto toMs = [&](int64_t qpc) { return static_cast<float>(static_cast<double>(qpc - qpcBegin) / static_cast<double>(QpcFrequency()) * 1000.0); };
+	inputLiveMs = toMs(qpcInputLive);
+	startupMs = toMs(QpcNow());
+	startupWorkingSet = GetProcessWorkingSet();
+	startedHeadless = headless;
+}
+
+void PerfStats::RecordRelease(size_t workingSetBefore) noexcept {
+	workingSetBeforeRelease = workingSetBefore;
+	workingSetAfterRelease = GetProcessWorkingSet();
+	++releaseCount;
+}
+
+void App::DumpPerfStats(std::ostream& out) const {
+	double seconds = static_cast<double>(QpcNow() - perf.qpcStart) / static_cast<double>(QpcFrequency());
+	out << std::format("Startup ({}): input live after {:.1f}ms, ready after {:.1f}ms, working set {} KiB\n", perf.startedHeadless ? "headless" : "with UI", perf.inputLiveMs, perf.startupMs, perf.startupWorkingSet / 1024);
+	out << std::format("Working set: {} KiB now, {} KiB peak\n", GetProcessWorkingSet() / 1024, GetProcessPeakWorkingSet() / 1024);
+	out << std::format("UI resources released {} times, last {} KiB -> {} KiB\n", perf.releaseCount, perf.workingSetBeforeRelease / 1024, perf.workingSetAfterRelease / 1024);
+	double samplerSeconds = static_cast<double>(feeder->GetSamplerRunTime()) / static_cast<double>(QpcFrequency());
+	out << std::format("Session: {:.1f}s, CPU {:.3f}% of one core\n", seconds, perf.GetSessionCpuPercent());
+	out << std::format("Stick sampler: running {:.1f}s ({:.1f}% of session), {} ticks\n",
+		samplerSeconds, seconds > 0.0 ? samplerSeconds / seconds * 100.0 : 0.0, feeder->GetSamplerTicks());
+	out << std::format("UI: {} frames, {} message loop wakeups\n", perf.uiFrames, perf.wakeups);
+}
+
+DWORD App::GetFrameLimitWaitMs() const noexcept {
+	if (uiFrameRateLimit <= 0)
+		return 0;
+
+	int64_t qpcNextFrame = qpcLastFrame + QpcFrequency() / uiFrameRateLimit;
+	int64_t qpcNow = QpcNow();
+	if (qpcNow >= qpcNextFrame)
+		return 0;
+	// Round up, so we don't wake up just before the deadline only to wait again
+	return static_cast<DWORD>(((qpcNextFrame - qpcNow) * 1000 + QpcFrequency() - 1) / QpcFrequency());
 }
 
 void App::MainRenderFrame() {
+	TRACE_ZONE("App::MainRenderFrame");
+	// Trimmed, and recreating the swap chain failed
+	if (!mainWindow->swapChain)
+		return;
+
+	int64_t qpcFrameBegin = QpcNow();
+	qpcLastFrame = qpcFrameBegin;
+	++perf.uiFrames;
+	drawnStateVersion = feeder->GetStateVersion();
 	ImGui_ImplDX11_NewFrame();
 	ImGui_ImplWin32_NewFrame();
 	ImGui::NewFrame();
@@ -294,112 +762,257 @@ void App::MainRenderFrame() {
 	ImGui::Render();
 	constexpr ImVec4 kClearColor{ 0.45f, 0.55f, 0.60f, 1.00f };
 	constexpr float kClearColorPremultAlpha[]{ kClearColor.x * kClearColor.w, kClearColor.y * kClearColor.w, kClearColor.z * kClearColor.w, kClearColor.w };
-	ID3D11DeviceContext* devCtx = mainWindow.d3dDeviceContext;
-	ID3D11RenderTargetView* rtv = mainWindow.mainRenderTargetView;
+	ID3D11DeviceContext* devCtx = mainWindow->d3dDeviceContext;
+	ID3D11RenderTargetView* rtv = mainWindow->mainRenderTargetView;
 	devCtx->OMSetRenderTargets(1, &rtv, nullptr);
 	devCtx->ClearRenderTargetView(rtv, kClearColorPremultAlpha);
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
-	mainWindow.swapChain->Present(1, 0); // Present with vsync
+	int64_t qpcPresentBegin = QpcNow();
+	{
+		TRACE_ZONE("Present");
+		mainWindow->swapChain->Present(1, 0); // Present with vsync
+	}
+
+	// Any input that is waiting now, had to wait for (at most) this whole frame
+	bool inputArrived = HIWORD(GetQueueStatus(QS_INPUT)) != 0;
+	uiLatency.Record(qpcFrameBegin, qpcPresentBegin, QpcNow(), inputArrived);
 }
 
-LRESULT App::OnRawInput(RAWINPUT* ri) {
+LRESULT App::OnRawInput(RAWINPUT* ri, const InputTimestamp& ts) {
+	TRACE_ZONE("App::OnRawInput");
 	switch (ri->header.dwType) {
 	case RIM_TYPEMOUSE: {
 		const auto& mouse = ri->data.mouse;
 		auto& idev = FindIdev(ri->header.hDevice);
-
 		auto bf = mouse.usButtonFlags;
-		if (bf & RI_MOUSE_LEFT_BUTTON_DOWN) feeder->HandleKeyPress(idev, VK_LBUTTON, true);
-		if (bf & RI_MOUSE_LEFT_BUTTON_UP) feeder->HandleKeyPress(idev, VK_LBUTTON, false);
-		if (bf & RI_MOUSE_RIGHT_BUTTON_DOWN) feeder->HandleKeyPress(idev, VK_RBUTTON, true);
-		if (bf & RI_MOUSE_RIGHT_BUTTON_UP) feeder->HandleKeyPress(idev, VK_RBUTTON, false);
-		if (bf & RI_MOUSE_MIDDLE_BUTTON_DOWN) feeder->HandleKeyPress(idev, VK_MBUTTON, true);
-		if (bf & RI_MOUSE_MIDDLE_BUTTON_UP) feeder->HandleKeyPress(idev, VK_MBUTTON, false);
-		if (bf & RI_MOUSE_BUTTON_4_DOWN) feeder->HandleKeyPress(idev, VK_XBUTTON1, true);
-		if (bf & RI_MOUSE_BUTTON_4_UP) feeder->HandleKeyPress(idev, VK_XBUTTON1, false);
-		if (bf & RI_MOUSE_BUTTON_5_DOWN) feeder->HandleKeyPress(idev, VK_XBUTTON2, true);
-		if (bf & RI_MOUSE_BUTTON_5_UP) feeder->HandleKeyPress(idev, VK_XBUTTON2, false);
+
+		// Capturing a rebind rebuilds the routes, which allocates, so it goes before the no-alloc scope
+		if (feeder->IsRebindPending()) [[unlikely]] {
+			if (bf & RI_MOUSE_LEFT_BUTTON_DOWN) feeder->CaptureRebind(idev, VK_LBUTTON);
+			if (bf & RI_MOUSE_RIGHT_BUTTON_DOWN) feeder->CaptureRebind(idev, VK_RBUTTON);
+			if (bf & RI_MOUSE_MIDDLE_BUTTON_DOWN) feeder->CaptureRebind(idev, VK_MBUTTON);
+			if (bf & RI_MOUSE_BUTTON_4_DOWN) feeder->CaptureRebind(idev, VK_XBUTTON1);
+			if (bf & RI_MOUSE_BUTTON_5_DOWN) feeder->CaptureRebind(idev, VK_XBUTTON2);
+		}
+
+		NO_ALLOC_SCOPE();
+		if (bf & RI_MOUSE_LEFT_BUTTON_DOWN) feeder->HandleKeyPress(idev, VK_LBUTTON, true, ts);
+		if (bf & RI_MOUSE_LEFT_BUTTON_UP) feeder->HandleKeyPress(idev, VK_LBUTTON, false, ts);
+		if (bf & RI_MOUSE_RIGHT_BUTTON_DOWN) feeder->HandleKeyPress(idev, VK_RBUTTON, true, ts);
+		if (bf & RI_MOUSE_RIGHT_BUTTON_UP) feeder->HandleKeyPress(idev, VK_RBUTTON, false, ts);
+		if (bf & RI_MOUSE_MIDDLE_BUTTON_DOWN) feeder->HandleKeyPress(idev, VK_MBUTTON, true, ts);
+		if (bf & RI_MOUSE_MIDDLE_BUTTON_UP) feeder->HandleKeyPress(idev, VK_MBUTTON, false, ts);
+		if (bf & RI_MOUSE_BUTTON_4_DOWN) feeder->HandleKeyPress(idev, VK_XBUTTON1, true, ts);
+		if (bf & RI_MOUSE_BUTTON_4_UP) feeder->HandleKeyPress(idev, VK_XBUTTON1, false, ts);
+		if (bf & RI_MOUSE_BUTTON_5_DOWN) feeder->HandleKeyPress(idev, VK_XBUTTON2, true, ts);
+		if (bf & RI_MOUSE_BUTTON_5_UP) feeder->HandleKeyPress(idev, VK_XBUTTON2, false, ts);
 
 		if (mouse.usFlags & MOUSE_MOVE_ABSOLUTE) {
-			LOG_DEBUG("Warning: RAWINPUT reported absolute mouse corrdinates, not supported");
+			LOG_DEBUG_STATIC(L"Warning: RAWINPUT reported absolute mouse corrdinates, not supported");
 			break;
 		} // else: MOUSE_MOVE_RELATIVE
 
-		feeder->HandleMouseMovement(idev, mouse.lLastX, mouse.lLastY);
+		if (mouse.lLastX != 0 || mouse.lLastY != 0)
+			idev.mouseMeter.Record(mouse.lLastX, mouse.lLastY, ts.qpcReceived);
+		feeder->HandleMouseMovement(idev, mouse.lLastX, mouse.lLastY, ts);
 	} break;
 
 	case RIM_TYPEKEYBOARD: {
 		const auto& kbd = ri->data.keyboard;
 		auto& idev = FindIdev(ri->header.hDevice);
 
-		// This message is a part of a longer makecode sequence -- the actual Vkey is in another one
-		if (kbd.VKey == 0xFF)
-			break;
-		// All of the relevant keys that we support fit in a BYTE
-		if (kbd.VKey > 0xFF)
-			break;
+		BYTE newVKey = 0xFF;
+		bool press = false;
+		{
+			NO_ALLOC_SCOPE();
 
-		BYTE newVKey;
-		bool extended = kbd.Flags & RI_KEY_E0;
-		switch (kbd.VKey) {
-		case VK_SHIFT:
-			newVKey = MapVirtualKeyW(kbd.MakeCode, MAPVK_VSC_TO_VK_EX);
-			break;
-		case VK_CONTROL:
-			newVKey = extended ? VK_RCONTROL : VK_LCONTROL;
-			break;
-		case VK_MENU:
-			newVKey = extended ? VK_RMENU : VK_LMENU;
-			break;
-		default:
-			// Explicitly cast to make MSVC shut up
-			newVKey = (BYTE)kbd.VKey;
-			break;
+			// This message is a part of a longer makecode sequence -- the actual Vkey is in another one
+			if (kbd.VKey == 0xFF)
+				break;
+
+			if (feeder->GetConfig().keyboardInputMode == KeyboardInputMode::ScanCode) {
+				newVKey = KeyCodeFromScanCode(kbd.MakeCode, kbd.Flags);
+				if (newVKey == 0xFF)
+					break;
+			}
+			else {
+				// All of the relevant keys that we support fit in a BYTE
+				if (kbd.VKey > 0xFF)
+					break;
+
+				bool extended = kbd.Flags & RI_KEY_E0;
+				switch (kbd.VKey) {
+				case VK_SHIFT:
+					// Left and right shift are the only pair not told apart by RI_KEY_E0, but their make codes differ
+					newVKey = kbd.MakeCode == 0x36 ? VK_RSHIFT : VK_LSHIFT;
+					break;
+				case VK_CONTROL:
+					newVKey = extended ? VK_RCONTROL : VK_LCONTROL;
+					break;
+				case VK_MENU:
+					newVKey = extended ? VK_RMENU : VK_LMENU;
+					break;
+				default:
+					// Explicitly cast to make MSVC shut up
+					newVKey = (BYTE)kbd.VKey;
+					break;
+				}
+			}
+
+			bool prevPress = idev.keyStates[newVKey];
+			press = !(kbd.Flags & RI_KEY_BREAK);
+			// Skip key repeats
+			if (prevPress == press)
+				break;
+			idev.keyStates.set(newVKey, press);
 		}
 
-		bool prevPress = idev.keyStates[newVKey];
-		bool press = !(kbd.Flags & RI_KEY_BREAK);
-		// Skip key repeats
-		if (prevPress == press)
-			break;
-		idev.keyStates.set(newVKey, press);
+		// Like hotkeys below, capturing a rebind is a cold path that allocates (route rebuild)
+		if (press && feeder->IsRebindPending()) [[unlikely]]
+			feeder->CaptureRebind(idev, newVKey);
 
-		feeder->HandleKeyPress(idev, newVKey, press);
+		{
+			NO_ALLOC_SCOPE();
+			feeder->HandleKeyPress(idev, newVKey, press, ts);
+		}
+
+		// Hotkeys are a cold path (file IO etc.), so they are handled outside of the no-alloc scope
+		if (press)
+			HandleHotkey(newVKey);
 	} break;
 	}
 
 	return 0;
 }
 
+void App::HandleHotkey(KeyCode key) {
+	const auto& config = feeder->GetConfig();
+
+	if (key == config.hotkeyShowUI)
+		RequestUI(!uiRequested);
+	if (key == config.hotkeyToggleTrace)
+		ToggleTraceRecording();
+}
+
+void App::ToggleTraceRecording() {
+	if (!IsTraceEnabled()) {
+		SetTraceEnabled(true);
+		LOG_DEBUG(L"Trace recording started");
+		return;
+	}
+
+	SetTraceEnabled(false);
+	if (TraceDumpChromeJson(fs::path(L"trace.json")))
+		LOG_DEBUG(L"Trace written to trace.json");
+	else
+		LOG_DEBUG(L"Failed to write trace.json");
+}
+
 IdevDevice& App::FindIdev(HANDLE hDevice) {
 	auto iter = devices.find(hDevice);
-	if (iter != devices.end())
+	if (iter != devices.end()) [[likely]]
 		return iter->second;
 	else
+		// Cold path: RIDEV_DEVNOTIFY sends GIDC_ARRIVAL for every device present at registration, so all devices should already be known
 		return OnIdevConnect(hDevice);
 }
 
 IdevDevice& App::OnIdevConnect(HANDLE hDevice) {
+	// May have already been connected by FindIdev(), if its input arrived before the GIDC_ARRIVAL
+	if (auto iter = devices.find(hDevice); iter != devices.end())
+		return iter->second;
+
 	auto [it, success] = devices.try_emplace(hDevice, IdevDevice::FromHANDLE(hDevice));
-	assert(success);
 	auto& idev = it->second;
+	if (idev.info.dwType == RIM_TYPEMOUSE)
+		feeder->ApplyMouseCalibration(idev);
+	feeder->AttachDevice(idev);
 
 	LOG_DEBUG("Connected {} {}", RawInputTypeToString(idev.info.dwType), Utf8ToWide(idev.nameUtf8));
 	return idev;
 }
 
+bool App::FinishMouseCalibration(IdevDevice& idev, float distanceCm) {
+	float counts = idev.mouseMeter.FinishCalibration();
+	if (counts < 1.0f || distanceCm <= 0.0f)
+		return false;
+
+	ConfigMouseCalibration calib;
+	calib.dpi = counts / (distanceCm / 2.54f);
+	calib.pollingRate = idev.mouseMeter.GetPollingRate();
+
+	uint32_t vidPid = idev.GetVidPid();
+	// Without VID/PID, there is no model to remember it for: only this mouse, until it disconnects
+	if (vidPid == 0) {
+		idev.mouseCountScale = kReferenceMouseDpi / calib.dpi;
+		LOG_DEBUG("Calibrated mouse {} without VID/PID: {:.0f} DPI", Utf8ToWide(idev.nameUtf8), calib.dpi);
+		return true;
+	}
+
+	feeder->SetMouseCalibration(vidPid, calib);
+	for (auto& [hDevice, other] : devices) {
+		if (other.info.dwType == RIM_TYPEMOUSE && other.GetVidPid() == vidPid)
+			feeder->ApplyMouseCalibration(other);
+	}
+
+	LOG_DEBUG("Calibrated mouse {:04X}:{:04X}: {:.0f} DPI, {:.0f} Hz", idev.vendorId, idev.productId, calib.dpi, calib.pollingRate);
+	return true;
+}
+
 void App::OnIdevDisconnect(HANDLE hDevice) {
-#if _DEBUG
 	auto iter = devices.find(hDevice);
 	if (iter == devices.end()) {
+#if _DEBUG
 		LOG_DEBUG("Error: recieved GIDC_REMOVAL for a device that had never GIDC_ARRIVAL-ed");
+#endif
 		return;
 	}
 	auto& idev = iter->second;
+#if _DEBUG
 	LOG_DEBUG("Disconnected {} {}", RawInputTypeToString(idev.info.dwType), Utf8ToWide(idev.nameUtf8));
 #endif
-	devices.erase(hDevice);
+	feeder->DetachDevice(idev);
+	devices.erase(iter);
+}
+
+ImFont* FontCache::Get(ImFontAtlas& atlas, const std::string& fontFilePath, float fontSize, UINT dpi, bool& atlasChanged) {
+	++useCounter;
+	for (int i = 0; i < count; ++i) {
+		if (entries[i].dpi == dpi) {
+			entries[i].lastUse = useCounter;
+			atlasChanged = false;
+			return entries[i].font;
+		}
+	}
+
+	auto addFont = [&](Entry& e) {
+		e.font = atlas.AddFontFromFileTTF(fontFilePath.c_str(), fontSize * static_cast<float>(e.dpi) / USER_DEFAULT_SCREEN_DPI);
+	};
+
+	Entry* target;
+	if (count < kCapacity) {
+		target = &entries[count++];
+		*target = Entry{ dpi, nullptr, useCounter };
+		addFont(*target);
+	}
+	else {
+		target = &*std::ranges::min_element(entries, {}, &Entry::lastUse);
+		*target = Entry{ dpi, nullptr, useCounter };
+		// Invalidates all ImFont* in the atlas, re-add the ones we keep
+		atlas.Clear();
+		for (auto& e : entries)
+			addFont(e);
+	}
+
+	atlas.Build();
+	atlasChanged = true;
+	return target->font;
+}
+
+void FontCache::Clear() noexcept {
+	entries = {};
+	count = 0;
 }
 
 void App::OnDpiChanged(UINT newDpi, bool recreateAtlas) {
@@ -408,20 +1021,11 @@ void App::OnDpiChanged(UINT newDpi, bool recreateAtlas) {
 	auto& io = ImGui::GetIO();
 	auto& style = ImGui::GetStyle();
 
-	// Yes, we are leaking as the user switch between different DPIs
-	// But having so many monitors of different DPI, _and_ constantly dragging the window between them to cause exceesive memory usage seems very unlikely
-	ImFont* font;
-	auto iter = fonts.find(newDpi);
-	if (iter != fonts.end())
-		font = iter->second;
-	else {
-		font = io.Fonts->AddFontFromFileTTF(fontFilePath.c_str(), fontSize * scaleFactor);
-		io.Fonts->Build();
-		if (recreateAtlas)
-			// https://github.com/ocornut/imgui/issues/2311#issuecomment-460039964
-			ImGui_ImplDX11_InvalidateDeviceObjects();
-		fonts.emplace(newDpi, font);
-	}
+	bool atlasChanged;
+	ImFont* font = fonts.Get(*io.Fonts, fontFilePath, fontSize, newDpi, atlasChanged);
+	if (atlasChanged && recreateAtlas)
+		// https://github.com/ocornut/imgui/issues/2311#issuecomment-460039964
+		ImGui_ImplDX11_InvalidateDeviceObjects();
 
 	io.FontDefault = font;
 	style = {};
@@ -429,27 +1033,69 @@ void App::OnDpiChanged(UINT newDpi, bool recreateAtlas) {
 }
 
 int AppMain(HINSTANCE hInstance, std::span<const std::wstring_view> args) {
+	TraceRegisterThread();
+	bool traceFromStartup = std::ranges::find(args, L"--trace"sv) != args.end();
+	if (traceFromStartup)
+		SetTraceEnabled(true);
+
+	// Headless: only the input window and the feeder, the UI is created on demand from the tray icon or the ShowUI hotkey
+	bool headless = std::ranges::find(args, L"--headless"sv) != args.end();
+
+	// Per-phase startup timings, written to startup_profile.txt
+	bool startupProfile = std::ranges::find(args, L"--startup-profile"sv) != args.end();
+
+	int64_t qpcStartup = QpcNow();
 	App s(hInstance);
+	// WM_QUIT while the UI was getting ready
+	if (!s.Startup(qpcStartup, headless, startupProfile))
+		goto exit;
 
 	while (true) {
 		MSG msg;
 
+		// Create or destroy the UI here, outside of any window procedure or ImGui frame
+		if (s.uiRequested != s.IsUIShown()) {
+			if (s.uiRequested)
+				s.ShowUI();
+			else
+				s.HideUI();
+		}
+
 		// The blocking message pump
-		// We'll block here, until one of the messages changes changes blockingMessagePump to false (i.e. we should be rendering again) ...
-		while (s.shownWindowCount == 0 && GetMessageW(&msg, nullptr, 0, 0)) {
+		// We'll block here, until one of the messages changes shownWindowCount (i.e. we should be rendering again) or requests showing/hiding the UI ...
+		while (s.shownWindowCount == 0 && s.uiRequested == s.IsUIShown()) {
+			// Not GetMessageW(), the wait must be alertable for the button action timer's APC to run on this thread
+			if (!PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+				// Idle, e.g. after a rebind or a device's route picking up its new name
+				s.SaveConfigIfDirty();
+				MsgWaitForMultipleObjectsEx(0, nullptr, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE | MWMO_ALERTABLE);
+				++s.perf.wakeups;
+				continue;
+			}
+			if (msg.message == WM_QUIT)
+				goto exit;
+
+			TRACE_ZONE("BlockingPump.Dispatch");
+			++s.perf.wakeups;
 			if (msg.message == WM_TIMER) {
-				msg.hwnd = s.mainWindow.hWnd;
+				msg.hwnd = s.inputWindow.hWnd;
 			}
 			TranslateMessage(&msg);
 			DispatchMessageW(&msg);
-			if (msg.message == WM_QUIT)
-				goto exit;
 		}
+		if (s.uiRequested != s.IsUIShown())
+			continue;
 
 		// ... in which case the above loop breaks, and we come here (regular polling message pump) to process the rest, and then enter regular main loop doing rendering + polling
+		bool dirty = false;
 		while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+			TRACE_ZONE("PollingPump.Dispatch");
 			if (msg.message == WM_TIMER) {
-				msg.hwnd = s.mainWindow.hWnd;
+				msg.hwnd = s.inputWindow.hWnd;
+			}
+			// Raw input that changed a gamepad is picked up from the state version below, the rest doesn't show on screen
+			else if (msg.message != WM_INPUT) {
+				dirty = true;
 			}
 			TranslateMessage(&msg);
 			DispatchMessageW(&msg);
@@ -458,9 +1104,62 @@ int AppMain(HINSTANCE hInstance, std::span<const std::wstring_view> args) {
 			if (msg.message == WM_QUIT)
 				goto exit;
 		}
+		// E.g. the window was closed
+		if (s.uiRequested != s.IsUIShown())
+			continue;
+
+		// Only render when something on screen may have changed: input or other window messages, or a new gamepad state
+		// ImGui needs a couple more frames after an event for things like hover state to settle
+		constexpr int kSettleFrames = 3;
+		if (dirty || s.feeder->GetStateVersion() != s.drawnStateVersion)
+			s.pendingFrames = kSettleFrames;
+
+		if (s.pendingFrames > 0) {
+			// Keep processing messages while waiting for the frame rate limit, and for the swap chain to be ready for
+			// another frame, so that rendering never holds up input beyond the frame itself
+			if (DWORD waitMs = s.GetFrameLimitWaitMs(); waitMs > 0) {
+				TRACE_ZONE("PollingPump.WaitFrameLimit");
+				MsgWaitForMultipleObjectsEx(0, nullptr, waitMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE | MWMO_ALERTABLE);
+				++s.perf.wakeups;
+				continue;
+			}
+			if (HANDLE waitable = s.mainWindow->frameLatencyWaitable) {
+				TRACE_ZONE("PollingPump.WaitSwapChain");
+				// Bounded, so a misbehaving driver can't stall the UI for good; Present() just blocks instead
+				constexpr DWORD kSwapChainWaitTimeoutMs = 100;
+				DWORD res = MsgWaitForMultipleObjectsEx(1, &waitable, kSwapChainWaitTimeoutMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE | MWMO_ALERTABLE);
+				++s.perf.wakeups;
+				// Messages and APCs first, the waitable stays signaled until we consume it with a successful wait
+				if (res == WAIT_OBJECT_0 + 1 || res == WAIT_IO_COMPLETION)
+					continue;
+			}
+
+			--s.pendingFrames;
+			s.MainRenderFrame();
+			continue;
+		}
 
-		s.MainRenderFrame();
+		// Nothing to render: sleep until the next message, or until the UI wants to be redrawn
+		// Edits made in the UI are saved once it has settled, rather than on every frame of e.g. a slider drag
+		s.SaveConfigIfDirty();
+		{
+			TRACE_ZONE("PollingPump.Wait");
+			DWORD res = MsgWaitForMultipleObjectsEx(0, nullptr, s.mainUI.redrawTimeoutMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE | MWMO_ALERTABLE);
+			++s.perf.wakeups;
+			if (res == WAIT_TIMEOUT)
+				s.pendingFrames = 1;
+		}
 	}
 exit:
+	s.SaveConfigIfDirty();
+	if (std::ofstream latencyFile("latency_stats.txt"); latencyFile) {
+		s.feeder->DumpLatencyStats(latencyFile);
+		s.uiLatency.Dump(latencyFile);
+	}
+	if (std::ofstream perfFile("perf_stats.txt"); perfFile)
+		s.DumpPerfStats(perfFile);
+	// Recording may have been stopped (and dumped) by the hotkey already
+	if (traceFromStartup && IsTraceEnabled())
+		TraceDumpChromeJson(fs::path(L"trace.json"));
 	return 0;
 }
@@ -3,15 +3,37 @@
 #include "modelconfig.hpp"
 #include "modelruntime.hpp"
 #include "inputdevice.hpp"
+#include "latency.hpp"
 #include "ui.hpp"
+#include "vigemsink.hpp"
+#include "win32host.hpp"
 
-#include <ViGEm/Client.h>
+#include <dxgi1_3.h>
 
 #include <memory>
+#include <ostream>
 #include <unordered_map>
 
 class App;
 
+// Hidden window that receives raw input, device notifications, timers and the tray icon's messages
+// Exists for the whole lifetime of the app, whether or not the UI is shown. Not a message-only window, because
+// those don't get the TaskbarCreated broadcast needed to restore the tray icon after Explorer restarts.
+struct InputWindow {
+	HWND hWnd = nullptr;
+	ATOM hWc = 0;
+	UINT taskbarCreatedMsg = 0;
+	NOTIFYICONDATAW trayIcon = {};
+
+	InputWindow(App& app, HINSTANCE hInstance);
+	~InputWindow();
+
+	void AddTrayIcon() noexcept;
+	void ShowTrayMenu(App& app) noexcept;
+};
+
+LRESULT CALLBACK InputWindowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept;
+
 // Wrap as struct for RAII helper
 // Not an encapsulated object in the OOP sense
 struct MainWindow {
@@ -23,12 +45,28 @@ struct MainWindow {
 	// For ImGui main viewport
 	ID3D11Device* d3dDevice = nullptr;
 	ID3D11DeviceContext* d3dDeviceContext = nullptr;
-	IDXGISwapChain* swapChain = nullptr;
+	IDXGISwapChain2* swapChain = nullptr;
 	ID3D11RenderTargetView* mainRenderTargetView = nullptr;
+	// Signaled when the swap chain can accept another frame without Present() blocking
+	HANDLE frameLatencyWaitable = nullptr;
+
+	static constexpr UINT kSwapChainFlags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 
-	MainWindow(App& app, HINSTANCE hInstance);
+	// Takes ownership of the device and context, or creates them if nullptr
+	MainWindow(App& app, HINSTANCE hInstance, ID3D11Device* device = nullptr, ID3D11DeviceContext* context = nullptr);
 	~MainWindow();
 
+	// Thread-safe, for creating the device ahead of the window
+	static void CreateDevice(ID3D11Device*& device, ID3D11DeviceContext*& context);
+
+	// Create the swap chain and its render target, sized to the window
+	// \return false on failure, in which case swapChain is nullptr
+	bool CreateSwapChain() noexcept;
+	// Release the swap chain along with its buffers, the device stays
+	void ReleaseSwapChain() noexcept;
+	// Ask the driver to free the memory it's holding onto for the device, after releasing resources
+	void TrimDevice() noexcept;
+
 	void CreateRenderTarget();
 	void DestroyRenderTarget() noexcept;
 	// Resize the render target after initial creation
@@ -38,43 +76,166 @@ struct MainWindow {
 
 LRESULT CALLBACK MainWindowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept;
 
+// Fonts for the most recently used DPIs, all living in the ImGui font atlas
+// ImFontAtlas can't remove a single font, so evicting one rebuilds the atlas from the remaining ones.
+struct FontCache {
+	// Enough for dragging the window back and forth between two monitors without rebuilding
+	static constexpr int kCapacity = 2;
+
+	struct Entry {
+		UINT dpi = 0;
+		ImFont* font = nullptr;
+		// Larger is more recently used
+		uint64_t lastUse = 0;
+	};
+	std::array<Entry, kCapacity> entries = {};
+	int count = 0;
+	uint64_t useCounter = 0;
+
+	// Find the font for the DPI, or add it to the atlas
+	// \param atlasChanged set to whether the atlas was rebuilt, in which case the font texture has to be recreated
+	ImFont* Get(ImFontAtlas& atlas, const std::string& fontFilePath, float fontSize, UINT dpi, bool& atlasChanged);
+	// Forget all fonts, for when the atlas itself was destroyed
+	void Clear() noexcept;
+};
+
+// CPU and wakeup counters, to keep track of how much the app costs while nothing is happening
+struct PerfStats {
+	int64_t qpcStart = 0;
+	uint64_t cpuStart = 0;
+	uint64_t uiFrames = 0;
+	// Number of times the main loop woke up from waiting for messages
+	uint64_t wakeups = 0;
+
+	// Process CPU usage over the last completed window of at least 1 second, in percent of one core
+	float cpuPercent = 0.0f;
+	int64_t qpcWindowBegin = 0;
+	uint64_t cpuWindowBegin = 0;
+
+	// Time from entering AppMain until input is translated to gamepads, and until the UI (if any) is ready too
+	float inputLiveMs = 0.0f;
+	float startupMs = 0.0f;
+	// Working set once ready
+	size_t startupWorkingSet = 0;
+	bool startedHeadless = false;
+
+	// Working set right before and after UI resources were last released, by trimming or hiding the UI
+	size_t workingSetBeforeRelease = 0;
+	size_t workingSetAfterRelease = 0;
+	uint64_t releaseCount = 0;
+
+	PerfStats() noexcept;
+
+	void RecordStartup(int64_t qpcBegin, int64_t qpcInputLive, bool headless) noexcept;
+	void RecordRelease(size_t workingSetBefore) noexcept;
+
+	// Start a new window if the current one is at least 1 second long
+	void Sample() noexcept;
+	// Process CPU usage since startup, in percent of one core
+	float GetSessionCpuPercent() const noexcept;
+};
+
 class App {
 public:
 	HINSTANCE hInstance;
 
-	MainWindow mainWindow;
+	InputWindow inputWindow;
+	// Only exists while the UI is shown, along with the ImGui context and fonts
+	std::unique_ptr<MainWindow> mainWindow;
 	UIState mainUI;
 
-	ViGEm vigem;
+	std::unique_ptr<ViGEmSink> vigem;
+	std::unique_ptr<Win32EngineHost> engineHost;
 
+	// Declared after what it runs on, so that it is destroyed first
 	std::unique_ptr<FeederEngine> feeder;
 
+	// The config file as read, and where it was read from, see SaveConfig()
+	toml::table configFile;
+	std::filesystem::path configFilePath;
 	std::string fontFilePath;
-	std::unordered_map<UINT, ImFont*> fonts;
+	// Set as the ImGui context's atlas, instead of letting the context create its own, so that it can be built ahead of the context
+	std::unique_ptr<ImFontAtlas> fontAtlas;
+	FontCache fonts;
+
+	// Created during startup off the main thread, taken over by ShowUI()
+	ID3D11Device* preparedD3dDevice = nullptr;
+	ID3D11DeviceContext* preparedD3dContext = nullptr;
 	std::unordered_map<HANDLE, IdevDevice> devices;
 
 	// For a RAWINPUT*
-	// We have to use a manually sized buffer, because RAWINPUT uses a flexible array member at the end
-	std::unique_ptr<std::byte[]> rawinput;
-	size_t rawinputSize = 0;
+	// RAWINPUT uses a flexible array member at the end, but that's only used by RIM_TYPEHID which we don't register for
+	// so a fixed size buffer always fits, and WM_INPUT never needs to allocate
+	alignas(RAWINPUT) std::byte rawinput[sizeof(RAWINPUT)];
+
+	PerfStats perf;
+	UILatency uiLatency;
+	// FeederEngine::GetStateVersion() as of the last rendered frame
+	uint64_t drawnStateVersion = 0;
+	// Frames left to render after something changed, before going back to waiting for messages
+	int pendingFrames = 0;
+
+	// Maximum UI frames per second on top of vsync, 0 for no limit
+	int uiFrameRateLimit;
+	int64_t qpcLastFrame = 0;
 
 	float scaleFactor = 1.0f;
 	float fontSize;
 	int shownWindowCount = 0;
-	bool configDirty = false;
+	// Whether the swap chain and font texture were released after the UI was minimized for a while
+	bool uiTrimmed = false;
 	bool capturingCursor = false;
+	// Whether the UI should be shown, applied by the main loop with ShowUI()/HideUI()
+	bool uiRequested = false;
 
 public:
 	App(HINSTANCE hInstance);
 	~App();
 
+	// Load the config, connect to ViGEm, start the feeder and register for input, then show the UI unless headless
+	// Independent steps run in parallel, and input is handled while the UI is being created.
+	// \param qpcBegin start of startup, for timings
+	// \param profile write per-step timings to startup_profile.txt
+	// \return false if WM_QUIT was received during startup
+	bool Startup(int64_t qpcBegin, bool headless, bool profile);
+	void RegisterRawInput();
+
+	bool IsUIShown() const noexcept { return mainWindow != nullptr; }
+	// Show or hide the UI once control gets back to the main loop, safe to call from anywhere, including window procedures and inside an ImGui frame
+	void RequestUI(bool shown) noexcept { uiRequested = shown; }
+	// Create the main window, D3D device and ImGui context
+	// DO NOT CALL from a window procedure or inside an ImGui frame, use RequestUI() instead
+	void ShowUI();
+	// Destroy everything created by ShowUI()
+	// DO NOT CALL from a window procedure or inside an ImGui frame, use RequestUI() instead
+	void HideUI() noexcept;
+	// Release the swap chain and font textures, while keeping the window and ImGui state
+	void TrimUIResources() noexcept;
+	// Recreate what TrimUIResources() released
+	void RestoreUIResources() noexcept;
+
+	// Milliseconds until uiFrameRateLimit allows the next frame, 0 if it can be rendered now
+	DWORD GetFrameLimitWaitMs() const noexcept;
 	void MainRenderFrame();
+	void DumpPerfStats(std::ostream& out) const;
+
+	// Write the feeder's config back to the file it was loaded from
+	void SaveConfig();
+	// Only if the feeder changed it since, called whenever the main loop goes idle and on exit
+	void SaveConfigIfDirty();
 
 	IdevDevice& FindIdev(HANDLE hDevice);
+	// Store the calibration measured on this mouse for its model, and apply it to all connected mice of that model
+	// \param distanceCm the physical distance the mouse was moved since MouseMeter::BeginCalibration()
+	// \return false if the measurement is unusable
+	bool FinishMouseCalibration(IdevDevice& idev, float distanceCm);
+
+	void HandleHotkey(KeyCode key);
+	void ToggleTraceRecording();
 
 	// DO NOT CALL when inside an ImGui frame (i.e. in MainRenderFrame)
 	IdevDevice& OnIdevConnect(HANDLE hDevice);
 	void OnIdevDisconnect(HANDLE hDevice);
 	void OnDpiChanged(UINT newDpi, bool recreateAtlas = true);
-	LRESULT OnRawInput(RAWINPUT*);
+	LRESULT OnRawInput(RAWINPUT*, const InputTimestamp&);
 };
@@ -0,0 +1,2 @@
+// <poppack.h> of the Windows SDK, for building ViGEm/Common.h elsewhere
+#pragma pack(pop)
@@ -0,0 +1,2 @@
+// <pshpack1.h> of the Windows SDK, for building ViGEm/Common.h elsewhere
+#pragma pack(push, 1)
@@ -0,0 +1,173 @@
+#include "pch.hpp"
+
+#include "ds4report.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Finger lifts once the mouse stopped moving for this long
+constexpr float kTouchLiftSeconds = 0.1f;
+// Full scale is 2000 degrees per second
+constexpr float kGyroUnitsPerDps = 16.384f;
+// Accelerometer reading of 1g, the controller lying flat and still
+constexpr SHORT kAccelOneG = 8192;
+
+// XUSB_GAMEPAD_* bit index -> DS4_BUTTON_*, 0 for the D-pad and Guide which go elsewhere
+constexpr USHORT kDS4ButtonOf[16] = {
+	0, 0, 0, 0,
+	DS4_BUTTON_OPTIONS,
+	DS4_BUTTON_SHARE,
+	DS4_BUTTON_THUMB_LEFT,
+	DS4_BUTTON_THUMB_RIGHT,
+	DS4_BUTTON_SHOULDER_LEFT,
+	DS4_BUTTON_SHOULDER_RIGHT,
+	0, 0,
+	DS4_BUTTON_CROSS,
+	DS4_BUTTON_CIRCLE,
+	DS4_BUTTON_SQUARE,
+	DS4_BUTTON_TRIANGLE,
+};
+
+// XUSB_GAMEPAD_DPAD_* bits (up, down, left, right) -> DS4 hat direction, opposing directions cancel
+constexpr BYTE kDS4DpadOf[16] = {
+	DS4_BUTTON_DPAD_NONE,      // -
+	DS4_BUTTON_DPAD_NORTH,     // U
+	DS4_BUTTON_DPAD_SOUTH,     // D
+	DS4_BUTTON_DPAD_NONE,      // UD
+	DS4_BUTTON_DPAD_WEST,      // L
+	DS4_BUTTON_DPAD_NORTHWEST, // UL
+	DS4_BUTTON_DPAD_SOUTHWEST, // DL
+	DS4_BUTTON_DPAD_WEST,      // UDL
+	DS4_BUTTON_DPAD_EAST,      // R
+	DS4_BUTTON_DPAD_NORTHEAST, // UR
+	DS4_BUTTON_DPAD_SOUTHEAST, // DR
+	DS4_BUTTON_DPAD_EAST,      // UDR
+	DS4_BUTTON_DPAD_NONE,      // LR
+	DS4_BUTTON_DPAD_NORTH,     // ULR
+	DS4_BUTTON_DPAD_SOUTH,     // DLR
+	DS4_BUTTON_DPAD_NONE,      // UDLR
+};
+
+// wButtons translated a byte at a time, i.e. without a loop over the set bits
+// The low byte carries the D-pad hat, which isn't a bit mask.
+struct DS4ButtonTables {
+	USHORT lo[256] = {};
+	USHORT hi[256] = {};
+};
+static constexpr DS4ButtonTables kDS4Buttons = [] {
+	DS4ButtonTables t;
+	for (int b = 0; b < 256; ++b) {
+		t.lo[b] = kDS4DpadOf[b & 0xF];
+		for (int i = 4; i < 8; ++i)
+			t.lo[b] |= (b >> i & 1) ? kDS4ButtonOf[i] : 0;
+		for (int i = 0; i < 8; ++i)
+			t.hi[b] |= (b >> i & 1) ? kDS4ButtonOf[8 + i] : 0;
+	}
+	return t;
+}();
+
+static SHORT ToGyro(float dps) noexcept {
+	return static_cast<SHORT>(std::clamp(std::lround(dps * kGyroUnitsPerDps), -32768L, 32767L));
+}
+
+// XUSB axes are signed and positive-up, DS4 ones are unsigned and positive-down
+static BYTE ToDS4AxisX(SHORT v) noexcept { return static_cast<BYTE>((v + 32768) >> 8); }
+static BYTE ToDS4AxisY(SHORT v) noexcept { return static_cast<BYTE>(255 - ((v + 32768) >> 8)); }
+
+void DS4Motion::AddMotion(float dx, float dy, int64_t qpc) noexcept {
+	pendingX += dx;
+	pendingY += dy;
+	if (qpcLastAdvance == 0)
+		qpcLastAdvance = qpc;
+	qpcLastMotion = qpc;
+}
+
+bool DS4Motion::Advance(const ConfigDS4& cfg, int64_t qpcNow, int64_t qpcFrequency) noexcept {
+	float dt = qpcLastAdvance != 0 ? static_cast<float>(qpcNow - qpcLastAdvance) / qpcFrequency : 0.0f;
+	bool moved = pendingX != 0.0f || pendingY != 0.0f;
+
+	switch (cfg.mouseMode) {
+	case DS4MouseMode::None:
+		break;
+
+	case DS4MouseMode::Touchpad:
+		if (moved) {
+			// Each stroke lands in the center, so that it has room to move in every direction
+			if (!touching) {
+				touching = true;
+				trackingNum = (trackingNum + 1) & 0x7F;
+				touchX = kDS4TouchWidth / 2;
+				touchY = kDS4TouchHeight / 2;
+			}
+			touchX = std::clamp(touchX + pendingX * cfg.touchSensitivity, 0.0f, kDS4TouchWidth - 1.0f);
+			touchY = std::clamp(touchY + pendingY * cfg.touchSensitivity, 0.0f, kDS4TouchHeight - 1.0f);
+			++touchPacket;
+		}
+		else if (touching && qpcNow - qpcLastMotion >= static_cast<int64_t>(kTouchLiftSeconds * qpcFrequency)) {
+			touching = false;
+			++touchPacket;
+		}
+		break;
+
+	case DS4MouseMode::Gyro: {
+		// Rotation rate from the average mouse velocity over the interval: yaw from horizontal, pitch from vertical motion
+		float perSecond = dt > 0.0f ? 1.0f / dt : 0.0f;
+		gyroX = ToGyro(-pendingY * perSecond * cfg.gyroSensitivity);
+		gyroY = ToGyro(-pendingX * perSecond * cfg.gyroSensitivity);
+		gyroZ = 0;
+	} break;
+	}
+
+	pendingX = 0.0f;
+	pendingY = 0.0f;
+	bool atRest = !touching && gyroX == 0 && gyroY == 0 && gyroZ == 0;
+	qpcLastAdvance = atRest ? 0 : qpcNow;
+	return atRest;
+}
+
+uint16_t DS4TimestampOf(int64_t qpc, int64_t qpcFrequency) noexcept {
+	// Through double, as qpc * 187500 overflows after a couple of months of uptime
+	double units = static_cast<double>(qpc) * (3'000'000.0 / 16.0) / static_cast<double>(qpcFrequency);
+	return static_cast<uint16_t>(static_cast<uint64_t>(units));
+}
+
+void PackDS4Report(const XUSB_REPORT& state, const DS4Motion& motion, uint16_t timestamp, DS4_REPORT_EX& out) noexcept {
+	std::memset(&out, 0, sizeof(out));
+	auto& r = out.Report;
+
+	r.bThumbLX = ToDS4AxisX(state.sThumbLX);
+	r.bThumbLY = ToDS4AxisY(state.sThumbLY);
+	r.bThumbRX = ToDS4AxisX(state.sThumbRX);
+	r.bThumbRY = ToDS4AxisY(state.sThumbRY);
+
+	USHORT buttons = kDS4Buttons.lo[state.wButtons & 0xFF] | kDS4Buttons.hi[state.wButtons >> 8];
+	// Also digital buttons on a DS4
+	if (state.bLeftTrigger)
+		buttons |= DS4_BUTTON_TRIGGER_LEFT;
+	if (state.bRightTrigger)
+		buttons |= DS4_BUTTON_TRIGGER_RIGHT;
+	r.wButtons = buttons;
+	r.bSpecial = (state.wButtons & XUSB_GAMEPAD_GUIDE) ? DS4_SPECIAL_BUTTON_PS : 0;
+	r.bTriggerL = state.bLeftTrigger;
+	r.bTriggerR = state.bRightTrigger;
+	r.wTimestamp = timestamp;
+
+	r.wGyroX = motion.gyroX;
+	r.wGyroY = motion.gyroY;
+	r.wGyroZ = motion.gyroZ;
+	r.wAccelY = kAccelOneG;
+
+	// One touch packet, with the second finger always up
+	r.bTouchPacketsN = 1;
+	auto& t = r.sCurrentTouch;
+	t.bPacketCounter = motion.touchPacket;
+	t.bIsUpTrackingNum1 = (motion.touching ? 0x00 : 0x80) | (motion.trackingNum & 0x7F);
+	auto x = static_cast<unsigned>(motion.touchX + 0.5f);
+	auto y = static_cast<unsigned>(motion.touchY + 0.5f);
+	// Two 12 bit values, little endian
+	t.bTouchData1[0] = static_cast<BYTE>(x & 0xFF);
+	t.bTouchData1[1] = static_cast<BYTE>(((x >> 8) & 0x0F) | (y & 0x0F) << 4);
+	t.bTouchData1[2] = static_cast<BYTE>(y >> 4);
+	t.bIsUpTrackingNum2 = 0x80;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "modelconfig.hpp"
+
+#include <ViGEm/Common.h>
+
+#include <cstdint>
+
+constexpr int kDS4TouchWidth = 1920;
+constexpr int kDS4TouchHeight = 943;
+
+// Touchpad and gyro state of a DS4 target, driven by its source mouse, see ConfigDS4
+struct DS4Motion {
+	/* Touchpad */
+	// Finger position, in touchpad units
+	float touchX = kDS4TouchWidth / 2;
+	float touchY = kDS4TouchHeight / 2;
+	bool touching = false;
+	// Incremented for every new finger down
+	uint8_t trackingNum = 0;
+	uint8_t touchPacket = 0;
+
+	/* Gyro, in DS4 units */
+	SHORT gyroX = 0;
+	SHORT gyroY = 0;
+	SHORT gyroZ = 0;
+
+	// Mouse counts since the last Advance()
+	float pendingX = 0.0f;
+	float pendingY = 0.0f;
+	// 0 while at rest
+	int64_t qpcLastAdvance = 0;
+	int64_t qpcLastMotion = 0;
+
+	// \param dx, dy in positive-right, positive-down
+	void AddMotion(float dx, float dy, int64_t qpc) noexcept;
+	// Turn the pending motion into touchpad and gyro state, before sending a report
+	// \return whether at rest, i.e. no finger on the touchpad and no rotation
+	bool Advance(const ConfigDS4& cfg, int64_t qpcNow, int64_t qpcFrequency) noexcept;
+};
+
+// DS4 reports count time in units of 16/3 us
+uint16_t DS4TimestampOf(int64_t qpc, int64_t qpcFrequency) noexcept;
+
+// Translate the gamepad state into a DS4 input report, in place, without allocating
+// Every byte of `out` is written, so that the result depends only on the inputs.
+void PackDS4Report(const XUSB_REPORT& state, const DS4Motion& motion, uint16_t timestamp, DS4_REPORT_EX& out) noexcept;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "modelconfig.hpp"
+#include "platform.hpp"
+
+#include <cstdint>
+#include <span>
+
+class FeederEngine;
+
+// A source keyboard, and the keys to hide from other applications when they come from it
+struct KeySuppressDevice {
+	HANDLE hDevice;
+	// 256 bit set indexed by KeyCode
+	uint64_t keys[4];
+};
+
+// Timers and notifications the engine needs from the platform it runs on, see Win32EngineHost
+// Callbacks into the engine must arrive on the engine's thread, the one that feeds it input.
+class EngineHost {
+public:
+	virtual ~EngineHost() = default;
+
+	// Call engine.Update() every periodMs until StopSampler()
+	// \return false if the timer couldn't be started
+	virtual bool StartSampler(FeederEngine& engine, int periodMs) noexcept = 0;
+	virtual void StopSampler() noexcept = 0;
+	// Call engine.RunActionTimers() once, after the delay, replacing whatever was set before
+	virtual void SetActionTimer(FeederEngine& engine, int64_t delayMicros) noexcept = 0;
+	virtual void CancelActionTimer() noexcept = 0;
+	// Called on the keymap compiler thread, engine.InstallCompiledKeymaps() must follow on the engine's thread
+	virtual void PostKeymapsCompiled() noexcept = 0;
+
+	/* Optional, the defaults do without */
+
+	// Start hiding the keys PublishSuppressedKeys() passes from other applications
+	// \return false if the platform can't
+	virtual bool StartKeySuppression(KeyboardInputMode mode) { return false; }
+	// Replaces everything published before
+	virtual void PublishSuppressedKeys(std::span<const KeySuppressDevice> devices) noexcept {}
+	// Call engine.OnForegroundApp() as applications come to the foreground
+	virtual void StartForegroundTracking(FeederEngine& engine) {}
+};
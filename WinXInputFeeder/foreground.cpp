@@ -0,0 +1,36 @@
+#include "pch.hpp"
+
+#include "foreground.hpp"
+
+#include "utils.hpp"
+
+std::string NormalizeExeName(std::string_view exePath) {
+	auto sep = exePath.find_last_of("\\/");
+	if (sep != std::string_view::npos)
+		exePath.remove_prefix(sep + 1);
+
+	std::string res(exePath);
+	for (char& c : res) {
+		if ('A' <= c && c <= 'Z')
+			c = static_cast<char>(c - 'A' + 'a');
+	}
+	return res;
+}
+
+void ForegroundSwitcher::Index(const Config::ProfileTable& profiles) {
+	profileByExe.clear();
+	for (auto& profile : profiles) {
+		for (auto& exe : profile.second.executables) {
+			auto [iter, inserted] = profileByExe.try_emplace(NormalizeExeName(exe), &profile);
+			if (!inserted)
+				LOG_DEBUG("{} is mapped to both profile {} and {}, using the former", Utf8ToWide(exe), Utf8ToWide(iter->second->first), Utf8ToWide(profile.first));
+		}
+	}
+}
+
+Config::ProfileRef ForegroundSwitcher::Find(std::string_view exePath) const {
+	if (profileByExe.empty())
+		return nullptr;
+	auto iter = profileByExe.find(NormalizeExeName(exePath));
+	return iter != profileByExe.end() ? iter->second : nullptr;
+}
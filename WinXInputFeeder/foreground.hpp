@@ -0,0 +1,24 @@
+#pragma once
+
+#include "modelconfig.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Picks the profile for the application in the foreground, see ConfigProfile::executables
+// Lookups go through an index of executable file names, built once per change of the profiles.
+struct ForegroundSwitcher {
+	// Normalized executable file name -> profile, see NormalizeExeName()
+	std::unordered_map<std::string, Config::ProfileRef> profileByExe;
+
+	// Rebuild the index, after profiles or their executables changed
+	void Index(const Config::ProfileTable& profiles);
+	// \param exePath UTF-8 path or file name of the application's executable
+	// \return the profile mapped to it, or nullptr if none is, in which case the current profile should stay
+	Config::ProfileRef Find(std::string_view exePath) const;
+};
+
+// File name part of the path, ASCII lowercased, as Windows matches file names case-insensitively
+std::string NormalizeExeName(std::string_view exePath);
@@ -0,0 +1,61 @@
+#include "pch.hpp"
+
+#include "foregroundhook.hpp"
+
+#include "utils.hpp"
+
+#include <format>
+#include <stdexcept>
+
+// WinEvent procedures get no context pointer
+static ForegroundHook* gForegroundHook = nullptr;
+
+ForegroundHook::ForegroundHook(ForegroundCallback callback, void* ctx)
+	: callback{ callback }
+	, ctx{ ctx }
+{
+	if (gForegroundHook)
+		throw std::runtime_error("Foreground hook already installed");
+
+	hHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, WinEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+	if (!hHook)
+		throw std::runtime_error(std::format("Error installing foreground hook: {}", GetLastErrorStrUtf8()));
+	gForegroundHook = this;
+}
+
+ForegroundHook::~ForegroundHook() {
+	UnhookWinEvent(hHook);
+	gForegroundHook = nullptr;
+}
+
+void CALLBACK ForegroundHook::WinEventProc(HWINEVENTHOOK hHook, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD idEventThread, DWORD dwmsEventTime) {
+	int64_t qpcEvent = QpcNow();
+	if (!gForegroundHook || event != EVENT_SYSTEM_FOREGROUND || idObject != OBJID_WINDOW || !hWnd)
+		return;
+	gForegroundHook->OnForeground(hWnd, qpcEvent);
+}
+
+void ForegroundHook::OnForeground(HWND hWnd, int64_t qpcEvent) {
+	DWORD processId = 0;
+	GetWindowThreadProcessId(hWnd, &processId);
+	if (processId == 0 || processId == lastProcessId)
+		return;
+	lastProcessId = processId;
+
+	// Limited access is granted even for elevated processes, unlike PROCESS_QUERY_INFORMATION
+	HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+	if (!hProcess) {
+		LOG_DEBUG("Error opening foreground process {}: {}", processId, GetLastErrorStr());
+		return;
+	}
+	wchar_t path[MAX_PATH * 2];
+	DWORD pathLen = static_cast<DWORD>(std::size(path));
+	BOOL ok = QueryFullProcessImageNameW(hProcess, 0, path, &pathLen);
+	CloseHandle(hProcess);
+	if (!ok) {
+		LOG_DEBUG("Error querying foreground process {}: {}", processId, GetLastErrorStr());
+		return;
+	}
+
+	callback(ctx, WideToUtf8(std::wstring_view(path, pathLen)), qpcEvent);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <cstdint>
+#include <string_view>
+
+// \param exePath UTF-8 path of the foreground application's executable
+// \param qpcEvent QueryPerformanceCounter() when the event was received
+using ForegroundCallback = void (*)(void* ctx, std::string_view exePath, int64_t qpcEvent);
+
+// Reports the application whose window came to the foreground, through an out of context WinEvent hook
+// Events are delivered on the thread that created it, which must pump messages. Only one may exist at a time.
+class ForegroundHook {
+private:
+	HWINEVENTHOOK hHook = nullptr;
+	ForegroundCallback callback;
+	void* ctx;
+	// Process of the last reported window, switching between its windows is not reported again
+	DWORD lastProcessId = 0;
+
+	static void CALLBACK WinEventProc(HWINEVENTHOOK hHook, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD idEventThread, DWORD dwmsEventTime);
+	void OnForeground(HWND hWnd, int64_t qpcEvent);
+
+public:
+	// Throws std::runtime_error if the hook can't be installed
+	ForegroundHook(ForegroundCallback callback, void* ctx);
+	~ForegroundHook();
+
+	ForegroundHook(const ForegroundHook&) = delete;
+	ForegroundHook& operator=(const ForegroundHook&) = delete;
+};
@@ -0,0 +1,26 @@
+#include "pch.hpp"
+
+#include "gamepadsink.hpp"
+
+#include <utility>
+
+GamepadTarget::GamepadTarget(GamepadSink& sink, GamepadKind kind)
+	: sink{ &sink }
+	, handle{ sink.Plug(kind) } {}
+
+GamepadTarget::~GamepadTarget() {
+	if (sink)
+		sink->Unplug(handle);
+}
+
+GamepadTarget::GamepadTarget(GamepadTarget&& that) noexcept
+	: sink{ std::exchange(that.sink, nullptr) }
+	, handle{ std::exchange(that.handle, nullptr) } {}
+
+GamepadTarget& GamepadTarget::operator=(GamepadTarget&& that) noexcept {
+	if (sink)
+		sink->Unplug(handle);
+	sink = std::exchange(that.sink, nullptr);
+	handle = std::exchange(that.handle, nullptr);
+	return *this;
+}
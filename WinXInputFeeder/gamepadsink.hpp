@@ -0,0 +1,39 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <ViGEm/Common.h>
+
+enum class GamepadKind : unsigned char {
+	X360,
+	DS4,
+};
+
+// Where the engine's gamepads go, e.g. the ViGEm bus (see ViGEmSink), or a recorder in benchmarks and replay tests
+// Called on the engine's thread only.
+class GamepadSink {
+public:
+	virtual ~GamepadSink() = default;
+
+	// Plug in a virtual controller
+	// Throws std::runtime_error if it can't be.
+	// \return handle identifying it in the other calls
+	virtual void* Plug(GamepadKind kind) = 0;
+	virtual void Unplug(void* target) noexcept = 0;
+	virtual void SubmitX360(void* target, const XUSB_REPORT& report) noexcept = 0;
+	virtual void SubmitDS4(void* target, const DS4_REPORT_EX& report) noexcept = 0;
+};
+
+// A virtual controller plugged into a GamepadSink, unplugged when destroyed
+struct GamepadTarget {
+	GamepadSink* sink;
+	void* handle;
+
+	GamepadTarget(GamepadSink& sink, GamepadKind kind);
+	~GamepadTarget();
+
+	GamepadTarget(const GamepadTarget&) = delete;
+	GamepadTarget& operator=(const GamepadTarget&) = delete;
+	GamepadTarget(GamepadTarget&&) noexcept;
+	GamepadTarget& operator=(GamepadTarget&&) noexcept;
+};
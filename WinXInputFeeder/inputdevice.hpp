@@ -1,39 +1,44 @@
 #pragma once
 
+#include "inputsource.hpp"
+#include "keycode.hpp"
+
 #include <bitset>
-#include <optional>
-#include <string>
+#include <cstdint>
 #include <string_view>
 
-#include <minwindef.h>
-
-// Win32 Vkey keycode
-using KeyCode = BYTE;
-
-void InitKeyCodeConv();
-std::string_view KeyCodeToString(KeyCode key) noexcept;
-std::optional<KeyCode> KeyCodeFromString(std::string_view str) noexcept;
-
-bool IsKeyCodeMouseButton(KeyCode key) noexcept;
-
 // For RIM_TYPExxx values
 std::wstring_view RawInputTypeToString(DWORD type);
 
-enum class IdevKind {
-    Keyboard = RIM_TYPEMOUSE,
-    Mouse = RIM_TYPEKEYBOARD,
-    Hid = RIM_TYPEHID,
+// Live measurement of a mouse's report rate, and of the counts moved during calibration
+// Record() is called for every motion packet, and is constant time and allocation-free.
+struct MouseMeter {
+    // Running average of the time between motion packets, in seconds, 0 if not measured yet
+    float packetInterval = 0.0f;
+    int64_t qpcLastPacket = 0;
+    uint64_t packetCount = 0;
+
+    // Movement summed since BeginCalibration()
+    int64_t calibSumX = 0;
+    int64_t calibSumY = 0;
+    bool calibrating = false;
+
+    void Record(LONG dx, LONG dy, int64_t qpc) noexcept;
+    // Reports per second, 0 if not measured yet
+    float GetPollingRate() const noexcept { return packetInterval > 0.0f ? 1.0f / packetInterval : 0.0f; }
+
+    void BeginCalibration() noexcept;
+    // \return straight-line distance moved since BeginCalibration(), in counts
+    float FinishCalibration() noexcept;
 };
 
-struct IdevDevice {
-    HANDLE hDevice = INVALID_HANDLE_VALUE;
-    std::string nameUtf8;
+// A device as raw input reports it
+struct IdevDevice : InputDevice {
     std::bitset<0xFF> keyStates = {};
     RID_DEVICE_INFO info;
-    USHORT vendorId;
-    USHORT productId;
 
-    IdevKind GetKind() const noexcept { return static_cast<IdevKind>(info.dwType); }
+    /* Mouse only */
+    MouseMeter mouseMeter;
 
     static IdevDevice FromHANDLE(HANDLE hDevice);
 };
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "keycode.hpp"
+#include "platform.hpp"
+
+#include <cstdint>
+#include <string>
+
+enum class IdevKind {
+	Keyboard = RIM_TYPEMOUSE,
+	Mouse = RIM_TYPEKEYBOARD,
+	Hid = RIM_TYPEHID,
+};
+
+// A keyboard or mouse as the engine sees it
+// An input source, e.g. raw input on Windows (see IdevDevice) or a replay of recorded input, keeps one per device for
+// as long as it is connected, and feeds its events in through FeederEngine::AttachDevice(), HandleKeyPress(),
+// HandleMouseMovement() and DetachDevice(), in that order, on the engine's thread.
+struct InputDevice {
+	// Opaque to the engine, only compared for identity
+	HANDLE hDevice = INVALID_HANDLE_VALUE;
+	// Device interface name, stable across reboots while the device stays in the same port
+	std::string nameUtf8;
+	IdevKind kind = IdevKind::Hid;
+	// 0 if unknown
+	USHORT vendorId = 0;
+	USHORT productId = 0;
+
+	// Multiplier that normalizes this mouse's counts to kReferenceMouseDpi, from its calibration
+	float mouseCountScale = 1.0f;
+	// Slot in the feeder's RouteTable, assigned by FeederEngine::AttachDevice(); 0xFF if it has none
+	uint8_t routeSlot = 0xFF;
+
+	// Identity used to look up per-model settings, e.g. mouse calibration
+	uint32_t GetVidPid() const noexcept { return (static_cast<uint32_t>(vendorId) << 16) | productId; }
+};
@@ -0,0 +1,481 @@
+#include "pch.hpp"
+
+#include "keycode.hpp"
+
+#include <array>
+#include <cstdint>
+
+using namespace std::literals;
+
+namespace {
+struct KeyName {
+	std::string_view name;
+	KeyCode key;
+};
+
+// The first name of a key is its canonical name, used by KeyCodeToString(); any further ones are aliases
+constexpr KeyName kKeyNames[] = {
+	// https://learn.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
+
+	{ "MouseLeft"sv, VK_LBUTTON },
+	{ "MouseRight"sv, VK_RBUTTON },
+	{ "CtrlBreak"sv, VK_CANCEL },
+	{ "MouseMiddle"sv, VK_MBUTTON },
+	{ "MouseX1"sv, VK_XBUTTON1 },
+	{ "MouseX2"sv, VK_XBUTTON2 },
+	// 0x07 ---- Undefined
+	{ "Backspace"sv, VK_BACK },
+	{ "Tab"sv, VK_TAB },
+	// 0x0A-0B ---- Reserved
+	/*{ "CLEAR key"sv, VK_CLEAR },*/
+	{ "Enter"sv, VK_RETURN },
+	// 0x0E-0F ---- Undefined
+	{ "NumpadEnter"sv, kVkNumpadEnter },
+	{ "IntlYen"sv, kVkIntlYen },
+	/* // See below, we use the individual left/right keys
+	{ "SHIFT key"sv, VK_SHIFT },
+	{ "CTRL key"sv, VK_CONTROL },
+	{ "ALT key"sv, VK_MENU },
+	*/
+	{ "Pause"sv, VK_PAUSE },
+	{ "CapsLock"sv, VK_CAPITAL },
+	{ "Kana"sv, VK_KANA },
+	/*
+	{ "IME Hangul mode"sv, VK_HANGUL },
+	{ "IME On"sv, VK_IME_ON },
+	{ "IME Junja mode"sv, VK_JUNJA },
+	{ "IME final mode"sv, VK_FINAL },
+	{ "IME Hanja mode"sv, VK_HANJA },
+	{ "IME Kanji mode"sv, VK_KANJI },
+	{ "IME Off"sv, VK_IME_OFF },
+	*/
+	{ "Escape"sv, VK_ESCAPE }, { "Esc"sv, VK_ESCAPE },
+	{ "Convert"sv, VK_CONVERT },
+	{ "NonConvert"sv, VK_NONCONVERT },
+	/*
+	{ "IME accept"sv, VK_ACCEPT },
+	{ "IME mode change request"sv, VK_MODECHANGE },
+	*/
+	{ "Space"sv, VK_SPACE },
+	{ "PageUp"sv, VK_PRIOR },
+	{ "PageDown"sv, VK_NEXT },
+	{ "End"sv, VK_END },
+	{ "Home"sv, VK_HOME },
+	{ "LeftArrow"sv, VK_LEFT },
+	{ "UpArrow"sv, VK_UP },
+	{ "RightArrow"sv, VK_RIGHT },
+	{ "DownArrow"sv, VK_DOWN },
+	/*{ "SELECT key"sv, VK_SELECT },*/
+	/*{ "PRINT key"sv, VK_PRINT },*/
+	/*{ "EXECUTE key"sv, VK_EXECUTE },*/
+	{ "PrintScreen"sv, VK_SNAPSHOT },
+	{ "Insert"sv, VK_INSERT },
+	{ "Delete"sv, VK_DELETE },
+	/*{ "HELP key"sv, VK_HELP },*/
+	{ "0"sv, '0' },
+	{ "1"sv, '1' },
+	{ "2"sv, '2' },
+	{ "3"sv, '3' },
+	{ "4"sv, '4' },
+	{ "5"sv, '5' },
+	{ "6"sv, '6' },
+	{ "7"sv, '7' },
+	{ "8"sv, '8' },
+	{ "9"sv, '9' },
+	// 0x3A-40 ---- Undefined
+	{ "A"sv, 'A' },
+	{ "B"sv, 'B' },
+	{ "C"sv, 'C' },
+	{ "D"sv, 'D' },
+	{ "E"sv, 'E' },
+	{ "F"sv, 'F' },
+	{ "G"sv, 'G' },
+	{ "H"sv, 'H' },
+	{ "I"sv, 'I' },
+	{ "J"sv, 'J' },
+	{ "K"sv, 'K' },
+	{ "L"sv, 'L' },
+	{ "M"sv, 'M' },
+	{ "N"sv, 'N' },
+	{ "O"sv, 'O' },
+	{ "P"sv, 'P' },
+	{ "Q"sv, 'Q' },
+	{ "R"sv, 'R' },
+	{ "S"sv, 'S' },
+	{ "T"sv, 'T' },
+	{ "U"sv, 'U' },
+	{ "V"sv, 'V' },
+	{ "W"sv, 'W' },
+	{ "X"sv, 'X' },
+	{ "Y"sv, 'Y' },
+	{ "Z"sv, 'Z' },
+	{ "LWin"sv, VK_LWIN },
+	{ "RWin"sv, VK_RWIN },
+	{ "Apps"sv, VK_APPS },
+	// 0x5E ---- Reserved
+	{ "Sleep"sv, VK_SLEEP },
+	{ "Numpad0"sv, VK_NUMPAD0 },
+	{ "Numpad1"sv, VK_NUMPAD1 },
+	{ "Numpad2"sv, VK_NUMPAD2 },
+	{ "Numpad3"sv, VK_NUMPAD3 },
+	{ "Numpad4"sv, VK_NUMPAD4 },
+	{ "Numpad5"sv, VK_NUMPAD5 },
+	{ "Numpad6"sv, VK_NUMPAD6 },
+	{ "Numpad7"sv, VK_NUMPAD7 },
+	{ "Numpad8"sv, VK_NUMPAD8 },
+	{ "Numpad9"sv, VK_NUMPAD9 },
+	{ "NumpadMultiply"sv, VK_MULTIPLY },
+	{ "NumpadAdd"sv, VK_ADD },
+	{ "Separator"sv, VK_SEPARATOR }, // I don't think this key exists on modern keyboards
+	{ "NumpadSubtract"sv, VK_SUBTRACT },
+	{ "NumpadDecimal"sv, VK_DECIMAL },
+	{ "NumpadDivide"sv, VK_DIVIDE },
+	{ "F1"sv, VK_F1 },
+	{ "F2"sv, VK_F2 },
+	{ "F3"sv, VK_F3 },
+	{ "F4"sv, VK_F4 },
+	{ "F5"sv, VK_F5 },
+	{ "F6"sv, VK_F6 },
+	{ "F7"sv, VK_F7 },
+	{ "F8"sv, VK_F8 },
+	{ "F9"sv, VK_F9 },
+	{ "F10"sv, VK_F10 },
+	{ "F11"sv, VK_F11 },
+	{ "F12"sv, VK_F12 },
+	{ "F13"sv, VK_F13 },
+	{ "F14"sv, VK_F14 },
+	{ "F15"sv, VK_F15 },
+	{ "F16"sv, VK_F16 },
+	{ "F17"sv, VK_F17 },
+	{ "F18"sv, VK_F18 },
+	{ "F19"sv, VK_F19 },
+	{ "F20"sv, VK_F20 },
+	{ "F21"sv, VK_F21 },
+	{ "F22"sv, VK_F22 },
+	{ "F23"sv, VK_F23 },
+	{ "F24"sv, VK_F24 },
+	// 0x88-8F ---- Unassigned
+	{ "NumLock"sv, VK_NUMLOCK },
+	{ "ScrollLock"sv, VK_SCROLL },
+	// 0x92-96 ---- OEM specific
+	// 0x97-9F ---- Unassigned
+	{ "LShift"sv, VK_LSHIFT },
+	{ "RShift"sv, VK_RSHIFT },
+	{ "LCtrl"sv, VK_LCONTROL },
+	{ "RCtrl"sv, VK_RCONTROL },
+	{ "LAlt"sv, VK_LMENU },
+	{ "RAlt"sv, VK_RMENU },
+	{ "BrowserBack"sv, VK_BROWSER_BACK },
+	{ "BrowserForward"sv, VK_BROWSER_FORWARD },
+	{ "BrowserRefresh"sv, VK_BROWSER_REFRESH },
+	{ "BrowserStop"sv, VK_BROWSER_STOP },
+	{ "BrowserSearch"sv, VK_BROWSER_SEARCH },
+	{ "BrowserFavorites"sv, VK_BROWSER_FAVORITES },
+	{ "BrowserHome"sv, VK_BROWSER_HOME },
+	{ "VolumeMute"sv, VK_VOLUME_MUTE },
+	{ "VolumeDown"sv, VK_VOLUME_DOWN },
+	{ "VolumeUp"sv, VK_VOLUME_UP },
+	{ "MediaNext"sv, VK_MEDIA_NEXT_TRACK },
+	{ "MediaPrevious"sv, VK_MEDIA_PREV_TRACK },
+	{ "MediaStop"sv, VK_MEDIA_STOP },
+	{ "MediaPlayPause"sv, VK_MEDIA_PLAY_PAUSE },
+	{ "LaunchMail"sv, VK_LAUNCH_MAIL },
+	{ "MediaSelect"sv, VK_LAUNCH_MEDIA_SELECT },
+	{ "LaunchApp1"sv, VK_LAUNCH_APP1 },
+	{ "LaunchApp2"sv, VK_LAUNCH_APP2 },
+	// 0xB8-B9 ---- Reserved
+	{ "Semicolon"sv, VK_OEM_1 }, { ";"sv, VK_OEM_1 },
+	{ "Equals"sv, VK_OEM_PLUS }, { "="sv, VK_OEM_PLUS },
+	{ "Comma"sv, VK_OEM_COMMA }, { ","sv, VK_OEM_COMMA },
+	{ "Minus"sv, VK_OEM_MINUS }, { "-"sv, VK_OEM_MINUS },
+	{ "Period"sv, VK_OEM_PERIOD }, { "."sv, VK_OEM_PERIOD },
+	{ "ForwardSlash"sv, VK_OEM_2 }, { "/"sv, VK_OEM_2 },
+	{ "Grave"sv, VK_OEM_3 }, { "`"sv, VK_OEM_3 },
+	{ "IntlRo"sv, kVkIntlRo },
+	// 0xC2-D7 ---- Reserved
+	// 0xD8-DA ---- Unassigned
+	{ "LeftBracket"sv, VK_OEM_4 }, { "["sv, VK_OEM_4 },
+	{ "BackSlash"sv, VK_OEM_5 }, { "\\"sv, VK_OEM_5 },
+	{ "RightBracket"sv, VK_OEM_6 }, { "]"sv, VK_OEM_6 },
+	{ "Quote"sv, VK_OEM_7 }, { "'"sv, VK_OEM_7 },
+	/*{ "Used for miscellaneous characters; it can vary by keyboard."sv, VK_OEM_8 },*/
+	// 0xE0 ---- Reserved
+	// 0xE1 ---- OEM specific
+	// The <> keys on the US standard keyboard, or the \| key on the non-US 102-key keyboard
+	{ "IntlBackslash"sv, VK_OEM_102 },
+	// 0xE3-E4 ---- OEM specific
+	/*{ "IME PROCESS key"sv, VK_PROCESSKEY },*/
+	// 0xE6 ---- OEM specific
+	/*{ "Used to pass Unicode characters as if they were keystrokes.The VK_PACKET key is the low word of a 32 - bit Virtual Key value used for non - keyboard input methods.For more information, see Remark in KEYBDINPUT, SendInput, WM_KEYDOWN, and WM_KEYUP"sv, VK_PACKET },*/
+	// 0xE8 ---- Unassigned
+	// 0xE9-F5 ---- OEM specific
+	/*
+	{ "Attn key"sv, VK_ATTN },
+	{ "CrSel key"sv, VK_CRSEL },
+	{ "ExSel key"sv, VK_EXSEL },
+	{ "Erase EOF key"sv, VK_EREOF },
+	{ "Play key"sv, VK_PLAY },
+	{ "Zoom key"sv, VK_ZOOM },
+	{ "Reserved"sv, VK_NONAME },
+	{ "PA1 key"sv, VK_PA1 },
+	{ "Clear key"sv, VK_OEM_CLEAR },
+	*/
+};
+
+// Name lookup is a perfect hash built at compile time by hash-and-displace: the names are split into
+// kKeyNameBucketCount buckets by their FNV-1a hash, and each bucket gets the smallest displacement that moves all of
+// its names into free slots, fullest buckets first. Unlike one seed for all names at once, whose odds fall off
+// exponentially with the name count, this keeps working as names are added: the 160 names in 1024 slots need displacements of at most 3, and random sets of up to 254 names (all that
+// kNoKeyName leaves) stay around 10, far from the 65536 tried.
+constexpr int kKeyNameSlotBits = 10;
+constexpr int kKeyNameSlotCount = 1 << kKeyNameSlotBits;
+constexpr int kKeyNameBucketBits = 6;
+constexpr int kKeyNameBucketCount = 1 << kKeyNameBucketBits;
+constexpr uint8_t kNoKeyName = 0xFF;
+static_assert(std::size(kKeyNames) < kNoKeyName);
+
+constexpr uint32_t KeyNameHashOf(std::string_view name) noexcept {
+	uint32_t h = 2166136261u;
+	for (char c : name) {
+		h ^= static_cast<uint8_t>(c);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+constexpr int KeyNameBucketOf(uint32_t hash) noexcept {
+	// The high bits are the well mixed ones
+	return static_cast<int>(hash >> (32 - kKeyNameBucketBits));
+}
+
+constexpr int KeyNameSlotOf(uint32_t hash, uint16_t displacement) noexcept {
+	// Fibonacci hashing, so that the displacement in the low bits reaches the high ones
+	return static_cast<int>(((hash ^ displacement) * 2654435769u) >> (32 - kKeyNameSlotBits));
+}
+
+struct KeyNameTable {
+	std::array<uint16_t, kKeyNameBucketCount> displacements = {};
+	// Slot -> index into kKeyNames
+	std::array<uint8_t, kKeyNameSlotCount> slots = {};
+	// False if some bucket found no displacement
+	bool complete = true;
+};
+
+constexpr auto kKeyNameTable = [] {
+	KeyNameTable res;
+	res.slots.fill(kNoKeyName);
+
+	std::array<uint32_t, std::size(kKeyNames)> hashes = {};
+	std::array<int, kKeyNameBucketCount> bucketSizes = {};
+	for (size_t i = 0; i < std::size(kKeyNames); ++i) {
+		hashes[i] = KeyNameHashOf(kKeyNames[i].name);
+		++bucketSizes[KeyNameBucketOf(hashes[i])];
+	}
+
+	std::array<int, kKeyNameBucketCount> order = {};
+	for (int b = 0; b < kKeyNameBucketCount; ++b)
+		order[b] = b;
+	std::ranges::sort(order, [&](int a, int b) { return bucketSizes[a] > bucketSizes[b]; });
+
+	for (int bucket : order) {
+		if (bucketSizes[bucket] == 0)
+			break;
+
+		bool placed = false;
+		for (uint32_t d = 0; d <= UINT16_MAX && !placed; ++d) {
+			auto displacement = static_cast<uint16_t>(d);
+			// Names of one bucket may also collide with each other
+			auto slots = res.slots;
+			placed = true;
+			for (size_t i = 0; i < std::size(kKeyNames) && placed; ++i) {
+				if (KeyNameBucketOf(hashes[i]) != bucket)
+					continue;
+				auto& slot = slots[KeyNameSlotOf(hashes[i], displacement)];
+				placed = slot == kNoKeyName;
+				slot = static_cast<uint8_t>(i);
+			}
+			if (placed) {
+				res.slots = slots;
+				res.displacements[bucket] = displacement;
+			}
+		}
+		if (!placed) {
+			res.complete = false;
+			break;
+		}
+	}
+	return res;
+}();
+static_assert(kKeyNameTable.complete, "No perfect hash for kKeyNames, try a bigger kKeyNameSlotBits");
+
+// KeyCode -> canonical name
+constexpr auto kKeyCodeNames = [] {
+	std::array<std::string_view, 0x100> names = {};
+	for (const auto& kn : kKeyNames) {
+		if (names[kn.key].empty())
+			names[kn.key] = kn.name;
+	}
+	for (auto& name : names) {
+		if (name.empty())
+			name = "<unknown>"sv;
+	}
+	return names;
+}();
+
+struct ScanCodeKey {
+	// Set 1 make code, with the E0/E1 prefix in the high byte
+	uint16_t scanCode;
+	KeyCode key;
+};
+
+// Keys are named after their legend on the US layout, regardless of the active layout
+constexpr ScanCodeKey kScanCodeKeys[] = {
+	{ 0x01, VK_ESCAPE },
+	{ 0x02, '1' }, { 0x03, '2' }, { 0x04, '3' }, { 0x05, '4' }, { 0x06, '5' },
+	{ 0x07, '6' }, { 0x08, '7' }, { 0x09, '8' }, { 0x0A, '9' }, { 0x0B, '0' },
+	{ 0x0C, VK_OEM_MINUS },
+	{ 0x0D, VK_OEM_PLUS },
+	{ 0x0E, VK_BACK },
+	{ 0x0F, VK_TAB },
+	{ 0x10, 'Q' }, { 0x11, 'W' }, { 0x12, 'E' }, { 0x13, 'R' }, { 0x14, 'T' },
+	{ 0x15, 'Y' }, { 0x16, 'U' }, { 0x17, 'I' }, { 0x18, 'O' }, { 0x19, 'P' },
+	{ 0x1A, VK_OEM_4 },
+	{ 0x1B, VK_OEM_6 },
+	{ 0x1C, VK_RETURN },
+	{ 0x1D, VK_LCONTROL },
+	{ 0x1E, 'A' }, { 0x1F, 'S' }, { 0x20, 'D' }, { 0x21, 'F' }, { 0x22, 'G' },
+	{ 0x23, 'H' }, { 0x24, 'J' }, { 0x25, 'K' }, { 0x26, 'L' },
+	{ 0x27, VK_OEM_1 },
+	{ 0x28, VK_OEM_7 },
+	{ 0x29, VK_OEM_3 },
+	{ 0x2A, VK_LSHIFT },
+	{ 0x2B, VK_OEM_5 },
+	{ 0x2C, 'Z' }, { 0x2D, 'X' }, { 0x2E, 'C' }, { 0x2F, 'V' }, { 0x30, 'B' },
+	{ 0x31, 'N' }, { 0x32, 'M' },
+	{ 0x33, VK_OEM_COMMA },
+	{ 0x34, VK_OEM_PERIOD },
+	{ 0x35, VK_OEM_2 },
+	{ 0x36, VK_RSHIFT },
+	{ 0x37, VK_MULTIPLY },
+	{ 0x38, VK_LMENU },
+	{ 0x39, VK_SPACE },
+	{ 0x3A, VK_CAPITAL },
+	{ 0x3B, VK_F1 }, { 0x3C, VK_F2 }, { 0x3D, VK_F3 }, { 0x3E, VK_F4 }, { 0x3F, VK_F5 },
+	{ 0x40, VK_F6 }, { 0x41, VK_F7 }, { 0x42, VK_F8 }, { 0x43, VK_F9 }, { 0x44, VK_F10 },
+	{ 0x45, VK_NUMLOCK },
+	{ 0x46, VK_SCROLL },
+	// The numpad, as itself regardless of NumLock
+	{ 0x47, VK_NUMPAD7 }, { 0x48, VK_NUMPAD8 }, { 0x49, VK_NUMPAD9 },
+	{ 0x4A, VK_SUBTRACT },
+	{ 0x4B, VK_NUMPAD4 }, { 0x4C, VK_NUMPAD5 }, { 0x4D, VK_NUMPAD6 },
+	{ 0x4E, VK_ADD },
+	{ 0x4F, VK_NUMPAD1 }, { 0x50, VK_NUMPAD2 }, { 0x51, VK_NUMPAD3 },
+	{ 0x52, VK_NUMPAD0 },
+	{ 0x53, VK_DECIMAL },
+	// Alt+PrintScreen
+	{ 0x54, VK_SNAPSHOT },
+	{ 0x56, VK_OEM_102 },
+	{ 0x57, VK_F11 },
+	{ 0x58, VK_F12 },
+	{ 0x64, VK_F13 }, { 0x65, VK_F14 }, { 0x66, VK_F15 }, { 0x67, VK_F16 }, { 0x68, VK_F17 },
+	{ 0x69, VK_F18 }, { 0x6A, VK_F19 }, { 0x6B, VK_F20 }, { 0x6C, VK_F21 }, { 0x6D, VK_F22 },
+	{ 0x6E, VK_F23 },
+	{ 0x70, VK_KANA },
+	{ 0x73, kVkIntlRo },
+	{ 0x76, VK_F24 },
+	{ 0x79, VK_CONVERT },
+	{ 0x7B, VK_NONCONVERT },
+	{ 0x7D, kVkIntlYen },
+
+	{ 0xE010, VK_MEDIA_PREV_TRACK },
+	{ 0xE019, VK_MEDIA_NEXT_TRACK },
+	{ 0xE01C, kVkNumpadEnter },
+	{ 0xE01D, VK_RCONTROL },
+	{ 0xE020, VK_VOLUME_MUTE },
+	{ 0xE021, VK_LAUNCH_APP2 },
+	{ 0xE022, VK_MEDIA_PLAY_PAUSE },
+	{ 0xE024, VK_MEDIA_STOP },
+	// 0xE02A/0xE036 are the fake shifts sent around navigation keys, deliberately left unmapped
+	{ 0xE02E, VK_VOLUME_DOWN },
+	{ 0xE030, VK_VOLUME_UP },
+	{ 0xE032, VK_BROWSER_HOME },
+	{ 0xE035, VK_DIVIDE },
+	{ 0xE037, VK_SNAPSHOT },
+	{ 0xE038, VK_RMENU },
+	// Some keyboards send NumLock with an E0 prefix
+	{ 0xE045, VK_NUMLOCK },
+	// Ctrl+Pause
+	{ 0xE046, VK_CANCEL },
+	{ 0xE047, VK_HOME },
+	{ 0xE048, VK_UP },
+	{ 0xE049, VK_PRIOR },
+	{ 0xE04B, VK_LEFT },
+	{ 0xE04D, VK_RIGHT },
+	{ 0xE04F, VK_END },
+	{ 0xE050, VK_DOWN },
+	{ 0xE051, VK_NEXT },
+	{ 0xE052, VK_INSERT },
+	{ 0xE053, VK_DELETE },
+	{ 0xE05B, VK_LWIN },
+	{ 0xE05C, VK_RWIN },
+	{ 0xE05D, VK_APPS },
+	{ 0xE05F, VK_SLEEP },
+	{ 0xE065, VK_BROWSER_SEARCH },
+	{ 0xE066, VK_BROWSER_FAVORITES },
+	{ 0xE067, VK_BROWSER_REFRESH },
+	{ 0xE068, VK_BROWSER_STOP },
+	{ 0xE069, VK_BROWSER_FORWARD },
+	{ 0xE06A, VK_BROWSER_BACK },
+	{ 0xE06B, VK_LAUNCH_APP1 },
+	{ 0xE06C, VK_LAUNCH_MAIL },
+	{ 0xE06D, VK_LAUNCH_MEDIA_SELECT },
+
+	// Pause is E1 1D 45; raw input reports it as 1D with RI_KEY_E1, followed by a 45 with Vkey 0xFF
+	{ 0xE11D, VK_PAUSE },
+};
+
+// Make codes are 7 bits, so E1 takes bit 7 and E0 bit 8 of the slot
+constexpr int kScanCodeSlotCount = 512;
+
+constexpr int ScanCodeSlotOf(USHORT makeCode, USHORT flags) noexcept {
+	return (makeCode & 0x7F) | ((flags & RI_KEY_E1) << 5) | ((flags & RI_KEY_E0) << 7);
+}
+
+// Slot -> KeyCode, 0xFF for none
+constexpr auto kScanCodeSlots = [] {
+	std::array<KeyCode, kScanCodeSlotCount> slots = {};
+	for (auto& slot : slots)
+		slot = 0xFF;
+	for (const auto& sk : kScanCodeKeys) {
+		USHORT flags = (sk.scanCode >> 8) == 0xE0 ? RI_KEY_E0 : (sk.scanCode >> 8) == 0xE1 ? RI_KEY_E1 : 0;
+		slots[ScanCodeSlotOf(sk.scanCode & 0xFF, flags)] = sk.key;
+	}
+	return slots;
+}();
+static_assert(kScanCodeSlots[ScanCodeSlotOf(0x1C, RI_KEY_E0)] == kVkNumpadEnter);
+static_assert(kScanCodeSlots[ScanCodeSlotOf(0x1D, RI_KEY_E1)] == VK_PAUSE);
+static_assert(kScanCodeSlots[ScanCodeSlotOf(0x2A, RI_KEY_E0)] == 0xFF);
+}
+
+std::string_view KeyCodeToString(KeyCode key) noexcept {
+	return kKeyCodeNames[key];
+}
+
+std::optional<KeyCode> KeyCodeFromString(std::string_view str) noexcept {
+	uint32_t hash = KeyNameHashOf(str);
+	uint8_t idx = kKeyNameTable.slots[KeyNameSlotOf(hash, kKeyNameTable.displacements[KeyNameBucketOf(hash)])];
+	if (idx == kNoKeyName || kKeyNames[idx].name != str)
+		return {};
+	return kKeyNames[idx].key;
+}
+
+KeyCode KeyCodeFromScanCode(USHORT makeCode, USHORT flags) noexcept {
+	// E.g. KEYBOARD_OVERRUN_MAKE_CODE
+	if (makeCode > 0x7F)
+		return 0xFF;
+	return kScanCodeSlots[ScanCodeSlotOf(makeCode, flags)];
+}
+
+bool IsKeyCodeMouseButton(KeyCode key) noexcept {
+	return key == VK_LBUTTON || key == VK_RBUTTON || key == VK_MBUTTON || key == VK_XBUTTON1 || key == VK_XBUTTON2;
+}
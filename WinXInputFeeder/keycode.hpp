@@ -0,0 +1,27 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Win32 Vkey keycode, on every platform, see platform.hpp
+using KeyCode = BYTE;
+
+// Physical keys that have no Vkey of their own, given otherwise unused codes so that they can be bound in scan code mode
+constexpr KeyCode kVkNumpadEnter = 0x0E;
+constexpr KeyCode kVkIntlYen = 0x0F;
+// VK_ABNT_C1 from kbd.h, the JIS Ro / Brazilian /? key
+constexpr KeyCode kVkIntlRo = 0xC1;
+
+std::string_view KeyCodeToString(KeyCode key) noexcept;
+std::optional<KeyCode> KeyCodeFromString(std::string_view str) noexcept;
+// Layout independent: keys are identified by position, and named after their US layout legend
+// Allocation and syscall free, a lookup in a 512 entry table.
+// \param makeCode RAWKEYBOARD::MakeCode
+// \param flags RAWKEYBOARD::Flags, for the RI_KEY_E0/RI_KEY_E1 prefixes
+// \return 0xFF if the scan code isn't a key on its own, e.g. the fake shifts sent around navigation keys
+KeyCode KeyCodeFromScanCode(USHORT makeCode, USHORT flags) noexcept;
+
+bool IsKeyCodeMouseButton(KeyCode key) noexcept;
@@ -0,0 +1,131 @@
+#include "pch.hpp"
+
+#include "keymap.hpp"
+
+#include <bit>
+#include <iterator>
+#include <utility>
+
+static void PressButtons(KeymapState& state, USHORT buttons, USHORT& wButtons) noexcept {
+	for (; buttons != 0; buttons &= buttons - 1) {
+		int i = std::countr_zero(buttons);
+		if (state.buttonRefs[i]++ == 0)
+			wButtons |= 1 << i;
+	}
+}
+
+static void ReleaseButtons(KeymapState& state, USHORT buttons, USHORT& wButtons) noexcept {
+	for (; buttons != 0; buttons &= buttons - 1) {
+		int i = std::countr_zero(buttons);
+		if (state.buttonRefs[i] > 0 && --state.buttonRefs[i] == 0)
+			wButtons &= ~(1 << i);
+	}
+}
+
+void KeymapState::Reset(USHORT& wButtons) noexcept {
+	for (int i = 0; i < 16; ++i) {
+		if (buttonRefs[i] > 0)
+			wButtons &= ~(1 << i);
+	}
+	*this = {};
+}
+
+bool HasKeymap(const ConfigGamepad& gamepad) noexcept {
+	return !gamepad.multiKeys.empty() || !gamepad.layers.empty() || !gamepad.chords.empty();
+}
+
+void CompileKeymap(const ConfigGamepad& gamepad, KeymapTables& t) noexcept {
+	t = {};
+	auto Mark = [&](KeyCode key) {
+		t.keys[key >> 6] |= uint64_t(1) << (key & 63);
+	};
+
+	for (auto&& [key, buttons] : gamepad.multiKeys) {
+		t.layerButtons[0][key] = buttons;
+		Mark(key);
+	}
+
+	if (gamepad.layers.size() > kMaxKeyLayers)
+		LOG_DEBUG("Gamepad has {} layers, only the first {} are used", gamepad.layers.size(), kMaxKeyLayers);
+	for (int i = 0; i < gamepad.layers.size() && i < kMaxKeyLayers; ++i) {
+		auto& layer = gamepad.layers[i];
+		if (layer.key == 0xFF)
+			continue;
+		t.layerBits[layer.key] |= 1 << i;
+		Mark(layer.key);
+		for (auto&& [key, buttons] : layer.buttons) {
+			t.layerButtons[i + 1][key] = buttons;
+			Mark(key);
+		}
+	}
+	// Keys a layer leaves out behave as on the base layer, not as on whichever layer is held below it
+	for (int layer = 1; layer <= kMaxKeyLayers; ++layer) {
+		for (int key = 0; key < 0xFF; ++key) {
+			if (t.layerButtons[layer][key] == 0)
+				t.layerButtons[layer][key] = t.layerButtons[0][key];
+		}
+	}
+
+	// Chord keys get their state bits in order of first appearance
+	int chordKeyCount = 0;
+	for (auto& chord : gamepad.chords) {
+		if (chord.keys.empty() || chord.buttons == 0)
+			continue;
+
+		int newKeys = 0;
+		for (KeyCode key : chord.keys)
+			newKeys += t.chordBits[key] == 0;
+		if (chordKeyCount + newKeys > kMaxChordKeys) {
+			LOG_DEBUG("Chord skipped, a gamepad's chords can use at most {} distinct keys", kMaxChordKeys);
+			continue;
+		}
+
+		BYTE chordMask = 0;
+		for (KeyCode key : chord.keys) {
+			if (t.chordBits[key] == 0)
+				t.chordBits[key] = static_cast<BYTE>(1 << chordKeyCount++);
+			chordMask |= t.chordBits[key];
+			Mark(key);
+		}
+		// Every state that holds all of the chord's keys completes it
+		for (unsigned state = 0; state < std::size(t.chordButtons); ++state) {
+			if ((state & chordMask) == chordMask)
+				t.chordButtons[state] |= chord.buttons;
+		}
+	}
+}
+
+bool TranslateKeymapKey(const KeymapTables& t, KeymapState& state, KeyCode key, bool pressed, USHORT& wButtons) noexcept {
+	bool consumed = false;
+
+	if (BYTE bit = t.layerBits[key]) {
+		state.heldLayers = pressed ? state.heldLayers | bit : state.heldLayers & ~bit;
+		consumed = true;
+	}
+
+	if (BYTE bit = t.chordBits[key]) {
+		state.chordKeys = pressed ? state.chordKeys | bit : state.chordKeys & ~bit;
+		USHORT chordButtons = t.chordButtons[state.chordKeys];
+		ReleaseButtons(state, state.chordButtons & ~chordButtons, wButtons);
+		PressButtons(state, chordButtons & ~state.chordButtons, wButtons);
+		state.chordButtons = chordButtons;
+	}
+
+	if (pressed) {
+		// Typematic repeat of a key that already pressed its buttons
+		if (state.keyButtons[key] != 0) {
+			consumed = true;
+		}
+		else if (USHORT buttons = t.layerButtons[std::bit_width(state.heldLayers)][key]) {
+			state.keyButtons[key] = buttons;
+			PressButtons(state, buttons, wButtons);
+			consumed = true;
+		}
+	}
+	else if (USHORT buttons = std::exchange(state.keyButtons[key], 0)) {
+		ReleaseButtons(state, buttons, wButtons);
+		consumed = true;
+	}
+
+	return consumed;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "keycode.hpp"
+#include "modelconfig.hpp"
+
+#include <cstdint>
+
+constexpr int kMaxKeyLayers = 4;
+// Distinct keys across all chords of a gamepad, KeymapTables::chordButtons has 2^N entries
+constexpr int kMaxChordKeys = 8;
+
+// Layers, chords and multi-button keys of one gamepad, flattened so that a key event costs a few table lookups
+// Built by CompileKeymap() off the main thread, read-only afterwards.
+struct KeymapTables {
+	// Bit the key sets in KeymapState::heldLayers while held, 0 if it isn't a layer key
+	// Layer N is bit N-1, so the active layer is std::bit_width(heldLayers).
+	BYTE layerBits[0xFF] = {};
+	// Bit the key sets in KeymapState::chordKeys while held, 0 if it takes part in no chord
+	BYTE chordBits[0xFF] = {};
+	// XUSB_GAMEPAD_* bits the key presses on each layer, 0 for its plain binding; [0] is the base layer
+	// Keys a layer leaves out have the base layer's entry copied in.
+	USHORT layerButtons[kMaxKeyLayers + 1][0xFF] = {};
+	// KeymapState::chordKeys -> XUSB_GAMEPAD_* bits of every chord it completes
+	USHORT chordButtons[1 << kMaxChordKeys] = {};
+	// Bit set of the keys that appear in any of the above, which must skip the plain binding fast path
+	uint64_t keys[4] = {};
+
+	bool HasKey(KeyCode key) const noexcept { return (keys[key >> 6] >> (key & 63)) & 1; }
+};
+
+// Per gamepad runtime state of the keymap
+// Buttons are reference counted, so that e.g. a chord and a layer key pressing the same button don't release each other's.
+// A plain binding of the same button isn't counted and still releases it.
+struct KeymapState {
+	BYTE heldLayers = 0;
+	BYTE chordKeys = 0;
+	// XUSB_GAMEPAD_* bits pressed by completed chords
+	USHORT chordButtons = 0;
+	uint8_t buttonRefs[16] = {};
+	// XUSB_GAMEPAD_* bits each key pressed, released with it even if the active layer changed in between
+	USHORT keyButtons[0xFF] = {};
+
+	// Release everything held through the keymap, e.g. before its tables are replaced
+	void Reset(USHORT& wButtons) noexcept;
+};
+
+bool HasKeymap(const ConfigGamepad& gamepad) noexcept;
+void CompileKeymap(const ConfigGamepad& gamepad, KeymapTables& out) noexcept;
+
+// Apply a key event to wButtons (XUSB_REPORT::wButtons)
+// \return true if the keymap consumed the key, false if its plain binding should apply as well
+bool TranslateKeymapKey(const KeymapTables& tables, KeymapState& state, KeyCode key, bool pressed, USHORT& wButtons) noexcept;
@@ -0,0 +1,108 @@
+#include "pch.hpp"
+
+#include "keysuppress.hpp"
+
+#include "utils.hpp"
+#include "../WndMsgFilter/suppressmask.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+using InstallKeySuppressHookFn = HHOOK(*)();
+
+KeySuppressor::KeySuppressor(KeyboardInputMode mode) {
+	try {
+		hMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(SuppressMaskTable), kSuppressMaskMappingName);
+		if (!hMapping)
+			throw std::runtime_error(std::format("Error creating key suppression mapping: {}", GetLastErrorStrUtf8()));
+		table = static_cast<SuppressMaskTable*>(MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SuppressMaskTable)));
+		if (!table)
+			throw std::runtime_error(std::format("Error mapping key suppression table: {}", GetLastErrorStrUtf8()));
+
+		// New mappings are zero filled, which is an empty table; one left over from a crashed instance is emptied by Publish()
+		table->magic.store(0, std::memory_order_relaxed);
+		table->mode = std::to_underlying(mode == KeyboardInputMode::ScanCode ? SuppressKeyMode::ScanCode : SuppressKeyMode::VirtualKey);
+		table->feederProcessId = GetCurrentProcessId();
+		for (int slot = 0; slot < kSuppressScanCodeSlotCount; ++slot) {
+			USHORT flags = (slot & 0x80 ? RI_KEY_E1 : 0) | (slot & 0x100 ? RI_KEY_E0 : 0);
+			table->scanCodeKeys[slot] = KeyCodeFromScanCode(slot & 0x7F, flags);
+		}
+		Publish({});
+		table->magic.store(kSuppressMaskMagic, std::memory_order_release);
+
+		// The hook DLL maps the table when it gets loaded into a process, so it must be ready by now
+		hFilterDll = LoadLibraryW(L"WndMsgFilter.dll");
+		if (!hFilterDll)
+			throw std::runtime_error(std::format("Error loading WndMsgFilter.dll: {}", GetLastErrorStrUtf8()));
+		auto install = reinterpret_cast<InstallKeySuppressHookFn>(GetProcAddress(hFilterDll, "InstallKeySuppressHook"));
+		if (!install)
+			throw std::runtime_error("WndMsgFilter.dll has no InstallKeySuppressHook");
+		hHook = install();
+		if (!hHook)
+			throw std::runtime_error("Error installing key suppression hook");
+	}
+	catch (...) {
+		Release();
+		throw;
+	}
+}
+
+KeySuppressor::~KeySuppressor() {
+	Release();
+}
+
+void KeySuppressor::Release() noexcept {
+	// Hooked processes keep their view of the table until the DLL gets unloaded from them, so leave it empty
+	if (table) {
+		Publish({});
+		table->magic.store(0, std::memory_order_release);
+	}
+
+	if (hHook)
+		UnhookWindowsHookEx(std::exchange(hHook, nullptr));
+	if (hFilterDll)
+		FreeLibrary(std::exchange(hFilterDll, nullptr));
+	if (table)
+		UnmapViewOfFile(std::exchange(table, nullptr));
+	if (hMapping)
+		CloseHandle(std::exchange(hMapping, nullptr));
+}
+
+void KeySuppressor::Publish(std::span<const KeySuppressDevice> devices) noexcept {
+	constexpr uint64_t kNoKeys[4] = {};
+
+	auto ToHandleValue = [](HANDLE h) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(h)); };
+	auto IsPublished = [&](uint64_t h) {
+		return std::ranges::any_of(devices, [&](const KeySuppressDevice& dev) { return ToHandleValue(dev.hDevice) == h; });
+	};
+
+	// Free the entries of devices that are gone first, so that their slots can be reused below
+	for (auto& entry : table->devices) {
+		uint64_t h = entry.hDevice.load(std::memory_order_relaxed);
+		if (h != 0 && !IsPublished(h))
+			WriteSuppressDeviceEntry(entry, 0, kNoKeys);
+	}
+
+	for (const auto& dev : devices) {
+		uint64_t h = ToHandleValue(dev.hDevice);
+		SuppressDeviceEntry* target = nullptr;
+		for (auto& entry : table->devices) {
+			uint64_t entryH = entry.hDevice.load(std::memory_order_relaxed);
+			if (entryH == h) {
+				target = &entry;
+				break;
+			}
+			if (entryH == 0 && !target)
+				target = &entry;
+		}
+
+		if (!target) {
+			LOG_DEBUG_STATIC(L"Too many keyboards to suppress keys of, ignoring the rest");
+			break;
+		}
+		WriteSuppressDeviceEntry(*target, h, dev.keys);
+	}
+
+	UpdateSuppressAnyDevice(*table);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "enginehost.hpp"
+#include "modelconfig.hpp"
+
+#include <cstdint>
+#include <span>
+
+struct SuppressMaskTable;
+
+// Hides the keys bound to gamepads from other applications, through the WndMsgFilter hook DLL
+// The keys are published in shared memory, which the hook reads without locking, see suppressmask.hpp.
+class KeySuppressor {
+private:
+	HANDLE hMapping = nullptr;
+	SuppressMaskTable* table = nullptr;
+	HMODULE hFilterDll = nullptr;
+	HHOOK hHook = nullptr;
+
+	void Release() noexcept;
+
+public:
+	// Throws std::runtime_error if the shared memory or the hook can't be set up
+	explicit KeySuppressor(KeyboardInputMode mode);
+	~KeySuppressor();
+
+	KeySuppressor(const KeySuppressor&) = delete;
+	KeySuppressor& operator=(const KeySuppressor&) = delete;
+
+	// Replaces everything published before, keys of devices not in the list are no longer hidden
+	void Publish(std::span<const KeySuppressDevice> devices) noexcept;
+};
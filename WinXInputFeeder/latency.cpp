@@ -0,0 +1,109 @@
+#include "pch.hpp"
+
+#include "latency.hpp"
+
+#include "utils.hpp"
+
+#include <bit>
+#include <format>
+
+int LatencyHistogram::BucketIndexOf(uint32_t value) noexcept {
+	if (value < kSubBucketCount)
+		return static_cast<int>(value);
+
+	// Exponent of the power of two range, relative to the first range that needs sub-bucketing
+	int exp = std::bit_width(value) - 1 - kSubBucketBits;
+	// In range [0, kSubBucketCount)
+	int mantissa = static_cast<int>(value >> exp) - kSubBucketCount;
+	return kSubBucketCount + exp * kSubBucketCount + mantissa;
+}
+
+uint32_t LatencyHistogram::BucketHighestValue(int idx) noexcept {
+	if (idx < kSubBucketCount)
+		return static_cast<uint32_t>(idx);
+
+	int exp = (idx - kSubBucketCount) / kSubBucketCount;
+	int mantissa = (idx - kSubBucketCount) % kSubBucketCount;
+	uint64_t nextLowest = static_cast<uint64_t>(kSubBucketCount + mantissa + 1) << exp;
+	return static_cast<uint32_t>(nextLowest - 1);
+}
+
+void LatencyHistogram::Record(uint32_t micros) noexcept {
+	counts[BucketIndexOf(micros)].fetch_add(1, std::memory_order_relaxed);
+	totalCount.fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t prevMax = maxValue.load(std::memory_order_relaxed);
+	while (prevMax < micros && !maxValue.compare_exchange_weak(prevMax, micros, std::memory_order_relaxed))
+		;
+}
+
+void LatencyHistogram::Reset() noexcept {
+	for (auto& c : counts)
+		c.store(0, std::memory_order_relaxed);
+	totalCount.store(0, std::memory_order_relaxed);
+	maxValue.store(0, std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::GetPercentile(double percentile) const noexcept {
+	uint64_t total = GetCount();
+	if (total == 0)
+		return 0;
+
+	// Nearest-rank method, with the rank counted from 1
+	auto rank = static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(total)));
+	rank = std::max<uint64_t>(rank, 1);
+
+	uint64_t seen = 0;
+	for (int i = 0; i < kBucketCount; ++i) {
+		seen += counts[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+			return std::min(BucketHighestValue(i), GetMax());
+	}
+	// Only reachable if Record() raced with us, the max is the best answer we have
+	return GetMax();
+}
+
+void LatencyHistogram::Dump(std::ostream& out, std::string_view label) const {
+	out << std::format("{}: n={} p50={}us p90={}us p99={}us p99.9={}us max={}us\n",
+		label, GetCount(), GetPercentile(50.0), GetPercentile(90.0), GetPercentile(99.0), GetPercentile(99.9), GetMax());
+}
+
+void GamepadLatency::Record(const InputTimestamp& ts, int64_t qpcNow) noexcept {
+	if (!ts.IsValid())
+		return;
+
+	auto micros = static_cast<uint32_t>(std::min<int64_t>((qpcNow - ts.qpcReceived) * 1'000'000 / QpcFrequency(), UINT32_MAX));
+	processing.Record(micros);
+
+	uint64_t queueMicros = static_cast<uint64_t>(ts.GetQueueDelayMs()) * 1000;
+	endToEnd.Record(static_cast<uint32_t>(std::min<uint64_t>(micros + queueMicros, UINT32_MAX)));
+}
+
+void GamepadLatency::Reset() noexcept {
+	processing.Reset();
+	endToEnd.Reset();
+}
+
+void UILatency::Record(int64_t qpcFrameBegin, int64_t qpcPresentBegin, int64_t qpcFrameEnd, bool inputArrived) noexcept {
+	auto toMicros = [](int64_t qpcDelta) {
+		return static_cast<uint32_t>(std::min<int64_t>(qpcDelta * 1'000'000 / QpcFrequency(), UINT32_MAX));
+	};
+
+	uint32_t frameMicros = toMicros(qpcFrameEnd - qpcFrameBegin);
+	frameTime.Record(frameMicros);
+	present.Record(toMicros(qpcFrameEnd - qpcPresentBegin));
+	if (inputArrived)
+		inputDelay.Record(frameMicros);
+}
+
+void UILatency::Reset() noexcept {
+	frameTime.Reset();
+	present.Reset();
+	inputDelay.Reset();
+}
+
+void UILatency::Dump(std::ostream& out) const {
+	frameTime.Dump(out, "UI frame time");
+	present.Dump(out, "UI present");
+	inputDelay.Dump(out, "UI input delay");
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+#include "platform.hpp"
+
+// Timestamps attached to an input event, carried from WM_INPUT receipt until the resulting gamepad report is submitted
+struct InputTimestamp {
+	// QueryPerformanceCounter() at WM_INPUT receipt
+	int64_t qpcReceived = 0;
+	// GetMessageTime() of the WM_INPUT message, i.e. when the OS posted it, in GetTickCount() milliseconds
+	DWORD msgTime = 0;
+	// GetTickCount() at WM_INPUT receipt, so that (tickReceived - msgTime) is the time spent in our message queue
+	DWORD tickReceived = 0;
+
+	bool IsValid() const noexcept { return qpcReceived != 0; }
+	DWORD GetQueueDelayMs() const noexcept { return tickReceived - msgTime; }
+};
+
+// HDR-style log-linear histogram of microsecond values
+// Every power of two range is split into kSubBucketCount linear buckets, giving ~3% relative precision across the whole uint32_t range.
+// Record() is lock-free and allocation-free, so it is safe to call in the input path while the UI thread reads the stats.
+class LatencyHistogram {
+public:
+	static constexpr int kSubBucketBits = 5;
+	static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+	static constexpr int kBucketCount = (32 - kSubBucketBits + 1) * kSubBucketCount;
+
+private:
+	std::atomic<uint32_t> counts[kBucketCount] = {};
+	std::atomic<uint64_t> totalCount = 0;
+	std::atomic<uint32_t> maxValue = 0;
+
+public:
+	void Record(uint32_t micros) noexcept;
+	void Reset() noexcept;
+
+	uint64_t GetCount() const noexcept { return totalCount.load(std::memory_order_relaxed); }
+	uint32_t GetMax() const noexcept { return maxValue.load(std::memory_order_relaxed); }
+	// \param percentile percentile ∈ [0,100]
+	// \return the highest value equivalent to the bucket containing the given percentile, or 0 if nothing was recorded
+	uint32_t GetPercentile(double percentile) const noexcept;
+
+	void Dump(std::ostream& out, std::string_view label) const;
+
+	static int BucketIndexOf(uint32_t value) noexcept;
+	static uint32_t BucketHighestValue(int idx) noexcept;
+};
+
+// Latency measurements for a single gamepad
+struct GamepadLatency {
+	// From WM_INPUT receipt to SendReport() returning
+	LatencyHistogram processing;
+	// Same as above, plus the time the WM_INPUT message spent in the message queue (millisecond precision)
+	LatencyHistogram endToEnd;
+
+	void Record(const InputTimestamp& ts, int64_t qpcNow) noexcept;
+	void Reset() noexcept;
+};
+
+// Latency measurements for the config UI, which renders on the same thread that handles input
+struct UILatency {
+	// From the start of a frame to Present() returning, during which no input is processed
+	LatencyHistogram frameTime;
+	// Time spent in Present() alone, i.e. blocked on the GPU or vblank
+	LatencyHistogram present;
+	// Frame time of frames during which input arrived, an upper bound of the delay rendering added to that input
+	LatencyHistogram inputDelay;
+
+	void Record(int64_t qpcFrameBegin, int64_t qpcPresentBegin, int64_t qpcFrameEnd, bool inputArrived) noexcept;
+	void Reset() noexcept;
+	void Dump(std::ostream& out) const;
+};
@@ -1,6 +1,5 @@
 #include "pch.hpp"
 
-#include "inputdevice.hpp"
 #include "utils.hpp"
 
 #include <memory>
@@ -11,8 +10,6 @@
 int AppMain(HINSTANCE hInstance, std::span<const std::wstring_view> args);
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow) {
-	InitKeyCodeConv();
-
 	int argCount;
 	PWSTR* argList = CommandLineToArgvW(pCmdLine, &argCount);
 	
@@ -2,18 +2,19 @@
 
 #include "modelconfig.hpp"
 
-#include "modelruntime.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <format>
 #include <fstream>
 
 using namespace std::literals;
 
 X360Button X360ButtonFromViGEm(XUSB_BUTTON btn) noexcept {
-	unsigned long idx;
-	unsigned char res = _BitScanForward(&idx, btn);
-	return res == 0 ? static_cast<X360Button>(idx) : X360Button::None;
+	return btn != 0 ? static_cast<X360Button>(std::countr_zero(static_cast<unsigned>(btn))) : X360Button::None;
 }
 
 XUSB_BUTTON X360ButtonToViGEm(X360Button btn) noexcept {
@@ -51,42 +52,268 @@ std::string_view X360ButtonToString(X360Button btn) noexcept {
 	return kX360ButtonStrings[std::to_underlying(btn)];
 }
 
+std::optional<X360Button> X360ButtonFromString(std::string_view str) noexcept {
+	auto iter = std::ranges::find(kX360ButtonStrings, str);
+	if (iter == std::end(kX360ButtonStrings))
+		return {};
+	return static_cast<X360Button>(iter - std::begin(kX360ButtonStrings));
+}
+
 ConfigGamepad::ConfigGamepad() {
 	memset(buttons, 0xFF, kX360ButtonCount * sizeof(KeyCode));
 }
 
 std::pair<ConfigGamepad&, size_t> ConfigProfile::AddX360() {
-	if (x360Count >= 4) {
+	if (x360Count >= kMaxX360Count || gamepads.size() >= kMaxX360Count) {
 		// Return a dummy reference, the SIZE_MAX should already indicate failure
 		return { gamepads.front(), SIZE_MAX };
 	}
 
 	gamepads.insert(gamepads.begin() + x360Count, ConfigGamepad());
 	size_t idx = x360Count++;
+	// Routes to the DS4 gamepads follow them to their new ids
+	for (auto& route : routes) {
+		BYTE below = route.pads & ((1 << idx) - 1);
+		route.pads = static_cast<BYTE>(below | (route.pads & ~below) << 1);
+	}
 	return { gamepads[idx], idx };
 }
 
 std::pair<ConfigGamepad&, size_t> ConfigProfile::AddDS4() {
-	// TODO
-	return { gamepads.front(), 0 };
+	// DS4 targets share the gamepad slots with X360 ones
+	if (gamepads.size() >= kMaxX360Count) {
+		// Return a dummy reference, the SIZE_MAX should already indicate failure
+		return { gamepads.front(), SIZE_MAX };
+	}
+
+	size_t idx = gamepads.size();
+	gamepads.push_back(ConfigGamepad());
+	return { gamepads[idx], idx };
 }
 
 void ConfigProfile::RemoveGamepad(size_t idx) {
 	gamepads.erase(gamepads.begin() + idx);
 	if (idx < x360Count)
 		--x360Count;
+	for (auto& route : routes) {
+		BYTE below = route.pads & ((1 << idx) - 1);
+		route.pads = static_cast<BYTE>(below | (route.pads >> 1 & ~((1 << idx) - 1)));
+	}
+}
+
+
+static std::string_view SocdModeToString(SocdMode mode) {
+	switch (mode) {
+	case SocdMode::Neutral: return "neutral"sv;
+	case SocdMode::LastInput: return "last"sv;
+	case SocdMode::FirstInput: return "first"sv;
+	case SocdMode::Absolute: return "absolute"sv;
+	default: return "off"sv;
+	}
+}
+
+static SocdMode ReadSocdMode(toml::node_view<const toml::node> v) {
+	if (v == "neutral")
+		return SocdMode::Neutral;
+	else if (v == "last")
+		return SocdMode::LastInput;
+	else if (v == "first")
+		return SocdMode::FirstInput;
+	else if (v == "absolute")
+		return SocdMode::Absolute;
+	else
+		return SocdMode::Off;
+}
+
+static toml::table WriteRamp(const ConfigRamp& ramp) {
+	toml::table res;
+	res.emplace("Attack", ramp.attackTime);
+	res.emplace("Release", ramp.releaseTime);
+	switch (ramp.curve) {
+	case RampCurve::Linear: res.emplace("Curve", "linear"s); break;
+	case RampCurve::EaseIn: res.emplace("Curve", "easein"s); break;
+	case RampCurve::EaseOut: res.emplace("Curve", "easeout"s); break;
+	case RampCurve::Smooth: res.emplace("Curve", "smooth"s); break;
+	}
+	return res;
+}
+
+static void ReadRamp(toml::node_view<const toml::node> t, ConfigRamp& ramp) {
+	ramp.attackTime = std::max(t["Attack"].value_or<float>(0.0f), 0.0f);
+	ramp.releaseTime = std::max(t["Release"].value_or<float>(0.0f), 0.0f);
+	if (const auto& v = t["Curve"];
+		v == "linear")
+		ramp.curve = RampCurve::Linear;
+	else if (v == "easein")
+		ramp.curve = RampCurve::EaseIn;
+	else if (v == "easeout")
+		ramp.curve = RampCurve::EaseOut;
+	else if (v == "smooth")
+		ramp.curve = RampCurve::Smooth;
+}
+
+static toml::table WriteDS4(const ConfigDS4& ds4) {
+	toml::table res;
+	switch (ds4.mouseMode) {
+	case DS4MouseMode::None: res.emplace("Mouse", "none"s); break;
+	case DS4MouseMode::Touchpad: res.emplace("Mouse", "touchpad"s); break;
+	case DS4MouseMode::Gyro: res.emplace("Mouse", "gyro"s); break;
+	}
+	res.emplace("TouchSensitivity", ds4.touchSensitivity);
+	res.emplace("GyroSensitivity", ds4.gyroSensitivity);
+	return res;
+}
+
+static void ReadDS4(toml::node_view<const toml::node> t, ConfigDS4& ds4) {
+	if (const auto& v = t["Mouse"];
+		v == "touchpad")
+		ds4.mouseMode = DS4MouseMode::Touchpad;
+	else if (v == "gyro")
+		ds4.mouseMode = DS4MouseMode::Gyro;
+	else
+		ds4.mouseMode = DS4MouseMode::None;
+	ds4.touchSensitivity = t["TouchSensitivity"].value_or<float>(1.0f);
+	ds4.gyroSensitivity = t["GyroSensitivity"].value_or<float>(0.1f);
+}
+
+static toml::array WriteRouteButtons(uint32_t buttons) {
+	toml::array res;
+	for (unsigned char i = 0; i < kX360ButtonCount; ++i) {
+		if (buttons & (uint32_t(1) << i))
+			res.push_back(X360ButtonToString(static_cast<X360Button>(i)));
+	}
+	return res;
+}
+
+static uint32_t ReadRouteButtons(const toml::array* fButtons) {
+	if (!fButtons)
+		return kAllRouteButtons;
+	uint32_t res = 0;
+	for (auto& fBtn : *fButtons) {
+		auto str = fBtn.value<std::string_view>();
+		if (auto btn = str ? X360ButtonFromString(*str) : std::nullopt; btn && IsX360ButtonValid(*btn))
+			res |= uint32_t(1) << std::to_underlying(*btn);
+	}
+	return res;
 }
 
 static void WriteJoystick(toml::table& profile, const ConfigJoystick& js) {
 	profile.emplace("Type", js.useMouse ? "mouse"s : "keyboard"s);
 	profile.emplace("Speed", js.speed);
+	profile.emplace("Socd", SocdModeToString(js.socd));
+	profile.emplace("Ramp", WriteRamp(js.ramp));
 	profile.emplace("Sensitivity", js.sensitivity);
 	profile.emplace("NonLinearSensitivity", js.nonLinear);
 	profile.emplace("Deadzone", js.deadzone);
+	profile.emplace("OuterRadius", js.outerRadius);
 	profile.emplace("InvertXAxis", js.invertXAxis);
 	profile.emplace("InvertYAxis", js.invertYAxis);
 }
 
+static std::optional<X360Button> ReadDirectMapButton(std::optional<std::string_view> str) {
+	auto btn = str ? X360ButtonFromString(*str) : std::nullopt;
+	if (btn && IsX360ButtonDirectMap(*btn))
+		return btn;
+	return {};
+}
+
+// XUSB_GAMEPAD_* bits <-> array of direct map button names
+static toml::array WriteButtonMask(USHORT buttons) {
+	toml::array res;
+	for (unsigned char i = 0; i < kX360ButtonDirectMapCount; ++i) {
+		if (buttons & (1 << i))
+			res.push_back(X360ButtonToString(static_cast<X360Button>(i)));
+	}
+	return res;
+}
+
+static USHORT ReadButtonMask(const toml::array* fButtons) {
+	USHORT res = 0;
+	if (fButtons) for (auto& fBtn : *fButtons) {
+		if (auto btn = ReadDirectMapButton(fBtn.value<std::string_view>()))
+			res |= X360ButtonToViGEm(*btn);
+	}
+	return res;
+}
+
+// Key -> XUSB_GAMEPAD_* bits, as a table of key names to arrays of button names
+static toml::table WriteKeyButtons(const std::map<KeyCode, USHORT>& keyButtons) {
+	toml::table res;
+	for (auto&& [key, buttons] : keyButtons)
+		res.emplace(KeyCodeToString(key), WriteButtonMask(buttons));
+	return res;
+}
+
+static void ReadKeyButtons(const toml::table* fKeys, std::map<KeyCode, USHORT>& keyButtons) {
+	if (fKeys) for (auto&& [fKey, val] : *fKeys) {
+		auto key = KeyCodeFromString(fKey.str());
+		USHORT buttons = ReadButtonMask(val.as_array());
+		if (key && buttons != 0)
+			keyButtons.insert_or_assign(*key, buttons);
+	}
+}
+
+// Only the fields of the action's kind are written
+static void WriteButtonAction(toml::table& actions, X360Button btn, const ConfigButtonAction& action) {
+	toml::table res;
+	switch (action.kind) {
+	case ButtonActionKind::Press:
+		return;
+	case ButtonActionKind::Turbo:
+		res.emplace("Type", "turbo"s);
+		res.emplace("Rate", action.turboRate);
+		break;
+	case ButtonActionKind::TapHold:
+		res.emplace("Type", "taphold"s);
+		if (action.holdButton != X360Button::None)
+			res.emplace("Hold", X360ButtonToString(action.holdButton));
+		res.emplace("HoldTime", action.holdTime);
+		res.emplace("TapTime", action.tapTime);
+		break;
+	case ButtonActionKind::Sequence: {
+		res.emplace("Type", "sequence"s);
+		toml::array steps;
+		for (const auto& step : action.steps) {
+			toml::table fStep;
+			fStep.emplace("Buttons", WriteButtonMask(step.buttons));
+			fStep.emplace("Time", step.duration);
+			steps.push_back(std::move(fStep));
+		}
+		res.emplace("Steps", std::move(steps));
+	} break;
+	}
+	actions.emplace(X360ButtonToString(btn), std::move(res));
+}
+
+static void ReadButtonAction(toml::node_view<const toml::node> t, ConfigButtonAction& action) {
+	if (const auto& v = t["Type"];
+		v == "press")
+		action.kind = ButtonActionKind::Press;
+	else if (v == "turbo")
+		action.kind = ButtonActionKind::Turbo;
+	else if (v == "taphold")
+		action.kind = ButtonActionKind::TapHold;
+	else if (v == "sequence")
+		action.kind = ButtonActionKind::Sequence;
+
+	action.turboRate = std::clamp(t["Rate"].value_or<float>(10.0f), 0.5f, 1000.0f);
+	action.holdButton = ReadDirectMapButton(t["Hold"].value<std::string_view>()).value_or(X360Button::None);
+	action.holdTime = std::max(t["HoldTime"].value_or<float>(200.0f), 0.0f);
+	action.tapTime = std::max(t["TapTime"].value_or<float>(50.0f), 0.0f);
+
+	auto fSteps = t["Steps"].as_array();
+	if (fSteps) for (auto& val : *fSteps) {
+		auto e1 = val.as_table();
+		if (!e1) continue;
+		auto& fStep = *e1;
+
+		ConfigSequenceStep step;
+		step.buttons = ReadButtonMask(fStep["Buttons"].as_array());
+		step.duration = std::max(fStep["Time"].value_or<float>(50.0f), 0.0f);
+		action.steps.push_back(step);
+	}
+}
+
 static KeyCode ReadKeyCode(toml::node_view<const toml::node> t) {
 	auto str = t.value<std::string_view>();
 	if (str)
@@ -103,9 +330,12 @@ static void ReadJoystick(toml::node_view<const toml::node> t, ConfigJoystick& js
 		js.useMouse = true;
 
 	js.speed = std::clamp(t["Speed"].value_or<float>(1.0f), 0.0f, 1.0f);
+	js.socd = ReadSocdMode(t["Socd"]);
+	ReadRamp(t["Ramp"], js.ramp);
 	js.sensitivity = t["Sensitivity"].value_or<float>(50.0f);
 	js.nonLinear = t["NonLinearSensitivity"].value_or<float>(0.8f);
 	js.deadzone = t["Deadzone"].value_or<float>(0.02f);
+	js.outerRadius = std::max(t["OuterRadius"].value_or<float>(10.0f), 1.0f);
 	js.invertXAxis = t["InvertXAxis"].value_or<bool>(false);
 	js.invertYAxis = t["InvertYAxis"].value_or<bool>(false);
 }
@@ -115,10 +345,42 @@ Config::Config() {}
 Config::Config(const toml::table& fConfig) {
 	auto fGeneral = fConfig["General"];
 	this->mouseCheckFrequency = fGeneral["MouseCheckFrequency"].value_or<int>(75);
+	if (const auto& v = fGeneral["MouseFilter"];
+		v == "ema")
+		this->mouseFilter.kind = MouseFilterKind::Ema;
+	else if (v == "oneeuro")
+		this->mouseFilter.kind = MouseFilterKind::OneEuro;
+	this->mouseFilter.timeConstant = std::max(fGeneral["MouseFilterTimeConstant"].value_or<float>(75.0f), 1.0f);
+	this->mouseFilter.minCutoff = std::max(fGeneral["MouseFilterMinCutoff"].value_or<float>(2.0f), 0.01f);
+	this->mouseFilter.beta = std::max(fGeneral["MouseFilterBeta"].value_or<float>(0.005f), 0.0f);
+	if (const auto& v = fGeneral["KeyboardInput"];
+		v == "vkey")
+		this->keyboardInputMode = KeyboardInputMode::VirtualKey;
+	else if (v == "scancode")
+		this->keyboardInputMode = KeyboardInputMode::ScanCode;
+	this->suppressBoundKeys = fGeneral["SuppressBoundKeys"].value_or<bool>(false);
 
 	auto fHotkey = fConfig["HotKeys"];
 	this->hotkeyShowUI = ReadKeyCode(fHotkey["ShowUI"]);
 	this->hotkeyCaptureCursor = ReadKeyCode(fHotkey["CaptureCursor"]);
+	this->hotkeyToggleTrace = ReadKeyCode(fHotkey["ToggleTrace"]);
+
+	// Keys are "VVVV:PPPP" in hex
+	auto fCalibrations = fConfig["MouseCalibrations"].as_table();
+	if (fCalibrations) for (auto&& [key, val] : *fCalibrations) {
+		auto e1 = val.as_table();
+		if (!e1) continue;
+		auto& fCalib = *e1;
+
+		unsigned vid, pid;
+		if (std::sscanf(std::string(key.str()).c_str(), "%4x:%4x", &vid, &pid) != 2)
+			continue;
+
+		ConfigMouseCalibration calib;
+		calib.dpi = std::max(fCalib["Dpi"].value_or<float>(kReferenceMouseDpi), 1.0f);
+		calib.pollingRate = fCalib["PollingRate"].value_or<float>(0.0f);
+		this->mouseCalibrations.insert_or_assign((vid << 16) | pid, calib);
+	}
 
 	auto fProfiles = fConfig["Profiles"].as_table();
 	if (fProfiles) for (auto&& [key, val] : *fProfiles) {
@@ -142,12 +404,73 @@ Config::Config(const toml::table& fConfig) {
 			for (unsigned char i = 0; i < kX360ButtonCount; ++i) {
 				gamepad.buttons[i] = ReadKeyCode(fGamepad[X360ButtonToString(static_cast<X360Button>(i))]);
 			}
+			for (unsigned char i = 0; i < kX360ButtonDirectMapCount; ++i) {
+				ReadButtonAction(fGamepad["Actions"][X360ButtonToString(static_cast<X360Button>(i))], gamepad.actions[i]);
+			}
+			ReadKeyButtons(fGamepad["MultiKeys"].as_table(), gamepad.multiKeys);
+			if (auto fLayers = fGamepad["Layers"].as_array(); fLayers) for (auto& val : *fLayers) {
+				auto e1 = val.as_table();
+				if (!e1) continue;
+				auto& fLayer = *e1;
+
+				ConfigKeyLayer layer;
+				layer.key = ReadKeyCode(fLayer["Key"]);
+				ReadKeyButtons(fLayer["Buttons"].as_table(), layer.buttons);
+				gamepad.layers.push_back(std::move(layer));
+			}
+			if (auto fChords = fGamepad["Chords"].as_array(); fChords) for (auto& val : *fChords) {
+				auto e1 = val.as_table();
+				if (!e1) continue;
+				auto& fChord = *e1;
+
+				ConfigChord chord;
+				if (auto fKeys = fChord["Keys"].as_array(); fKeys) for (auto& fKey : *fKeys) {
+					auto str = fKey.value<std::string_view>();
+					if (auto key = str ? KeyCodeFromString(*str) : std::nullopt)
+						chord.keys.push_back(*key);
+				}
+				chord.buttons = ReadButtonMask(fChord["Buttons"].as_array());
+				gamepad.chords.push_back(std::move(chord));
+			}
+			gamepad.dpadSocd = ReadSocdMode(fGamepad["DPadSocd"]);
+			ReadRamp(fGamepad["LeftTriggerRamp"], gamepad.leftTriggerRamp);
+			ReadRamp(fGamepad["RightTriggerRamp"], gamepad.rightTriggerRamp);
 			ReadJoystick(fGamepad["LStick"], gamepad.lstick);
 			ReadJoystick(fGamepad["RStick"], gamepad.rstick);
+			ReadDS4(fGamepad["DS4"], gamepad.ds4);
 
 			profile.gamepads.push_back(std::move(gamepad));
 		}
 
+		if (auto fRoutes = fProfile["Routes"].as_array(); fRoutes) for (auto& val : *fRoutes) {
+			auto e1 = val.as_table();
+			if (!e1) continue;
+			auto& fRoute = *e1;
+
+			ConfigRoute route;
+			route.device = fRoute["Device"].value_or(""s);
+			if (route.device.empty()) continue;
+			route.kind = fRoute["Kind"] == "mouse" ? IdevKind::Mouse : IdevKind::Keyboard;
+			unsigned vid, pid;
+			if (auto fVidPid = fRoute["VidPid"].value<std::string_view>();
+				fVidPid && std::sscanf(std::string(*fVidPid).c_str(), "%4x:%4x", &vid, &pid) == 2)
+				route.vidPid = vid << 16 | pid;
+			route.ordinal = static_cast<uint8_t>(fRoute["Ordinal"].value_or(int64_t(0)));
+			if (auto fPads = fRoute["Pads"].as_array(); fPads) for (auto& fPad : *fPads) {
+				auto pad = fPad.value<int64_t>();
+				if (pad && 0 <= *pad && *pad < kMaxX360Count)
+					route.pads |= 1 << *pad;
+			}
+			route.buttons = ReadRouteButtons(fRoute["Buttons"].as_array());
+			profile.routes.push_back(std::move(route));
+		}
+
+		if (auto fExes = fProfile["Executables"].as_array(); fExes) for (auto& fExe : *fExes) {
+			auto exe = fExe.value<std::string>();
+			if (exe && !exe->empty())
+				profile.executables.push_back(std::move(*exe));
+		}
+
 		this->profiles.try_emplace(std::string(fName), std::move(profile));
 	}
 }
@@ -157,13 +480,29 @@ toml::table Config::ExportAsToml() const {
 
 	toml::table general;
 	general.emplace("MouseCheckFrequency", this->mouseCheckFrequency);
+	general.emplace("MouseFilter", this->mouseFilter.kind == MouseFilterKind::OneEuro ? "oneeuro"s : "ema"s);
+	general.emplace("MouseFilterTimeConstant", this->mouseFilter.timeConstant);
+	general.emplace("MouseFilterMinCutoff", this->mouseFilter.minCutoff);
+	general.emplace("MouseFilterBeta", this->mouseFilter.beta);
+	general.emplace("KeyboardInput", this->keyboardInputMode == KeyboardInputMode::ScanCode ? "scancode"s : "vkey"s);
+	general.emplace("SuppressBoundKeys", this->suppressBoundKeys);
 	res.emplace("General", std::move(general));
 
 	toml::table hotkeys;
 	hotkeys.emplace("ShowUI", KeyCodeToString(this->hotkeyShowUI));
 	hotkeys.emplace("CaptureCursor", KeyCodeToString(this->hotkeyCaptureCursor));
+	hotkeys.emplace("ToggleTrace", KeyCodeToString(this->hotkeyToggleTrace));
 	res.emplace("HotKeys", std::move(hotkeys));
 
+	toml::table calibrations;
+	for (auto&& [vVidPid, vCalib] : this->mouseCalibrations) {
+		toml::table calib;
+		calib.emplace("Dpi", vCalib.dpi);
+		calib.emplace("PollingRate", vCalib.pollingRate);
+		calibrations.emplace(std::format("{:04X}:{:04X}", vVidPid >> 16, vVidPid & 0xFFFF), std::move(calib));
+	}
+	res.emplace("MouseCalibrations", std::move(calibrations));
+
 	toml::table profiles;
 	for (auto&& [vName, vProfile] : this->profiles) {
 		toml::table profile;
@@ -176,22 +515,87 @@ toml::table Config::ExportAsToml() const {
 
 			for (int vBtn = 0; vBtn < kX360ButtonCount; ++vBtn) {
 				KeyCode vKey = vGamepad.buttons[vBtn];
-				if (vBtn != 0xFF)
+				if (vKey != 0xFF)
 					gamepad.emplace(X360ButtonToString(static_cast<X360Button>(vBtn)), KeyCodeToString(vKey));
 			}
 
+			toml::table actions;
+			for (int vBtn = 0; vBtn < kX360ButtonDirectMapCount; ++vBtn)
+				WriteButtonAction(actions, static_cast<X360Button>(vBtn), vGamepad.actions[vBtn]);
+			if (!actions.empty())
+				gamepad.emplace("Actions", std::move(actions));
+
+			if (!vGamepad.multiKeys.empty())
+				gamepad.emplace("MultiKeys", WriteKeyButtons(vGamepad.multiKeys));
+			if (!vGamepad.layers.empty()) {
+				toml::array layers;
+				for (auto& vLayer : vGamepad.layers) {
+					toml::table layer;
+					layer.emplace("Key", KeyCodeToString(vLayer.key));
+					layer.emplace("Buttons", WriteKeyButtons(vLayer.buttons));
+					layers.push_back(std::move(layer));
+				}
+				gamepad.emplace("Layers", std::move(layers));
+			}
+			if (!vGamepad.chords.empty()) {
+				toml::array chords;
+				for (auto& vChord : vGamepad.chords) {
+					toml::array keys;
+					for (KeyCode key : vChord.keys)
+						keys.push_back(KeyCodeToString(key));
+					toml::table chord;
+					chord.emplace("Keys", std::move(keys));
+					chord.emplace("Buttons", WriteButtonMask(vChord.buttons));
+					chords.push_back(std::move(chord));
+				}
+				gamepad.emplace("Chords", std::move(chords));
+			}
+
+			gamepad.emplace("DPadSocd", SocdModeToString(vGamepad.dpadSocd));
+			gamepad.emplace("LeftTriggerRamp", WriteRamp(vGamepad.leftTriggerRamp));
+			gamepad.emplace("RightTriggerRamp", WriteRamp(vGamepad.rightTriggerRamp));
+
 			toml::table lstick;
-			WriteJoystick(gamepad, vGamepad.lstick);
+			WriteJoystick(lstick, vGamepad.lstick);
 			gamepad.emplace("LStick", std::move(lstick));
 
 			toml::table rstick;
-			WriteJoystick(gamepad, vGamepad.rstick);
+			WriteJoystick(rstick, vGamepad.rstick);
 			gamepad.emplace("RStick", std::move(rstick));
 
+			gamepad.emplace("DS4", WriteDS4(vGamepad.ds4));
+
 			gamepads.push_back(std::move(gamepad));
 		}
 		profile.emplace("Gamepads", std::move(gamepads));
 
+		toml::array routes;
+		for (auto& vRoute : vProfile.routes) {
+			toml::table route;
+			route.emplace("Device", vRoute.device);
+			route.emplace("Kind", vRoute.kind == IdevKind::Mouse ? "mouse"s : "keyboard"s);
+			if (vRoute.vidPid != 0) {
+				route.emplace("VidPid", std::format("{:04X}:{:04X}", vRoute.vidPid >> 16, vRoute.vidPid & 0xFFFF));
+				route.emplace("Ordinal", vRoute.ordinal);
+			}
+			toml::array pads;
+			for (int i = 0; i < kMaxX360Count; ++i) {
+				if (vRoute.pads & (1 << i))
+					pads.push_back(i);
+			}
+			route.emplace("Pads", std::move(pads));
+			// Absent means all
+			if (vRoute.buttons != kAllRouteButtons)
+				route.emplace("Buttons", WriteRouteButtons(vRoute.buttons));
+			routes.push_back(std::move(route));
+		}
+		profile.emplace("Routes", std::move(routes));
+
+		toml::array exes;
+		for (auto& exe : vProfile.executables)
+			exes.push_back(exe);
+		profile.emplace("Executables", std::move(exes));
+
 		profiles.emplace(vName, std::move(profile));
 	}
 	res.emplace("Profiles", std::move(profiles));
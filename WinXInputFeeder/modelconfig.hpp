@@ -1,11 +1,13 @@
 #pragma once
 
-#include "inputdevice.hpp"
+#include "inputsource.hpp"
+#include "keycode.hpp"
 #include "utils.hpp"
 
-#include <ViGEm/Client.h>
+#include <ViGEm/Common.h>
 
 #include <map>
+#include <optional>
 #include <string>
 #include <span>
 #include <string>
@@ -55,6 +57,7 @@ constexpr auto kX360ButtonAnalogCounterpartCount = kX360ButtonCount - kX360Butto
 X360Button X360ButtonFromViGEm(XUSB_BUTTON) noexcept;
 XUSB_BUTTON X360ButtonToViGEm(X360Button) noexcept;
 std::string_view X360ButtonToString(X360Button) noexcept;
+std::optional<X360Button> X360ButtonFromString(std::string_view) noexcept;
 
 inline bool IsX360ButtonStick(X360Button btn) noexcept {
 	auto begin = static_cast<unsigned char>(X360Button::STICK_BEGIN);
@@ -63,6 +66,10 @@ inline bool IsX360ButtonStick(X360Button btn) noexcept {
 	return begin <= i && i < end;
 }
 
+inline bool IsX360ButtonDPad(X360Button btn) noexcept {
+	return std::to_underlying(btn) <= std::to_underlying(X360Button::DPadRight);
+}
+
 inline bool IsX360ButtonValid(X360Button btn) noexcept {
 	return static_cast<unsigned char>(btn) < kX360ButtonCount;
 }
@@ -75,9 +82,62 @@ inline bool IsX360ButtonAnalogCounterpart(X360Button btn) noexcept {
 	return !IsX360ButtonDirectMap(btn);
 }
 
+// What a stick or D-pad does while opposing directions, e.g. left and right, are held at once
+enum class SocdMode : unsigned char {
+	// Passed through: they cancel out on a stick, and press both buttons on the D-pad
+	Off,
+	// Neither direction
+	Neutral,
+	// The direction pressed last
+	LastInput,
+	// The direction pressed first
+	FirstInput,
+	// Up over down, and neither of left and right
+	Absolute,
+};
+
+enum class RampCurve : unsigned char {
+	Linear,
+	// Slow start, i.e. fine control around the center
+	EaseIn,
+	// Fast start
+	EaseOut,
+	// Slow start and end
+	Smooth,
+};
+
+// How a key-driven stick or trigger moves between rest and full
+struct ConfigRamp {
+	// In milliseconds from rest to full and back, 0 for instant
+	float attackTime = 0.0f;
+	float releaseTime = 0.0f;
+	RampCurve curve = RampCurve::Linear;
+
+	bool IsInstant() const noexcept { return attackTime <= 0.0f && releaseTime <= 0.0f; }
+};
+
+enum class DS4MouseMode : unsigned char {
+	None,
+	// Mouse motion drags a finger across the touchpad
+	Touchpad,
+	// Mouse velocity turns into rotation rate
+	Gyro,
+};
+
+// Extras of a DS4 target, driven by the gamepad's source mouse on top of any mouse stick
+struct ConfigDS4 {
+	DS4MouseMode mouseMode = DS4MouseMode::None;
+	// Touchpad units (1920x943 in total) per mouse count
+	float touchSensitivity = 1.0f;
+	// Degrees per second of rotation per mouse count per second, negative inverts
+	float gyroSensitivity = 0.1f;
+};
+
 struct ConfigJoystick {
 	/* Settings for keyboard mode */
 	float speed = 1.0f;
+	SocdMode socd = SocdMode::Off;
+	ConfigRamp ramp;
 
 	/* Settings for mouse mode */
 	// Lower value corresponds to higher sensitivity
@@ -87,23 +147,111 @@ struct ConfigJoystick {
 	float nonLinear = 1.0f;
 	// Range: [0,1]
 	float deadzone = 0.0f;
+	// Mouse distance (at sensitivity 15) from center that gives a fully tilted stick
+	float outerRadius = 10.0f;
 	bool invertXAxis = false;
 	bool invertYAxis = false;
 
-	// If true, both axis will be generated from mouse movements (specifically the mouse specified by XiGamepad.srcMouse)
+	// If true, both axis will be generated from mouse movements (specifically the mice routed to the gamepad, see ConfigRoute)
 	bool useMouse = false;
 };
 
+enum class ButtonActionKind : unsigned char {
+	// Held down while the key is
+	Press,
+	// Repeatedly pressed and released while the key is held
+	Turbo,
+	// Releasing the key before holdTime taps the button, holding it longer presses holdButton instead
+	TapHold,
+	// Pressing the key plays a timed sequence of button combinations
+	Sequence,
+};
+
+struct ConfigSequenceStep {
+	// XUSB_GAMEPAD_* bits held down during this step
+	USHORT buttons = 0;
+	// In milliseconds
+	float duration = 50.0f;
+};
+
+// What a key bound to a direct map button does
+struct ConfigButtonAction {
+	ButtonActionKind kind = ButtonActionKind::Press;
+	/* Turbo */
+	// Presses per second
+	float turboRate = 10.0f;
+	/* TapHold */
+	// Must be a direct map button, None to do nothing on hold
+	X360Button holdButton = X360Button::None;
+	// In milliseconds
+	float holdTime = 200.0f;
+	// How long a tap holds the button down, in milliseconds
+	float tapTime = 50.0f;
+	/* Sequence */
+	std::vector<ConfigSequenceStep> steps;
+};
+
+// While its key is held, the layer's keys press their own buttons instead of their plain bindings
+struct ConfigKeyLayer {
+	KeyCode key = 0xFF;
+	// Key -> XUSB_GAMEPAD_* bits; keys not in here behave as on the base layer
+	std::map<KeyCode, USHORT> buttons;
+};
+
+// Holding all of the keys at once presses the buttons, on top of whatever the keys do on their own
+struct ConfigChord {
+	std::vector<KeyCode> keys;
+	// XUSB_GAMEPAD_* bits
+	USHORT buttons = 0;
+};
+
 struct ConfigGamepad {
 	KeyCode buttons[kX360ButtonCount];
+	ConfigButtonAction actions[kX360ButtonDirectMapCount];
+	// Base layer keys pressing several direct map buttons at once, key -> XUSB_GAMEPAD_* bits
+	std::map<KeyCode, USHORT> multiKeys;
+	// At most kMaxKeyLayers, later ones take precedence while several are held
+	std::vector<ConfigKeyLayer> layers;
+	std::vector<ConfigChord> chords;
+	// Applies to D-pad buttons with a plain press action
+	SocdMode dpadSocd = SocdMode::Off;
+	ConfigRamp leftTriggerRamp, rightTriggerRamp;
 	ConfigJoystick lstick, rstick;
+	// Only used by DS4 targets
+	ConfigDS4 ds4;
 
 	ConfigGamepad();
 };
 
+constexpr int kMaxX360Count = 4;
+
+constexpr uint32_t kAllRouteButtons = (uint32_t(1) << kX360ButtonCount) - 1;
+
+// Routes an input device to gamepads of the profile
+// Several devices routed to one gamepad are merged, one device routed to several gamepads drives all of them.
+struct ConfigRoute {
+	// Device interface name, see InputDevice::nameUtf8
+	// Changes when the device is plugged into another port, it is then matched by VID/PID and ordinal instead.
+	std::string device;
+	IdevKind kind = IdevKind::Keyboard;
+	// See InputDevice::GetVidPid(), 0 to match by name only
+	uint32_t vidPid = 0;
+	// Tells apart devices of the same VID/PID, see RouteDevice::ordinal
+	uint8_t ordinal = 0;
+	// Bit N for gamepad N
+	BYTE pads = 0;
+	// Bit N lets the device drive X360Button N, judged by the key's plain binding
+	// Keys bound only through layers, chords or multi-button keys need all buttons allowed.
+	uint32_t buttons = kAllRouteButtons;
+};
+
 struct ConfigProfile {
 	std::vector<ConfigGamepad> gamepads;
-	unsigned char x360Count = 0; // Max 4
+	unsigned char x360Count = 0; // Max kMaxX360Count
+	std::vector<ConfigRoute> routes;
+	// File names of the executables whose windows switch to this profile when they come to the foreground, e.g. "game.exe"
+	// Matched case-insensitively, see ForegroundSwitcher.
+	std::vector<std::string> executables;
 
 	size_t GetX360Count() const { return x360Count; }
 	std::span<ConfigGamepad> GetX360s() { return std::span(gamepads.data(), x360Count); }
@@ -117,6 +265,42 @@ struct ConfigProfile {
 	void RemoveGamepad(size_t idx);
 };
 
+enum class MouseFilterKind {
+	// Exponential moving average with a fixed time constant
+	Ema,
+	// One-euro filter, time constant shrinks as speed increases
+	OneEuro,
+};
+
+struct ConfigMouseFilter {
+	MouseFilterKind kind = MouseFilterKind::Ema;
+	/* Settings for Ema */
+	// In milliseconds
+	float timeConstant = 75.0f;
+	/* Settings for OneEuro */
+	// In Hz, the cutoff frequency at rest
+	float minCutoff = 2.0f;
+	// In Hz per (counts/second), how much the cutoff frequency rises with speed
+	float beta = 0.005f;
+};
+
+enum class KeyboardInputMode {
+	// Keys are identified by the Vkey the active layout assigns them
+	VirtualKey,
+	// Keys are identified by their physical position, see KeyCodeFromScanCode()
+	ScanCode,
+};
+
+// Mouse DPI that stick parameters are tuned against, counts of calibrated mice are scaled to it
+constexpr float kReferenceMouseDpi = 800.0f;
+
+// Measured properties of one mouse model, identified by VID/PID
+struct ConfigMouseCalibration {
+	float dpi = kReferenceMouseDpi;
+	// Reports per second, informational only: the mouse-to-stick pipeline is already independent of it
+	float pollingRate = 0.0f;
+};
+
 struct Config {
 	using ProfileTable = std::map<std::string, ConfigProfile, std::less<>>;
 	using ProfileRef = const ProfileTable::value_type*;
@@ -125,8 +309,15 @@ struct Config {
 	ProfileTable profiles;
 	// Recommends 50-100
 	int mouseCheckFrequency = 75;
+	ConfigMouseFilter mouseFilter;
+	KeyboardInputMode keyboardInputMode = KeyboardInputMode::VirtualKey;
+	// Hide keys bound to gamepads from other applications, through the WndMsgFilter hook
+	bool suppressBoundKeys = false;
+	// Key is (VID << 16 | PID), see InputDevice::GetVidPid()
+	std::map<uint32_t, ConfigMouseCalibration> mouseCalibrations;
 	KeyCode hotkeyShowUI = 0xFF;
 	KeyCode hotkeyCaptureCursor = 0xFF;
+	KeyCode hotkeyToggleTrace = 0xFF;
 
 	Config();
 	Config(const toml::table&);
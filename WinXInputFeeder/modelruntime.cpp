@@ -2,134 +2,256 @@
 
 #include "modelruntime.hpp"
 
+#include "trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <format>
 #include <stdexcept>
 #include <utility>
 
 using namespace std::literals;
 
-ViGEm::ViGEm()
-	: hvigem{ vigem_alloc() }
-{
-	VIGEM_ERROR err;
+X360Gamepad::X360Gamepad(GamepadSink& sink, GamepadKind kind)
+	: target(sink, kind)
+	, kind{ kind } {}
 
-	err = vigem_connect(hvigem);
-	if (!VIGEM_SUCCESS(err))
-		throw std::runtime_error(std::format("Failed to connect ViGEm bus"));
-}
+X360Gamepad::X360Gamepad(GamepadTarget target, GamepadKind kind)
+	: target(std::move(target))
+	, kind{ kind } {}
 
-ViGEm::~ViGEm() {
-	vigem_disconnect(hvigem);
-	vigem_free(hvigem);
+bool X360Gamepad::GetButton(XUSB_BUTTON btn) const noexcept {
+	// When an integral value is coerced into bool, all non-zero values are turned to 1 (and zero to 0)
+	return state.wButtons & btn;
 }
 
-ViGEm::ViGEm(ViGEm&& that) noexcept
-	: hvigem{ std::exchange(that.hvigem, nullptr) } {}
+void X360Gamepad::SetButton(XUSB_BUTTON btn, bool onoff) noexcept {
+	if (onoff)
+		state.wButtons |= btn;
+	else
+		state.wButtons &= ~btn;
+}
 
-ViGEm& ViGEm::operator=(ViGEm&& that) noexcept {
-	vigem_disconnect(hvigem);
-	vigem_free(hvigem);
-	hvigem = std::exchange(that.hvigem, nullptr);
-	return *this;
+void X360Gamepad::SendReport() {
+	TRACE_ZONE("X360Gamepad::SendReport");
+	if (kind == GamepadKind::DS4) {
+		PackDS4Report(state, ds4Motion, DS4TimestampOf(QpcNow(), QpcFrequency()), ds4Report);
+		target.sink->SubmitDS4(target.handle, ds4Report);
+		return;
+	}
+	target.sink->SubmitX360(target.handle, state);
 }
 
-X360Gamepad::X360Gamepad(const ViGEm& client)
-	: hvigem{ client.hvigem }
-	, htarget{ /*vigem_target_x360_alloc()*/ }
-{
-	VIGEM_ERROR err;
+static const ConfigRamp& GetRampConfig(const ConfigGamepad& gamepad, int axis) noexcept {
+	switch (axis) {
+	case kRampLX: case kRampLY: return gamepad.lstick.ramp;
+	case kRampRX: case kRampRY: return gamepad.rstick.ramp;
+	case kRampLT: return gamepad.leftTriggerRamp;
+	default: return gamepad.rightTriggerRamp;
+	}
+}
 
-	//err = vigem_target_add(client.hvigem, htarget);
-	//if (!VIGEM_SUCCESS(err))
-	//	throw std::runtime_error(std::format("Failed to add X360 gamepad to ViGEm bus"));
+// Write the ramp's current output into the report
+static void ApplyRampAxis(X360Gamepad& dev, const ConfigGamepad& gamepad, int axis) noexcept {
+	float out = dev.ramps[axis].Output(GetRampConfig(gamepad, axis).curve);
+	switch (axis) {
+	case kRampLX: dev.SetStickLX(static_cast<SHORT>(out * MAXSHORT * gamepad.lstick.speed)); break;
+	case kRampLY: dev.SetStickLY(static_cast<SHORT>(out * MAXSHORT * gamepad.lstick.speed)); break;
+	case kRampRX: dev.SetStickRX(static_cast<SHORT>(out * MAXSHORT * gamepad.rstick.speed)); break;
+	case kRampRY: dev.SetStickRY(static_cast<SHORT>(out * MAXSHORT * gamepad.rstick.speed)); break;
+	case kRampLT: dev.SetLeftTrigger(static_cast<BYTE>(std::lround(out * 0xFF))); break;
+	case kRampRT: dev.SetRightTrigger(static_cast<BYTE>(std::lround(out * 0xFF))); break;
+	}
 }
 
-X360Gamepad::~X360Gamepad() {
-	//vigem_target_remove(hvigem, htarget);
-	//vigem_target_free(htarget);
+// Jumps there if the axis has no ramp, otherwise marks it as moving for FeederEngine::StartRamps()
+static void SetRampTarget(X360Gamepad& dev, const ConfigGamepad& gamepad, int axis, float target) noexcept {
+	auto& ramp = dev.ramps[axis];
+	ramp.target = target;
+	if (GetRampConfig(gamepad, axis).IsInstant())
+		ramp.level = target;
+	else if (ramp.level != target)
+		dev.rampingAxes |= 1 << axis;
+	ApplyRampAxis(dev, gamepad, axis);
 }
 
-X360Gamepad::X360Gamepad(X360Gamepad&& that) noexcept
-	: hvigem{ std::exchange(that.hvigem, nullptr) }
-	, htarget{ std::exchange(that.htarget, nullptr) } {}
+template <bool kTriggers, bool kKbdLStick, bool kKbdRStick>
+static void TranslateAnalogKey(X360Gamepad& dev, const ConfigGamepad& gamepad, X360Button btn, bool pressed) noexcept {
+	using enum X360Button;
 
-X360Gamepad& X360Gamepad::operator=(X360Gamepad&& that) noexcept {
-	//vigem_target_remove(hvigem, htarget);
-	//vigem_target_free(htarget);
-	hvigem = std::exchange(that.hvigem, nullptr);
-	htarget = std::exchange(that.htarget, nullptr);
-	return *this;
-}
+	if constexpr (kTriggers) {
+		if (btn == LeftTrigger) {
+			SetRampTarget(dev, gamepad, kRampLT, pressed ? 1.0f : 0.0f);
+			return;
+		}
+		if (btn == RightTrigger) {
+			SetRampTarget(dev, gamepad, kRampRT, pressed ? 1.0f : 0.0f);
+			return;
+		}
+	}
 
-bool X360Gamepad::GetButton(XUSB_BUTTON btn) const noexcept {
-	// When an integral value is coerced into bool, all non-zero values are turned to 1 (and zero to 0)
-	return state.wButtons & btn;
-}
+	if constexpr (kKbdLStick || kKbdRStick) {
+		// Each stick's directions are in the same order as the SOCD bits
+		int nth = std::to_underlying(btn) - std::to_underlying(STICK_BEGIN);
 
-void X360Gamepad::SetButton(XUSB_BUTTON btn, bool onoff) noexcept {
-	if (onoff)
-		state.wButtons |= btn;
-	else
-		state.wButtons &= ~btn;
+		auto SetStick = [&](SocdState& keys, const ConfigJoystick& stick, int axisX, int axisY) {
+			BYTE dirs = keys.Resolve(stick.socd);
+			SetRampTarget(dev, gamepad, axisX, (dirs & kSocdRight ? 1.0f : 0.0f) - (dirs & kSocdLeft ? 1.0f : 0.0f));
+			SetRampTarget(dev, gamepad, axisY, (dirs & kSocdUp ? 1.0f : 0.0f) - (dirs & kSocdDown ? 1.0f : 0.0f));
+		};
+
+		if (kKbdLStick && nth < 4) {
+			dev.lstickKeys.Set(nth, pressed, dev.pressClock);
+			SetStick(dev.lstickKeys, gamepad.lstick, kRampLX, kRampLY);
+		}
+		else if (kKbdRStick) {
+			dev.rstickKeys.Set(nth - 4, pressed, dev.pressClock);
+			SetStick(dev.rstickKeys, gamepad.rstick, kRampRX, kRampRY);
+		}
+	}
 }
 
-void X360Gamepad::SendReport() {
-	//vigem_target_x360_update(hvigem, htarget, state);
+// Indexed by (triggers bound) | (keyboard left stick bound) << 1 | (keyboard right stick bound) << 2
+constexpr InputTranslationStruct::KeyHandler kAnalogKeyHandlers[] = {
+	&TranslateAnalogKey<false, false, false>,
+	&TranslateAnalogKey<true, false, false>,
+	&TranslateAnalogKey<false, true, false>,
+	&TranslateAnalogKey<true, true, false>,
+	&TranslateAnalogKey<false, false, true>,
+	&TranslateAnalogKey<true, false, true>,
+	&TranslateAnalogKey<false, true, true>,
+	&TranslateAnalogKey<true, true, true>,
+};
+
+// Whether a device with the button subset may drive the key binding, see ConfigRoute::buttons
+static bool IsRouteAllowed(uint32_t allowed, const InputTranslationStruct::KeyBinding& binding) noexcept {
+	if (allowed == kAllRouteButtons)
+		return true;
+	return binding.btn != X360Button::None && (allowed >> std::to_underlying(binding.btn) & 1);
 }
 
 void InputTranslationStruct::ClearAll() {
-	for (int gamepadId = 0; gamepadId < 4; ++gamepadId) {
-		for (int i = 0; i < 0xFF; ++i) {
-			btns[gamepadId][i] = X360Button::None;
-		}
+	for (int gamepadId = 0; gamepadId < kMaxX360Count; ++gamepadId) {
+		for (auto& binding : btns[gamepadId])
+			binding = {};
+		handlers[gamepadId] = kAnalogKeyHandlers[0];
 	}
+	for (auto& pads : boundPads)
+		pads = 0;
 }
 
 void InputTranslationStruct::PopulateBtnLut(int gamepadId, const ConfigGamepad& gamepad) {
 	using enum X360Button;
 
 	// Clear
-	for (auto& btn : btns[gamepadId])
-		btn = None;
+	for (auto& binding : btns[gamepadId])
+		binding = {};
+	for (auto& pads : boundPads)
+		pads &= ~(1 << gamepadId);
 
-	for (unsigned char i = 0; i < kX360ButtonCount + 2 /* triggers */; ++i) {
+	auto Bind = [&](unsigned char i) {
 		auto boundKey = gamepad.buttons[i];
-		if (boundKey != 0xFF)
-			btns[gamepadId][boundKey] = static_cast<X360Button>(i);
-	}
+		if (boundKey == 0xFF)
+			return false;
+		auto btn = static_cast<X360Button>(i);
+		bool plainPress = IsX360ButtonDirectMap(btn) && gamepad.actions[i].kind == ButtonActionKind::Press
+			&& !(IsX360ButtonDPad(btn) && gamepad.dpadSocd != SocdMode::Off);
+		btns[gamepadId][boundKey] = { btn, false, static_cast<USHORT>(plainPress ? X360ButtonToViGEm(btn) : 0) };
+		boundPads[boundKey] |= 1 << gamepadId;
+		return true;
+	};
+
+	for (unsigned char i = 0; i < kX360ButtonDirectMapCount; ++i)
+		Bind(i);
+	bool triggers = Bind(std::to_underlying(LeftTrigger));
+	triggers |= Bind(std::to_underlying(RightTrigger));
 
 	auto DoStick = [&](unsigned char base, const ConfigJoystick& stick) {
 		if (stick.useMouse)
-			return;
-		for (unsigned char i = 0; i < 4; ++i) {
-			auto boundKey = gamepad.buttons[base + i];
-			if (boundKey != 0xFF)
-				btns[gamepadId][boundKey] = static_cast<X360Button>(base + i);
-		}};
-	DoStick(static_cast<unsigned char>(LStickUp), gamepad.lstick);
-	DoStick(static_cast<unsigned char>(RStickUp), gamepad.rstick);
-}
-
-static void CALLBACK MouseCheckTimeProc(HWND hWnd, UINT message, UINT_PTR idTimer, DWORD dwTime) {
-	auto self = reinterpret_cast<FeederEngine*>(idTimer);
-	self->Update();
+			return false;
+		bool any = false;
+		for (unsigned char i = 0; i < 4; ++i)
+			any |= Bind(base + i);
+		return any;
+	};
+	bool lstick = DoStick(std::to_underlying(LStickUp), gamepad.lstick);
+	bool rstick = DoStick(std::to_underlying(RStickUp), gamepad.rstick);
+
+	handlers[gamepadId] = kAnalogKeyHandlers[triggers | lstick << 1 | rstick << 2];
+
+	// Keymapped keys keep btn for when the keymap doesn't consume them, but never take the fast path
+	if (auto& keymap = keymaps[gamepadId]) {
+		for (int key = 0; key < 0xFF; ++key) {
+			if (!keymap->HasKey(static_cast<KeyCode>(key)))
+				continue;
+			btns[gamepadId][key].keymapped = true;
+			btns[gamepadId][key].buttonMask = 0;
+			boundPads[key] |= 1 << gamepadId;
+		}
+	}
 }
 
-FeederEngine::FeederEngine(HWND eventHwnd, Config c, ViGEm& vigem)
-	: vigem{ &vigem }
+FeederEngine::FeederEngine(EngineHost& host, GamepadSink& sink, Config c)
+	: host{ &host }
+	, sink{ &sink }
 	, config{ std::move(c) }
-	, eventHwnd{ eventHwnd }
+	, qpcActionTickOrigin{ QpcNow() }
 {
+	for (int gamepadId = 0; gamepadId < kMaxX360Count; ++gamepadId) {
+		for (unsigned char i = 0; i < kX360ButtonDirectMapCount; ++i) {
+			auto& st = buttonActions[gamepadId][i];
+			st.engine = this;
+			st.gamepadId = static_cast<uint8_t>(gamepadId);
+			st.btn = static_cast<X360Button>(i);
+			st.fire = [](TimerNode& node) noexcept {
+				auto& st = static_cast<ButtonActionState&>(node);
+				st.engine->OnButtonActionTimer(st);
+			};
+		}
+
+		auto& rt = rampTimers[gamepadId];
+		rt.engine = this;
+		rt.gamepadId = static_cast<uint8_t>(gamepadId);
+		rt.fire = [](TimerNode& node) noexcept {
+			auto& rt = static_cast<RampTimer&>(node);
+			rt.engine->OnRampTimer(rt);
+		};
+	}
+
+	foregroundSwitcher.Index(config.profiles);
 	if (!config.profiles.empty())
 		SelectProfile(&*config.profiles.begin());
 
-	mouseCheckTimer = SetTimer(eventHwnd, reinterpret_cast<UINT_PTR>(this), config.mouseCheckFrequency, MouseCheckTimeProc);
-	if (!mouseCheckTimer)
-		LOG_DEBUG(L"Failed to register mouse check timer");
+	// The sampler is started by the first mouse movement
 }
 
 FeederEngine::~FeederEngine() {
-	KillTimer(eventHwnd, mouseCheckTimer);
+	StopSampler();
+	host->CancelActionTimer();
+}
+
+void FeederEngine::StartSampler() noexcept {
+	if (samplerRunning)
+		return;
+
+	if (!host->StartSampler(*this, config.mouseCheckFrequency))
+		return;
+	samplerRunning = true;
+	qpcSamplerStarted = QpcNow();
+}
+
+void FeederEngine::StopSampler() noexcept {
+	if (!samplerRunning)
+		return;
+
+	host->StopSampler();
+	samplerRunning = false;
+	qpcSamplerRunTotal += QpcNow() - qpcSamplerStarted;
+}
+
+int64_t FeederEngine::GetSamplerRunTime() const noexcept {
+	return qpcSamplerRunTotal + (samplerRunning ? QpcNow() - qpcSamplerStarted : 0);
 }
 
 void FeederEngine::SelectProfile(Config::ProfileRef profileConst) {
@@ -138,58 +260,135 @@ void FeederEngine::SelectProfile(Config::ProfileRef profileConst) {
 	if (currentProfile == profile)
 		return;
 
-	x360s.clear();
+	ResetButtonActions();
+	ResetKeymaps();
 	its.ClearAll();
+	mouseSticks.Clear();
+	for (auto& f : mouseFilters)
+		f.Reset();
+	for (auto& l : x360Latency)
+		l.Reset();
 
 	currentProfile = profile;
+	// DS4 targets take whatever slots the X360 ones left
+	size_t n = profile ? std::min(profile->second.gamepads.size(), static_cast<size_t>(kMaxX360Count)) : 0;
+	x360s.erase(x360s.begin() + std::min(n, x360s.size()), x360s.end());
 	if (profile) {
 		const ConfigProfile& p = profile->second;
-		size_t n = p.GetX360Count();
 
 		x360s.reserve(n);
 		for (int i = 0; i < n; ++i) {
-			x360s.push_back(X360Gamepad(*vigem));
+			auto kind = i < p.GetX360Count() ? GamepadKind::X360 : GamepadKind::DS4;
+			if (i == x360s.size())
+				x360s.push_back(X360Gamepad(*sink, kind));
+			else if (x360s[i].kind != kind)
+				x360s[i] = X360Gamepad(*sink, kind);
+			else {
+				// Replugging would make games drop the controller, so keep the target and release what the old profile held
+				x360s[i] = X360Gamepad(std::move(x360s[i].target), kind);
+				x360s[i].SendReport();
+			}
 			its.PopulateBtnLut(i, p.gamepads[i]);
+			CompileMouseSticks(i);
 		}
 	}
+	CompileRoutes();
+	RequestKeymaps();
 }
 
 bool FeederEngine::AddProfile(std::string profileName) {
 	auto [DISCARD, success] = config.profiles.try_emplace(std::move(profileName));
+	configDirty |= success;
 	return success;
 }
 
+void FeederEngine::SetProfileExecutables(Config::ProfileRef profileConst, std::vector<std::string> executables) {
+	auto profile = const_cast<Config::ProfileRefMut>(profileConst);
+
+	profile->second.executables = std::move(executables);
+	foregroundSwitcher.Index(config.profiles);
+	configDirty = true;
+}
+
+void FeederEngine::OnForegroundApp(std::string_view exePath, int64_t qpcEvent) {
+	TRACE_ZONE("FeederEngine::OnForegroundApp");
+	auto profile = foregroundSwitcher.Find(exePath);
+	if (!profile || profile == currentProfile)
+		return;
+
+	SelectProfile(profile);
+	int64_t micros = (QpcNow() - qpcEvent) * 1'000'000 / QpcFrequency();
+	profileSwitchLatency.Record(static_cast<uint32_t>(std::clamp<int64_t>(micros, 0, UINT32_MAX)));
+	++stateVersion;
+	LOG_DEBUG("Switched to profile {} for {}", Utf8ToWide(profile->first), Utf8ToWide(exePath));
+}
+
 void FeederEngine::RemoveProfile(Config::ProfileRef profileConst) {
 	auto profile = const_cast<Config::ProfileRefMut>(profileConst);
 
-	config.profiles.erase(profile->first);
+	// Switch away before erasing: leaving a profile settles its ramps, which reads its gamepads
 	if (currentProfile == profile) {
-		if (!config.profiles.empty())
-			SelectProfile(&*config.profiles.begin());
-		else
-			SelectProfile(nullptr);
+		auto next = std::ranges::find_if(config.profiles, [&](const auto& p) { return &p != profile; });
+		SelectProfile(next != config.profiles.end() ? &*next : nullptr);
 	}
+	config.profiles.erase(profile->first);
+	foregroundSwitcher.Index(config.profiles);
+	configDirty = true;
 }
 
-bool FeederEngine::AddX360() {
-	auto&& [gamepad, gamepadId] = currentProfile->second.AddX360();
+bool FeederEngine::AddGamepad(GamepadKind kind) {
+	auto&& [gamepad, gamepadId] = kind == GamepadKind::DS4
+		? currentProfile->second.AddDS4()
+		: currentProfile->second.AddX360();
 	if (gamepadId == SIZE_MAX)
 		return false;
+	configDirty = true;
 
-	x360s.push_back(X360Gamepad(*vigem));
-	auto& dev = x360s.back();
+	// Appending keeps every id, but an X360 gamepad goes in front of the DS4 ones
+	if (gamepadId == x360s.size()) {
+		x360s.push_back(X360Gamepad(*sink, kind));
+		its.PopulateBtnLut(static_cast<int>(gamepadId), gamepad);
+		CompileMouseSticks(static_cast<int>(gamepadId));
+		CompileRoutes();
+		return true;
+	}
 
+	ResetButtonActions();
+	ResetKeymaps();
+	x360s.insert(x360s.begin() + gamepadId, X360Gamepad(*sink, kind));
+	OnGamepadIdsChanged();
 	return true;
 }
 
+bool FeederEngine::AddX360() {
+	return AddGamepad(GamepadKind::X360);
+}
+
+bool FeederEngine::AddDS4() {
+	return AddGamepad(GamepadKind::DS4);
+}
+
+void FeederEngine::OnGamepadIdsChanged() {
+	CompileKeyBindings();
+	mouseSticks.Clear();
+	for (auto& f : mouseFilters)
+		f.Reset();
+	for (int i = 0; i < x360s.size(); ++i)
+		CompileMouseSticks(i);
+	CompileRoutes();
+	RequestKeymaps();
+}
+
 bool FeederEngine::RemoveGamepad(int gamepadId) {
 	if (gamepadId < 0 || gamepadId >= x360s.size())
 		return false;
+	ResetButtonActions();
+	ResetKeymaps();
 	currentProfile->second.RemoveGamepad(gamepadId);
-	if (gamepadId < x360s.size())
-		x360s.erase(x360s.begin() + gamepadId);
-	else
-		; // TODO
+	configDirty = true;
+	x360s.erase(x360s.begin() + gamepadId);
+	// Tables and lanes are indexed by gamepad id, which just shifted
+	OnGamepadIdsChanged();
 	return true;
 }
 
@@ -202,19 +401,131 @@ void FeederEngine::StartRebindX360Device(int gamepadId, IdevKind kind) {
 	switch (kind) {
 	case Keyboard: dev.pendingRebindKbd = true; break;
 	case Mouse: dev.pendingRebindMouse = true; break;
+	// Never routed, see AttachDevice()
+	case Hid: return;
 	}
+	rebindPending = true;
 }
 
 void FeederEngine::RebindX360Device(int gamepadId, IdevKind kind, HANDLE handle) {
 	if (gamepadId < 0 || gamepadId >= x360s.size())
 		return;
-	auto& dev = x360s[gamepadId];
 
-	using enum IdevKind;
-	switch (kind) {
-	case Keyboard: dev.srcKbd = handle; break;
-	case Mouse: dev.srcMouse = handle; break;
+	RouteExclusively(gamepadId, kind, handle);
+	CompileRoutes();
+}
+
+void FeederEngine::RouteExclusively(int gamepadId, IdevKind kind, HANDLE hDevice) {
+	auto& profile = currentProfile->second;
+	auto bit = static_cast<BYTE>(1 << gamepadId);
+
+	for (auto& route : profile.routes) {
+		if (route.kind == kind)
+			route.pads &= ~bit;
+	}
+	for (unsigned slots = routes.usedSlots; slots != 0; slots &= slots - 1) {
+		auto slot = static_cast<uint8_t>(std::countr_zero(slots));
+		auto& device = routes.devices[slot];
+		if (device.hDevice == hDevice && device.kind == kind)
+			GetDeviceRoute(slot).pads |= bit;
 	}
+	configDirty = true;
+}
+
+ConfigRoute& FeederEngine::GetDeviceRoute(uint8_t slot) {
+	auto& profileRoutes = currentProfile->second.routes;
+	auto& device = routes.devices[slot];
+	if (int idx = routes.FindRoute(device); idx >= 0)
+		return profileRoutes[idx];
+
+	auto& route = profileRoutes.emplace_back();
+	route.device = device.name;
+	route.kind = device.kind;
+	route.vidPid = device.vidPid;
+	route.ordinal = device.ordinal;
+	routes.Index(profileRoutes);
+	return route;
+}
+
+void FeederEngine::AttachDevice(InputDevice& idev) {
+	if (idev.kind == IdevKind::Hid)
+		return;
+
+	uint8_t slot = routes.Attach(idev.hDevice, idev.nameUtf8, idev.kind, idev.GetVidPid());
+	idev.routeSlot = slot;
+	if (slot == kNoRouteSlot) {
+		LOG_DEBUG("More than {} input devices, {} can't drive any gamepad", kMaxRouteDevices, Utf8ToWide(idev.nameUtf8));
+		return;
+	}
+	if (!currentProfile)
+		return;
+
+	// A lookup in the index CompileRoutes() built, so that a replugged device is live again before its first input
+	auto& profileRoutes = currentProfile->second.routes;
+	int idx = routes.ResolveSlot(slot, profileRoutes, static_cast<int>(x360s.size()));
+	if (idx < 0)
+		return;
+
+	// Matched by VID/PID, e.g. after moving to another port: take the new name, so that it matches exactly from now on
+	// Routes saved before VID/PID were recorded get them here.
+	auto& route = profileRoutes[idx];
+	auto& device = routes.devices[slot];
+	if (!routes.routeByName.contains(device.name) || route.vidPid != device.vidPid) {
+		route.device = device.name;
+		route.vidPid = device.vidPid;
+		route.ordinal = device.ordinal;
+		routes.Index(profileRoutes);
+		configDirty = true;
+	}
+
+	if (device.kind == IdevKind::Keyboard && routes.pads[slot] != 0)
+		PublishSuppressedKeys();
+	++stateVersion;
+}
+
+void FeederEngine::DetachDevice(InputDevice& idev) noexcept {
+	if (idev.routeSlot == kNoRouteSlot)
+		return;
+	uint8_t slot = std::exchange(idev.routeSlot, kNoRouteSlot);
+	routes.Detach(slot);
+
+	// The slot goes to the next device attached
+	auto slotBit = static_cast<RouteSlotMask>(1 << slot);
+	for (auto& dev : x360s) {
+		for (auto& holders : dev.keyHolders)
+			holders &= ~slotBit;
+	}
+	PublishSuppressedKeys();
+	++stateVersion;
+}
+
+void FeederEngine::SetDeviceRoute(int slot, int gamepadId, bool routed) {
+	if (slot < 0 || slot >= kMaxRouteDevices || !(routes.usedSlots & (1 << slot)))
+		return;
+	if (gamepadId < 0 || gamepadId >= x360s.size())
+		return;
+
+	auto& route = GetDeviceRoute(static_cast<uint8_t>(slot));
+	auto bit = static_cast<BYTE>(1 << gamepadId);
+	route.pads = routed ? route.pads | bit : route.pads & ~bit;
+	configDirty = true;
+	CompileRoutes();
+}
+
+void FeederEngine::CompileRoutes() {
+	std::span<const ConfigRoute> profileRoutes;
+	if (currentProfile)
+		profileRoutes = currentProfile->second.routes;
+	routes.Index(profileRoutes);
+	routes.Resolve(profileRoutes, static_cast<int>(x360s.size()));
+
+	// Keys held through a device that no longer drives the gamepad would otherwise never be released
+	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+		RouteSlotMask slots = routes.GetSlotsOf(gamepadId);
+		for (auto& holders : x360s[gamepadId].keyHolders)
+			holders &= slots;
+	}
+	PublishSuppressedKeys();
 }
 
 void FeederEngine::StartRebindX360Mapping(int gamepadId, X360Button btn) {
@@ -223,6 +534,7 @@ void FeederEngine::StartRebindX360Mapping(int gamepadId, X360Button btn) {
 	auto& dev = x360s[gamepadId];
 
 	dev.pendingRebindBtn = btn;
+	rebindPending = true;
 }
 
 void FeederEngine::SetX360JoystickMode(int gamepadId, bool useRight, bool useMouse) {
@@ -233,6 +545,16 @@ void FeederEngine::SetX360JoystickMode(int gamepadId, bool useRight, bool useMou
 
 	auto& stick = useRight ? gamepad.rstick : gamepad.lstick;
 	stick.useMouse = useMouse;
+	// Stop a keyboard ramp from overwriting the stick
+	int axisX = useRight ? kRampRX : kRampLX;
+	int axisY = useRight ? kRampRY : kRampLY;
+	dev.ramps[axisX] = {};
+	dev.ramps[axisY] = {};
+	dev.rampingAxes &= ~(1 << axisX | 1 << axisY);
+	mouseSticks.SetLaneParams(MouseStickBatch::LaneOf(gamepadId, useRight), stick);
+	// The stick's keys are bound only in keyboard mode
+	its.PopulateBtnLut(gamepadId, gamepad);
+	PublishSuppressedKeys();
 	configDirty = true;
 }
 
@@ -241,209 +563,539 @@ ConfigJoystick& FeederEngine::GetX360JoystickParams(int gamepadId, bool leftrigh
 	return leftright ? gamepad.rstick : gamepad.lstick;
 }
 
-void FeederEngine::HandleKeyPress(const IdevDevice& idev, BYTE vkey, bool pressed) {
-	using enum X360Button;
+void FeederEngine::CommitX360JoystickParams(int gamepadId, bool leftright) {
+	if (gamepadId < 0 || gamepadId >= x360s.size())
+		return;
+	mouseSticks.SetLaneParams(MouseStickBatch::LaneOf(gamepadId, leftright), GetX360JoystickParams(gamepadId, leftright));
+	configDirty = true;
+}
 
-	HANDLE hDevice = idev.hDevice;
+void FeederEngine::CompileKeyBindings() noexcept {
+	its.ClearAll();
+	for (int i = 0; i < x360s.size(); ++i)
+		its.PopulateBtnLut(i, currentProfile->second.gamepads[i]);
+	PublishSuppressedKeys();
+}
 
-	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
-		auto& dev = x360s[gamepadId];
-		auto& gamepad = currentProfile->second.gamepads[gamepadId];
+void FeederEngine::ResetKeymaps() noexcept {
+	for (auto& dev : x360s)
+		dev.keymap.Reset(dev.state.wButtons);
+	for (auto& keymap : its.keymaps)
+		keymap.reset();
+}
 
-		// Device filtering
-		if (IsKeyCodeMouseButton(vkey)) {
-			if (dev.pendingRebindMouse) {
-				dev.srcMouse = hDevice;
-				dev.pendingRebindMouse = false;
-			}
+void FeederEngine::RequestKeymaps() {
+	uint64_t generation = ++keymapGeneration;
 
-			if (dev.srcMouse != hDevice) continue;
+	std::vector<ConfigGamepad> gamepads;
+	if (currentProfile) {
+		auto& all = currentProfile->second.gamepads;
+		gamepads.assign(all.begin(), all.begin() + x360s.size());
+	}
+	bool installed = std::ranges::any_of(its.keymaps, [](const auto& keymap) { return keymap != nullptr; });
+	if (!installed && std::ranges::none_of(gamepads, HasKeymap))
+		return;
+
+	// Assigning joins the previous compilation, which takes microseconds
+	keymapCompiler = std::jthread([this, generation, gamepads = std::move(gamepads)] {
+		std::vector<std::unique_ptr<KeymapTables>> keymaps(gamepads.size());
+		for (size_t i = 0; i < gamepads.size(); ++i) {
+			if (!HasKeymap(gamepads[i]))
+				continue;
+			keymaps[i] = std::make_unique<KeymapTables>();
+			CompileKeymap(gamepads[i], *keymaps[i]);
 		}
-		else {
-			if (dev.pendingRebindKbd) {
-				dev.srcKbd = hDevice;
-				dev.pendingRebindKbd = false;
+
+		{
+			std::lock_guard lock(compiledKeymapsMutex);
+			compiledKeymapsGeneration = generation;
+			compiledKeymaps = std::move(keymaps);
+		}
+		host->PostKeymapsCompiled();
+	});
+}
+
+void FeederEngine::InstallCompiledKeymaps() noexcept {
+	std::vector<std::unique_ptr<KeymapTables>> keymaps;
+	{
+		std::lock_guard lock(compiledKeymapsMutex);
+		if (compiledKeymapsGeneration != keymapGeneration)
+			return;
+		compiledKeymapsGeneration = 0;
+		keymaps = std::move(compiledKeymaps);
+		compiledKeymaps.clear();
+	}
+
+	// Gamepads may have been added since the request, they have no keymap yet
+	for (size_t i = 0; i < x360s.size(); ++i) {
+		auto& dev = x360s[i];
+		dev.keymap.Reset(dev.state.wButtons);
+		its.keymaps[i] = i < keymaps.size() ? std::move(keymaps[i]) : nullptr;
+		// Buttons held through the previous keymap were released
+		dev.SendReport();
+	}
+	CompileKeyBindings();
+	++stateVersion;
+}
+
+void FeederEngine::StartKeySuppression() {
+	if (!config.suppressBoundKeys || keySuppression)
+		return;
+
+	keySuppression = host->StartKeySuppression(config.keyboardInputMode);
+	PublishSuppressedKeys();
+}
+
+void FeederEngine::StartForegroundTracking() {
+	host->StartForegroundTracking(*this);
+}
+
+void FeederEngine::PublishSuppressedKeys() noexcept {
+	if (!keySuppression)
+		return;
+
+	KeySuppressDevice devices[kMaxRouteDevices];
+	size_t deviceCount = 0;
+	for (unsigned slots = routes.usedSlots; slots != 0; slots &= slots - 1) {
+		int slot = std::countr_zero(slots);
+		if (routes.devices[slot].kind != IdevKind::Keyboard || routes.pads[slot] == 0)
+			continue;
+
+		auto& dev = devices[deviceCount++];
+		dev = { routes.devices[slot].hDevice, {} };
+		for (int key = 0; key < 0xFF; ++key) {
+			if (IsKeyCodeMouseButton(static_cast<KeyCode>(key)))
+				continue;
+			for (unsigned pads = its.boundPads[key] & routes.pads[slot]; pads != 0; pads &= pads - 1) {
+				if (IsRouteAllowed(routes.buttons[slot], its.btns[std::countr_zero(pads)][key])) {
+					dev.keys[key >> 6] |= uint64_t(1) << (key & 63);
+					break;
+				}
 			}
+		}
+	}
+
+	host->PublishSuppressedKeys(std::span(devices, deviceCount));
+}
 
-			if (dev.srcKbd != hDevice) continue;
+void FeederEngine::CompileMouseSticks(int gamepadId) noexcept {
+	auto& gamepad = currentProfile->second.gamepads[gamepadId];
+	mouseSticks.SetLaneParams(MouseStickBatch::LaneOf(gamepadId, false), gamepad.lstick);
+	mouseSticks.SetLaneParams(MouseStickBatch::LaneOf(gamepadId, true), gamepad.rstick);
+}
+
+const ConfigMouseCalibration* FeederEngine::GetMouseCalibration(uint32_t vidPid) const {
+	auto iter = config.mouseCalibrations.find(vidPid);
+	return iter != config.mouseCalibrations.end() ? &iter->second : nullptr;
+}
+
+void FeederEngine::SetMouseCalibration(uint32_t vidPid, const ConfigMouseCalibration& calib) {
+	if (vidPid == 0)
+		return;
+	config.mouseCalibrations.insert_or_assign(vidPid, calib);
+	configDirty = true;
+}
+
+void FeederEngine::ApplyMouseCalibration(InputDevice& idev) const noexcept {
+	auto calib = GetMouseCalibration(idev.GetVidPid());
+	idev.mouseCountScale = calib ? kReferenceMouseDpi / calib->dpi : 1.0f;
+}
+
+void FeederEngine::ResetLatencyStats() noexcept {
+	for (auto& l : x360Latency)
+		l.Reset();
+	profileSwitchLatency.Reset();
+}
+
+void FeederEngine::DumpLatencyStats(std::ostream& out) const {
+	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+		auto& l = x360Latency[gamepadId];
+		l.processing.Dump(out, std::format("Gamepad {} processing", gamepadId));
+		l.endToEnd.Dump(out, std::format("Gamepad {} end-to-end", gamepadId));
+	}
+	profileSwitchLatency.Dump(out, "Profile switch");
+}
+
+void FeederEngine::CaptureRebind(const InputDevice& idev, BYTE vkey) {
+	TRACE_ZONE("FeederEngine::CaptureRebind");
+	if (!rebindPending)
+		return;
+
+	bool isMouse = IsKeyCodeMouseButton(vkey);
+	BYTE routedPads = idev.routeSlot != kNoRouteSlot ? routes.pads[idev.routeSlot] : 0;
+	bool routesChanged = false;
+
+	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+		auto& dev = x360s[gamepadId];
+		auto& gamepad = currentProfile->second.gamepads[gamepadId];
+
+		bool& pendingRebindDevice = isMouse ? dev.pendingRebindMouse : dev.pendingRebindKbd;
+		if (pendingRebindDevice) {
+			RouteExclusively(gamepadId, isMouse ? IdevKind::Mouse : IdevKind::Keyboard, idev.hDevice);
+			routedPads |= 1 << gamepadId;
+			routesChanged = true;
+			pendingRebindDevice = false;
 		}
 
-		// Handle button rebinds
-		if (dev.pendingRebindBtn != None) {
+		if (!(routedPads & (1 << gamepadId))) continue;
+
+		if (dev.pendingRebindBtn != X360Button::None) {
 			gamepad.buttons[std::to_underlying(dev.pendingRebindBtn)] = vkey;
 			its.PopulateBtnLut(gamepadId, gamepad);
+			configDirty = true;
 
-			dev.pendingRebindBtn = None;
+			dev.pendingRebindBtn = X360Button::None;
 		}
+	}
 
-		// Bits in X360Gamepad::stickKeys corresponding to each button
-		enum { LUp, LDown, LLeft, LRight, RUp, RDown, RLeft, RRight };
+	rebindPending = std::ranges::any_of(x360s, [](const X360Gamepad& dev) {
+		return dev.pendingRebindKbd || dev.pendingRebindMouse || dev.pendingRebindBtn != X360Button::None;
+	});
+	if (routesChanged)
+		CompileRoutes();
+	else
+		PublishSuppressedKeys();
+}
+
+void FeederEngine::HandleKeyPress(const InputDevice& idev, BYTE vkey, bool pressed, const InputTimestamp& ts) {
+	TRACE_ZONE("FeederEngine::HandleKeyPress");
+
+	uint8_t slot = idev.routeSlot;
+	if (slot == kNoRouteSlot)
+		return;
+	uint32_t allowed = routes.buttons[slot];
+	auto slotBit = static_cast<RouteSlotMask>(1 << slot);
+
+	// Only the gamepads the device is routed to that have the key bound
+	for (unsigned pads = its.boundPads[vkey] & routes.pads[slot]; pads != 0; pads &= pads - 1) {
+		int gamepadId = std::countr_zero(pads);
+		auto& dev = x360s[gamepadId];
+		auto binding = its.btns[gamepadId][vkey];
 
-		X360Button btn = its.btns[gamepadId][vkey];
-		if (btn == None)
+		if (!IsRouteAllowed(allowed, binding)) [[unlikely]]
 			continue;
-		if (IsX360ButtonDirectMap(btn)) {
-			dev.SetButton(X360ButtonToViGEm(btn), pressed);
-		}
-		else switch (btn) {
-		case LeftTrigger: dev.SetLeftTrigger(pressed ? 0xFF : 0x00); break;
-		case RightTrigger:dev.SetRightTrigger(pressed ? 0xFF : 0x00); break;
-
-			// NOTE: we assume that if any key is setup for the joystick directions, it's on keyboard mode
-			//       that is, we rely on the translation struct being populated from the current user config correctly
-
-#define SET_BIT(nth) SetUnsetBit(dev.stickKeys, nth, pressed)
-#define HAS_BIT(nth) (dev.stickKeys & (1 << nth))
-		case LStickUp: SET_BIT(LUp); goto lstick;
-		case LStickDown: SET_BIT(LDown); goto lstick;
-		case LStickLeft: SET_BIT(LLeft); goto lstick;
-		case LStickRight: SET_BIT(LRight); goto lstick;
-		lstick: {
-			auto val = static_cast<SHORT>(MAXSHORT * gamepad.lstick.speed);
-			dev.SetStickLX((HAS_BIT(LRight) ? val : 0) - (HAS_BIT(LLeft) ? val : 0));
-			dev.SetStickLY((HAS_BIT(LUp) ? val : 0) - (HAS_BIT(LDown) ? val : 0));
-		} break;
-
-		case RStickUp: SET_BIT(RUp); goto rstick;
-		case RStickDown: SET_BIT(RDown); goto rstick;
-		case RStickLeft: SET_BIT(RLeft); goto rstick;
-		case RStickRight: SET_BIT(RRight); goto rstick;
-		rstick: {
-			auto val = static_cast<SHORT>(MAXSHORT * gamepad.lstick.speed);
-			dev.SetStickRX((HAS_BIT(RRight) ? val : 0) - (HAS_BIT(RLeft) ? val : 0));
-			dev.SetStickRY((HAS_BIT(RUp) ? val : 0) - (HAS_BIT(RDown) ? val : 0));
-		} break;
-#undef HAS_BIT
-#undef SET_BIT
+
+		// Merged devices: a release only counts once no other device holds the key
+		auto& holders = dev.keyHolders[vkey];
+		if (pressed)
+			holders |= slotBit;
+		else if ((holders &= ~slotBit) != 0)
+			continue;
+
+		if (binding.buttonMask != 0) [[likely]]
+			dev.SetButton(static_cast<XUSB_BUTTON>(binding.buttonMask), pressed);
+		else if (binding.keymapped && TranslateKeymapKey(*its.keymaps[gamepadId], dev.keymap, vkey, pressed, dev.state.wButtons))
+			; // Consumed by a layer or multi-button key
+		else if (binding.btn == X360Button::None)
+			; // Only part of a chord
+		else if (IsX360ButtonDirectMap(binding.btn))
+			HandleButtonAction(gamepadId, binding.btn, pressed);
+		else {
+			its.handlers[gamepadId](dev, currentProfile->second.gamepads[gamepadId], binding.btn, pressed);
+			if (dev.rampingAxes != 0 && !rampTimers[gamepadId].IsArmed())
+				StartRamps(gamepadId);
 		}
 
 		dev.SendReport();
+		x360Latency[gamepadId].Record(ts, QpcNow());
+		++stateVersion;
 	}
 }
 
-static float Scale(float x, float lowerbound, float upperbound) {
-	return (x - lowerbound) / (upperbound - lowerbound);
+// ButtonActionState::phase
+enum : uint8_t {
+	kActionIdle = 0,
+	// Turbo
+	kTurboDown = 1,
+	kTurboUp,
+	// TapHold
+	kHoldPending = 1,
+	kHolding,
+	kTapping,
+	// Sequence: the current step is phase - kSequenceFirstStep
+	kSequenceFirstStep = 1,
+};
+
+uint64_t FeederEngine::GetActionTick() const noexcept {
+	return static_cast<uint64_t>(QpcNow() - qpcActionTickOrigin) * kActionTicksPerSecond / QpcFrequency();
 }
 
-constexpr float pi = 3.14159265358979323846f;
+void FeederEngine::ScheduleButtonAction(ButtonActionState& st, float ms) noexcept {
+	auto ticks = static_cast<uint64_t>(std::ceil(ms * (kActionTicksPerSecond / 1000.0f)));
+	actionTimers.Schedule(st, ticks);
+}
 
-/// \param phi phi ∈ [0,2π], defines in which direction the stick is tilted.
-/// \param tilt tilt ∈ (0,1], defines the amount of tilt. 0 is no tilt, 1 is full tilt.
-static void CalcJoystickPosition(float phi, float tilt, bool invertX, bool invertY, short& outX, short& outY) {
-	constexpr float kSnapToFullFilt = 0.005f;
+void FeederEngine::ArmActionTimer() noexcept {
+	uint64_t ticks = actionTimers.GetTicksUntilNext();
+	if (ticks == TimerWheel::kNever) {
+		host->CancelActionTimer();
+		return;
+	}
 
-	tilt = std::clamp(tilt, 0.0f, 1.0f);
-	tilt = (1 - tilt) < kSnapToFullFilt ? 1 : tilt;
+	host->SetActionTimer(*this, static_cast<int64_t>(ticks * (1'000'000 / kActionTicksPerSecond)));
+}
 
-#define UNNORMALIZE(VAL) static_cast<short>(VAL * 32767) 
+void FeederEngine::ResetButtonActions() noexcept {
+	for (auto& pad : buttonActions) {
+		for (auto& st : pad) {
+			actionTimers.Cancel(st);
+			st.phase = kActionIdle;
+		}
+	}
+	for (auto& rt : rampTimers)
+		actionTimers.Cancel(rt);
+	// Moving ramps jump to their targets
+	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+		auto& dev = x360s[gamepadId];
+		for (unsigned axes = dev.rampingAxes; axes != 0; axes &= axes - 1) {
+			int axis = std::countr_zero(axes);
+			dev.ramps[axis].level = dev.ramps[axis].target;
+			ApplyRampAxis(dev, currentProfile->second.gamepads[gamepadId], axis);
+		}
+		dev.rampingAxes = 0;
+	}
+	ArmActionTimer();
+}
+
+void FeederEngine::StartRamps(int gamepadId) noexcept {
+	auto& rt = rampTimers[gamepadId];
+	actionTimers.AdvanceTo(GetActionTick());
+	rt.lastTick = actionTimers.GetCurrentTick();
+	actionTimers.Schedule(rt, kRampTicks);
+	ArmActionTimer();
+}
 
-#define STICK_MORE_VERTI(LOWERBOUND, UPPERBOUND, X_DIR, Y_DIR) \
-	if (phi >= LOWERBOUND && phi <= UPPERBOUND) { \
-		outX = UNNORMALIZE(X_DIR * tilt * Scale(phi, LOWERBOUND, UPPERBOUND)); \
-		outY = UNNORMALIZE(Y_DIR * tilt); \
-		return; \
+void FeederEngine::OnRampTimer(RampTimer& rt) noexcept {
+	auto& dev = x360s[rt.gamepadId];
+	auto& gamepad = currentProfile->second.gamepads[rt.gamepadId];
+
+	// Fired on its exact tick, so steps are deterministic
+	uint64_t now = actionTimers.GetCurrentTick();
+	float dt = static_cast<float>(now - rt.lastTick) / kActionTicksPerSecond;
+	rt.lastTick = now;
+
+	for (unsigned axes = dev.rampingAxes; axes != 0; axes &= axes - 1) {
+		int axis = std::countr_zero(axes);
+		if (!dev.ramps[axis].Advance(GetRampConfig(gamepad, axis), dt))
+			dev.rampingAxes &= ~(1 << axis);
+		ApplyRampAxis(dev, gamepad, axis);
 	}
-#define STICK_MORE_HORIZ(LOWERBOUND, UPPERBOUND, X_DIR, Y_DIR) \
-	if (phi >= LOWERBOUND && phi <= UPPERBOUND) { \
-		outX = UNNORMALIZE(X_DIR * tilt); \
-		outY = UNNORMALIZE(Y_DIR * tilt * Scale(phi, LOWERBOUND, UPPERBOUND)); \
-		return; \
+
+	dev.SendReport();
+	++stateVersion;
+	if (dev.rampingAxes != 0)
+		actionTimers.Schedule(rt, kRampTicks);
+}
+
+void FeederEngine::HandleButtonAction(int gamepadId, X360Button btn, bool pressed) noexcept {
+	auto& gamepad = currentProfile->second.gamepads[gamepadId];
+	auto& action = gamepad.actions[std::to_underlying(btn)];
+	auto& st = buttonActions[gamepadId][std::to_underlying(btn)];
+	auto& dev = x360s[gamepadId];
+	auto mask = X360ButtonToViGEm(btn);
+
+	// Delays below are relative to the wheel's current tick, which only moves while timers are armed
+	actionTimers.AdvanceTo(GetActionTick());
+
+	switch (action.kind) {
+	case ButtonActionKind::Press:
+		if (IsX360ButtonDPad(btn) && gamepad.dpadSocd != SocdMode::Off) {
+			dev.dpadKeys.Set(std::to_underlying(btn), pressed, dev.pressClock);
+			// XUSB_GAMEPAD_DPAD_UP..RIGHT are bits 0-3, same as the SOCD bits
+			dev.state.wButtons = static_cast<USHORT>((dev.state.wButtons & ~0xF) | dev.dpadKeys.Resolve(gamepad.dpadSocd));
+		}
+		else {
+			dev.SetButton(mask, pressed);
+		}
+		break;
+
+	case ButtonActionKind::Turbo:
+		if (pressed) {
+			dev.SetButton(mask, true);
+			st.phase = kTurboDown;
+			ScheduleButtonAction(st, 500.0f / action.turboRate);
+		}
+		else {
+			actionTimers.Cancel(st);
+			dev.SetButton(mask, false);
+			st.phase = kActionIdle;
+		}
+		break;
+
+	case ButtonActionKind::TapHold:
+		if (pressed) {
+			// Pressed again before the last tap finished
+			if (st.phase == kTapping)
+				dev.SetButton(mask, false);
+			st.phase = kHoldPending;
+			ScheduleButtonAction(st, action.holdTime);
+		}
+		else if (st.phase == kHoldPending) {
+			dev.SetButton(mask, true);
+			st.phase = kTapping;
+			ScheduleButtonAction(st, action.tapTime);
+		}
+		else if (st.phase == kHolding) {
+			if (action.holdButton != X360Button::None)
+				dev.SetButton(X360ButtonToViGEm(action.holdButton), false);
+			st.phase = kActionIdle;
+		}
+		break;
+
+	case ButtonActionKind::Sequence:
+		// Plays to the end regardless of the key being released, pressing again restarts it
+		if (!pressed || action.steps.empty())
+			break;
+		if (st.phase != kActionIdle)
+			dev.SetButton(static_cast<XUSB_BUTTON>(action.steps[st.phase - kSequenceFirstStep].buttons), false);
+		st.phase = kSequenceFirstStep;
+		dev.SetButton(static_cast<XUSB_BUTTON>(action.steps[0].buttons), true);
+		ScheduleButtonAction(st, action.steps[0].duration);
+		break;
 	}
 
-#define POS_X (invertX ? -1 : 1)
-#define NEG_X (invertX ? 1 : -1)
-#define POS_Y (invertY ? -1 : 1)
-#define NEG_Y (invertY ? 1 : -1)
+	ArmActionTimer();
+}
 
-	// Two cases with forward+right
-	// Tilt is forward and slightly right
-	STICK_MORE_VERTI(pi/4, pi/2, POS_X, POS_Y);
-	// Tilt is slightly forward and right.
-	STICK_MORE_HORIZ(0, pi/4, POS_X, POS_Y);
+void FeederEngine::OnButtonActionTimer(ButtonActionState& st) noexcept {
+	auto& action = currentProfile->second.gamepads[st.gamepadId].actions[std::to_underlying(st.btn)];
+	auto& dev = x360s[st.gamepadId];
+	auto mask = X360ButtonToViGEm(st.btn);
 
-	// Two cases with right+downward
-	// Tilt is right and slightly downward.
-	STICK_MORE_HORIZ(-pi/4, 0, POS_X, NEG_Y);
-	// Tilt is downward and slightly right.
-	STICK_MORE_VERTI(-pi/2, -pi/4, POS_X, NEG_Y);
+	switch (action.kind) {
+	case ButtonActionKind::Press:
+		return;
 
-	// Two cases with downward+left
-	// Tilt is downward and slightly left.
-	STICK_MORE_VERTI(-3*pi/4, -pi/2, NEG_X, NEG_Y);
-	// Tilt is left and slightly downward.
-	STICK_MORE_HORIZ(-pi, -3*pi/4, NEG_X, NEG_Y);
+	case ButtonActionKind::Turbo:
+		st.phase = st.phase == kTurboDown ? kTurboUp : kTurboDown;
+		dev.SetButton(mask, st.phase == kTurboDown);
+		ScheduleButtonAction(st, 500.0f / action.turboRate);
+		break;
+
+	case ButtonActionKind::TapHold:
+		if (st.phase == kHoldPending) {
+			if (action.holdButton != X360Button::None)
+				dev.SetButton(X360ButtonToViGEm(action.holdButton), true);
+			st.phase = kHolding;
+		}
+		else if (st.phase == kTapping) {
+			dev.SetButton(mask, false);
+			st.phase = kActionIdle;
+		}
+		break;
+
+	case ButtonActionKind::Sequence: {
+		size_t step = st.phase - kSequenceFirstStep;
+		dev.SetButton(static_cast<XUSB_BUTTON>(action.steps[step].buttons), false);
+		if (++step < action.steps.size()) {
+			++st.phase;
+			dev.SetButton(static_cast<XUSB_BUTTON>(action.steps[step].buttons), true);
+			ScheduleButtonAction(st, action.steps[step].duration);
+		}
+		else {
+			st.phase = kActionIdle;
+		}
+	} break;
+	}
 
-	// Two cases with forward+left
-	// Tilt is left and slightly forward.
-	STICK_MORE_HORIZ(3*pi/4, pi, NEG_X, POS_Y);
-	// Tilt is forward and slightly left.
-	STICK_MORE_VERTI(pi/2, 3*pi/4, NEG_X, POS_Y);
+	dev.SendReport();
+	++stateVersion;
+}
 
-	// If nothing matched, reset stick
-	outX = 0;
-	outY = 0;
+void FeederEngine::RunActionTimers() noexcept {
+	TRACE_ZONE("FeederEngine::RunActionTimers");
+	actionTimers.AdvanceTo(GetActionTick());
+	ArmActionTimer();
 }
 
-void FeederEngine::HandleMouseMovement(const IdevDevice& idev, LONG dx, LONG dy) {
-	HANDLE hDevice = idev.hDevice;
+void FeederEngine::HandleMouseMovement(const InputDevice& idev, LONG dx, LONG dy, const InputTimestamp& ts) {
+	TRACE_ZONE("FeederEngine::HandleMouseMovement");
+	int64_t qpc = ts.IsValid() ? ts.qpcReceived : QpcNow();
+	// Normalized to kReferenceMouseDpi, so that one profile behaves the same across mice
+	float x = static_cast<float>(dx) * idev.mouseCountScale;
+	float y = static_cast<float>(dy) * idev.mouseCountScale;
 
-	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+	if (idev.routeSlot == kNoRouteSlot)
+		return;
+
+	// Merged mice add up their motion
+	for (unsigned pads = routes.pads[idev.routeSlot]; pads != 0; pads &= pads - 1) {
+		int gamepadId = std::countr_zero(pads);
 		auto& dev = x360s[gamepadId];
-		if (dev.srcMouse != hDevice) continue;
 
 		// dx, dy are in positive-right, positive-down
-		// results of atan2() are in traditional math positive-right, positive-up
-		dev.accuMouseX += dx;
-		dev.accuMouseY -= dy;
+		// the stick kernel works in traditional math positive-right, positive-up
+		mouseFilters[gamepadId].AddMotion(config.mouseFilter, x, -y, qpc);
+		if (dev.kind == GamepadKind::DS4)
+			dev.ds4Motion.AddMotion(x, y, qpc);
+		StartSampler();
+
+		if (!dev.pendingMouseTs.IsValid())
+			dev.pendingMouseTs = ts;
 	}
 }
 
 void FeederEngine::Update() {
-	constexpr float kOuterRadius = 10.0f;
+	TRACE_ZONE("FeederEngine::Update");
 	constexpr float kBounceBack = 0.0f;
 
-	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
-		auto& gamepad = currentProfile->second.gamepads[gamepadId];
-		auto& dev = x360s[gamepadId];
-
-		// Skip expensive calculations if both sticks don't use mouse2joystick
-		if (!gamepad.lstick.useMouse && !gamepad.rstick.useMouse)
-			continue;
+	++samplerTicks;
+	// Cleared below by any mouse-driven stick that is still moving or off-center
+	bool atRest = true;
+
+	if (mouseSticks.activeMask != 0) {
+		int64_t qpcNow = QpcNow();
+		for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+			auto& filter = mouseFilters[gamepadId];
+			filter.AdvanceTo(config.mouseFilter, qpcNow);
+			mouseSticks.SetDeflection(gamepadId, filter.GetDeflectionX(), filter.GetDeflectionY());
+			atRest &= filter.IsAtRest();
+		}
 
-		float accuX = dev.accuMouseX;
-		float accuY = dev.accuMouseY;
+		// All sticks of all gamepads in one pass
+		mouseSticks.Compute(kBounceBack);
+	}
 
-		// Distance of mouse from center
-		float r = sqrt(accuX * accuX + accuY * accuY);
+	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+		auto& dev = x360s[gamepadId];
 
-		// Clamp to a point on controller circle, if we are outside it
-		if (r > kOuterRadius) {
-			accuX = round(accuX * (kOuterRadius - kBounceBack) / r);
-			accuY = round(accuY * (kOuterRadius - kBounceBack) / r);
-			r = sqrt(accuX * accuX + accuY * accuY);
+		int lLane = MouseStickBatch::LaneOf(gamepadId, false);
+		int rLane = MouseStickBatch::LaneOf(gamepadId, true);
+		bool useL = mouseSticks.IsLaneActive(lLane);
+		bool useR = mouseSticks.IsLaneActive(rLane);
+		// Touchpad and gyro of a DS4 go out in the same report as its mouse-driven sticks
+		bool useMotion = false;
+		if (dev.kind == GamepadKind::DS4) {
+			const auto& ds4 = currentProfile->second.gamepads[gamepadId].ds4;
+			if (ds4.mouseMode != DS4MouseMode::None) {
+				useMotion = true;
+				atRest &= dev.ds4Motion.Advance(ds4, QpcNow(), QpcFrequency());
+			}
 		}
 
-		float phi = atan2f(accuY, accuX);
-		dev.lastAngle = phi; //DBG
-
-		auto forStick = [&](const ConfigJoystick& conf, short& outX, short& outY) {
-			if (!conf.useMouse)
-				return;
-			if (r > conf.deadzone * kOuterRadius) {
-				float num = r - conf.deadzone * kOuterRadius;
-				float denom = kOuterRadius - conf.deadzone * kOuterRadius;
-				CalcJoystickPosition(phi, pow(num / denom, conf.nonLinear), conf.invertXAxis, conf.invertYAxis, outX, outY);
-			}
-			else {
-				outX = 0;
-				outY = 0;
-			}};
-		forStick(gamepad.lstick, dev.state.sThumbLX, dev.state.sThumbLY);
-		forStick(gamepad.rstick, dev.state.sThumbRX, dev.state.sThumbRY);
+		if (!useL && !useR && !useMotion) {
+			dev.pendingMouseTs = {};
+			continue;
+		}
 
-		dev.accuMouseX = 0.0f;
-		dev.accuMouseY = 0.0f;
+		if (useL) {
+			dev.state.sThumbLX = mouseSticks.outX[lLane];
+			dev.state.sThumbLY = mouseSticks.outY[lLane];
+		}
+		if (useR) {
+			dev.state.sThumbRX = mouseSticks.outX[rLane];
+			dev.state.sThumbRY = mouseSticks.outY[rLane];
+		}
 
 		dev.SendReport();
+		x360Latency[gamepadId].Record(dev.pendingMouseTs, QpcNow());
+		dev.pendingMouseTs = {};
+		++stateVersion;
 	}
+
+	// A filter at rest means a deflection of exactly 0, so the report just sent has all mouse-driven sticks centered
+	// Likewise a DS4 at rest has its finger lifted and no rotation
+	// Nothing can change until the next mouse movement, which restarts the sampler
+	if (atRest)
+		StopSampler();
 }
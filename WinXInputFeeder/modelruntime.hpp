@@ -1,53 +1,68 @@
 #pragma once
 
 #include "modelconfig.hpp"
-
-#include <ViGEm/Client.h>
+#include "ds4report.hpp"
+#include "enginehost.hpp"
+#include "foreground.hpp"
+#include "gamepadsink.hpp"
+#include "inputsource.hpp"
+#include "keymap.hpp"
+#include "latency.hpp"
+#include "mousefilter.hpp"
+#include "ramp.hpp"
+#include "routing.hpp"
+#include "socd.hpp"
+#include "stickkernel.hpp"
+#include "timerwheel.hpp"
 
 #include <cassert>
-#include <minwindef.h>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <string_view>
 #include <span>
+#include <thread>
 #include <vector>
 
-struct ViGEm {
-	PVIGEM_CLIENT hvigem;
-
-	ViGEm();
-	~ViGEm();
-
-	ViGEm(const ViGEm&) = delete;
-	ViGEm& operator=(const ViGEm&) = delete;
-	ViGEm(ViGEm&&) noexcept;
-	ViGEm& operator=(ViGEm&&) noexcept;
+// Analog values driven by keys, see X360Gamepad::ramps
+enum RampAxisId {
+	kRampLX, kRampLY,
+	kRampRX, kRampRY,
+	kRampLT, kRampRT,
+	kRampAxisCount,
 };
 
+// State is kept as an XUSB_REPORT regardless of kind, DS4 targets translate it when sending
 struct X360Gamepad {
-	PVIGEM_CLIENT hvigem;
-	PVIGEM_TARGET htarget;
+	GamepadTarget target;
+	GamepadKind kind;
 
-	// If == INVALID_HANDLE_VALUE, accept any input source
-	// Otherwise accept only the specified input source
-	HANDLE srcKbd = INVALID_HANDLE_VALUE;
-	HANDLE srcMouse = INVALID_HANDLE_VALUE;
-
-	float accuMouseX = 0.0f;
-	float accuMouseY = 0.0f;
-	float lastAngle = 0.0f;
+	// Earliest mouse movement not yet reflected in a sent report
+	InputTimestamp pendingMouseTs;
 	XUSB_REPORT state = {};
 
 	X360Button pendingRebindBtn = X360Button::None;
-	BYTE stickKeys = 0;
+	// Held directions, tracked for a D-pad only if it has an SOCD mode, see ConfigGamepad::dpadSocd
+	SocdState dpadKeys, lstickKeys, rstickKeys;
+	// Orders direction presses for SocdMode::LastInput and FirstInput
+	uint32_t pressClock = 0;
+	RampAxis ramps[kRampAxisCount];
+	// Bit N set while ramps[N] hasn't reached its target
+	BYTE rampingAxes = 0;
+	KeymapState keymap;
+	// Route slots holding each key down; the gamepad sees a key held while any device routed to it holds it
+	RouteSlotMask keyHolders[0xFF] = {};
 	bool pendingRebindKbd = false;
 	bool pendingRebindMouse = false;
 
-	X360Gamepad(const ViGEm& client);
-	~X360Gamepad();
+	/* DS4 targets only */
+	DS4Motion ds4Motion;
+	// Packed in place by SendReport()
+	DS4_REPORT_EX ds4Report = {};
 
-	X360Gamepad(const X360Gamepad&) = delete;
-	X360Gamepad& operator=(const X360Gamepad&) = delete;
-	X360Gamepad(X360Gamepad&&) noexcept;
-	X360Gamepad& operator=(X360Gamepad&&) noexcept;
+	X360Gamepad(GamepadSink& sink, GamepadKind kind);
+	// Takes over a target already plugged in, which must be of the given kind
+	X360Gamepad(GamepadTarget target, GamepadKind kind);
 
 	bool GetButton(XUSB_BUTTON) const noexcept;
 	void SetButton(XUSB_BUTTON, bool onoff) noexcept;
@@ -56,18 +71,54 @@ struct X360Gamepad {
 	void SetRightTrigger(BYTE val) noexcept { state.bRightTrigger = val; }
 	void SetStickLX(SHORT val) noexcept { state.sThumbLX = val; }
 	void SetStickLY(SHORT val) noexcept { state.sThumbLY = val; }
-	void SetStickRX(SHORT val) noexcept { state.sThumbLX = val; }
+	void SetStickRX(SHORT val) noexcept { state.sThumbRX = val; }
 	void SetStickRY(SHORT val) noexcept { state.sThumbRY = val; }
 
 	void SendReport();
 };
 
+class FeederEngine;
+
+// Runtime state of a direct map button with a timed action, see ConfigButtonAction
+struct ButtonActionState : TimerNode {
+	FeederEngine* engine;
+	uint8_t gamepadId;
+	X360Button btn;
+	// 0 when idle, otherwise depends on the action kind, see FeederEngine::HandleButtonAction()
+	uint8_t phase = 0;
+};
+
+// Advances the ramps of one gamepad while any of them moves, see ConfigRamp
+struct RampTimer : TimerNode {
+	FeederEngine* engine;
+	uint8_t gamepadId;
+	// Wheel tick the ramps were last advanced at
+	uint64_t lastTick = 0;
+};
+
 // Information and lookup tables computable from a Config object
 // used for translating input key presses/mouse movements into gamepad state
 struct InputTranslationStruct {
+	struct KeyBinding {
+		X360Button btn = X360Button::None;
+		// Goes through the gamepad's keymap first, see TranslateKeymapKey()
+		bool keymapped = false;
+		// XUSB_GAMEPAD_* bit if btn is a direct map button with a plain press action
+		// 0 if it has a timed action, is keymapped, or is handled by the gamepad's KeyHandler
+		USHORT buttonMask = 0;
+	};
+	// Translates a key bound to an analog counterpart, i.e. a trigger or a keyboard stick direction
+	// Instantiated for which of those the gamepad has bound, see PopulateBtnLut().
+	using KeyHandler = void (*)(X360Gamepad& dev, const ConfigGamepad& gamepad, X360Button btn, bool pressed) noexcept;
+
 	// VK_xxx is BYTE, max 255 values
-	// NOTE: XiButton::COUNT is used to indicate "this mapping is not bound"
-	X360Button btns[4][0xFF];
+	KeyBinding btns[kMaxX360Count][0xFF];
+	// Bit N is set if gamepad N has something bound to the key
+	BYTE boundPads[0xFF];
+	KeyHandler handlers[kMaxX360Count];
+	// nullptr if the gamepad has no layers, chords or multi-button keys
+	// Replaced as a whole by FeederEngine::InstallCompiledKeymaps(), left alone by ClearAll() and PopulateBtnLut().
+	std::unique_ptr<KeymapTables> keymaps[kMaxX360Count];
 
 	InputTranslationStruct() {
 		ClearAll();
@@ -76,24 +127,101 @@ struct InputTranslationStruct {
 	void ClearAll();
 	void PopulateBtnLut(int userIndex, const ConfigGamepad& gamepad);
 };
+static_assert(kMaxX360Count <= 8, "InputTranslationStruct::boundPads is a BYTE");
+
+// Resolution of timed button actions, i.e. 250us ticks
+constexpr int kActionTicksPerSecond = 4000;
+// Moving ramps are advanced at 250Hz
+constexpr int kRampTicks = kActionTicksPerSecond / 250;
 
+// Translates input into gamepad state, portable: the platform comes in through EngineHost, gamepads go out through GamepadSink
 class FeederEngine {
 private:
-	ViGEm* vigem;
+	EngineHost* host;
+	GamepadSink* sink;
 	Config config;
 
-	HWND eventHwnd;
-	UINT_PTR mouseCheckTimer;
+	bool samplerRunning = false;
+	uint64_t samplerTicks = 0;
+	// Total time the sampler has been running, excluding the current run
+	int64_t qpcSamplerRunTotal = 0;
+	int64_t qpcSamplerStarted = 0;
+	// Incremented every time any state visible in the UI changes
+	uint64_t stateVersion = 0;
 
 	Config::ProfileRefMut currentProfile = nullptr;
+	// All gamepads despite the name, X360 ones first, in the order of ConfigProfile::gamepads; see X360Gamepad::kind
 	std::vector<X360Gamepad> x360s;
-	//std::vector<DualShockGamepad> dualshocks;
 	InputTranslationStruct its;
+	RouteTable routes;
+	MouseStickBatch mouseSticks;
+	MouseVelocityFilter mouseFilters[kMaxX360Count];
+	GamepadLatency x360Latency[kMaxX360Count];
+	// Turbo, tap/hold and sequence actions; ticks are kActionTicksPerSecond since qpcActionTickOrigin
+	// The host's action timer is set to when it next has something to do, see ArmActionTimer()
+	TimerWheel actionTimers;
+	int64_t qpcActionTickOrigin;
+	ButtonActionState buttonActions[kMaxX360Count][kX360ButtonDirectMapCount];
+	// Armed only while some ramp of the gamepad moves
+	RampTimer rampTimers[kMaxX360Count];
+	// Set once the host hides keys, see StartKeySuppression()
+	bool keySuppression = false;
+	ForegroundSwitcher foregroundSwitcher;
+	// From an application coming to the foreground to its profile being in effect
+	LatencyHistogram profileSwitchLatency;
+	// Bumped by every RequestKeymaps(), so that results of superseded compilations are dropped
+	uint64_t keymapGeneration = 0;
+	std::mutex compiledKeymapsMutex;
+	// Guarded by compiledKeymapsMutex
+	uint64_t compiledKeymapsGeneration = 0;
+	std::vector<std::unique_ptr<KeymapTables>> compiledKeymaps;
 
+	// Set by everything that changes config, cleared by MarkConfigSaved()
 	bool configDirty = false;
+	// Set while any gamepad waits for a key to rebind a device or mapping to, see CaptureRebind()
+	bool rebindPending = false;
+
+	// Last, so that it is joined before anything it touches goes away
+	std::jthread keymapCompiler;
+
+	// Recompile the key translation tables of all gamepads from their current config
+	void CompileKeyBindings() noexcept;
+	// Drop all keymaps and release what they hold, e.g. before gamepad ids change; the key bindings must be recompiled after
+	void ResetKeymaps() noexcept;
+	// Compile the keymaps of the current gamepads on keymapCompiler, installed once done, see EngineHost::PostKeymapsCompiled()
+	// The previous keymaps stay in effect until then.
+	void RequestKeymaps();
+	uint64_t GetActionTick() const noexcept;
+	void HandleButtonAction(int gamepadId, X360Button btn, bool pressed) noexcept;
+	void OnButtonActionTimer(ButtonActionState& st) noexcept;
+	void ScheduleButtonAction(ButtonActionState& st, float ms) noexcept;
+	// Set the host's action timer to the next tick actionTimers has something to do at, or cancel it if nothing is armed
+	void ArmActionTimer() noexcept;
+	void StartRamps(int gamepadId) noexcept;
+	void OnRampTimer(RampTimer& rt) noexcept;
+	// Cancel all timed actions and ramp timers, e.g. before gamepad ids change
+	void ResetButtonActions() noexcept;
+	// Make the device the gamepad's only one of its kind in the profile's routes, or drop them all for INVALID_HANDLE_VALUE
+	// The routes must be recompiled after.
+	void RouteExclusively(int gamepadId, IdevKind kind, HANDLE hDevice);
+	// The device's route in the current profile, created empty if it has none
+	ConfigRoute& GetDeviceRoute(uint8_t slot);
+	// Index the current profile's routes and resolve those of the attached devices, after routes or gamepads changed
+	void CompileRoutes();
+	// Publish the keys bound on each source keyboard to the key suppression hook, after bindings or sources changed
+	void PublishSuppressedKeys() noexcept;
+	// Recompile both mouse stick lanes of the gamepad from its current config
+	void CompileMouseSticks(int gamepadId) noexcept;
+	bool AddGamepad(GamepadKind kind);
+	// Rebuild everything indexed by gamepad id, after gamepads were inserted or removed
+	void OnGamepadIdsChanged();
+
+	void StartSampler() noexcept;
+	void StopSampler() noexcept;
 
 public:
-	FeederEngine(HWND eventHwnd, Config config, ViGEm& vigem);
+	// Both must outlive the engine
+	FeederEngine(EngineHost& host, GamepadSink& sink, Config config);
 	~FeederEngine();
 
 	FeederEngine(const FeederEngine&) = delete;
@@ -102,29 +230,86 @@ public:
 	FeederEngine& operator=(FeederEngine&&) = delete;
 
 	const Config& GetConfig() const { return config; }
+	// Whether the config changed since it was loaded or last saved, i.e. ExportAsToml() has something new to write
+	bool IsConfigDirty() const noexcept { return configDirty; }
+	void MarkConfigSaved() noexcept { configDirty = false; }
+
+	// Have the host hide bound keys from other applications, if enabled in the config
+	// Must be called on a thread that outlives the hook, as hooks are removed when their thread exits.
+	void StartKeySuppression();
+	// Have the host switch profiles as applications come to the foreground, see ConfigProfile::executables
+	// Must be called on the engine's thread, which the events are delivered to.
+	void StartForegroundTracking();
 
 	Config::ProfileRef GetCurrentProfile() const { return currentProfile; }
+	// Gamepads of the same kind at the same id in both profiles stay plugged in
 	void SelectProfile(Config::ProfileRef profile);
 	bool AddProfile(std::string profileName);
 	void RemoveProfile(Config::ProfileRef profile);
+	void SetProfileExecutables(Config::ProfileRef profile, std::vector<std::string> executables);
+	// Switch to the profile mapped to the application, if any, otherwise keep the current one
+	// Called by the host's foreground tracking; anything else can feed it events too, e.g. a scripted source in tests.
+	// \param qpcEvent QueryPerformanceCounter() when the application came to the foreground, the switch latency is measured from it
+	void OnForegroundApp(std::string_view exePath, int64_t qpcEvent);
 
 	std::span<const X360Gamepad> GetX360s() const { return x360s; }
 	bool AddX360();
+	bool AddDS4();
 	bool RemoveGamepad(int gamepadId);
 
+	// Give the device a route slot, or not if all are taken, and resolve its route through the prebuilt index
+	void AttachDevice(InputDevice& idev);
+	void DetachDevice(InputDevice& idev) noexcept;
+	const RouteTable& GetRoutes() const { return routes; }
+	// Add or remove the gamepad from the routes of the device in the given slot, keeping its other gamepads
+	void SetDeviceRoute(int slot, int gamepadId, bool routed);
+
 	void StartRebindX360Device(int gamepadId, IdevKind kind);
+	// Route the device as the gamepad's only keyboard or mouse, or unroute all of them for INVALID_HANDLE_VALUE
 	void RebindX360Device(int gamepadId, IdevKind kind, HANDLE);
 
 	void StartRebindX360Mapping(int gamepadId, X360Button btn);
+	bool IsRebindPending() const noexcept { return rebindPending; }
+	// Apply the pending rebinds to the pressed key; rebuilds routes and allocates, so call it before HandleKeyPress() and outside of its no-alloc scope
+	void CaptureRebind(const InputDevice& idev, BYTE vkey);
 	void SetX360JoystickMode(int gamepadId, bool useRight /* false: left */, bool useMouse /* false: keyboard */);
 	// TODO do it this way instead?
 	/*void SetX360JoystickParam(int gamepadId, bool leftright, ); */
 	// DO NOT CHANGE useMouse field to not cause desync - use SetX360JoystickMode instead
+	// After changing any other field, call CommitX360JoystickParams to apply it
 	ConfigJoystick& GetX360JoystickParams(int gamepadId, bool leftright);
+	void CommitX360JoystickParams(int gamepadId, bool leftright);
+
+	// Install the keymaps RequestKeymaps() compiled in the background, unless they were superseded since
+	void InstallCompiledKeymaps() noexcept;
+
+	const MouseStickBatch& GetMouseSticks() const { return mouseSticks; }
+
+	// nullptr if the mouse model was never calibrated
+	const ConfigMouseCalibration* GetMouseCalibration(uint32_t vidPid) const;
+	// Ignored for vidPid 0: a mouse without VID/PID has no model that others could share the calibration of
+	void SetMouseCalibration(uint32_t vidPid, const ConfigMouseCalibration& calib);
+	// Update the device's count scale from the calibration of its model
+	void ApplyMouseCalibration(InputDevice& idev) const noexcept;
+
+	const GamepadLatency& GetX360Latency(int gamepadId) const { return x360Latency[gamepadId]; }
+	const LatencyHistogram& GetProfileSwitchLatency() const { return profileSwitchLatency; }
+	void ResetLatencyStats() noexcept;
+	void DumpLatencyStats(std::ostream& out) const;
+
+	uint64_t GetStateVersion() const noexcept { return stateVersion; }
+
+	// The mouse stick sampler runs only while some mouse-driven stick is off-center or mouse motion is pending
+	bool IsSamplerRunning() const noexcept { return samplerRunning; }
+	uint64_t GetSamplerTicks() const noexcept { return samplerTicks; }
+	// Total time the sampler has been running, in QPC ticks
+	int64_t GetSamplerRunTime() const noexcept;
 
-	void HandleKeyPress(const IdevDevice& idev, BYTE vkey, bool pressed);
-	void HandleMouseMovement(const IdevDevice& idev, LONG dx, LONG dy);
-	// Send joystick state generated from mouse to ViGEm
-	// Triggered on a timer
+	void HandleKeyPress(const InputDevice& idev, BYTE vkey, bool pressed, const InputTimestamp& ts);
+	void HandleMouseMovement(const InputDevice& idev, LONG dx, LONG dy, const InputTimestamp& ts);
+	// Fire the timed actions that are due, called by the host's action timer
+	void RunActionTimers() noexcept;
+	// Send joystick state generated from mouse to the sink
+	// Triggered by the host's sampler timer, which is stopped once all mouse-driven sticks came to rest at the center
 	void Update();
 };
@@ -0,0 +1,95 @@
+#include "pch.hpp"
+
+#include "mousefilter.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr float kPi = 3.14159265358979323846f;
+
+// Below this deflection (in counts over kMouseReferenceWindow), the estimate is snapped to exactly 0, so that it comes
+// to rest in finite time instead of decaying forever
+constexpr float kRestThreshold = 0.001f;
+// Gaps between packets longer than this are pauses in movement, not the polling interval
+constexpr float kMaxPacketInterval = 0.05f;
+
+// Time constant of the filter in seconds, given the current velocity estimate
+static float GetTimeConstant(const ConfigMouseFilter& conf, float vx, float vy) noexcept {
+	switch (conf.kind) {
+	case MouseFilterKind::Ema:
+		return std::max(conf.timeConstant, 1.0f) / 1000.0f;
+	case MouseFilterKind::OneEuro: {
+		// One-euro filter: the cutoff frequency rises with speed, trading smoothing at rest for less lag when moving fast
+		float speed = std::sqrt(vx * vx + vy * vy);
+		float cutoff = std::max(conf.minCutoff, 0.01f) + conf.beta * speed;
+		return 1.0f / (2.0f * kPi * cutoff);
+	}
+	}
+	return kMouseReferenceWindow;
+}
+
+static float QpcToSeconds(int64_t qpcDelta) noexcept {
+	return static_cast<float>(static_cast<double>(qpcDelta) / static_cast<double>(QpcFrequency()));
+}
+
+static int64_t SecondsToQpc(float seconds) noexcept {
+	return static_cast<int64_t>(static_cast<double>(seconds) * static_cast<double>(QpcFrequency()));
+}
+
+void MouseVelocityFilter::DecayTo(const ConfigMouseFilter& conf, int64_t qpc) noexcept {
+	// The estimate is held (not decayed) for a while after each packet
+	int64_t begin = std::max(qpcDecayed, qpcLastPacket + SecondsToQpc(GetHoldTime()));
+	if (qpc <= begin || IsAtRest())
+		return;
+
+	float decay = std::exp(-QpcToSeconds(qpc - begin) / GetTimeConstant(conf, vx, vy));
+	vx *= decay;
+	vy *= decay;
+	qpcDecayed = qpc;
+}
+
+void MouseVelocityFilter::AddMotion(const ConfigMouseFilter& conf, float dx, float dy, int64_t qpc) noexcept {
+	// Length of the interval this packet's movement is spread over
+	float dt;
+	if (qpcLastPacket == 0 || IsAtRest()) {
+		// Movement starting from rest, assume it happened over a regular polling interval
+		dt = packetInterval;
+	}
+	else {
+		// Messages of one batch may be timestamped out of order relative to each other; never go backwards
+		float gap = QpcToSeconds(std::max<int64_t>(qpc - qpcLastPacket, 0));
+		if (gap < kMaxPacketInterval)
+			packetInterval += (gap - packetInterval) * 0.05f;
+
+		DecayTo(conf, qpc);
+		dt = std::min(gap, GetHoldTime());
+	}
+
+	float tau = GetTimeConstant(conf, vx, vy);
+	float decay = std::exp(-dt / tau);
+	// (1 - e^(-dt/tau)) / dt, which tends to 1/tau as dt -> 0, i.e. packets with identical timestamps act as impulses
+	float gain = dt > 1e-6f ? -std::expm1(-dt / tau) / dt : 1.0f / tau;
+	vx = vx * decay + dx * gain;
+	vy = vy * decay + dy * gain;
+
+	qpcLastPacket = std::max(qpcLastPacket, qpc);
+	qpcDecayed = qpcLastPacket;
+}
+
+void MouseVelocityFilter::AdvanceTo(const ConfigMouseFilter& conf, int64_t qpc) noexcept {
+	DecayTo(conf, qpc);
+
+	if (std::abs(GetDeflectionX()) < kRestThreshold && std::abs(GetDeflectionY()) < kRestThreshold) {
+		vx = 0.0f;
+		vy = 0.0f;
+	}
+}
+
+void MouseVelocityFilter::Reset() noexcept {
+	vx = 0.0f;
+	vy = 0.0f;
+	qpcLastPacket = 0;
+	qpcDecayed = 0;
+}
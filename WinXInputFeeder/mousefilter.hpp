@@ -0,0 +1,42 @@
+#pragma once
+
+#include "modelconfig.hpp"
+
+#include <cstdint>
+
+// Mouse movement is turned into a stick deflection through a velocity estimate, rather than by summing whatever packets
+// happened to land in the current Update() tick. This makes the output independent of both the mouse's polling rate and
+// the tick rate.
+//
+// Each motion packet is taken to mean constant velocity since the previous packet, and fed into a continuous-time
+// exponential filter, which is integrated exactly over that interval. Between packets the estimate is held for a couple
+// of (measured) polling intervals, and only after that decays as if the mouse stopped.
+
+// Deflection is expressed as the displacement over this window at the estimated velocity, in mouse counts.
+// This is the default MouseCheckFrequency, so that stick parameters tuned for summing mouse movement per tick keep their meaning.
+constexpr float kMouseReferenceWindow = 0.075f;
+
+struct MouseVelocityFilter {
+	// Estimated velocity in counts per second, positive-right, positive-up
+	float vx = 0.0f;
+	float vy = 0.0f;
+	// Running average of the time between motion packets, in seconds
+	float packetInterval = 0.008f;
+	// QPC of the last motion packet, 0 if none since the last Reset()
+	int64_t qpcLastPacket = 0;
+	// QPC up to which the decay of the estimate has been applied
+	int64_t qpcDecayed = 0;
+
+	void AddMotion(const ConfigMouseFilter& conf, float dx, float dy, int64_t qpc) noexcept;
+	// Bring the estimate up to the given point in time
+	void AdvanceTo(const ConfigMouseFilter& conf, int64_t qpc) noexcept;
+	void Reset() noexcept;
+
+	bool IsAtRest() const noexcept { return vx == 0.0f && vy == 0.0f; }
+	float GetDeflectionX() const noexcept { return vx * kMouseReferenceWindow; }
+	float GetDeflectionY() const noexcept { return vy * kMouseReferenceWindow; }
+
+private:
+	float GetHoldTime() const noexcept { return 2.0f * packetInterval; }
+	void DecayTo(const ConfigMouseFilter& conf, int64_t qpc) noexcept;
+};
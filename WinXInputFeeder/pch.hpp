@@ -31,19 +31,22 @@
 
 ////////// System headers //////////
 
-#define NOMINMAX
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+#include "platform.hpp"
 
+// Only the Windows app uses these, the portable core doesn't, see CMakeLists.txt
+#if defined(_WIN32) && !defined(WXF_PORTABLE_CORE)
 #include <d3d11.h>
 #include <hidusage.h>
 #include <tlhelp32.h>
 #include <shellapi.h>
+#endif
 
 ////////// 3rd party headers //////////
 
+#if defined(_WIN32) && !defined(WXF_PORTABLE_CORE)
 #include <imgui.h>
 #include <imgui_impl_dx11.h>
 #include <imgui_impl_win32.h>
 #include <imgui_stdlib.h>
+#endif
 #include <toml++/toml.h>
@@ -0,0 +1,57 @@
+#include "pch.hpp"
+
+#include "ramp.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+constexpr int kRampCurveSteps = 256;
+constexpr int kRampCurveCount = 4;
+
+// Indexed by RampCurve, then by level in kRampCurveSteps steps
+static constexpr auto kRampCurves = [] {
+	std::array<std::array<float, kRampCurveSteps + 1>, kRampCurveCount> res{};
+	for (int i = 0; i <= kRampCurveSteps; ++i) {
+		float x = static_cast<float>(i) / kRampCurveSteps;
+		res[std::to_underlying(RampCurve::Linear)][i] = x;
+		res[std::to_underlying(RampCurve::EaseIn)][i] = x * x;
+		res[std::to_underlying(RampCurve::EaseOut)][i] = 1.0f - (1.0f - x) * (1.0f - x);
+		res[std::to_underlying(RampCurve::Smooth)][i] = x * x * (3.0f - 2.0f * x);
+	}
+	return res;
+}();
+
+bool RampAxis::Advance(const ConfigRamp& ramp, float dt) noexcept {
+	// At most twice, when passing the center
+	while (dt > 0.0f && level != target) {
+		float goal, time;
+		if (level == 0.0f || (target > level) == (level > 0.0f)) {
+			goal = target;
+			time = ramp.attackTime;
+		}
+		else {
+			goal = level > 0.0f ? std::max(target, 0.0f) : std::min(target, 0.0f);
+			time = ramp.releaseTime;
+		}
+
+		// Landing exactly on goal, so that ramps always end
+		float needed = std::abs(goal - level) * time / 1000.0f;
+		if (needed <= dt) {
+			level = goal;
+			dt -= needed;
+		}
+		else {
+			float step = dt * 1000.0f / time;
+			level += goal > level ? step : -step;
+			dt = 0.0f;
+		}
+	}
+	return level != target;
+}
+
+float RampAxis::Output(RampCurve curve) const noexcept {
+	auto& table = kRampCurves[std::to_underlying(curve)];
+	float mag = table[std::lround(std::abs(level) * kRampCurveSteps)];
+	return level < 0.0f ? -mag : mag;
+}
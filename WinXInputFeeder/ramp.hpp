@@ -0,0 +1,18 @@
+#pragma once
+
+#include "modelconfig.hpp"
+
+// One key-driven analog axis, moving towards its target over time as set by a ConfigRamp
+struct RampAxis {
+	// -1..1, linear in time; the curve shapes it into the output
+	float level = 0.0f;
+	// -1, 0 or 1 for a stick axis, 0 or 1 for a trigger
+	float target = 0.0f;
+
+	// Move towards target by `dt` seconds
+	// Away from the center takes ConfigRamp::attackTime, towards it releaseTime; going past it releases to 0, then attacks.
+	// \return whether it still hasn't reached target
+	bool Advance(const ConfigRamp& ramp, float dt) noexcept;
+	// -1..1, level shaped by the curve's precomputed table
+	float Output(RampCurve curve) const noexcept;
+};
@@ -0,0 +1,97 @@
+#include "pch.hpp"
+
+#include "routing.hpp"
+
+#include <bit>
+#include <utility>
+
+std::string NormalizeDeviceName(std::string_view name) {
+	std::string res(name);
+	for (char& c : res) {
+		if ('A' <= c && c <= 'Z')
+			c = static_cast<char>(c - 'A' + 'a');
+	}
+	return res;
+}
+
+uint64_t RouteTable::MakeModelKey(uint32_t vidPid, IdevKind kind, uint8_t ordinal) noexcept {
+	return static_cast<uint64_t>(vidPid) << 16 | static_cast<uint64_t>(std::to_underlying(kind) & 0xFF) << 8 | ordinal;
+}
+
+uint8_t RouteTable::Attach(HANDLE hDevice, std::string_view name, IdevKind kind, uint32_t vidPid) {
+	RouteSlotMask freeSlots = static_cast<RouteSlotMask>(~usedSlots);
+	if (freeSlots == 0)
+		return kNoRouteSlot;
+
+	// Reconnecting one of two identical keyboards gives it back its ordinal, not the other's
+	uint32_t takenOrdinals = 0;
+	for (unsigned slots = usedSlots; slots != 0; slots &= slots - 1) {
+		auto& other = devices[std::countr_zero(slots)];
+		if (other.vidPid == vidPid && other.kind == kind && other.ordinal < 32)
+			takenOrdinals |= uint32_t(1) << other.ordinal;
+	}
+
+	auto slot = static_cast<uint8_t>(std::countr_zero(freeSlots));
+	usedSlots |= 1 << slot;
+	devices[slot] = { hDevice, NormalizeDeviceName(name), kind, vidPid, static_cast<uint8_t>(std::countr_one(takenOrdinals)) };
+	pads[slot] = 0;
+	buttons[slot] = kAllRouteButtons;
+	return slot;
+}
+
+void RouteTable::Detach(uint8_t slot) noexcept {
+	usedSlots &= ~(1 << slot);
+	devices[slot].hDevice = INVALID_HANDLE_VALUE;
+	pads[slot] = 0;
+}
+
+void RouteTable::Index(std::span<const ConfigRoute> routes) {
+	routeByName.clear();
+	routeByModel.clear();
+	for (size_t i = 0; i < routes.size(); ++i) {
+		auto& route = routes[i];
+		// First one wins, as with a linear search
+		routeByName.try_emplace(NormalizeDeviceName(route.device), static_cast<uint16_t>(i));
+		if (route.vidPid != 0)
+			routeByModel.try_emplace(MakeModelKey(route.vidPid, route.kind, route.ordinal), static_cast<uint16_t>(i));
+	}
+}
+
+int RouteTable::FindRoute(const RouteDevice& device) const noexcept {
+	if (auto iter = routeByName.find(device.name); iter != routeByName.end())
+		return iter->second;
+	if (device.vidPid == 0)
+		return -1;
+	if (auto iter = routeByModel.find(MakeModelKey(device.vidPid, device.kind, device.ordinal)); iter != routeByModel.end())
+		return iter->second;
+	return -1;
+}
+
+int RouteTable::ResolveSlot(uint8_t slot, std::span<const ConfigRoute> routes, int gamepadCount) noexcept {
+	auto padMask = static_cast<BYTE>((1 << gamepadCount) - 1);
+	int idx = FindRoute(devices[slot]);
+	if (idx >= 0) {
+		pads[slot] = routes[idx].pads & padMask;
+		buttons[slot] = routes[idx].buttons;
+	}
+	else {
+		pads[slot] = 0;
+		buttons[slot] = kAllRouteButtons;
+	}
+	return idx;
+}
+
+void RouteTable::Resolve(std::span<const ConfigRoute> routes, int gamepadCount) noexcept {
+	for (unsigned slots = usedSlots; slots != 0; slots &= slots - 1)
+		ResolveSlot(static_cast<uint8_t>(std::countr_zero(slots)), routes, gamepadCount);
+}
+
+RouteSlotMask RouteTable::GetSlotsOf(int gamepadId) const noexcept {
+	RouteSlotMask res = 0;
+	for (unsigned slots = usedSlots; slots != 0; slots &= slots - 1) {
+		int slot = std::countr_zero(slots);
+		if (pads[slot] & (1 << gamepadId))
+			res |= 1 << slot;
+	}
+	return res;
+}
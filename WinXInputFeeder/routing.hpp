@@ -0,0 +1,68 @@
+#pragma once
+
+#include "inputsource.hpp"
+#include "modelconfig.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+constexpr int kMaxRouteDevices = 16;
+constexpr uint8_t kNoRouteSlot = 0xFF;
+// Bit N for route slot N
+using RouteSlotMask = uint16_t;
+static_assert(kMaxRouteDevices <= 16, "RouteSlotMask is 16 bits");
+static_assert(kMaxX360Count <= 8, "RouteTable::pads is a BYTE");
+
+// An attached keyboard or mouse, see RouteTable
+struct RouteDevice {
+	HANDLE hDevice = INVALID_HANDLE_VALUE;
+	// Device interface name, normalized, see NormalizeDeviceName()
+	std::string name;
+	IdevKind kind = IdevKind::Keyboard;
+	// See InputDevice::GetVidPid(), 0 if the name has none
+	uint32_t vidPid = 0;
+	// Among attached devices of the same VID/PID and kind, the lowest not taken by another
+	uint8_t ordinal = 0;
+};
+
+// Which gamepads each attached device drives, resolved from the current profile's routes
+// A device holds a slot while attached, which the hot path reaches through InputDevice::routeSlot.
+// A route matches a device by interface name, or failing that, by VID/PID and ordinal, as the name changes when
+// a device is plugged into another port; those lookups go through an index built once per change of the routes.
+struct RouteTable {
+	RouteDevice devices[kMaxRouteDevices];
+	RouteSlotMask usedSlots = 0;
+	// Gamepad bits per slot, limited to existing gamepads
+	BYTE pads[kMaxRouteDevices] = {};
+	// ConfigRoute::buttons per slot
+	uint32_t buttons[kMaxRouteDevices] = {};
+
+	// Lowercase interface name -> index in the routes passed to Index()
+	std::unordered_map<std::string, uint16_t> routeByName;
+	// MakeModelKey() -> index in the routes passed to Index()
+	std::unordered_map<uint64_t, uint16_t> routeByModel;
+
+	// \return the slot, or kNoRouteSlot if all are taken
+	uint8_t Attach(HANDLE hDevice, std::string_view name, IdevKind kind, uint32_t vidPid);
+	void Detach(uint8_t slot) noexcept;
+
+	// Rebuild the lookup index, after routes were added or renamed
+	void Index(std::span<const ConfigRoute> routes);
+	// \return the index of the device's route in the routes last indexed, or -1
+	int FindRoute(const RouteDevice& device) const noexcept;
+	// Fill pads and buttons of one attached device, routes must be the ones last indexed
+	// \return the index of its route, or -1
+	int ResolveSlot(uint8_t slot, std::span<const ConfigRoute> routes, int gamepadCount) noexcept;
+	// ResolveSlot() for every attached device
+	void Resolve(std::span<const ConfigRoute> routes, int gamepadCount) noexcept;
+	// Slots routed to the gamepad
+	RouteSlotMask GetSlotsOf(int gamepadId) const noexcept;
+
+	static uint64_t MakeModelKey(uint32_t vidPid, IdevKind kind, uint8_t ordinal) noexcept;
+};
+
+// Interface names differ in case between APIs and Windows versions
+std::string NormalizeDeviceName(std::string_view name);
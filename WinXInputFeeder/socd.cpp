@@ -0,0 +1,41 @@
+#include "pch.hpp"
+
+#include "socd.hpp"
+
+void SocdState::Set(int dir, bool pressed, uint32_t& clock) noexcept {
+	BYTE bit = 1 << dir;
+	if (pressed) {
+		// Typematic repeats don't count as new presses
+		if (!(held & bit))
+			pressedAt[dir] = ++clock;
+		held |= bit;
+	}
+	else {
+		held &= ~bit;
+	}
+}
+
+// \param first index into pressedAt of the axis' negative direction, i.e. up or left
+static BYTE ResolveAxis(SocdMode mode, BYTE axis, int first, const uint32_t (&pressedAt)[4]) noexcept {
+	BYTE a = 1 << first;
+	BYTE b = 1 << (first + 1);
+	if (axis != (a | b))
+		return axis;
+
+	// Wraparound safe, as long as both presses are less than 2^31 presses apart
+	bool aLater = static_cast<int32_t>(pressedAt[first] - pressedAt[first + 1]) > 0;
+	switch (mode) {
+	case SocdMode::Off: return axis;
+	case SocdMode::Neutral: return 0;
+	case SocdMode::LastInput: return aLater ? a : b;
+	case SocdMode::FirstInput: return aLater ? b : a;
+	// Up wins on the vertical axis, the horizontal one goes neutral, as on leverless fight sticks
+	case SocdMode::Absolute: return first == 0 ? a : 0;
+	}
+	return axis;
+}
+
+BYTE SocdState::Resolve(SocdMode mode) const noexcept {
+	return ResolveAxis(mode, held & (kSocdUp | kSocdDown), 0, pressedAt)
+		| ResolveAxis(mode, held & (kSocdLeft | kSocdRight), 2, pressedAt);
+}
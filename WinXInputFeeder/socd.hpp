@@ -0,0 +1,26 @@
+#pragma once
+
+#include "modelconfig.hpp"
+
+#include <cstdint>
+
+// Bits of SocdState::held, in the same order as X360Button::DPadUp.. and X360Button::LStickUp..
+enum : BYTE {
+	kSocdUp = 1 << 0,
+	kSocdDown = 1 << 1,
+	kSocdLeft = 1 << 2,
+	kSocdRight = 1 << 3,
+};
+
+// Directions held on one stick or D-pad, and the order they were pressed in
+struct SocdState {
+	BYTE held = 0;
+	// Logical timestamp of each direction's last press, from the gamepad's press counter
+	uint32_t pressedAt[4] = {};
+
+	// \param dir 0..3 for up, down, left, right
+	// \param clock the gamepad's press counter, advanced on every new press
+	void Set(int dir, bool pressed, uint32_t& clock) noexcept;
+	// Directions to output, as bits like held
+	BYTE Resolve(SocdMode mode) const noexcept;
+};
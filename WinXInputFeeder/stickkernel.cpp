@@ -0,0 +1,313 @@
+#include "pch.hpp"
+
+#include "stickkernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#define WXF_STICK_KERNEL_AVX2
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WXF_STICK_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+float MouseStickBatch::EvalTiltCurve(float u, float deadzone, float nonLinear) noexcept {
+	if (u <= deadzone)
+		return 0.0f;
+	float t = EvalLiveZoneCurve((u - deadzone) / (1.0f - deadzone), nonLinear);
+	return (1.0f - t) < kSnapToFullTilt ? 1.0f : t;
+}
+
+float MouseStickBatch::EvalLiveZoneCurve(float t, float nonLinear) noexcept {
+	return std::clamp(std::pow(t, nonLinear), 0.0f, 1.0f);
+}
+
+void MouseStickBatch::SetLaneParams(int lane, const ConfigJoystick& conf) noexcept {
+	if (!conf.useMouse) {
+		ClearLane(lane);
+		return;
+	}
+
+	// Sensitivity scales the mouse movement itself, so that outer radius (and the clamp to it) stays in the same units for every setting
+	gain[lane] = kNeutralSensitivity / std::max(conf.sensitivity, kMinSensitivity);
+	outerRadius[lane] = std::max(conf.outerRadius, kMinOuterRadius);
+	signX[lane] = conf.invertXAxis ? -1.0f : 1.0f;
+	signY[lane] = conf.invertYAxis ? -1.0f : 1.0f;
+	deadzone[lane] = std::clamp(conf.deadzone, 0.0f, 1.0f);
+
+	// The LUT only replaces the pow() of the non-linearity. Everything else stays arithmetic in ComputeLanes(), per
+	// lane per tick: gain, clamping to the outer radius, the deadzone cut and renormalization, snapping to full tilt,
+	// the octant mapping and inversion. Their parameters above are only range checked and stored.
+	// Sampled at t = v^4 instead of evenly, so that curves that are steep near the center (nonLinear < 1) still
+	// get interpolated accurately there: pow(v^4, nonLinear) is smooth near 0 for nonLinear >= 0.25
+	for (int i = 0; i <= kLutSegments; ++i) {
+		float v = static_cast<float>(i) / kLutSegments;
+		tiltLut[lane][i] = EvalLiveZoneCurve(v * v * v * v, conf.nonLinear);
+	}
+
+	activeMask |= 1u << lane;
+}
+
+void MouseStickBatch::ClearLane(int lane) noexcept {
+	deflX[lane] = 0.0f;
+	deflY[lane] = 0.0f;
+	gain[lane] = 1.0f;
+	outerRadius[lane] = 1.0f;
+	deadzone[lane] = 0.0f;
+	signX[lane] = 1.0f;
+	signY[lane] = 1.0f;
+	for (float& v : tiltLut[lane])
+		v = 0.0f;
+	outX[lane] = 0;
+	outY[lane] = 0;
+	activeMask &= ~(1u << lane);
+}
+
+void MouseStickBatch::Clear() noexcept {
+	for (int lane = 0; lane < kLaneCount; ++lane)
+		ClearLane(lane);
+}
+
+void MouseStickBatch::SetDeflection(int gamepadId, float x, float y) noexcept {
+	int l = LaneOf(gamepadId, false);
+	int r = LaneOf(gamepadId, true);
+	deflX[l] = x; deflY[l] = y;
+	deflX[r] = x; deflY[r] = y;
+}
+
+// Each of the following implements the same set of operations on a different vector width, for use by ComputeLanes<>()
+
+struct VecScalar {
+	using F = float;
+	using M = bool;
+	static constexpr int kWidth = 1;
+
+	static F Load(const float* p) noexcept { return *p; }
+	static void Store(float* p, F v) noexcept { *p = v; }
+	static F Set(float v) noexcept { return v; }
+	static F Add(F a, F b) noexcept { return a + b; }
+	static F Sub(F a, F b) noexcept { return a - b; }
+	static F Mul(F a, F b) noexcept { return a * b; }
+	static F Div(F a, F b) noexcept { return a / b; }
+	static F Min(F a, F b) noexcept { return a < b ? a : b; }
+	static F Max(F a, F b) noexcept { return a > b ? a : b; }
+	static F Sqrt(F a) noexcept { return std::sqrt(a); }
+	static F Abs(F a) noexcept { return std::fabs(a); }
+	static F RoundAway(F a) noexcept { return std::round(a); }
+	static M Gt(F a, F b) noexcept { return a > b; }
+	static M Ge(F a, F b) noexcept { return a >= b; }
+	static M Lt(F a, F b) noexcept { return a < b; }
+	static M Eq(F a, F b) noexcept { return a == b; }
+	static M And(M a, M b) noexcept { return a && b; }
+	static M Or(M a, M b) noexcept { return a || b; }
+	static M Xor(M a, M b) noexcept { return a != b; }
+	static F Select(M m, F a, F b) noexcept { return m ? a : b; }
+	static M SelectMask(M m, M a, M b) noexcept { return m ? a : b; }
+	static void StoreTruncated(int16_t* p, F v) noexcept { *p = static_cast<int16_t>(v); }
+};
+
+#ifdef WXF_STICK_KERNEL_SSE2
+struct VecSse2 {
+	using F = __m128;
+	using M = __m128;
+	static constexpr int kWidth = 4;
+
+	static F Load(const float* p) noexcept { return _mm_load_ps(p); }
+	static void Store(float* p, F v) noexcept { _mm_store_ps(p, v); }
+	static F Set(float v) noexcept { return _mm_set1_ps(v); }
+	static F Add(F a, F b) noexcept { return _mm_add_ps(a, b); }
+	static F Sub(F a, F b) noexcept { return _mm_sub_ps(a, b); }
+	static F Mul(F a, F b) noexcept { return _mm_mul_ps(a, b); }
+	static F Div(F a, F b) noexcept { return _mm_div_ps(a, b); }
+	static F Min(F a, F b) noexcept { return _mm_min_ps(a, b); }
+	static F Max(F a, F b) noexcept { return _mm_max_ps(a, b); }
+	static F Sqrt(F a) noexcept { return _mm_sqrt_ps(a); }
+	static F Abs(F a) noexcept { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	// Round half away from zero like std::round() (including its -0.0f results); only valid for |a| < 2^31, which all of our coordinates are
+	static F RoundAway(F a) noexcept {
+		F sign = _mm_and_ps(_mm_set1_ps(-0.0f), a);
+		F rounded = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(a, _mm_or_ps(_mm_set1_ps(0.5f), sign))));
+		return _mm_or_ps(rounded, sign);
+	}
+	static M Gt(F a, F b) noexcept { return _mm_cmpgt_ps(a, b); }
+	static M Ge(F a, F b) noexcept { return _mm_cmpge_ps(a, b); }
+	static M Lt(F a, F b) noexcept { return _mm_cmplt_ps(a, b); }
+	static M Eq(F a, F b) noexcept { return _mm_cmpeq_ps(a, b); }
+	static M And(M a, M b) noexcept { return _mm_and_ps(a, b); }
+	static M Or(M a, M b) noexcept { return _mm_or_ps(a, b); }
+	static M Xor(M a, M b) noexcept { return _mm_xor_ps(a, b); }
+	static F Select(M m, F a, F b) noexcept { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	static M SelectMask(M m, M a, M b) noexcept { return Select(m, a, b); }
+	static void StoreTruncated(int16_t* p, F v) noexcept {
+		__m128i i32 = _mm_cvttps_epi32(v);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(i32, i32));
+	}
+};
+#endif
+
+#ifdef WXF_STICK_KERNEL_AVX2
+struct VecAvx2 {
+	using F = __m256;
+	using M = __m256;
+	static constexpr int kWidth = 8;
+
+	static F Load(const float* p) noexcept { return _mm256_load_ps(p); }
+	static void Store(float* p, F v) noexcept { _mm256_store_ps(p, v); }
+	static F Set(float v) noexcept { return _mm256_set1_ps(v); }
+	static F Add(F a, F b) noexcept { return _mm256_add_ps(a, b); }
+	static F Sub(F a, F b) noexcept { return _mm256_sub_ps(a, b); }
+	static F Mul(F a, F b) noexcept { return _mm256_mul_ps(a, b); }
+	static F Div(F a, F b) noexcept { return _mm256_div_ps(a, b); }
+	static F Min(F a, F b) noexcept { return _mm256_min_ps(a, b); }
+	static F Max(F a, F b) noexcept { return _mm256_max_ps(a, b); }
+	static F Sqrt(F a) noexcept { return _mm256_sqrt_ps(a); }
+	static F Abs(F a) noexcept { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	// Round half away from zero like std::round() (including its -0.0f results); only valid for |a| < 2^31, which all of our coordinates are
+	static F RoundAway(F a) noexcept {
+		F sign = _mm256_and_ps(_mm256_set1_ps(-0.0f), a);
+		F rounded = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_add_ps(a, _mm256_or_ps(_mm256_set1_ps(0.5f), sign))));
+		return _mm256_or_ps(rounded, sign);
+	}
+	static M Gt(F a, F b) noexcept { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static M Ge(F a, F b) noexcept { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static M Lt(F a, F b) noexcept { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static M Eq(F a, F b) noexcept { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	static M And(M a, M b) noexcept { return _mm256_and_ps(a, b); }
+	static M Or(M a, M b) noexcept { return _mm256_or_ps(a, b); }
+	static M Xor(M a, M b) noexcept { return _mm256_xor_ps(a, b); }
+	static F Select(M m, F a, F b) noexcept { return _mm256_blendv_ps(b, a, m); }
+	static M SelectMask(M m, M a, M b) noexcept { return Select(m, a, b); }
+	static void StoreTruncated(int16_t* p, F v) noexcept {
+		__m256i i32 = _mm256_cvttps_epi32(v);
+		__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(i32), _mm256_extracti128_si256(i32, 1));
+		_mm_store_si128(reinterpret_cast<__m128i*>(p), packed);
+	}
+};
+#endif
+
+constexpr float pi = 3.14159265358979323846f;
+
+// atan(z) for z ∈ [0,1], max error ~1e-5 rad (Abramowitz & Stegun 4.4.49)
+template <typename V>
+static typename V::F AtanUnit(typename V::F z) noexcept {
+	auto z2 = V::Mul(z, z);
+	auto p = V::Set(0.0208351f);
+	p = V::Add(V::Mul(p, z2), V::Set(-0.0851330f));
+	p = V::Add(V::Mul(p, z2), V::Set(0.1801410f));
+	p = V::Add(V::Mul(p, z2), V::Set(-0.3302995f));
+	p = V::Add(V::Mul(p, z2), V::Set(0.9998660f));
+	return V::Mul(p, z);
+}
+
+// Linearly interpolated tiltLut lookup of each lane, v ∈ [0,1]
+// There is no gather before AVX2 and the lanes are few, so this goes through memory one lane at a time.
+template <typename V>
+static typename V::F LookupTilt(const MouseStickBatch& b, int begin, typename V::F v) noexcept {
+	constexpr int kSegs = MouseStickBatch::kLutSegments;
+
+	alignas(32) float pos[V::kWidth];
+	V::Store(pos, V::Mul(v, V::Set(static_cast<float>(kSegs))));
+	for (int i = 0; i < V::kWidth; ++i) {
+		const float* lut = b.tiltLut[begin + i];
+		int idx = std::min(static_cast<int>(pos[i]), kSegs - 1);
+		float frac = pos[i] - static_cast<float>(idx);
+		pos[i] = lut[idx] + (lut[idx + 1] - lut[idx]) * frac;
+	}
+	return V::Load(pos);
+}
+
+// Computes lanes [begin, begin + V::kWidth)
+//
+// The stick is tilted along whichever axis the mouse moved more on ("major" axis), at full tilt, while the other ("minor") axis
+// is scaled by the angle from the major axis. This is the octant mapping that used to be written as a cascade of
+// STICK_MORE_VERTI/STICK_MORE_HORIZ range checks on atan2f(); it is reproduced here exactly without atan2f() and without branches,
+// including which octant wins on the boundaries and its alternating use of f vs (1-f) for the minor axis.
+template <typename V>
+static void ComputeLanes(MouseStickBatch& b, int begin, float bounceBack) noexcept {
+	using F = typename V::F;
+	using M = typename V::M;
+
+	F zero = V::Set(0.0f);
+	F one = V::Set(1.0f);
+	F R = V::Load(b.outerRadius + begin);
+
+	F gain = V::Load(b.gain + begin);
+	F x = V::Mul(V::Load(b.deflX + begin), gain);
+	F y = V::Mul(V::Load(b.deflY + begin), gain);
+
+	// Distance of mouse from center
+	F r = V::Sqrt(V::Add(V::Mul(x, x), V::Mul(y, y)));
+
+	// Clamp to a point on controller circle, if we are outside it
+	{
+		M outside = V::Gt(r, R);
+		F k = V::Div(V::Sub(R, V::Set(bounceBack)), r);
+		F xc = V::RoundAway(V::Mul(x, k));
+		F yc = V::RoundAway(V::Mul(y, k));
+		x = V::Select(outside, xc, x);
+		y = V::Select(outside, yc, y);
+		r = V::Select(outside, V::Sqrt(V::Add(V::Mul(xc, xc), V::Mul(yc, yc))), r);
+	}
+
+	// Tilt ∈ [0,1] from the distance, the non-linearity is baked into the LUT
+	F tilt;
+	{
+		// Rounding in the clamp above may leave r slightly outside of the outer radius
+		F u = V::Min(V::Div(r, R), one);
+		F dz = V::Load(b.deadzone + begin);
+		// Max() also turns the NaN from a 100% deadzone into 0, which is masked out below anyways
+		F t = V::Min(V::Max(V::Div(V::Sub(u, dz), V::Sub(one, dz)), zero), one);
+		F lut = LookupTilt<V>(b, begin, V::Sqrt(V::Sqrt(t)));
+		// Snapping is a discontinuity, which the LUT would smear over a whole segment if it were baked in
+		lut = V::Select(V::Lt(V::Sub(one, lut), V::Set(MouseStickBatch::kSnapToFullTilt)), one, lut);
+		tilt = V::Select(V::Gt(u, dz), lut, zero);
+	}
+
+	F ax = V::Abs(x);
+	F ay = V::Abs(y);
+	// Signs as atan2f() sees them: x == -0.0f always counts as positive,
+	// y == -0.0f counts as positive if x is positive (-0.0 falls into [0,pi/4]), and negative otherwise (-pi falls into [-pi,-3pi/4])
+	M posX = V::Ge(x, zero);
+	M posY = V::SelectMask(posX, V::Ge(y, zero), V::Ge(V::Div(one, y), zero));
+	M oppositeSigns = V::Xor(posX, posY);
+	// On the diagonals, the 1st and 3rd quadrants use the vertical case, the 2nd and 4th quadrants the horizontal case
+	M horiz = V::Or(V::Gt(ax, ay), V::And(V::Eq(ax, ay), oppositeSigns));
+
+	// Angle from the major axis, normalized to [0,1]
+	F major = V::Max(V::Max(ax, ay), V::Set(1e-30f));
+	F f = V::Mul(AtanUnit<V>(V::Div(V::Min(ax, ay), major)), V::Set(4.0f / pi));
+	// The horizontal octants of the 1st and 3rd quadrants, and the vertical octants of the 2nd and 4th, use f; the others use 1-f
+	M useF = V::Xor(oppositeSigns, horiz);
+	F minorScale = V::Select(useF, f, V::Sub(one, f));
+
+	F signX = V::Mul(V::Select(posX, one, V::Set(-1.0f)), V::Load(b.signX + begin));
+	F signY = V::Mul(V::Select(posY, one, V::Set(-1.0f)), V::Load(b.signY + begin));
+	F full = V::Mul(tilt, V::Set(32767.0f));
+	F partial = V::Mul(full, minorScale);
+
+	V::StoreTruncated(b.outX + begin, V::Mul(signX, V::Select(horiz, full, partial)));
+	V::StoreTruncated(b.outY + begin, V::Mul(signY, V::Select(horiz, partial, full)));
+}
+
+template <typename V>
+static void ComputeAllLanes(MouseStickBatch& b, float bounceBack) noexcept {
+	static_assert(MouseStickBatch::kLaneCount % V::kWidth == 0);
+	for (int begin = 0; begin < MouseStickBatch::kLaneCount; begin += V::kWidth)
+		ComputeLanes<V>(b, begin, bounceBack);
+}
+
+void MouseStickBatch::Compute(float bounceBack) noexcept {
+#if defined(WXF_STICK_KERNEL_AVX2)
+	ComputeAllLanes<VecAvx2>(*this, bounceBack);
+#elif defined(WXF_STICK_KERNEL_SSE2)
+	ComputeAllLanes<VecSse2>(*this, bounceBack);
+#else
+	ComputeAllLanes<VecScalar>(*this, bounceBack);
+#endif
+}
+
+void MouseStickBatch::ComputeScalar(float bounceBack) noexcept {
+	ComputeAllLanes<VecScalar>(*this, bounceBack);
+}
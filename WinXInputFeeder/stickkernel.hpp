@@ -0,0 +1,71 @@
+#pragma once
+
+#include "modelconfig.hpp"
+
+#include <cstdint>
+
+// Mouse-driven joystick state of all gamepads, in structure-of-arrays form so that every stick is computed in one SIMD pass
+// Each gamepad owns two lanes: (gamepadId * 2) for the left stick, and (gamepadId * 2 + 1) for the right stick.
+struct MouseStickBatch {
+	// Padded to a multiple of the widest SIMD width we use (8 floats for AVX2)
+	static constexpr int kLaneCount = (kMaxX360Count * 2 + 7) / 8 * 8;
+
+	// Number of linear segments each response curve LUT is made of
+	static constexpr int kLutSegments = 256;
+	// ConfigJoystick::sensitivity at which mouse movement is used unscaled
+	static constexpr float kNeutralSensitivity = 15.0f;
+	static constexpr float kMinSensitivity = 0.01f;
+	static constexpr float kMinOuterRadius = 1.0f;
+	// Tilt closer than this to 1 is treated as full tilt
+	static constexpr float kSnapToFullTilt = 0.005f;
+
+	static constexpr int LaneOf(int gamepadId, bool leftright /* false: left */) noexcept {
+		return gamepadId * 2 + (leftright ? 1 : 0);
+	}
+
+	/* Input state */
+	// Mouse deflection from MouseVelocityFilter, in positive-right, positive-up
+	alignas(32) float deflX[kLaneCount] = {};
+	alignas(32) float deflY[kLaneCount] = {};
+
+	/* Parameters, compiled from ConfigJoystick by SetLaneParams() */
+	// Multiplier applied to mouse movement, derived from sensitivity
+	alignas(32) float gain[kLaneCount] = {};
+	// Distance from center (after gain) at which the stick saturates
+	alignas(32) float outerRadius[kLaneCount] = {};
+	// Fraction of the outer radius
+	alignas(32) float deadzone[kLaneCount] = {};
+	// -1 if the axis is inverted, 1 otherwise
+	alignas(32) float signX[kLaneCount] = {};
+	alignas(32) float signY[kLaneCount] = {};
+	// Tilt ∈ [0,1] outside of the deadzone, sampled at t = (i / kLutSegments)^4 where t ∈ [0,1] is the distance from the
+	// edge of the deadzone normalized to the outer radius
+	float tiltLut[kLaneCount][kLutSegments + 1] = {};
+
+	/* Output */
+	alignas(32) int16_t outX[kLaneCount] = {};
+	alignas(32) int16_t outY[kLaneCount] = {};
+
+	// Bit n is set if lane n is driven by the mouse
+	// Inactive lanes are still computed (with harmless results), but their outputs must not be used
+	uint32_t activeMask = 0;
+
+	bool IsLaneActive(int lane) const noexcept { return activeMask & (1u << lane); }
+	// Recompiles the lane, call whenever any of the stick's parameters change
+	void SetLaneParams(int lane, const ConfigJoystick& conf) noexcept;
+	void ClearLane(int lane) noexcept;
+	void Clear() noexcept;
+
+	// Set mouse deflection of both lanes of a gamepad
+	void SetDeflection(int gamepadId, float x, float y) noexcept;
+
+	// Compute outX/outY of all lanes from their mouse deflection
+	void Compute(float bounceBack) noexcept;
+	// Always uses the portable scalar implementation, regardless of which instruction set is available
+	void ComputeScalar(float bounceBack) noexcept;
+
+	// The analytic response curve, u ∈ [0,1] is the distance from center normalized to the outer radius
+	static float EvalTiltCurve(float u, float deadzone, float nonLinear) noexcept;
+	// The part of the response curve outside of the deadzone, before snapping to full tilt, which is what tiltLut samples
+	static float EvalLiveZoneCurve(float t, float nonLinear) noexcept;
+};
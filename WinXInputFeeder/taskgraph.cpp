@@ -0,0 +1,188 @@
+#include "pch.hpp"
+
+#include "taskgraph.hpp"
+
+#include "trace.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+TaskGraph::TaskGraph(int workerCount, int64_t qpcOrigin)
+	: hMainWake{ CreateEventW(nullptr, FALSE, FALSE, nullptr) }
+	, qpcOrigin{ qpcOrigin }
+	, workerCount{ workerCount }
+{
+	if (!hMainWake)
+		throw std::runtime_error(std::format("Error creating task graph event: {}", GetLastErrorStrUtf8()));
+}
+
+TaskGraph::~TaskGraph() {
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	workerCv.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+	CloseHandle(hMainWake);
+}
+
+TaskGraph::TaskId TaskGraph::Add(const char* name, std::function<void()> fn, std::initializer_list<TaskId> deps, Affinity affinity) {
+	assert(workers.empty());
+
+	auto id = static_cast<TaskId>(tasks.size());
+	auto& task = tasks.emplace_back();
+	task.name = name;
+	task.fn = std::move(fn);
+	task.affinity = affinity;
+
+	for (TaskId dep : deps) {
+		tasks[dep].dependents.push_back(id);
+		++task.pendingDeps;
+	}
+
+	std::lock_guard lock(mutex);
+	if (task.pendingDeps == 0)
+		MakeReady(id);
+	return id;
+}
+
+void TaskGraph::MakeReady(TaskId id) {
+	auto& task = tasks[id];
+	task.state = TaskState::Ready;
+	task.qpcReady = QpcNow();
+	if (task.affinity == Affinity::MainThread) {
+		mainQueue.push_back(id);
+	}
+	else {
+		workerQueue.push_back(id);
+		workerCv.notify_one();
+	}
+}
+
+void TaskGraph::Execute(TaskId id, int thread) noexcept {
+	// No other thread touches a task while it's running, the lock below publishes the results
+	auto& task = tasks[id];
+	task.thread = thread;
+	task.qpcBegin = QpcNow();
+
+	std::exception_ptr error;
+	try {
+		task.fn();
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+
+	task.qpcEnd = QpcNow();
+	if (IsTraceEnabled())
+		TraceRecord(task.name, task.qpcBegin, task.qpcEnd);
+
+	{
+		std::lock_guard lock(mutex);
+		if (error) {
+			// Dependents never become ready, RunUntil() rethrows instead
+			task.state = TaskState::Failed;
+			if (!firstError)
+				firstError = error;
+		}
+		else {
+			task.state = TaskState::Done;
+			for (TaskId dependent : task.dependents) {
+				if (--tasks[dependent].pendingDeps == 0)
+					MakeReady(dependent);
+			}
+		}
+	}
+	SetEvent(hMainWake);
+}
+
+void TaskGraph::WorkerMain(int thread) {
+	TraceRegisterThread();
+
+	while (true) {
+		TaskId id;
+		{
+			std::unique_lock lock(mutex);
+			workerCv.wait(lock, [&] { return stopping || !workerQueue.empty(); });
+			if (stopping)
+				return;
+			id = workerQueue.front();
+			workerQueue.pop_front();
+			tasks[id].state = TaskState::Running;
+		}
+		Execute(id, thread);
+	}
+}
+
+bool TaskGraph::RunUntil(std::span<const TaskId> targets, bool pumpMessages) {
+	if (workers.empty()) {
+		for (int i = 0; i < workerCount; ++i)
+			workers.emplace_back(&TaskGraph::WorkerMain, this, i + 1);
+	}
+
+	while (true) {
+		TaskId mainTask = -1;
+		{
+			std::lock_guard lock(mutex);
+			if (firstError)
+				std::rethrow_exception(firstError);
+			if (std::ranges::all_of(targets, [&](TaskId id) { return tasks[id].state == TaskState::Done; }))
+				return true;
+			if (!mainQueue.empty()) {
+				mainTask = mainQueue.front();
+				mainQueue.pop_front();
+				tasks[mainTask].state = TaskState::Running;
+			}
+		}
+
+		if (mainTask != -1) {
+			Execute(mainTask, 0);
+			continue;
+		}
+
+		if (!pumpMessages) {
+			WaitForSingleObject(hMainWake, INFINITE);
+			continue;
+		}
+
+		DWORD res = MsgWaitForMultipleObjectsEx(1, &hMainWake, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		if (res == WAIT_OBJECT_0 + 1) {
+			MSG msg;
+			while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+				if (msg.message == WM_QUIT)
+					return false;
+				TranslateMessage(&msg);
+				DispatchMessageW(&msg);
+			}
+		}
+	}
+}
+
+void TaskGraph::DumpProfile(std::ostream& out) {
+	std::lock_guard lock(mutex);
+
+	auto toMs = [&](int64_t qpc) { return static_cast<double>(qpc - qpcOrigin) * 1000.0 / static_cast<double>(QpcFrequency()); };
+
+	std::vector<TaskId> order;
+	for (TaskId id = 0; id < static_cast<TaskId>(tasks.size()); ++id)
+		order.push_back(id);
+	// Not started tasks last
+	std::ranges::sort(order, {}, [&](TaskId id) { return tasks[id].qpcBegin != 0 ? tasks[id].qpcBegin : INT64_MAX; });
+
+	out << std::format("{:<16} {:<10} {:>9} {:>9} {:>9} {:>9}\n", "Task", "Thread", "Ready", "Begin", "End", "Took");
+	for (TaskId id : order) {
+		auto& task = tasks[id];
+		if (task.state != TaskState::Done && task.state != TaskState::Failed) {
+			out << std::format("{:<16} not run\n", task.name);
+			continue;
+		}
+
+		auto thread = task.thread == 0 ? std::string("main") : std::format("worker {}", task.thread);
+		out << std::format("{:<16} {:<10} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f}{}\n",
+			task.name, thread, toMs(task.qpcReady), toMs(task.qpcBegin), toMs(task.qpcEnd),
+			toMs(task.qpcEnd) - toMs(task.qpcBegin), task.state == TaskState::Failed ? " (failed)" : "");
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Runs a dependency graph of tasks on a small pool of worker threads, and on the thread calling RunUntil()
+// Tasks that are tied to the calling thread, e.g. creating windows (which get their messages on the creating thread), have Affinity::MainThread.
+// Meant to be built once and run once, e.g. for startup.
+class TaskGraph {
+public:
+	using TaskId = int;
+
+	enum class Affinity {
+		Worker,
+		MainThread,
+	};
+
+	enum class TaskState {
+		Waiting,
+		Ready,
+		Running,
+		Done,
+		Failed,
+	};
+
+	struct Task {
+		// Must point to a string with static storage duration, e.g. a string literal; also used as the trace zone name
+		const char* name;
+		std::function<void()> fn;
+		std::vector<TaskId> dependents;
+		int pendingDeps = 0;
+		Affinity affinity;
+		TaskState state = TaskState::Waiting;
+
+		/* Profile */
+		// 0 for the main thread, 1.. for workers
+		int thread = -1;
+		// When all dependencies finished, and when the task itself ran
+		int64_t qpcReady = 0;
+		int64_t qpcBegin = 0;
+		int64_t qpcEnd = 0;
+	};
+
+private:
+	std::vector<Task> tasks;
+	std::deque<TaskId> workerQueue;
+	std::deque<TaskId> mainQueue;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable workerCv;
+	// Auto-reset, signaled whenever a task finishes
+	HANDLE hMainWake;
+	std::exception_ptr firstError;
+	int64_t qpcOrigin;
+	int workerCount;
+	bool stopping = false;
+
+	// Must hold mutex
+	void MakeReady(TaskId id);
+	void Execute(TaskId id, int thread) noexcept;
+	void WorkerMain(int thread);
+
+public:
+	// \param qpcOrigin timestamps in the profile are relative to this
+	TaskGraph(int workerCount, int64_t qpcOrigin);
+	// Waits for running tasks to finish, tasks that haven't started yet are dropped
+	~TaskGraph();
+
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	// All tasks must be added before the first RunUntil()
+	TaskId Add(const char* name, std::function<void()> fn, std::initializer_list<TaskId> deps = {}, Affinity affinity = Affinity::Worker);
+
+	// Run main thread tasks on the calling thread as they become ready, until all of the targets have finished
+	// Rethrows the first exception thrown by any task.
+	// \param pumpMessages whether to dispatch window messages while waiting, so that e.g. input keeps being handled
+	// \return false if WM_QUIT was received while pumping messages
+	bool RunUntil(std::span<const TaskId> targets, bool pumpMessages);
+
+	// Per-task timing, in milliseconds since qpcOrigin
+	void DumpProfile(std::ostream& out);
+};
@@ -0,0 +1,149 @@
+#include "pch.hpp"
+
+#include "timerwheel.hpp"
+
+#include <algorithm>
+#include <bit>
+
+static void LinkBefore(TimerNode& head, TimerNode& node) noexcept {
+	node.prev = head.prev;
+	node.next = &head;
+	head.prev->next = &node;
+	head.prev = &node;
+}
+
+static void Unlink(TimerNode& node) noexcept {
+	node.prev->next = node.next;
+	node.next->prev = node.prev;
+	node.prev = nullptr;
+	node.next = nullptr;
+}
+
+TimerWheel::TimerWheel() noexcept {
+	for (auto& level : slots) {
+		for (auto& head : level) {
+			head.prev = &head;
+			head.next = &head;
+		}
+	}
+}
+
+void TimerWheel::Insert(TimerNode& node) noexcept {
+	// 0 only when cascading a timer due right at the boundary, which FireSlot() picks up next
+	uint64_t delta = node.expiry - current;
+
+	int level = 0;
+	while (level < kLevels - 1 && delta >= (uint64_t(1) << (kSlotBits * (level + 1))))
+		++level;
+	int slot = static_cast<int>((node.expiry >> (kSlotBits * level)) & (kSlots - 1));
+
+	node.level = static_cast<uint8_t>(level);
+	node.slot = static_cast<uint8_t>(slot);
+	LinkBefore(slots[level][slot], node);
+	occupied[level] |= uint64_t(1) << slot;
+}
+
+void TimerWheel::Schedule(TimerNode& node, uint64_t delay) noexcept {
+	if (node.IsArmed())
+		Cancel(node);
+
+	node.expiry = current + std::clamp<uint64_t>(delay, 1, kMaxDelay);
+	Insert(node);
+	++armedCount;
+}
+
+void TimerWheel::Cancel(TimerNode& node) noexcept {
+	if (!node.IsArmed())
+		return;
+
+	Unlink(node);
+	--armedCount;
+	// The node may be on FireSlot()'s private list instead, in which case the slot is already empty and this is a no-op
+	auto& head = slots[node.level][node.slot];
+	if (head.next == &head)
+		occupied[node.level] &= ~(uint64_t(1) << node.slot);
+}
+
+void TimerWheel::Cascade(int level) noexcept {
+	int slot = static_cast<int>((current >> (kSlotBits * level)) & (kSlots - 1));
+	auto& head = slots[level][slot];
+	occupied[level] &= ~(uint64_t(1) << slot);
+
+	while (head.next != &head) {
+		TimerNode& node = *head.next;
+		Unlink(node);
+		Insert(node);
+	}
+}
+
+void TimerWheel::FireSlot(int slot) noexcept {
+	auto& head = slots[0][slot];
+	if (head.next == &head)
+		return;
+
+	// Move everything to a private list first, callbacks may re-arm into any slot
+	TimerNode pending;
+	pending.prev = head.prev;
+	pending.next = head.next;
+	pending.prev->next = &pending;
+	pending.next->prev = &pending;
+	head.prev = &head;
+	head.next = &head;
+	occupied[0] &= ~(uint64_t(1) << slot);
+
+	while (pending.next != &pending) {
+		TimerNode& node = *pending.next;
+		Unlink(node);
+		--armedCount;
+		node.fire(node);
+	}
+}
+
+void TimerWheel::AdvanceTo(uint64_t tick) noexcept {
+	while (current < tick) {
+		if (armedCount == 0) {
+			current = tick;
+			return;
+		}
+
+		// Jump to the next occupied slot of level 0 in this rotation, or else to the end of it, where upper levels cascade
+		int offset = static_cast<int>(current & (kSlots - 1));
+		uint64_t ahead = offset == kSlots - 1 ? 0 : occupied[0] & (~uint64_t(0) << (offset + 1));
+		uint64_t next = ahead
+			? (current & ~uint64_t(kSlots - 1)) + std::countr_zero(ahead)
+			: (current | (kSlots - 1)) + 1;
+		if (next > tick) {
+			current = tick;
+			return;
+		}
+		current = next;
+
+		// Each level cascades when all levels below it wrapped around
+		for (int level = 1; level < kLevels; ++level) {
+			if ((current & ((uint64_t(1) << (kSlotBits * level)) - 1)) != 0)
+				break;
+			Cascade(level);
+		}
+		FireSlot(static_cast<int>(current & (kSlots - 1)));
+	}
+}
+
+uint64_t TimerWheel::GetTicksUntilNext() const noexcept {
+	if (armedCount == 0)
+		return kNever;
+
+	uint64_t best = kNever;
+	for (int level = 0; level < kLevels; ++level) {
+		if (occupied[level] == 0)
+			continue;
+
+		int shift = kSlotBits * level;
+		int currentSlot = static_cast<int>((current >> shift) & (kSlots - 1));
+		// Slots after the current one are in this rotation of the level, the rest in the next
+		int slot = std::countr_zero(std::rotr(occupied[level], currentSlot + 1)) + currentSlot + 1;
+		uint64_t rotationStart = (current >> (shift + kSlotBits)) << (shift + kSlotBits);
+		uint64_t start = rotationStart + (static_cast<uint64_t>(slot) << shift);
+		best = std::min(best, start - current);
+	}
+	return best;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Intrusive timer, embedded in whatever owns it, so that arming one never allocates
+// The owner recovers itself from the node in the callback, e.g. by deriving from it.
+struct TimerNode {
+	// Both nullptr while not armed
+	TimerNode* prev = nullptr;
+	TimerNode* next = nullptr;
+	// Absolute tick the timer fires at
+	uint64_t expiry = 0;
+	uint8_t level = 0;
+	uint8_t slot = 0;
+	// Called from TimerWheel::AdvanceTo(), may schedule or cancel any timer, including this one
+	void (*fire)(TimerNode&) noexcept = nullptr;
+
+	bool IsArmed() const noexcept { return next != nullptr; }
+};
+
+// Hierarchical timing wheel, in abstract ticks
+// Level L has kSlots slots of kSlots^L ticks each. A timer is placed by how far away it is, and moved down a level when
+// time reaches its slot, so scheduling and cancelling are O(1), and advancing is O(1) per elapsed slot plus the timers fired.
+class TimerWheel {
+public:
+	static constexpr int kSlotBits = 6;
+	static constexpr int kSlots = 1 << kSlotBits;
+	static constexpr int kLevels = 4;
+	// Timers further away than this are clamped to it
+	static constexpr uint64_t kMaxDelay = (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+	static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+private:
+	// Sentinels of circular lists
+	TimerNode slots[kLevels][kSlots];
+	// Bit N set if slots[level][N] is non-empty
+	uint64_t occupied[kLevels] = {};
+	uint64_t current = 0;
+	size_t armedCount = 0;
+
+	void Insert(TimerNode& node) noexcept;
+	void Cascade(int level) noexcept;
+	void FireSlot(int slot) noexcept;
+
+public:
+	TimerWheel() noexcept;
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	uint64_t GetCurrentTick() const noexcept { return current; }
+	size_t GetArmedCount() const noexcept { return armedCount; }
+
+	// Fire the timer `delay` ticks from now, at least 1; re-arms it if already armed
+	void Schedule(TimerNode& node, uint64_t delay) noexcept;
+	// No-op if not armed
+	void Cancel(TimerNode& node) noexcept;
+
+	// Fire every timer due up to and including `tick`
+	void AdvanceTo(uint64_t tick) noexcept;
+	// Ticks from now until AdvanceTo() may have something to do: exact for timers due within kSlots ticks, the start
+	// of the earliest occupied slot for those further away. kNever if nothing is armed.
+	uint64_t GetTicksUntilNext() const noexcept;
+};
@@ -0,0 +1,104 @@
+#include "pch.hpp"
+
+#include "trace.hpp"
+
+#include "utils.hpp"
+
+#include <format>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+std::atomic<bool> gTraceEnabled = false;
+
+// Must be a power of two
+constexpr uint64_t kTraceRingCapacity = 1 << 16;
+
+namespace {
+struct TraceRing {
+	DWORD threadId = 0;
+	std::unique_ptr<TraceEvent[]> events;
+	// Monotonically increasing, the slot for an index is (idx % kTraceRingCapacity)
+	// Only ever written by the owning thread
+	std::atomic<uint64_t> writeIdx = 0;
+};
+}
+
+static SRWLOCK gRingsLock = SRWLOCK_INIT;
+// Rings are never freed, even after their thread exits, so that their events can still be dumped
+static std::vector<std::unique_ptr<TraceRing>> gRings;
+static thread_local TraceRing* tRing = nullptr;
+
+// Events that began before the current recording session are stale and skipped when dumping
+static std::atomic<int64_t> gSessionBeginQpc = 0;
+
+void SetTraceEnabled(bool enabled) noexcept {
+	if (enabled && !IsTraceEnabled())
+		gSessionBeginQpc.store(QpcNow(), std::memory_order_relaxed);
+	gTraceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TraceRegisterThread() {
+	if (tRing)
+		return;
+
+	auto ring = std::make_unique<TraceRing>();
+	ring->threadId = GetCurrentThreadId();
+	ring->events = std::make_unique<TraceEvent[]>(kTraceRingCapacity);
+
+	SrwExclusiveLock lock(gRingsLock);
+	tRing = ring.get();
+	gRings.push_back(std::move(ring));
+}
+
+void TraceRecord(const char* name, int64_t qpcBegin, int64_t qpcEnd) noexcept {
+	if (!tRing) {
+		try {
+			TraceRegisterThread();
+		}
+		catch (const std::bad_alloc&) {
+			return;
+		}
+	}
+
+	auto& ring = *tRing;
+	uint64_t idx = ring.writeIdx.load(std::memory_order_relaxed);
+	ring.events[idx & (kTraceRingCapacity - 1)] = TraceEvent{ name, qpcBegin, qpcEnd };
+	ring.writeIdx.store(idx + 1, std::memory_order_release);
+}
+
+bool TraceDumpChromeJson(const std::filesystem::path& path) {
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file)
+		return false;
+
+	int64_t sessionBegin = gSessionBeginQpc.load(std::memory_order_relaxed);
+	double microsPerTick = 1'000'000.0 / static_cast<double>(QpcFrequency());
+	DWORD pid = GetCurrentProcessId();
+
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+
+	SrwSharedLock lock(gRingsLock);
+	for (auto& ring : gRings) {
+		// Rings of other threads may be written to while we read them; at worst an event in the oldest slot is torn
+		uint64_t end = ring->writeIdx.load(std::memory_order_acquire);
+		uint64_t begin = end > kTraceRingCapacity ? end - kTraceRingCapacity : 0;
+		for (uint64_t i = begin; i < end; ++i) {
+			const auto& ev = ring->events[i & (kTraceRingCapacity - 1)];
+			if (ev.qpcBegin < sessionBegin)
+				continue;
+
+			// Zone names are string literals from our own code, they never need escaping
+			file << (first ? "\n" : ",\n");
+			file << std::format(R"({{"name":"{}","cat":"wxf","ph":"X","pid":{},"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+				ev.name, pid, ring->threadId,
+				static_cast<double>(ev.qpcBegin - sessionBegin) * microsPerTick,
+				static_cast<double>(ev.qpcEnd - ev.qpcBegin) * microsPerTick);
+			first = false;
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "utils.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+// In-process trace recorder
+// Scoped zones are recorded into a per-thread ring buffer, and can be dumped as a Chrome/Perfetto-compatible JSON trace.
+// When recording is disabled, a zone costs a single relaxed load.
+
+struct TraceEvent {
+	// Must point to a string with static storage duration, e.g. a string literal
+	const char* name;
+	int64_t qpcBegin;
+	int64_t qpcEnd;
+};
+
+extern std::atomic<bool> gTraceEnabled;
+
+inline bool IsTraceEnabled() noexcept { return gTraceEnabled.load(std::memory_order_relaxed); }
+void SetTraceEnabled(bool enabled) noexcept;
+
+// Allocate the ring buffer for the calling thread ahead of time, so that the first recorded zone doesn't allocate
+// Threads that never call this get their buffer allocated on their first recorded zone.
+void TraceRegisterThread();
+void TraceRecord(const char* name, int64_t qpcBegin, int64_t qpcEnd) noexcept;
+
+// Write all events currently in the ring buffers as Chrome trace event JSON
+// \return false if the file could not be written
+bool TraceDumpChromeJson(const std::filesystem::path& path);
+
+struct TraceZone {
+	const char* name;
+	// 0 if recording was disabled when the zone was entered
+	int64_t qpcBegin;
+
+	explicit TraceZone(const char* name) noexcept
+		: name{ name }
+		, qpcBegin{ IsTraceEnabled() ? QpcNow() : 0 } {}
+
+	~TraceZone() {
+		if (qpcBegin != 0)
+			TraceRecord(name, qpcBegin, QpcNow());
+	}
+
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+};
+
+#define TRACE_ZONE(name) TraceZone UNIQUE_NAME(traceZone){ name }
@@ -3,13 +3,18 @@
 #include "ui.hpp"
 
 #include "app.hpp"
+#include "app_p.hpp"
 #include "modelruntime.hpp"
 #include "utils.hpp"
 
 #include <imgui.h>
 #include <imgui_internal.h>
 #include <imgui_stdlib.h>
+#include <bit>
+#include <ranges>
 #include <string>
+#include <string_view>
+#include <vector>
 
 using namespace std::literals;
 
@@ -44,18 +49,27 @@ static bool ButtonDisablable(const char* msg, bool disabled) {
 
 struct UIStatePrivate {
 	UIState* pub;
+	App* app;
 	FeederEngine* feeder = nullptr;
 	std::string newProfileName;
+	// Comma separated ConfigProfile::executables being edited, of profileExesOf
+	std::string profileExes;
+	Config::ProfileRef profileExesOf = nullptr;
 	int selectedGamepadId = -1;
+	float calibDistanceCm = 10.0f;
 
-	UIStatePrivate(UIState& s)
+	UIStatePrivate(UIState& s, App& app)
 		: pub{ &s }
+		, app{ &app }
 	{
 	}
 
 	void Show();
 	void ShowNavWindow();
 	void ShowDetailWindow();
+	void ShowLatencyWindow();
+	void ShowDevicesWindow();
+	void ShowPerformanceWindow();
 
 	void ShowButton(const X360Gamepad& gamepad, int gamepadId, X360Button btn, KeyCode boundKey);
 };
@@ -103,7 +117,7 @@ static void ShowTextForKey(KeyCode boundKey, bool pressed) {
 }
 
 UIState::UIState(App& app)
-	: p{ new UIStatePrivate(*this) }
+	: p{ new UIStatePrivate(*this, app) }
 {
 }
 
@@ -129,8 +143,14 @@ void UIStatePrivate::Show() {
 
 	const Config& config = feeder->GetConfig();
 
+	pub->redrawTimeoutMs = INFINITE;
+
 	if (ImGui::BeginMainMenuBar()) {
 		if (ImGui::BeginMenu("WinXInputEmu")) {
+			if (ImGui::MenuItem("Hide to tray")) {
+				app->RequestUI(false);
+			}
+			HelpForItem("Closes this window and frees the resources used by it, the feeder keeps running.\nShow it again from the tray icon or with the ShowUI hotkey.");
 			if (ImGui::MenuItem("Quit")) {
 				PostQuitMessage(0);
 			}
@@ -146,6 +166,19 @@ void UIStatePrivate::Show() {
 	ImGui::Begin("Gamepad info");
 	ShowDetailWindow();
 	ImGui::End();
+
+	ImGui::Begin("Latency");
+	ShowLatencyWindow();
+	ImGui::End();
+
+	ImGui::Begin("Devices");
+	ShowDevicesWindow();
+	ImGui::End();
+
+	// Only keeps the UI redrawing periodically while it's actually visible
+	if (ImGui::Begin("Performance"))
+		ShowPerformanceWindow();
+	ImGui::End();
 }
 
 void UIStatePrivate::ShowNavWindow() {
@@ -204,6 +237,7 @@ void UIStatePrivate::ShowNavWindow() {
 		if (ImGui::Button("Confirm")) {
 			feeder->RemoveProfile(pp);
 			selectedGamepadId = -1;
+			profileExesOf = nullptr;
 			pp = nullptr;
 			ImGui::CloseCurrentPopup();
 		}
@@ -242,10 +276,36 @@ void UIStatePrivate::ShowNavWindow() {
 	const ConfigProfile& profile = pp->second;
 	auto x360s = feeder->GetX360s();
 
+	if (profileExesOf != pp) {
+		profileExesOf = pp;
+		profileExes.clear();
+		for (auto& exe : profile.executables) {
+			if (!profileExes.empty())
+				profileExes += ", ";
+			profileExes += exe;
+		}
+	}
+	if (ImGui::InputText("Executables", &profileExes, ImGuiInputTextFlags_EnterReturnsTrue)) {
+		std::vector<std::string> exes;
+		for (auto part : std::views::split(std::string_view(profileExes), ',')) {
+			auto exe = std::string_view(part);
+			while (!exe.empty() && exe.front() == ' ') exe.remove_prefix(1);
+			while (!exe.empty() && exe.back() == ' ') exe.remove_suffix(1);
+			if (!exe.empty())
+				exes.emplace_back(exe);
+		}
+		feeder->SetProfileExecutables(pp, std::move(exes));
+	}
+	HelpMarker("Comma separated executable file names, e.g. game.exe, press Enter to apply.\nThis profile is switched to whenever one of them comes to the foreground, other applications keep the current profile.");
+
 	if (ImGui::Button("+")) {
 		feeder->AddX360();
 	}
 	ImGui::SameLine();
+	if (ImGui::Button("+ DS4")) {
+		feeder->AddDS4();
+	}
+	ImGui::SameLine();
 	if (ButtonDisablable("-", selectedGamepadId == -1)) {
 		feeder->RemoveGamepad(selectedGamepadId);
 		--selectedGamepadId;
@@ -259,7 +319,7 @@ void UIStatePrivate::ShowNavWindow() {
 
 	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
 		char id[256];
-		snprintf(id, sizeof(id), "Gamepad %d", gamepadId);
+		snprintf(id, sizeof(id), x360s[gamepadId].kind == GamepadKind::DS4 ? "Gamepad %d (DS4)" : "Gamepad %d", gamepadId);
 		bool selected = selectedGamepadId == gamepadId;
 		if (ImGui::Selectable(id, &selected)) {
 			selectedGamepadId = gamepadId;
@@ -276,6 +336,9 @@ void UIStatePrivate::ShowDetailWindow() {
 	const ConfigProfile& profile = pp->second;
 	auto x360s = feeder->GetX360s();
 
+	// The profile may have been switched to one with fewer gamepads as another application came to the foreground
+	if (selectedGamepadId >= static_cast<int>(x360s.size()))
+		selectedGamepadId = -1;
 	if (selectedGamepadId == -1) {
 		ImGui::Text("Select a gamepad to show details");
 		return;
@@ -283,6 +346,26 @@ void UIStatePrivate::ShowDetailWindow() {
 
 	auto& dev = x360s[selectedGamepadId];
 	auto& gamepad = profile.gamepads[selectedGamepadId];
+	auto& routes = feeder->GetRoutes();
+
+	auto ShowRoutedDevices = [&](IdevKind kind) {
+		const char* what = kind == IdevKind::Mouse ? "mouse" : "keyboard";
+		int count = 0;
+		for (unsigned slots = routes.usedSlots; slots != 0; slots &= slots - 1) {
+			int slot = std::countr_zero(slots);
+			if (routes.devices[slot].kind == kind && (routes.pads[slot] & (1 << selectedGamepadId))) {
+				ImGui::Text("Bound %s: %s", what, routes.devices[slot].name.c_str());
+				++count;
+			}
+		}
+		if (count == 0) {
+			ImGui::Text("Bound %s: [not bound]", what);
+			if (kind == IdevKind::Mouse)
+				HelpMarker("This means no mouse button or movement will trigger any bound buttons, effectively disabling this gamepad from mouse inputs.");
+			else
+				HelpMarker("This means no key press will trigger any bound buttons, effectively disabling this gamepad from key inputs.");
+		}
+	};
 
 	if (ImGui::Button("Rebind##kbd")) {
 		feeder->StartRebindX360Device(selectedGamepadId, IdevKind::Keyboard);
@@ -296,12 +379,8 @@ void UIStatePrivate::ShowDetailWindow() {
 		ImGui::SameLine();
 		ImGui::Text("press any key on the keyboard");
 	}
-	else if (dev.srcKbd == INVALID_HANDLE_VALUE) {
-		ImGui::Text("Bound keyboard: [not bound]");
-		HelpMarker("This means no key press will trigger any bound buttons, effectively disabling this gamepad from key inputs.");
-	}
 	else {
-		ImGui::Text("Bound keyboard: %p", dev.srcKbd);
+		ShowRoutedDevices(IdevKind::Keyboard);
 	}
 
 	if (ImGui::Button("Rebind##mouse")) {
@@ -316,18 +395,28 @@ void UIStatePrivate::ShowDetailWindow() {
 		ImGui::SameLine();
 		ImGui::Text("press any mouse button");
 	}
-	else if (dev.srcMouse == INVALID_HANDLE_VALUE) {
-		ImGui::Text("Bound mouse: [not bound]");
-		HelpMarker("This means no mouse button or movement will trigger any bound buttons, effectively disabling this gamepad from mouse inputs.");
-	}
 	else {
-		ImGui::Text("Bound mouse: %p", dev.srcMouse);
+		ShowRoutedDevices(IdevKind::Mouse);
+	}
+
+	if (ImGui::TreeNode("Routing")) {
+		HelpMarker("Devices checked here all drive this gamepad, merged: a key counts as held while any of them holds it, and mouse motion adds up.\nA device can drive several gamepads at once.");
+		for (unsigned slots = routes.usedSlots; slots != 0; slots &= slots - 1) {
+			int slot = std::countr_zero(slots);
+			bool routed = routes.pads[slot] & (1 << selectedGamepadId);
+			char label[512];
+			snprintf(label, sizeof(label), "[%s] %s##route%d", routes.devices[slot].kind == IdevKind::Mouse ? "mouse" : "keyboard", routes.devices[slot].name.c_str(), slot);
+			if (ImGui::Checkbox(label, &routed))
+				feeder->SetDeviceRoute(slot, selectedGamepadId, routed);
+		}
+		ImGui::TreePop();
 	}
 
 	// DBG
-	ImGui::Text("accuMouseX: %f", dev.accuMouseX);
-	ImGui::Text("accuMouseY: %f", dev.accuMouseY);
-	ImGui::Text("lastAngle: %f", dev.lastAngle);
+	auto& mouseSticks = feeder->GetMouseSticks();
+	int lane = MouseStickBatch::LaneOf(selectedGamepadId, false);
+	ImGui::Text("mouseDeflX: %f", mouseSticks.deflX[lane]);
+	ImGui::Text("mouseDeflY: %f", mouseSticks.deflY[lane]);
 
 	ImGui::Spacing();
 	ImGui::Separator();
@@ -381,17 +470,25 @@ void UIStatePrivate::ShowDetailWindow() {
 
 		// rest items
 		if (useMouse) {
-			ImGui::InputFloat("Sensitivity", &opts.sensitivity);
+			bool changed = false;
+
+			changed |= ImGui::InputFloat("Sensitivity", &opts.sensitivity);
 			HelpForItem("Lower value corresponds to higher sensitivity.");
 
-			ImGui::SliderFloat("Non-Linear", &opts.nonLinear, 0.0f, 1.0f);
+			changed |= ImGui::SliderFloat("Non-Linear", &opts.nonLinear, 0.0f, 1.0f);
 			HelpForItem("1.0 is linear\n< 1.0 makes center more sensitive");
 
-			ImGui::SliderFloat("Deadzone", &opts.deadzone, 0.0f, 1.0f);
+			changed |= ImGui::SliderFloat("Deadzone", &opts.deadzone, 0.0f, 1.0f);
+
+			changed |= ImGui::InputFloat("Outer Radius", &opts.outerRadius);
+			HelpForItem("Mouse distance from center that fully tilts the stick.");
+
+			changed |= ImGui::Checkbox("Invert X-Axis", &opts.invertXAxis);
 
-			ImGui::Checkbox("Invert X-Axis", &opts.invertXAxis);
+			changed |= ImGui::Checkbox("Invert Y-Axis", &opts.invertYAxis);
 
-			ImGui::Checkbox("Invert Y-Axis", &opts.invertYAxis);
+			if (changed)
+				feeder->CommitX360JoystickParams(selectedGamepadId, leftright);
 		}
 		else {
 			ImGui::PushItemWidth(labelWidth);
@@ -455,6 +552,124 @@ void UIStatePrivate::ShowDetailWindow() {
 	ImGui::EndGroup();
 }
 
+void UIStatePrivate::ShowLatencyWindow() {
+	if (ImGui::Button("Reset")) {
+		feeder->ResetLatencyStats();
+		app->uiLatency.Reset();
+	}
+	HelpMarker("Processing: from WM_INPUT receipt to the gamepad report being submitted.\nEnd-to-end: processing plus the time the input spent in the message queue, with millisecond precision.\n\nUI frame time: rendering a frame of this window, during which input waits in the queue.\nUI input delay: frame time of the frames during which input arrived, i.e. at most how much the UI delayed it.\n\nProfile switch: from an application coming to the foreground to its profile being in effect.");
+
+	auto x360s = feeder->GetX360s();
+
+	if (!ImGui::BeginTable("LatencyTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		return;
+	ImGui::TableSetupColumn("Gamepad");
+	ImGui::TableSetupColumn("Stage");
+	ImGui::TableSetupColumn("Count");
+	ImGui::TableSetupColumn("p50 (us)");
+	ImGui::TableSetupColumn("p99 (us)");
+	ImGui::TableSetupColumn("max (us)");
+	ImGui::TableHeadersRow();
+
+	auto ShowRow = [](const char* owner, const char* stage, const LatencyHistogram& h) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(owner);
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(stage);
+		ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(h.GetCount()));
+		ImGui::TableNextColumn(); ImGui::Text("%u", h.GetPercentile(50.0));
+		ImGui::TableNextColumn(); ImGui::Text("%u", h.GetPercentile(99.0));
+		ImGui::TableNextColumn(); ImGui::Text("%u", h.GetMax());
+		};
+	for (int gamepadId = 0; gamepadId < x360s.size(); ++gamepadId) {
+		char id[16];
+		snprintf(id, sizeof(id), "%d", gamepadId);
+		auto& l = feeder->GetX360Latency(gamepadId);
+		ShowRow(id, "Processing", l.processing);
+		ShowRow(id, "End-to-end", l.endToEnd);
+	}
+	ShowRow("Profile", "Switch", feeder->GetProfileSwitchLatency());
+	auto& ul = app->uiLatency;
+	ShowRow("UI", "Frame time", ul.frameTime);
+	ShowRow("UI", "Present", ul.present);
+	ShowRow("UI", "Input delay", ul.inputDelay);
+	ImGui::EndTable();
+}
+
+void UIStatePrivate::ShowDevicesWindow() {
+	ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6.0f);
+	ImGui::InputFloat("Calibration distance (cm)", &calibDistanceCm, 0.0f, 0.0f, "%.1f");
+	HelpMarker("To calibrate a mouse, press Start, move the mouse in a straight line across this physical distance, then press Finish.\nThe measured DPI is stored for the mouse model (VID:PID), and its movement is scaled to behave like a 800 DPI mouse.");
+
+	if (!ImGui::BeginTable("DevicesTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		return;
+	ImGui::TableSetupColumn("Handle");
+	ImGui::TableSetupColumn("VID:PID");
+	ImGui::TableSetupColumn("Report rate (Hz)");
+	ImGui::TableSetupColumn("DPI");
+	ImGui::TableSetupColumn("Scale");
+	ImGui::TableSetupColumn("Calibration");
+	ImGui::TableHeadersRow();
+
+	for (auto& [hDevice, idev] : app->devices) {
+		if (idev.info.dwType != RIM_TYPEMOUSE)
+			continue;
+		auto& meter = idev.mouseMeter;
+		auto calib = feeder->GetMouseCalibration(idev.GetVidPid());
+
+		ImGui::PushID(hDevice);
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn(); ImGui::Text("%p", hDevice);
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("%s", idev.nameUtf8.c_str());
+		ImGui::TableNextColumn(); ImGui::Text("%04X:%04X", idev.vendorId, idev.productId);
+		ImGui::TableNextColumn(); ImGui::Text("%.0f", meter.GetPollingRate());
+		ImGui::TableNextColumn();
+		if (calib)
+			ImGui::Text("%.0f", calib->dpi);
+		else
+			ImGui::TextUnformatted("[not calibrated]");
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", idev.mouseCountScale);
+		ImGui::TableNextColumn();
+		if (!meter.calibrating) {
+			if (ImGui::Button("Start"))
+				meter.BeginCalibration();
+		}
+		else {
+			if (ImGui::Button("Finish"))
+				app->FinishMouseCalibration(idev, calibDistanceCm);
+			ImGui::SameLine();
+			if (ImGui::Button("Cancel"))
+				meter.FinishCalibration();
+			ImGui::SameLine();
+			ImGui::Text("%lld, %lld", static_cast<long long>(meter.calibSumX), static_cast<long long>(meter.calibSumY));
+		}
+		ImGui::PopID();
+	}
+	ImGui::EndTable();
+}
+
+void UIStatePrivate::ShowPerformanceWindow() {
+	auto& perf = app->perf;
+	perf.Sample();
+	pub->redrawTimeoutMs = 1000;
+
+	ImGui::Text("CPU: %.2f%% (session average %.3f%%)", perf.cpuPercent, perf.GetSessionCpuPercent());
+	HelpMarker("Percent of one CPU core used by this process, updated every second.\nWhile this window is visible, the UI redraws once a second to update it, which is included in the figure.");
+
+	ImGui::Text("Stick sampler: %s", feeder->IsSamplerRunning() ? "running" : "idle");
+	HelpMarker("The sampler for mouse-driven sticks only runs while a stick is off-center or the mouse is moving.");
+	ImGui::Text("Sampler ticks: %llu", static_cast<unsigned long long>(feeder->GetSamplerTicks()));
+	ImGui::Text("UI frames: %llu", static_cast<unsigned long long>(perf.uiFrames));
+	ImGui::Text("Message loop wakeups: %llu", static_cast<unsigned long long>(perf.wakeups));
+
+	ImGui::Separator();
+	ImGui::Text("Startup: input live after %.1f ms, ready after %.1f ms (%s)", perf.inputLiveMs, perf.startupMs, perf.startedHeadless ? "headless" : "with UI");
+	ImGui::Text("Working set: %zu KiB (%zu KiB at startup, %zu KiB peak)", GetProcessWorkingSet() / 1024, perf.startupWorkingSet / 1024, GetProcessPeakWorkingSet() / 1024);
+	HelpMarker("Start with --headless to skip creating the UI until it is shown from the tray icon or with the ShowUI hotkey.");
+	ImGui::Text("UI resources released %llu times, last %zu KiB -> %zu KiB", static_cast<unsigned long long>(perf.releaseCount), perf.workingSetBeforeRelease / 1024, perf.workingSetAfterRelease / 1024);
+	HelpMarker("GPU and font resources are released when the UI is hidden to tray, or has been minimized for 10 seconds.");
+}
+
 void UIStatePrivate::ShowButton(const X360Gamepad& gamepad, int gamepadId, X360Button btn, KeyCode boundKey) {
 	using enum X360Button;
 
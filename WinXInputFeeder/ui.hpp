@@ -14,6 +14,9 @@ public:
 	// If set to a valid gamepad user index, the next mouse click recieved by the input source will be used to set its mouse filter
 	// Note that it has to be a mouse button click, movements do not count (to prevent misinput).
 	/* [Out] */ int bindIdevFromNextMouse = -1;
+	// Redraw after this many milliseconds even if nothing happened, e.g. for periodically updated stats
+	// Set by Show() on every frame.
+	/* [Out] */ DWORD redrawTimeoutMs = INFINITE;
 
 public:
 	UIState(App&);
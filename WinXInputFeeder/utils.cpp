@@ -2,6 +2,9 @@
 
 #include "utils.hpp"
 
+#ifdef _WIN32
+#include <psapi.h>
+
 std::wstring Utf8ToWide(std::string_view utf8) {
     int len = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()), nullptr, 0);
     std::wstring result;
@@ -57,6 +60,86 @@ std::string GetLastErrorStrUtf8() noexcept {
     return msg;
 }
 
+int64_t QpcFrequency() noexcept {
+    static const int64_t freq = [] {
+        LARGE_INTEGER li;
+        QueryPerformanceFrequency(&li);
+        return li.QuadPart;
+    }();
+    return freq;
+}
+
+uint64_t GetProcessCpuTime() noexcept {
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0;
+    auto toU64 = [](FILETIME ft) { return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+    return toU64(kernel) + toU64(user);
+}
+
+size_t GetProcessWorkingSet() noexcept {
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return pmc.WorkingSetSize;
+}
+
+size_t GetProcessPeakWorkingSet() noexcept {
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return pmc.PeakWorkingSetSize;
+}
+#else
+// wchar_t is UTF-32 here; malformed sequences become U+FFFD
+std::wstring Utf8ToWide(std::string_view utf8) {
+    std::wstring result;
+    result.reserve(utf8.size());
+    for (size_t i = 0; i < utf8.size();) {
+        auto c = static_cast<unsigned char>(utf8[i]);
+        int len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+        if (len == 0 || i + len > utf8.size()) {
+            result.push_back(L'\uFFFD');
+            ++i;
+            continue;
+        }
+        char32_t cp = len == 1 ? c : c & (0x7F >> len);
+        for (int j = 1; j < len; ++j)
+            cp = (cp << 6) | (static_cast<unsigned char>(utf8[i + j]) & 0x3F);
+        result.push_back(static_cast<wchar_t>(cp));
+        i += len;
+    }
+    return result;
+}
+
+std::string WideToUtf8(std::wstring_view wide) {
+    std::string result;
+    result.reserve(wide.size());
+    for (wchar_t wc : wide) {
+        auto cp = static_cast<char32_t>(wc);
+        if (cp < 0x80) {
+            result.push_back(static_cast<char>(cp));
+        }
+        else if (cp < 0x800) {
+            result.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000) {
+            result.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            result.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else {
+            result.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            result.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+    return result;
+}
+#endif
+
 toml::table toml::parse_file(const std::filesystem::path& path) {
     // Modified from toml::parse_file()
 
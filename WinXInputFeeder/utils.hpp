@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <format>
 #include <filesystem>
 #include <functional>
@@ -8,9 +9,14 @@
 #include <utility>
 #include <vector>
 
-#define NOMINMAX
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+#include "platform.hpp"
+
+#ifndef _WIN32
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <shared_mutex>
+#endif
 
 #include <toml++/toml.h>
 
@@ -22,6 +28,7 @@
 #define UNIQUE_NAME(prefix) CONCAT(prefix, __COUNTER__)
 #define DISCARD UNIQUE_NAME(_discard)
 
+#ifdef _WIN32
 struct SrwExclusiveLock {
 	SRWLOCK* theLock;
 
@@ -49,22 +56,72 @@ struct SrwSharedLock {
 		ReleaseSRWLockShared(theLock);
 	}
 };
+#else
+using SRWLOCK = std::shared_mutex;
+#define SRWLOCK_INIT {}
+
+struct SrwExclusiveLock {
+	std::unique_lock<std::shared_mutex> theLock;
+
+	SrwExclusiveLock(SRWLOCK& lock) noexcept
+		: theLock{ lock } {}
+};
+
+struct SrwSharedLock {
+	std::shared_lock<std::shared_mutex> theLock;
+
+	SrwSharedLock(SRWLOCK& lock) noexcept
+		: theLock{ lock } {}
+};
+#endif
 
 std::wstring Utf8ToWide(std::string_view utf8);
 std::string WideToUtf8(std::wstring_view wide);
 
+#ifdef _WIN32
 std::wstring GetLastErrorStr() noexcept;
 std::string GetLastErrorStrUtf8() noexcept;
 
+inline int64_t QpcNow() noexcept {
+	LARGE_INTEGER li;
+	QueryPerformanceCounter(&li);
+	return li.QuadPart;
+}
+
+// Ticks per second of QpcNow(), queried once and cached
+int64_t QpcFrequency() noexcept;
+
+// User + kernel CPU time used by this process so far, in 100ns units
+uint64_t GetProcessCpuTime() noexcept;
+// Current and peak working set of this process in bytes, 0 on failure
+size_t GetProcessWorkingSet() noexcept;
+size_t GetProcessPeakWorkingSet() noexcept;
+#else
+// Monotonic nanoseconds elsewhere, so that QPC based math holds as is
+inline int64_t QpcNow() noexcept {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+inline int64_t QpcFrequency() noexcept { return 1'000'000'000; }
+#endif
+
 // Our extension to toml++
 namespace toml {
 	toml::table parse_file(const std::filesystem::path& path);
 }
 
-#ifdef _DEBUG
+#if defined(_DEBUG) && defined(_WIN32)
 #define LOG_DEBUG(msg, ...) OutputDebugStringW(std::format(L"[WinXInputEmu] " msg, __VA_ARGS__).c_str())
+// For a message without format arguments, does not allocate so it is usable in the input path
+#define LOG_DEBUG_STATIC(msg) OutputDebugStringW(L"[WinXInputEmu] " msg)
+#elif defined(_DEBUG)
+#define LOG_DEBUG(msg, ...) std::fputws(std::format(L"[WinXInputEmu] " msg L"\n", __VA_ARGS__).c_str(), stderr)
+#define LOG_DEBUG_STATIC(msg) std::fputws(L"[WinXInputEmu] " msg L"\n", stderr)
 #else
 #define LOG_DEBUG(...)
+#define LOG_DEBUG_STATIC(...)
 #endif
 
 template <typename TFunc>
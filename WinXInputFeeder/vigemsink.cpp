@@ -0,0 +1,56 @@
+#include "pch.hpp"
+
+#include "vigemsink.hpp"
+
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+ViGEm::ViGEm()
+	: hvigem{ vigem_alloc() }
+{
+	VIGEM_ERROR err;
+
+	err = vigem_connect(hvigem);
+	if (!VIGEM_SUCCESS(err))
+		throw std::runtime_error(std::format("Failed to connect ViGEm bus"));
+}
+
+ViGEm::~ViGEm() {
+	vigem_disconnect(hvigem);
+	vigem_free(hvigem);
+}
+
+ViGEm::ViGEm(ViGEm&& that) noexcept
+	: hvigem{ std::exchange(that.hvigem, nullptr) } {}
+
+ViGEm& ViGEm::operator=(ViGEm&& that) noexcept {
+	vigem_disconnect(hvigem);
+	vigem_free(hvigem);
+	hvigem = std::exchange(that.hvigem, nullptr);
+	return *this;
+}
+
+void* ViGEmSink::Plug(GamepadKind kind) {
+	PVIGEM_TARGET htarget = nullptr /*kind == GamepadKind::DS4 ? vigem_target_ds4_alloc() : vigem_target_x360_alloc()*/;
+
+	VIGEM_ERROR err;
+
+	//err = vigem_target_add(client.hvigem, htarget);
+	//if (!VIGEM_SUCCESS(err))
+	//	throw std::runtime_error(std::format("Failed to add {} gamepad to ViGEm bus", kind == GamepadKind::DS4 ? "DS4" : "X360"));
+	return htarget;
+}
+
+void ViGEmSink::Unplug(void* target) noexcept {
+	//vigem_target_remove(client.hvigem, static_cast<PVIGEM_TARGET>(target));
+	//vigem_target_free(static_cast<PVIGEM_TARGET>(target));
+}
+
+void ViGEmSink::SubmitX360(void* target, const XUSB_REPORT& report) noexcept {
+	//vigem_target_x360_update(client.hvigem, static_cast<PVIGEM_TARGET>(target), report);
+}
+
+void ViGEmSink::SubmitDS4(void* target, const DS4_REPORT_EX& report) noexcept {
+	//vigem_target_ds4_update_ex(client.hvigem, static_cast<PVIGEM_TARGET>(target), report);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "gamepadsink.hpp"
+
+#include <ViGEm/Client.h>
+
+struct ViGEm {
+	PVIGEM_CLIENT hvigem;
+
+	ViGEm();
+	~ViGEm();
+
+	ViGEm(const ViGEm&) = delete;
+	ViGEm& operator=(const ViGEm&) = delete;
+	ViGEm(ViGEm&&) noexcept;
+	ViGEm& operator=(ViGEm&&) noexcept;
+};
+
+// Plugs the engine's gamepads into the ViGEm bus
+class ViGEmSink : public GamepadSink {
+private:
+	ViGEm client;
+
+public:
+	void* Plug(GamepadKind kind) override;
+	void Unplug(void* target) noexcept override;
+	void SubmitX360(void* target, const XUSB_REPORT& report) noexcept override;
+	void SubmitDS4(void* target, const DS4_REPORT_EX& report) noexcept override;
+};
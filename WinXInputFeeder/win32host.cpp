@@ -0,0 +1,103 @@
+#include "pch.hpp"
+
+#include "win32host.hpp"
+
+#include "modelruntime.hpp"
+#include "utils.hpp"
+
+#include <format>
+#include <stdexcept>
+
+static void CALLBACK MouseCheckTimeProc(HWND hWnd, UINT message, UINT_PTR idTimer, DWORD dwTime) {
+	auto engine = reinterpret_cast<FeederEngine*>(idTimer);
+	engine->Update();
+}
+
+static void CALLBACK ActionTimerApc(LPVOID arg, DWORD dwTimerLowValue, DWORD dwTimerHighValue) {
+	auto engine = static_cast<FeederEngine*>(arg);
+	engine->RunActionTimers();
+}
+
+Win32EngineHost::Win32EngineHost(HWND eventHwnd)
+	: eventHwnd{ eventHwnd }
+{
+	// High resolution timers exist since Windows 10 1803, the regular ones are good to ~1ms with timeBeginPeriod()
+	hActionTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!hActionTimer)
+		hActionTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	if (!hActionTimer)
+		throw std::runtime_error(std::format("Error creating action timer: {}", GetLastErrorStrUtf8()));
+}
+
+Win32EngineHost::~Win32EngineHost() {
+	StopSampler();
+	CancelWaitableTimer(hActionTimer);
+	CloseHandle(hActionTimer);
+}
+
+bool Win32EngineHost::StartSampler(FeederEngine& engine, int periodMs) noexcept {
+	samplerTimer = SetTimer(eventHwnd, reinterpret_cast<UINT_PTR>(&engine), periodMs, MouseCheckTimeProc);
+	if (!samplerTimer) {
+		LOG_DEBUG_STATIC(L"Failed to register mouse check timer");
+		return false;
+	}
+	return true;
+}
+
+void Win32EngineHost::StopSampler() noexcept {
+	if (!samplerTimer)
+		return;
+	KillTimer(eventHwnd, samplerTimer);
+	samplerTimer = 0;
+}
+
+void Win32EngineHost::SetActionTimer(FeederEngine& engine, int64_t delayMicros) noexcept {
+	// Relative, in 100ns units
+	LARGE_INTEGER dueTime;
+	dueTime.QuadPart = -static_cast<LONGLONG>(delayMicros * 10);
+	if (!SetWaitableTimerEx(hActionTimer, &dueTime, 0, ActionTimerApc, &engine, nullptr, 0))
+		LOG_DEBUG_STATIC(L"Failed to set action timer");
+}
+
+void Win32EngineHost::CancelActionTimer() noexcept {
+	CancelWaitableTimer(hActionTimer);
+}
+
+void Win32EngineHost::PostKeymapsCompiled() noexcept {
+	PostMessageW(eventHwnd, kKeymapsCompiledMessage, 0, 0);
+}
+
+bool Win32EngineHost::StartKeySuppression(KeyboardInputMode mode) {
+	if (keySuppressor)
+		return true;
+
+	try {
+		keySuppressor = std::make_unique<KeySuppressor>(mode);
+	}
+	catch (const std::exception& err) {
+		// Not essential, the gamepads work without it
+		LOG_DEBUG("Key suppression disabled: {}", Utf8ToWide(err.what()));
+		return false;
+	}
+	return true;
+}
+
+void Win32EngineHost::PublishSuppressedKeys(std::span<const KeySuppressDevice> devices) noexcept {
+	if (keySuppressor)
+		keySuppressor->Publish(devices);
+}
+
+void Win32EngineHost::StartForegroundTracking(FeederEngine& engine) {
+	if (foregroundHook)
+		return;
+
+	try {
+		foregroundHook = std::make_unique<ForegroundHook>([](void* ctx, std::string_view exePath, int64_t qpcEvent) {
+			static_cast<FeederEngine*>(ctx)->OnForegroundApp(exePath, qpcEvent);
+		}, &engine);
+	}
+	catch (const std::exception& err) {
+		// Not essential, profiles can still be switched by hand
+		LOG_DEBUG("Foreground tracking disabled: {}", Utf8ToWide(err.what()));
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "enginehost.hpp"
+#include "foregroundhook.hpp"
+#include "keysuppress.hpp"
+
+#include <memory>
+
+// Posted to the engine's event window when keymaps compiled in the background are ready
+// The window procedure must call FeederEngine::InstallCompiledKeymaps() in response.
+constexpr UINT kKeymapsCompiledMessage = WM_APP + 2;
+
+// Runs the engine on the thread owning its event window, which must pump messages and wait alertably
+// The sampler is a window timer, timed actions are APCs of a waitable timer, and hooks deliver their events to the same thread.
+// Must outlive the engine.
+class Win32EngineHost : public EngineHost {
+private:
+	HWND eventHwnd;
+	// 0 while the sampler is stopped
+	UINT_PTR samplerTimer = 0;
+	HANDLE hActionTimer = nullptr;
+	// nullptr unless Config::suppressBoundKeys
+	std::unique_ptr<KeySuppressor> keySuppressor;
+	// nullptr until StartForegroundTracking()
+	std::unique_ptr<ForegroundHook> foregroundHook;
+
+public:
+	// Throws std::runtime_error if the action timer can't be created
+	explicit Win32EngineHost(HWND eventHwnd);
+	~Win32EngineHost();
+
+	Win32EngineHost(const Win32EngineHost&) = delete;
+	Win32EngineHost& operator=(const Win32EngineHost&) = delete;
+
+	bool StartSampler(FeederEngine& engine, int periodMs) noexcept override;
+	void StopSampler() noexcept override;
+	void SetActionTimer(FeederEngine& engine, int64_t delayMicros) noexcept override;
+	void CancelActionTimer() noexcept override;
+	void PostKeymapsCompiled() noexcept override;
+
+	bool StartKeySuppression(KeyboardInputMode mode) override;
+	void PublishSuppressedKeys(std::span<const KeySuppressDevice> devices) noexcept override;
+	void StartForegroundTracking(FeederEngine& engine) override;
+};
@@ -7,4 +7,7 @@
 // Defined in dllmain.cpp
 
 extern HMODULE gHModule;
-extern HHOOK gInstalledHook;
+
+// Installs GetMsgProc as a global WH_GETMESSAGE hook, which loads this DLL into every GUI process of the same bitness
+// Called by the feeder, after it created the suppression mask mapping. Remove with UnhookWindowsHookEx().
+extern "C" __declspec(dllexport) HHOOK InstallKeySuppressHook();
@@ -1,4 +1,5 @@
 #include "dll.hpp"
+#include "suppressmask.hpp"
 #include "utils.hpp"
 
 #include <cstddef>
@@ -10,20 +11,75 @@
 #include <Windows.h>
 
 HMODULE gHModule;
-HHOOK gInstalledHook;
+// Mapped read-only in hooked processes, nullptr if the feeder isn't running or this is the feeder itself
+static const SuppressMaskTable* gTable;
+static HANDLE gHMapping;
 
+// The same left/right split as the feeder's Vkey mode
+static uint8_t SplitModifierVKey(WPARAM vkey, uint32_t scanCode, bool extended) noexcept {
+	switch (vkey) {
+	case VK_SHIFT: return scanCode == 0x36 ? VK_RSHIFT : VK_LSHIFT;
+	case VK_CONTROL: return extended ? VK_RCONTROL : VK_LCONTROL;
+	case VK_MENU: return extended ? VK_RMENU : VK_LMENU;
+	default: return static_cast<uint8_t>(vkey);
+	}
+}
+
+// \return KeyCode of a WM_KEYDOWN/WM_KEYUP/WM_SYSKEYDOWN/WM_SYSKEYUP message
+static uint8_t KeyCodeFromKeyMessage(const SuppressMaskTable& table, WPARAM wParam, LPARAM lParam) noexcept {
+	uint32_t scanCode = (lParam >> 16) & 0xFF;
+	bool extended = (lParam >> 24) & 1;
+	if (table.mode == std::to_underlying(SuppressKeyMode::ScanCode))
+		return table.scanCodeKeys[SuppressScanCodeSlotOf(scanCode, extended, false)];
+	return wParam > 0xFF ? 0xFF : SplitModifierVKey(wParam, scanCode, extended);
+}
+
+// \return true if the message should be removed
+static bool FilterRawInput(const SuppressMaskTable& table, HRAWINPUT hRawInput) noexcept {
+	RAWINPUT ri;
+	UINT size = sizeof(ri);
+	// Keyboard input always fits; anything bigger is HID input, which we leave alone
+	if (GetRawInputData(hRawInput, RID_INPUT, &ri, &size, sizeof(RAWINPUTHEADER)) == static_cast<UINT>(-1))
+		return false;
+	if (ri.header.dwType != RIM_TYPEKEYBOARD)
+		return false;
+
+	const auto& kbd = ri.data.keyboard;
+	uint8_t key;
+	if (table.mode == std::to_underlying(SuppressKeyMode::ScanCode))
+		key = table.scanCodeKeys[SuppressScanCodeSlotOf(kbd.MakeCode, kbd.Flags & RI_KEY_E0, kbd.Flags & RI_KEY_E1)];
+	else if (kbd.VKey > 0xFF)
+		return false;
+	else
+		key = SplitModifierVKey(kbd.VKey, kbd.MakeCode, kbd.Flags & RI_KEY_E0);
+	if (key == 0xFF)
+		return false;
+
+	return IsKeySuppressed(table, reinterpret_cast<uintptr_t>(ri.header.hDevice), key);
+}
+
+// Runs inside every hooked application's message loop, so it must stay far below the hook timeout: no locks, no allocations
 LRESULT CALLBACK GetMsgProc(int code, WPARAM wParam, LPARAM lParam) {
 	if (code < 0)
 		return CallNextHookEx(nullptr, code, wParam, lParam);
 
-	if (code == HC_ACTION) {
+	if (code == HC_ACTION && gTable) {
 		auto msg = reinterpret_cast<MSG*>(lParam);
 		switch (msg->message) {
 		case WM_KEYDOWN:
 		case WM_KEYUP:
-			// Remove the message
-			msg->message = 0;
-			return 0;
+		case WM_SYSKEYDOWN:
+		case WM_SYSKEYUP: {
+			uint8_t key = KeyCodeFromKeyMessage(*gTable, msg->wParam, msg->lParam);
+			if (key != 0xFF && IsKeySuppressed(*gTable, key))
+				// Remove the message
+				msg->message = WM_NULL;
+		} break;
+
+		case WM_INPUT:
+			if (FilterRawInput(*gTable, reinterpret_cast<HRAWINPUT>(msg->lParam)))
+				msg->message = WM_NULL;
+			break;
 
 		default:
 			break;
@@ -33,17 +89,45 @@ LRESULT CALLBACK GetMsgProc(int code, WPARAM wParam, LPARAM lParam) {
 	return CallNextHookEx(nullptr, code, wParam, lParam);
 }
 
+extern "C" __declspec(dllexport) HHOOK InstallKeySuppressHook() {
+	HHOOK hook = SetWindowsHookExW(WH_GETMESSAGE, GetMsgProc, gHModule, 0);
+	if (!hook)
+		LOG_DEBUG("Failed to install hook: {}", GetLastErrorStr());
+	return hook;
+}
+
+static void MapSuppressMaskTable() noexcept {
+	gHMapping = OpenFileMappingW(FILE_MAP_READ, FALSE, kSuppressMaskMappingName);
+	if (!gHMapping)
+		return;
+
+	auto table = static_cast<const SuppressMaskTable*>(MapViewOfFile(gHMapping, FILE_MAP_READ, 0, 0, sizeof(SuppressMaskTable)));
+	if (!table)
+		return;
+	if (table->magic.load(std::memory_order_acquire) != kSuppressMaskMagic || table->feederProcessId == GetCurrentProcessId()) {
+		UnmapViewOfFile(table);
+		return;
+	}
+	gTable = table;
+}
+
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID lpReserved) noexcept {
 	switch (fdwReason) {
 	case DLL_PROCESS_ATTACH:
 		gHModule = hModule;
-		gInstalledHook = SetWindowsHookExW(WH_GETMESSAGE, GetMsgProc, nullptr, GetCurrentThreadId());
+		// Only kernel32 calls, which are safe under the loader lock
+		MapSuppressMaskTable();
+		break;
 
+	case DLL_PROCESS_DETACH:
+		if (gTable)
+			UnmapViewOfFile(gTable);
+		if (gHMapping)
+			CloseHandle(gHMapping);
 		break;
 
 	case DLL_THREAD_ATTACH:
 	case DLL_THREAD_DETACH:
-	case DLL_PROCESS_DETACH:
 		break;
 	}
 	return TRUE;
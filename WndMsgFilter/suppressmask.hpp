@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Which keys the hook should hide from the applications it is injected into.
+// Shared through a named file mapping between the feeder, the only writer, and every hooked process.
+// Readers never lock: each device entry is a seqlock, and a single key is a single atomic word load.
+// No Windows types in here, so that the protocol compiles (and can be exercised) anywhere.
+
+constexpr wchar_t kSuppressMaskMappingName[] = L"Local\\WinXInputFeeder.SuppressMask";
+// "WXSM", written last by the feeder once the table is fully initialized
+constexpr uint32_t kSuppressMaskMagic = 0x4D535857;
+constexpr int kSuppressMaxDevices = 16;
+constexpr int kSuppressScanCodeSlotCount = 512;
+
+// Shared with 32 bit hooked processes, so the layout must not depend on the bitness
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+enum class SuppressKeyMode : uint32_t {
+	// Keys are Vkeys, with left/right modifiers told apart
+	VirtualKey,
+	// Keys are looked up by scan code in SuppressMaskTable::scanCodeKeys
+	ScanCode,
+};
+
+// 256 bit set, indexed by the feeder's KeyCode
+struct SuppressKeyMask {
+	std::atomic<uint64_t> words[4];
+
+	bool Test(uint8_t key) const noexcept {
+		return (words[key >> 6].load(std::memory_order_relaxed) >> (key & 63)) & 1;
+	}
+};
+
+struct SuppressDeviceEntry {
+	// Odd while the feeder is rewriting the entry
+	std::atomic<uint32_t> seq;
+	// Raw input device handle as an integer, 0 for a free entry
+	std::atomic<uint64_t> hDevice;
+	SuppressKeyMask keys;
+};
+
+struct SuppressMaskTable {
+	std::atomic<uint32_t> magic;
+	// SuppressKeyMode
+	uint32_t mode;
+	// The feeder must not filter its own input
+	uint32_t feederProcessId;
+	// Union of all devices' masks, for WM_KEYDOWN and friends which don't tell which device they came from
+	SuppressKeyMask anyDevice;
+	SuppressDeviceEntry devices[kSuppressMaxDevices];
+	// Scan code slot (see SuppressScanCodeSlotOf()) -> KeyCode, 0xFF for none
+	uint8_t scanCodeKeys[kSuppressScanCodeSlotCount];
+};
+
+// Same layout as the feeder's scan code table: make codes are 7 bits, so E1 takes bit 7 and E0 bit 8
+constexpr int SuppressScanCodeSlotOf(uint32_t makeCode, bool e0, bool e1) noexcept {
+	return (makeCode & 0x7F) | (e1 << 7) | (e0 << 8);
+}
+
+/* Reader side, hooked processes */
+
+inline bool IsKeySuppressed(const SuppressMaskTable& table, uint8_t key) noexcept {
+	return table.anyDevice.Test(key);
+}
+
+inline bool IsKeySuppressed(const SuppressMaskTable& table, uint64_t hDevice, uint8_t key) noexcept {
+	for (const auto& entry : table.devices) {
+		// Cheap pre-check without the seqlock, entries of other devices are the common case
+		if (entry.hDevice.load(std::memory_order_relaxed) != hDevice)
+			continue;
+
+		while (true) {
+			uint32_t seq1 = entry.seq.load(std::memory_order_acquire);
+			if (seq1 & 1)
+				continue;
+			uint64_t h = entry.hDevice.load(std::memory_order_relaxed);
+			bool set = entry.keys.Test(key);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (entry.seq.load(std::memory_order_relaxed) != seq1)
+				continue;
+			// The entry may have been handed to another device in between
+			if (h != hDevice)
+				break;
+			return set;
+		}
+	}
+	return false;
+}
+
+/* Writer side, the feeder */
+
+inline void WriteSuppressDeviceEntry(SuppressDeviceEntry& entry, uint64_t hDevice, const uint64_t (&keys)[4]) noexcept {
+	uint32_t seq = entry.seq.load(std::memory_order_relaxed);
+	entry.seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	entry.hDevice.store(hDevice, std::memory_order_relaxed);
+	for (int i = 0; i < 4; ++i)
+		entry.keys.words[i].store(keys[i], std::memory_order_relaxed);
+
+	entry.seq.store(seq + 2, std::memory_order_release);
+}
+
+// Recompute SuppressMaskTable::anyDevice, after any entries changed
+inline void UpdateSuppressAnyDevice(SuppressMaskTable& table) noexcept {
+	uint64_t any[4] = {};
+	for (const auto& entry : table.devices) {
+		if (entry.hDevice.load(std::memory_order_relaxed) == 0)
+			continue;
+		for (int i = 0; i < 4; ++i)
+			any[i] |= entry.keys.words[i].load(std::memory_order_relaxed);
+	}
+	for (int i = 0; i < 4; ++i)
+		table.anyDevice.words[i].store(any[i], std::memory_order_relaxed);
+}